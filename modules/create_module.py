@@ -48,8 +48,8 @@ def create_module_json(module_dir, module_name, author, description, version, co
         "version": version,
         "description": description,
         "author": author,
-        "core_version": core_version,
-        "enabled": True,
+        "trinitycore_version": core_version,
+        "enabled_by_default": True,
         "dependencies": [],
         "features": [
             "player_events",
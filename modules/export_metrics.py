@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+TrinityCore Plugin Metrics Exporter
+Reads the plugin metrics region the worldserver maps at Plugins.Metrics.File
+and prints it in the Prometheus text format, or serves it over HTTP. The
+region is only read, the worldserver is never contacted.
+
+Usage:
+    python export_metrics.py <metrics file>
+    python export_metrics.py --listen 9464 <metrics file>
+
+The layout must match src/server/game/Plugins/PluginMetrics.h. Values are in
+the byte order of the worldserver host:
+
+    header          64 bytes    magic, format version, shard count, capacity,
+                                metric count, descriptor and value offsets,
+                                region size, start time, process id
+    descriptors     256 bytes   name, help, type, bucket count, shard count,
+                                shard stride, value offset, bucket bounds
+    values                      per metric shard count * shard stride bytes
+"""
+
+import sys
+import mmap
+import struct
+import argparse
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+METRICS_MAGIC = 0x544D4354          # "TCMT"
+METRICS_FORMAT_VERSION = 1
+
+HEADER_FORMAT = '=IHHIIQQQQI12x'
+DESCRIPTOR_FORMAT = '=64s48sBBHIQ16d'
+
+COUNTER = 1
+GAUGE = 2
+HISTOGRAM = 3
+
+TYPE_NAMES = {
+    COUNTER: 'counter',
+    GAUGE: 'gauge',
+    HISTOGRAM: 'histogram'
+}
+
+def c_string(data):
+    return data.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+def read_metrics(region):
+    """Yield (name, help, type, value) from a mapped region, value is a number or (buckets, sum)"""
+    magic, version, shard_count, capacity, count, descriptor_offset, value_offset, size, start_time, process_id = \
+        struct.unpack_from(HEADER_FORMAT, region, 0)
+
+    if magic != METRICS_MAGIC:
+        raise ValueError("not a plugin metrics region, or the worldserver is still creating it")
+    if version != METRICS_FORMAT_VERSION:
+        raise ValueError(f"unsupported format version {version}")
+    if size > len(region) or count > capacity:
+        raise ValueError("truncated metrics region")
+
+    descriptor_size = struct.calcsize(DESCRIPTOR_FORMAT)
+
+    for index in range(count):
+        fields = struct.unpack_from(DESCRIPTOR_FORMAT, region, descriptor_offset + index * descriptor_size)
+        name, help_text, metric_type, bucket_count, shards, stride, offset = fields[:7]
+        bounds = fields[7:7 + bucket_count]
+
+        if metric_type == COUNTER:
+            value = sum(struct.unpack_from('=Q', region, offset + shard * stride)[0] for shard in range(shards))
+        elif metric_type == GAUGE:
+            value = struct.unpack_from('=q', region, offset)[0]
+        elif metric_type == HISTOGRAM:
+            buckets = [0] * (bucket_count + 1)
+            total = 0.0
+            for shard in range(shards):
+                cells = struct.unpack_from(f'={bucket_count + 1}Qd', region, offset + shard * stride)
+                for bucket in range(bucket_count + 1):
+                    buckets[bucket] += cells[bucket]
+                total += cells[-1]
+            value = (list(zip(bounds, buckets)) + [(float('inf'), buckets[-1])], total)
+        else:
+            continue
+
+        yield c_string(name), c_string(help_text), metric_type, value
+
+def format_prometheus(region):
+    lines = []
+    for name, help_text, metric_type, value in read_metrics(region):
+        if help_text:
+            lines.append(f"# HELP {name} {help_text}")
+        lines.append(f"# TYPE {name} {TYPE_NAMES[metric_type]}")
+
+        if metric_type == HISTOGRAM:
+            buckets, total = value
+            cumulative = 0
+            for bound, count in buckets:
+                cumulative += count
+                label = '+Inf' if bound == float('inf') else repr(bound)
+                lines.append(f'{name}_bucket{{le="{label}"}} {cumulative}')
+            lines.append(f"{name}_sum {total!r}")
+            lines.append(f"{name}_count {cumulative}")
+        else:
+            lines.append(f"{name} {value}")
+
+    return '\n'.join(lines) + '\n'
+
+def open_region(path):
+    with open(path, 'rb') as f:
+        return mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+def serve(path, port):
+    class Handler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path != '/metrics':
+                self.send_error(404)
+                return
+
+            try:
+                # Mapped again per scrape, a restarted worldserver recreates the file
+                region = open_region(path)
+                try:
+                    body = format_prometheus(region).encode('utf-8')
+                finally:
+                    region.close()
+            except (OSError, ValueError, struct.error) as e:
+                self.send_error(503, str(e))
+                return
+
+            self.send_response(200)
+            self.send_header('Content-Type', 'text/plain; version=0.0.4')
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, format, *args):
+            pass
+
+    print(f"Serving {path} on :{port}/metrics")
+    HTTPServer(('', port), Handler).serve_forever()
+
+def main():
+    parser = argparse.ArgumentParser(description='Export the plugin metrics region of a worldserver')
+    parser.add_argument('--listen', type=int, metavar='PORT', help='Serve /metrics over HTTP instead of printing once')
+    parser.add_argument('file', help='Plugins.Metrics.File of the worldserver')
+
+    args = parser.parse_args()
+
+    if args.listen:
+        serve(args.file, args.listen)
+        return 0
+
+    try:
+        region = open_region(args.file)
+        sys.stdout.write(format_prometheus(region))
+        return 0
+
+    except (OSError, ValueError, struct.error) as e:
+        print(f"Error reading plugin metrics: {e}", file=sys.stderr)
+        return 1
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+"""
+TrinityCore Module Manifest Generator
+Packs the module.json files of all modules into one binary manifest that the
+plugin manager maps at startup, so load order, enabled state, dependencies and
+conflicts are known without opening any module library.
+
+Usage:
+    python generate_manifest.py --events <IPlugin.h> --output <modules.manifest> <module.json>...
+    python generate_manifest.py --events <IPlugin.h> --compiled-events <PluginCompiledEvents.h> <module.json>...
+
+With --compiled-events the manifest is not written, the header defines
+TRINITY_PLUGIN_COMPILED_EVENTS as the events the given enabled modules declare,
+all events when one of them has no 'events' list (see PluginHooks.h).
+
+The layout must match src/server/game/Plugins/PluginManifest.h. All values are
+little endian:
+
+    header      32 bytes    magic, format version, event count, module count,
+                            string table offset and size, reference table
+                            offset, FNV-1a checksum of everything after the header
+    records     40 bytes    one per module, sorted by load order, priority, name
+    references  4 bytes     string offsets, the dependencies of a module followed
+                            by its conflicts and its interfaces
+    strings                 NUL terminated UTF-8
+"""
+
+import os
+import re
+import sys
+import json
+import struct
+import argparse
+from pathlib import Path
+
+MANIFEST_MAGIC = 0x4D504354         # "TCPM"
+MANIFEST_FORMAT_VERSION = 1
+
+HEADER_FORMAT = '<IHHIIIII4x'
+RECORD_FORMAT = '<IIIIHHiQBBHI'
+
+FLAG_ENABLED = 0x01
+FLAG_HAS_EVENTS = 0x02
+FLAG_LAZY = 0x04
+
+PRIORITIES = {
+    'lowest': 0,
+    'low': 1,
+    'normal': 2,
+    'high': 3,
+    'highest': 4,
+    'critical': 5
+}
+
+# Every top level key a module.json may use, anything else is most likely a typo
+KNOWN_KEYS = {
+    'name', 'version', 'description', 'author', 'website', 'repository', 'license',
+    'trinitycore_version', 'api_version', 'dependencies', 'tags', 'enabled_by_default',
+    'requires_database', 'database_version', 'priority', 'load_order', 'library', 'lazy',
+    'events', 'interfaces', 'plugin_class', 'plugin_header', 'features', 'requirements',
+    'permissions', 'configuration', 'installation', 'changelog'
+}
+
+def read_event_names(header_file):
+    """Read the PluginEvent enum from IPlugin.h, the manifest stores events as bits of that enum"""
+    content = Path(header_file).read_text(encoding='utf-8')
+    
+    match = re.search(r'enum class PluginEvent\s*:\s*\w+\s*\{(.*?)\};', content, re.S)
+    if not match:
+        raise ValueError(f"PluginEvent enum not found in {header_file}")
+    
+    events = {}
+    for name, value in re.findall(r'(\w+)\s*=\s*(\d+)', match.group(1)):
+        events[name.lower()] = int(value)
+    
+    return events
+
+def fnv1a(data):
+    """32 bit FNV-1a, PluginManifest::Checksum"""
+    value = 0x811C9DC5
+    for byte in data:
+        value = ((value ^ byte) * 0x01000193) & 0xFFFFFFFF
+    return value
+
+class StringTable:
+    def __init__(self):
+        self.data = bytearray()
+        self.offsets = {}
+    
+    def add(self, text):
+        if text not in self.offsets:
+            self.offsets[text] = len(self.data)
+            self.data += text.encode('utf-8') + b'\0'
+        return self.offsets[text]
+
+def read_module(json_file, events):
+    """Extract the fields the plugin manager needs from one module.json"""
+    with open(json_file, encoding='utf-8') as f:
+        data = json.load(f)
+    
+    unknown = sorted(set(data) - KNOWN_KEYS)
+    if unknown:
+        raise ValueError(f"{json_file}: unknown keys {', '.join(repr(key) for key in unknown)}")
+    
+    name = data.get('name')
+    if not name:
+        raise ValueError(f"{json_file}: missing 'name' field")
+    
+    priority = str(data.get('priority', 'normal')).lower()
+    if priority not in PRIORITIES:
+        raise ValueError(f"{json_file}: unknown priority '{priority}'")
+    
+    module = {
+        'name': name,
+        'version': data.get('version', '1.0.0'),
+        'library': data.get('library', name),
+        'dependencies': list(data.get('dependencies', [])),
+        'conflicts': list(data.get('requirements', {}).get('conflicting_modules', [])),
+        'interfaces': list(data.get('interfaces', [])),
+        'priority': PRIORITIES[priority],
+        'load_order': int(data.get('load_order', 100)),
+        'enabled': bool(data.get('enabled_by_default', True)),
+        'lazy': bool(data.get('lazy', False)),
+        'event_mask': 0,
+        'has_events': 'events' in data
+    }
+    
+    for event in data.get('events', []):
+        if event not in events:
+            raise ValueError(f"{json_file}: unknown event '{event}'")
+        module['event_mask'] |= 1 << events[event]
+    
+    return module
+
+def build_manifest(modules, event_count):
+    modules.sort(key=lambda module: (module['load_order'], -module['priority'], module['name']))
+    
+    strings = StringTable()
+    references = []
+    records = bytearray()
+    
+    for module in modules:
+        reference_index = len(references)
+        references += [strings.add(name) for name in module['dependencies']]
+        references += [strings.add(name) for name in module['conflicts']]
+        references += [strings.add(name) for name in module['interfaces']]
+        
+        flags = 0
+        if module['enabled']:
+            flags |= FLAG_ENABLED
+        if module['has_events']:
+            flags |= FLAG_HAS_EVENTS
+        if module['lazy']:
+            flags |= FLAG_LAZY
+        
+        records += struct.pack(RECORD_FORMAT,
+                               strings.add(module['name']),
+                               strings.add(module['version']),
+                               strings.add(module['library']),
+                               reference_index,
+                               len(module['dependencies']),
+                               len(module['conflicts']),
+                               module['load_order'],
+                               module['event_mask'],
+                               module['priority'],
+                               flags,
+                               len(module['interfaces']),
+                               0)
+    
+    header_size = struct.calcsize(HEADER_FORMAT)
+    reference_offset = header_size + len(records)
+    string_offset = reference_offset + 4 * len(references)
+    
+    payload = bytes(records) + struct.pack(f'<{len(references)}I', *references) + bytes(strings.data)
+    
+    header = struct.pack(HEADER_FORMAT,
+                         MANIFEST_MAGIC,
+                         MANIFEST_FORMAT_VERSION,
+                         event_count,
+                         len(modules),
+                         string_offset,
+                         len(strings.data),
+                         reference_offset,
+                         fnv1a(payload))
+    
+    return header + payload
+
+def build_compiled_events(modules, events):
+    """PluginCompiledEvents.h, the hook sites of every other event are compiled out"""
+    enabled = [module for module in modules if module['enabled']]
+    undeclared = [module['name'] for module in enabled if not module['has_events']]
+    
+    if undeclared:
+        mask = (1 << len(events)) - 1
+        comment = f"{', '.join(sorted(undeclared))} {'declares' if len(undeclared) == 1 else 'declare'} no events, all hooks are compiled"
+    else:
+        mask = 0
+        for module in enabled:
+            mask |= module['event_mask']
+        names = [name for name, value in sorted(events.items(), key=lambda item: item[1]) if mask & (1 << value)]
+        comment = ', '.join(names) if names else 'no events'
+    
+    header = (
+        "/*\n"
+        " * Auto-generated from the events of the enabled modules\n"
+        " * Do not edit this file manually\n"
+        " */\n\n"
+        "#ifndef TRINITY_PLUGIN_COMPILED_EVENTS_H\n"
+        "#define TRINITY_PLUGIN_COMPILED_EVENTS_H\n\n"
+        f"// {comment}\n"
+        f"#define TRINITY_PLUGIN_COMPILED_EVENTS 0x{mask:X}ULL\n\n"
+        "#endif // TRINITY_PLUGIN_COMPILED_EVENTS_H\n"
+    )
+    
+    return header.encode('utf-8'), comment
+
+def write_if_changed(output, data):
+    output = Path(output)
+    output.parent.mkdir(parents=True, exist_ok=True)
+    
+    # Only touch the file when it changed, and replace it instead of
+    # rewriting it in place since a running server may have the manifest mapped
+    if not output.exists() or output.read_bytes() != data:
+        temporary = output.with_name(output.name + '.tmp')
+        temporary.write_bytes(data)
+        os.replace(temporary, output)
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate the binary module manifest read by the plugin manager')
+    parser.add_argument('--events', required=True, help='Path to IPlugin.h, source of the PluginEvent enum')
+    outputs = parser.add_mutually_exclusive_group(required=True)
+    outputs.add_argument('--output', help='Manifest file to write')
+    outputs.add_argument('--compiled-events', help='Write the compiled events header instead of the manifest')
+    parser.add_argument('modules', nargs='*', help='module.json files')
+    
+    args = parser.parse_args()
+    
+    try:
+        events = read_event_names(args.events)
+        modules = [read_module(json_file, events) for json_file in args.modules]
+        
+        names = [module['name'] for module in modules]
+        duplicates = sorted({name for name in names if names.count(name) > 1})
+        if duplicates:
+            raise ValueError(f"duplicate module names: {', '.join(duplicates)}")
+        
+        if args.compiled_events:
+            header, comment = build_compiled_events(modules, events)
+            write_if_changed(args.compiled_events, header)
+            print(f"Compiled plugin hooks: {comment}")
+            return 0
+        
+        manifest = build_manifest(modules, len(events))
+        write_if_changed(args.output, manifest)
+        
+        print(f"Module manifest: {len(modules)} modules, {len(manifest)} bytes")
+        return 0
+    
+    except (OSError, ValueError) as e:
+        print(f"Error generating module manifest: {e}")
+        return 1
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,11 @@
+-- Player data of the example module, written when PlayerData.SaveToDatabase is enabled
+DROP TABLE IF EXISTS `example_module_player_data`;
+CREATE TABLE `example_module_player_data` (
+  `guid` int unsigned NOT NULL,
+  `login_count` int unsigned NOT NULL DEFAULT '0',
+  `session_start` int unsigned NOT NULL DEFAULT '0',
+  `last_seen` int unsigned NOT NULL DEFAULT '0',
+  `total_play_time` int unsigned NOT NULL DEFAULT '0',
+  `last_level_up` int unsigned NOT NULL DEFAULT '0',
+  PRIMARY KEY (`guid`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4;
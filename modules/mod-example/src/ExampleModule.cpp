@@ -16,6 +16,8 @@
  */
 
 #include "ExampleModule.h"
+#include "PluginManager.h"
+#include "PluginStateBlob.h"
 #include "Player.h"
 #include "Chat.h"
 #include "World.h"
@@ -26,7 +28,7 @@
 #include "DatabaseEnv.h"
 #include "ObjectMgr.h"
 #include "GameTime.h"
-#include <fstream>
+#include <filesystem>
 #include <sstream>
 #include <iomanip>
 
@@ -60,14 +62,14 @@ public:
         }
     }
     
-    void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg) override
+    void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string_view msg) override
     {
         if (_module && _module->IsEnabled())
         {
             _module->HandlePlayerChat(player, type, lang, msg);
         }
     }
-    
+
 private:
     ExampleModule* _module;
 };
@@ -85,7 +87,7 @@ public:
             return true;
         }
         
-        std::ostringstream ss;
+        PluginArenaStringStream ss;
         ss << "Example Module Information:\n";
         ss << "Version: " << module->GetVersion() << "\n";
         ss << "Status: " << (module->IsEnabled() ? "Enabled" : "Disabled") << "\n";
@@ -109,20 +111,20 @@ public:
         Player* player = handler->GetSession()->GetPlayer();
         if (!player)
             return false;
-            
-        auto playerData = module->GetPlayerData(player->GetGUID());
-        if (!playerData)
+        
+        ExampleModule::PlayerData playerData;
+        if (!module->GetPlayerData(player->GetGUID(), playerData))
         {
             handler->SendSysMessage("No data found for your character.");
             return true;
         }
         
-        std::ostringstream ss;
+        PluginArenaStringStream ss;
         ss << "Your Statistics:\n";
-        ss << "Login count: " << playerData->loginCount << "\n";
-        ss << "Time played this session: " << (GameTime::GetGameTime() - playerData->sessionStartTime) << " seconds\n";
-        ss << "Last level up: " << (playerData->lastLevelUpTime > 0 ? 
-            std::to_string(GameTime::GetGameTime() - playerData->lastLevelUpTime) + " seconds ago" : "Never");
+        ss << "Login count: " << playerData.loginCount << "\n";
+        ss << "Time played this session: " << (GameTime::GetGameTime() - playerData.sessionStartTime) << " seconds\n";
+        ss << "Last level up: " << (playerData.lastLevelUpTime > 0 ? 
+            std::to_string(GameTime::GetGameTime() - playerData.lastLevelUpTime) + " seconds ago" : "Never");
         
         handler->SendSysMessage(ss.str().c_str());
         return true;
@@ -158,10 +160,28 @@ ExampleModule::ExampleModule()
     , _eventHandler(nullptr)
     , _totalLogins(0)
     , _totalLevelUps(0)
-    , _lastStatsUpdate(0)
-    , _lastConfigCheck(0)
+    , _isRunning(false)
 {
     _instance = this;
+    
+    // Settings read from event handlers and timers, resolved by LoadConfiguration()
+    _statsSaveInterval = _settings.Bind<uint32>("Statistics.SaveInterval", 300);
+    _statsFileName = _settings.Bind<std::string>("Statistics.FileName", "example_module_stats.bin");
+    _asyncOperations = _settings.Bind<bool>("Performance.AsyncOperations", true);
+    _chatLogging = _settings.Bind<bool>("Features.ChatLogging", false);
+    _cleanupInterval = _settings.Bind<uint32>("PlayerData.CleanupInterval", 3600);
+    _persistOffline = _settings.Bind<bool>("PlayerData.PersistOffline", true);
+    _offlineRetention = _settings.Bind<uint32>("PlayerData.OfflineRetention", 604800);
+    _saveToDatabase = _settings.Bind<bool>("PlayerData.SaveToDatabase", false);
+    _maxEntries = _settings.Bind<uint32>("PlayerData.MaxEntries", 10000);
+    _hotReload = _settings.Bind<bool>("Advanced.EnableHotReload", true);
+    
+    // Registered by name, a reloaded module keeps counting into the same metrics
+    _loginsMetric = sPluginMetrics->GetCounter("example_player_logins_total", "Player logins");
+    _levelUpsMetric = sPluginMetrics->GetCounter("example_player_level_ups_total", "Player level ups");
+    _onlinePlayersMetric = sPluginMetrics->GetGauge("example_players_online", "Players logged in");
+    _sessionLengthMetric = sPluginMetrics->GetHistogram("example_session_length_seconds", "Session length",
+        { 60, 300, 900, 1800, 3600, 7200, 14400, 28800 });
 }
 
 ExampleModule::~ExampleModule()
@@ -202,8 +222,9 @@ bool ExampleModule::Initialize()
     // Initialize statistics
     _totalLogins = 0;
     _totalLevelUps = 0;
-    _lastStatsUpdate = GameTime::GetGameTime();
-    _lastConfigCheck = GameTime::GetGameTime();
+    
+    if (_config.statisticsEnabled)
+        LoadStatistics();
     
     _enabled = true;
     
@@ -211,21 +232,49 @@ bool ExampleModule::Initialize()
     return true;
 }
 
+void ExampleModule::Start()
+{
+    // World thread only, Initialize() may run next to other plugins on the worker pool
+    sPluginManager->GetSweeper().Register(_playerData);
+    sPluginManager->GetSweeper().Register(_playerValues);
+    ScheduleTimers();
+    
+    // Edits to the module's own file arrive through OnConfigChanged(), parsed off the world thread
+    if (*_hotReload)
+        sPluginManager->WatchPluginConfig("ExampleModule", (std::filesystem::path(sConfigMgr->GetFilename()).parent_path() / "ExampleModule.conf").string());
+    
+    _isRunning = true;
+}
+
+void ExampleModule::Stop()
+{
+    _isRunning = false;
+    
+    sPluginManager->UnwatchPluginConfig("ExampleModule");
+    _timers.Cancel();
+    _playerData.StopSweeping();
+    _playerValues.StopSweeping();
+}
+
 void ExampleModule::Shutdown()
 {
     if (!_enabled)
         return;
-        
+    
     TC_LOG_INFO("modules", "Shutting down Example Module...");
     
-    // Save statistics
+    _timers.Cancel();
+    _playerData.StopSweeping();
+    _playerValues.StopSweeping();
+    
+    // Save statistics, and wait for the write since the module is going away
     SaveStatistics();
+    SavePlayerData();
+    sPluginManager->GetWorkerPool().WaitIdle();
     
     // Clear player data
-    {
-        std::lock_guard<std::mutex> lock(_playerDataMutex);
-        _playerData.clear();
-    }
+    _playerData.Clear();
+    _playerValues.Clear();
     
     // Unregister chat commands
     UnregisterChatCommands();
@@ -238,40 +287,49 @@ void ExampleModule::Shutdown()
     TC_LOG_INFO("modules", "Example Module shut down successfully");
 }
 
-void ExampleModule::Update(uint32 diff)
+void ExampleModule::ScheduleTimers()
 {
-    if (!_enabled)
-        return;
-        
-    uint32 currentTime = GameTime::GetGameTime();
+    // Intervals are read once here and again on every configuration reload
+    _timers.Cancel();
     
-    // Update statistics periodically
-    uint32 statsInterval = sConfigMgr->GetIntDefault("Statistics.UpdateInterval", 30000) / 1000;
-    if (currentTime - _lastStatsUpdate >= statsInterval)
-    {
-        UpdateStatistics();
-        _lastStatsUpdate = currentTime;
-    }
+    PluginTimerWheel& timers = sPluginManager->GetTimers();
     
-    // Check for configuration changes
-    uint32 configInterval = sConfigMgr->GetIntDefault("Advanced.ConfigReloadInterval", 0);
-    if (configInterval > 0 && currentTime - _lastConfigCheck >= configInterval)
+    timers.SchedulePeriodic(_timers, *_statsSaveInterval * IN_MILLISECONDS, [this]()
     {
-        if (sConfigMgr->GetBoolDefault("Advanced.EnableHotReload", true))
-        {
-            ReloadConfiguration();
-        }
-        _lastConfigCheck = currentTime;
-    }
+        SaveStatistics();
+        SavePlayerData();
+    });
+}
+
+void ExampleModule::ApplyConfigChanges()
+{
+    // MaxEntries is enforced on insert, persisted offline data is kept for OfflineRetention instead
+    _playerData.SetLimits(*_maxEntries, *_persistOffline ? *_offlineRetention : *_cleanupInterval);
+    _playerData.SetDirtyTracking(*_saveToDatabase);
     
-    // Clean up offline player data
-    CleanupPlayerData();
+    // Values are never saved, they are dropped on logout and bounded the same way meanwhile
+    _playerValues.SetLimits(*_maxEntries, *_cleanupInterval);
+    
+    if (_isRunning)
+        ScheduleTimers();
+}
+
+void ExampleModule::OnConfigChanged(std::unique_ptr<PluginConfig> config)
+{
+    // Only the compiled settings are read from the file, the rest follows the server config
+    _settings.Publish(*config);
+    ApplyConfigChanges();
+    
+    TC_LOG_INFO("modules", "Example Module settings reloaded from ExampleModule.conf");
 }
 
 bool ExampleModule::LoadConfiguration()
 {
     try
     {
+        _settings.PublishFromServerConfig();
+        ApplyConfigChanges();
+        
         _enabled = sConfigMgr->GetBoolDefault("ExampleModule.Enabled", true);
         _debugMode = sConfigMgr->GetBoolDefault("ExampleModule.DebugMode", false);
         
@@ -361,7 +419,7 @@ void ExampleModule::RegisterChatCommands()
 {
     if (!_config.commandsEnabled)
         return;
-        
+    
     // Register chat commands with the command system
     // This would typically involve registering with TrinityCore's command system
     // Implementation depends on TrinityCore's command registration mechanism
@@ -387,33 +445,25 @@ void ExampleModule::HandlePlayerLogin(Player* player)
 {
     if (!player || !_config.playerDataEnabled)
         return;
-        
-    ObjectGuid guid = player->GetGUID();
     
+    uint32 now = GameTime::GetGameTime();
+    uint32 loginCount = 0;
+    
+    _playerData.Update(player->GetGUID().GetCounter(), [&](PlayerData& data)
     {
-        std::lock_guard<std::mutex> lock(_playerDataMutex);
-        
-        auto& data = _playerData[guid];
-        data.loginCount++;
-        data.sessionStartTime = GameTime::GetGameTime();
-        data.lastSeenTime = GameTime::GetGameTime();
-        
-        _totalLogins++;
-    }
+        loginCount = ++data.loginCount;
+        data.sessionStartTime = now;
+        data.lastSeenTime = now;
+    });
+    
+    _totalLogins++;
+    _loginsMetric.Add();
+    _onlinePlayersMetric.Add(1);
     
     // Send welcome message
     if (_config.welcomeEnabled)
     {
-        bool shouldShow = true;
-        if (_config.welcomeFirstLoginOnly)
-        {
-            std::lock_guard<std::mutex> lock(_playerDataMutex);
-            auto it = _playerData.find(guid);
-            if (it != _playerData.end() && it->second.loginCount > 1)
-            {
-                shouldShow = false;
-            }
-        }
+        bool shouldShow = !_config.welcomeFirstLoginOnly || loginCount <= 1;
         
         if (shouldShow)
         {
@@ -439,19 +489,22 @@ void ExampleModule::HandlePlayerLogout(Player* player)
 {
     if (!player || !_config.playerDataEnabled)
         return;
-        
-    ObjectGuid guid = player->GetGUID();
     
+    uint32 now = GameTime::GetGameTime();
+    
+    uint32 sessionLength = 0;
+    bool tracked = _playerData.Modify(player->GetGUID().GetCounter(), [now, &sessionLength](PlayerData& data)
     {
-        std::lock_guard<std::mutex> lock(_playerDataMutex);
-        
-        auto it = _playerData.find(guid);
-        if (it != _playerData.end())
-        {
-            it->second.lastSeenTime = GameTime::GetGameTime();
-            it->second.totalPlayTime += GameTime::GetGameTime() - it->second.sessionStartTime;
-        }
-    }
+        data.lastSeenTime = now;
+        sessionLength = now - data.sessionStartTime;
+        data.totalPlayTime += sessionLength;
+    });
+    
+    _playerValues.RemovePlayer(player->GetGUID().GetCounter());
+    
+    _onlinePlayersMetric.Sub(1);
+    if (tracked)
+        _sessionLengthMetric.Observe(sessionLength);
     
     if (_debugMode)
     {
@@ -463,18 +516,14 @@ void ExampleModule::HandlePlayerLevelChanged(Player* player, uint8 oldLevel)
 {
     if (!player)
         return;
-        
+    
     uint8 newLevel = player->getLevel();
-    ObjectGuid guid = player->GetGUID();
+    uint32 now = GameTime::GetGameTime();
     
-    {
-        std::lock_guard<std::mutex> lock(_playerDataMutex);
-        
-        auto& data = _playerData[guid];
-        data.lastLevelUpTime = GameTime::GetGameTime();
-        
-        _totalLevelUps++;
-    }
+    _playerData.Update(player->GetGUID().GetCounter(), [now](PlayerData& data) { data.lastLevelUpTime = now; });
+    
+    _totalLevelUps++;
+    _levelUpsMetric.Add();
     
     // Give level up reward if configured
     if (_config.rewardEnabled && 
@@ -487,7 +536,7 @@ void ExampleModule::HandlePlayerLevelChanged(Player* player, uint8 oldLevel)
         {
             player->AddItem(_config.rewardItemId, _config.rewardCount);
             
-            std::ostringstream ss;
+            PluginArenaStringStream ss;
             ss << "Congratulations on reaching level " << static_cast<uint32>(newLevel) 
                << "! You have received a reward.";
             ChatHandler(player->GetSession()).SendSysMessage(ss.str().c_str());
@@ -501,11 +550,11 @@ void ExampleModule::HandlePlayerLevelChanged(Player* player, uint8 oldLevel)
     }
 }
 
-void ExampleModule::HandlePlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg)
+void ExampleModule::HandlePlayerChat(Player* player, uint32 type, uint32 lang, std::string_view msg)
 {
-    if (!player || !sConfigMgr->GetBoolDefault("Features.ChatLogging", false))
+    if (!player || !*_chatLogging)
         return;
-        
+    
     // Log chat messages if enabled
     if (_debugMode)
     {
@@ -513,125 +562,157 @@ void ExampleModule::HandlePlayerChat(Player* player, uint32 type, uint32 lang, s
     }
 }
 
-std::shared_ptr<ExampleModule::PlayerData> ExampleModule::GetPlayerData(ObjectGuid guid)
+bool ExampleModule::GetPlayerData(ObjectGuid guid, PlayerData& data)
+{
+    return _playerData.Get(guid.GetCounter(), data);
+}
+
+void ExampleModule::RemovePlayerData(ObjectGuid guid)
 {
-    std::lock_guard<std::mutex> lock(_playerDataMutex);
+    _playerData.Remove(guid.GetCounter());
+    _playerValues.RemovePlayer(guid.GetCounter());
+}
+
+void ExampleModule::SetPlayerValue(ObjectGuid guid, PluginSymbol key, PluginValue value)
+{
+    _playerValues.Set(guid.GetCounter(), key, std::move(value));
+}
+
+PluginValue ExampleModule::GetPlayerValue(ObjectGuid guid, PluginSymbol key) const
+{
+    return _playerValues.Get(guid.GetCounter(), key);
+}
+
+uint32 ExampleModule::GetTrackedPlayersCount() const
+{
+    return static_cast<uint32>(_playerData.GetSize());
+}
+
+bool ExampleModule::ExportState(PluginStateBlob& blob)
+{
+    // Called with the module stopped, nothing changes the player data meanwhile
+    blob.SetVersion(STATE_VERSION);
+    blob.Write<uint32>(_totalLogins);
+    blob.Write<uint32>(_totalLevelUps);
+    blob.Write<uint32>(static_cast<uint32>(_playerData.GetSize()));
     
-    auto it = _playerData.find(guid);
-    if (it != _playerData.end())
+    _playerData.ForEach([&blob](uint32 guid, PlayerData const& data)
     {
-        return std::make_shared<PlayerData>(it->second);
-    }
+        blob.Write(guid);
+        blob.Write(data);
+    });
     
-    return nullptr;
+    return true;
 }
 
-uint32 ExampleModule::GetTrackedPlayersCount() const
+bool ExampleModule::ImportState(PluginStateBlob const& blob)
 {
-    std::lock_guard<std::mutex> lock(_playerDataMutex);
-    return static_cast<uint32>(_playerData.size());
+    if (blob.GetVersion() != STATE_VERSION)
+        return false;
+    
+    PluginStateReader reader(blob);
+    uint32 totalLogins, totalLevelUps, playerCount;
+    if (!reader.Read(totalLogins) || !reader.Read(totalLevelUps) || !reader.Read(playerCount))
+        return false;
+    
+    _totalLogins = totalLogins;
+    _totalLevelUps = totalLevelUps;
+    
+    for (uint32 i = 0; i < playerCount; ++i)
+    {
+        uint32 guid;
+        PlayerData data;
+        if (!reader.Read(guid) || !reader.Read(data))
+            return false;
+        
+        _playerData.Update(guid, [&data](PlayerData& record) { record = data; });
+    }
+    
+    TC_LOG_INFO("modules", "Example Module took over {} tracked players from the previous instance", playerCount);
+    return true;
 }
 
-void ExampleModule::UpdateStatistics()
+void ExampleModule::SaveStatistics()
 {
     if (!_config.statisticsEnabled)
         return;
-        
-    // Update internal statistics
-    uint32 currentTime = GameTime::GetGameTime();
     
-    // Save statistics to file if configured
-    uint32 saveInterval = sConfigMgr->GetIntDefault("Statistics.SaveInterval", 300);
-    static uint32 lastSave = 0;
+    PluginStateBlob blob(STATISTICS_VERSION);
+    blob.Write<uint64>(GameTime::GetGameTime());
+    blob.Write<uint32>(_totalLogins);
+    blob.Write<uint32>(_totalLevelUps);
+    blob.Write<uint32>(GetTrackedPlayersCount());
     
-    if (currentTime - lastSave >= saveInterval)
+    std::string filename = *_statsFileName;
+    
+    if (*_asyncOperations)
     {
-        SaveStatistics();
-        lastSave = currentTime;
+        // Written and renamed into place by the plugin worker pool
+        sPluginManager->GetPersistence().SaveSnapshot(filename, std::move(blob));
+        return;
+    }
+    
+    std::string error;
+    if (!PluginPersistence::WriteSnapshot(filename, blob, error))
+    {
+        TC_LOG_ERROR("modules", "Failed to save statistics to {}: {}", filename, error);
+    }
+    else if (_debugMode)
+    {
+        TC_LOG_DEBUG("modules", "Statistics saved to {}", filename);
     }
 }
 
-void ExampleModule::SaveStatistics()
+void ExampleModule::LoadStatistics()
 {
-    if (!_config.statisticsEnabled)
+    std::string filename = *_statsFileName;
+    if (!std::filesystem::exists(filename))
         return;
-        
-    try
+    
+    PluginStateBlob blob;
+    std::string error;
+    if (!PluginPersistence::ReadSnapshot(filename, blob, error))
     {
-        std::string filename = sConfigMgr->GetStringDefault("Statistics.FileName", "example_module_stats.txt");
-        std::ofstream file(filename);
-        
-        if (file.is_open())
-        {
-            file << "Example Module Statistics\n";
-            file << "========================\n";
-            file << "Generated: " << std::put_time(std::localtime(&(time_t){GameTime::GetGameTime()}), "%Y-%m-%d %H:%M:%S") << "\n";
-            file << "Total Logins: " << _totalLogins << "\n";
-            file << "Total Level Ups: " << _totalLevelUps << "\n";
-            file << "Tracked Players: " << GetTrackedPlayersCount() << "\n";
-            
-            file.close();
-            
-            if (_debugMode)
-            {
-                TC_LOG_DEBUG("modules", "Statistics saved to {}", filename);
-            }
-        }
+        TC_LOG_ERROR("modules", "Failed to load statistics: {}", error);
+        return;
     }
-    catch (const std::exception& e)
+    
+    PluginStateReader reader(blob);
+    uint64 generated;
+    uint32 totalLogins, totalLevelUps;
+    if (blob.GetVersion() != STATISTICS_VERSION || !reader.Read(generated) || !reader.Read(totalLogins) || !reader.Read(totalLevelUps))
     {
-        TC_LOG_ERROR("modules", "Failed to save statistics: {}", e.what());
+        TC_LOG_ERROR("modules", "Ignoring statistics in {}, unknown format (version {})", filename, blob.GetVersion());
+        return;
     }
+    
+    _totalLogins = totalLogins;
+    _totalLevelUps = totalLevelUps;
 }
 
-void ExampleModule::CleanupPlayerData()
+void ExampleModule::SavePlayerData()
 {
-    if (!_config.playerDataEnabled)
+    if (!_config.playerDataEnabled || !*_saveToDatabase)
         return;
-        
-    uint32 cleanupInterval = sConfigMgr->GetIntDefault("PlayerData.CleanupInterval", 3600);
-    bool persistOffline = sConfigMgr->GetBoolDefault("PlayerData.PersistOffline", true);
-    uint32 maxEntries = sConfigMgr->GetIntDefault("PlayerData.MaxEntries", 10000);
     
-    if (persistOffline)
-        return; // Don't cleanup if we want to persist offline data
-        
-    std::lock_guard<std::mutex> lock(_playerDataMutex);
+    // Only records written since the last save, committed by the write-behind queue
+    std::vector<PluginStatement> statements;
+    _playerData.CollectDirty([&statements](uint32 guid, PlayerData const& data)
+    {
+        PluginStatement statement = PluginStatement::Text("REPLACE INTO example_module_player_data (guid, login_count, session_start, last_seen, total_play_time, last_level_up) VALUES (?, ?, ?, ?, ?, ?)");
+        statement.Bind(guid).Bind(data.loginCount).Bind(data.sessionStartTime).Bind(data.lastSeenTime).Bind(data.totalPlayTime).Bind(data.lastLevelUpTime);
+        statements.push_back(std::move(statement));
+    });
     
-    uint32 currentTime = GameTime::GetGameTime();
-    auto it = _playerData.begin();
+    if (statements.empty())
+        return;
     
-    while (it != _playerData.end())
+    if (_debugMode)
     {
-        // Remove data for players who have been offline for too long
-        if (currentTime - it->second.lastSeenTime > cleanupInterval)
-        {
-            it = _playerData.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
+        TC_LOG_DEBUG("modules", "Queued {} changed player records", statements.size());
     }
     
-    // Enforce maximum entries limit
-    while (_playerData.size() > maxEntries)
-    {
-        // Remove oldest entries
-        auto oldest = std::min_element(_playerData.begin(), _playerData.end(),
-            [](const auto& a, const auto& b) {
-                return a.second.lastSeenTime < b.second.lastSeenTime;
-            });
-            
-        if (oldest != _playerData.end())
-        {
-            _playerData.erase(oldest);
-        }
-        else
-        {
-            break;
-        }
-    }
+    sPluginManager->GetPersistence().Queue(PluginDatabase::CHARACTER, std::move(statements));
 }
 
 // Plugin registration
@@ -20,6 +20,11 @@
 
 #include "IPlugin.h"
 #include "PluginConfig.h"
+#include "PluginConfigHandle.h"
+#include "PluginMetrics.h"
+#include "PluginPlayerStore.h"
+#include "PluginValue.h"
+#include "PluginTimerWheel.h"
 #include "ExampleEventHandler.h"
 #include "ExampleCommands.h"
 #include <memory>
@@ -58,18 +63,23 @@ namespace TC
             // Configuration management
             bool LoadConfig(std::string const& configPath) override;
             void ReloadConfig() override;
+            void OnConfigChanged(std::unique_ptr<PluginConfig> config) override;
 
             // Dependency management
             bool CheckDependencies() const override;
 
+            // Hot reload, hands statistics and player data to the new instance
+            bool ExportState(PluginStateBlob& blob) override;
+            bool ImportState(PluginStateBlob const& blob) override;
+
             // Module-specific functionality
             void SendWelcomeMessage(Player* player);
             void TrackPlayerLogin(Player* player);
             void TrackPlayerLogout(Player* player);
             void ProcessLevelUpReward(Player* player, uint8 oldLevel);
-            void UpdateStatistics(uint32 diff);
             void SaveStatistics();
             void LoadStatistics();
+            void SavePlayerData();
 
             // Configuration accessors
             bool IsWelcomeMessageEnabled() const { return _welcomeMessageEnabled; }
@@ -85,9 +95,22 @@ namespace TC
             uint32 GetTotalLevelUps() const { return _totalLevelUps.load(); }
 
             // Thread-safe player data management
-            void SetPlayerData(uint32 playerGuid, std::string const& key, std::string const& value);
-            std::string GetPlayerData(uint32 playerGuid, std::string const& key, std::string const& defaultValue = "");
-            void RemovePlayerData(uint32 playerGuid);
+            struct PlayerData
+            {
+                uint32 loginCount;
+                uint32 sessionStartTime;
+                uint32 lastSeenTime;
+                uint32 totalPlayTime;
+                uint32 lastLevelUpTime;
+            };
+
+            bool GetPlayerData(ObjectGuid guid, PlayerData& data);
+            void RemovePlayerData(ObjectGuid guid);
+
+            // Free form per player values, intern keys once with sPluginSymbols->Intern()
+            void SetPlayerValue(ObjectGuid guid, PluginSymbol key, PluginValue value);
+            PluginValue GetPlayerValue(ObjectGuid guid, PluginSymbol key) const;
+            uint32 GetTrackedPlayersCount() const;
 
             // Event broadcasting
             void BroadcastMessage(std::string const& message, uint32 type = 0);
@@ -109,10 +132,7 @@ namespace TC
 
             // Statistics management
             void ResetStatistics();
-            void ScheduleStatisticsSave();
-
-            // Player data cleanup
-            void CleanupPlayerData();
+            void ScheduleTimers();
 
             // Configuration variables
             bool _welcomeMessageEnabled;
@@ -132,18 +152,36 @@ namespace TC
             std::atomic<uint32> _totalChatMessages;
             std::atomic<uint32> _totalCommandsExecuted;
 
-            // Timing
-            uint32 _lastUpdateTime;
-            uint32 _lastStatisticsSave;
+            // Exported through the plugin metrics region, see PluginMetrics.h
+            PluginCounter _loginsMetric;
+            PluginCounter _levelUpsMetric;
+            PluginGauge _onlinePlayersMetric;
+            PluginHistogram _sessionLengthMetric;
+
+            // Periodic statistics save, see ScheduleTimers()
+            PluginTimerToken _timers;
+
+            // Compiled settings, published on every LoadConfiguration()
+            PluginConfigTable _settings;
+            PluginConfigHandle<uint32> _statsSaveInterval;
+            PluginConfigHandle<std::string> _statsFileName;
+            PluginConfigHandle<bool> _asyncOperations;
+            PluginConfigHandle<bool> _chatLogging;
+            PluginConfigHandle<uint32> _cleanupInterval;
+            PluginConfigHandle<bool> _persistOffline;
+            PluginConfigHandle<uint32> _offlineRetention;
+            PluginConfigHandle<bool> _saveToDatabase;
+            PluginConfigHandle<uint32> _maxEntries;
+            PluginConfigHandle<bool> _hotReload;
 
             // Component instances
             std::unique_ptr<PluginConfig> _config;
             std::unique_ptr<ExampleEventHandler> _eventHandler;
             std::unique_ptr<ExampleCommands> _commandHandler;
 
-            // Player data storage (thread-safe)
-            mutable std::mutex _playerDataMutex;
-            std::unordered_map<uint32, std::unordered_map<std::string, std::string>> _playerData;
+            // Player data storage (thread-safe), keyed by GUID counter
+            PluginPlayerStore<PlayerData> _playerData;
+            PluginPlayerValues _playerValues;
 
             // Online players tracking
             mutable std::mutex _onlinePlayersMutex;
@@ -159,6 +197,8 @@ namespace TC
             static constexpr uint32 DEFAULT_STATISTICS_SAVE_INTERVAL = 300000; // 5 minutes
             static constexpr uint32 MAX_PLAYER_DATA_ENTRIES = 10000;
             static constexpr uint32 CLEANUP_INTERVAL = 3600000; // 1 hour
+            static constexpr uint32 STATE_VERSION = 1; // layout of ExportState(), bump on change
+            static constexpr uint32 STATISTICS_VERSION = 1; // layout of the statistics snapshot
         };
 
         // Global module instance accessor
@@ -166,7 +206,4 @@ namespace TC
     }
 }
 
-// Module registration macro
-REGISTER_PLUGIN(TC::Modules::ExampleModule)
-
 #endif // EXAMPLE_MODULE_H
\ No newline at end of file
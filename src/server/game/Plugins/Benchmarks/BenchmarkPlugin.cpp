@@ -0,0 +1,99 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BenchmarkPlugin.h"
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace
+{
+    // Every copy of the library is its own plugin, named after the file it was loaded from
+    std::string GetLibraryName()
+    {
+        static char const anchor = 0;
+
+#ifdef _WIN32
+        HMODULE module = nullptr;
+        char path[MAX_PATH];
+        
+        if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, &anchor, &module) ||
+            !GetModuleFileNameA(module, path, MAX_PATH))
+            return "BenchmarkPlugin";
+        
+        return std::filesystem::path(path).stem().string();
+#else
+        Dl_info info;
+        if (!dladdr(&anchor, &info) || !info.dli_fname)
+            return "BenchmarkPlugin";
+        
+        return std::filesystem::path(info.dli_fname).stem().string();
+#endif
+    }
+}
+
+void BenchmarkEventHandler::OnMapUpdate(Map* map, uint32 diff)
+{
+    if (BenchmarkMapState* state = _plugin->GetMapState<BenchmarkMapState>(map))
+        state->updates += diff;
+}
+
+BenchmarkPlugin::BenchmarkPlugin() : _eventHandler(this)
+{
+    _info.name = GetLibraryName();
+    _info.version = "1.0.0";
+    _info.author = "TrinityCore Team";
+    _info.description = "Synthetic plugin used by plugin-benchmark";
+    _info.priority = PluginPriority::NORMAL;
+    _info.autoLoad = true;
+    _info.eventMask = BENCHMARK_EVENT_MASK;
+    _info.SubscribeOpcode(PluginPacketDirection::RECEIVE, BENCHMARK_HOOKED_OPCODE);
+    _info.SubscribeOpcode(PluginPacketDirection::SEND, BENCHMARK_HOOKED_OPCODE);
+}
+
+bool BenchmarkPlugin::Load()
+{
+    _state = PluginState::LOADED;
+    return true;
+}
+
+bool BenchmarkPlugin::Initialize()
+{
+    _state = PluginState::INITIALIZED;
+    return true;
+}
+
+void BenchmarkPlugin::Start()
+{
+    _state = PluginState::RUNNING;
+}
+
+void BenchmarkPlugin::Stop()
+{
+    _state = PluginState::LOADED;
+}
+
+void BenchmarkPlugin::Unload()
+{
+    _state = PluginState::UNLOADED;
+}
+
+DECLARE_TRINITY_PLUGIN(BenchmarkPlugin);
@@ -0,0 +1,102 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_BENCHMARK_PLUGIN_H
+#define TRINITY_BENCHMARK_PLUGIN_H
+
+#include "IPlugin.h"
+
+/*
+ * Synthetic plugin driven by plugin-benchmark.
+ *
+ * The benchmark copies the library once per simulated plugin and every copy
+ * names itself after its file, so N copies register as N distinct plugins.
+ * Handlers only bump a counter: they never dereference the game objects they
+ * are given and no event is batched, which lets the benchmark dispatch with
+ * mock objects instead of a running world.
+ */
+
+// Opcode every benchmark plugin hooks in both directions, and one none of them hooks
+constexpr uint16 BENCHMARK_HOOKED_OPCODE = 0x01F6;
+constexpr uint16 BENCHMARK_UNHOOKED_OPCODE = 0x01F7;
+
+// Subscribed events, CREATURE_RESPAWN is left out to measure the unsubscribed hook cost
+constexpr PluginEventMask BENCHMARK_EVENT_MASK = PLUGIN_EVENT_MASK_DEFAULT & ~PluginEventBit(PluginEvent::CREATURE_RESPAWN);
+
+class BenchmarkMapState : public PluginMapState
+{
+public:
+    uint64 updates = 0;
+};
+
+class BenchmarkPlugin;
+
+class BenchmarkEventHandler : public IEventHandler
+{
+public:
+    explicit BenchmarkEventHandler(BenchmarkPlugin* plugin) : _plugin(plugin), _calls(0) { }
+    
+    void OnPlayerLogin(Player* /*player*/) override { ++_calls; }
+    void OnPlayerLogout(Player* /*player*/) override { ++_calls; }
+    void OnPlayerLevelChanged(Player* /*player*/, uint8 oldLevel) override { _calls += oldLevel; }
+    void OnPlayerChat(Player* /*player*/, uint32 /*type*/, uint32 /*lang*/, std::string_view msg) override { _calls += msg.size(); }
+    void OnPlayerKill(Player* /*killer*/, Player* /*killed*/) override { ++_calls; }
+    void OnPlayerKillCreature(Player* /*killer*/, Creature* /*killed*/) override { ++_calls; }
+    void OnCreatureKill(Creature* /*killer*/, Unit* /*killed*/) override { ++_calls; }
+    void OnCreatureDeath(Creature* /*creature*/, Unit* /*killer*/) override { ++_calls; }
+    void OnGameObjectUse(GameObject* /*go*/, Player* /*player*/) override { ++_calls; }
+    void OnGameObjectDestroyed(GameObject* /*go*/, Player* /*player*/) override { ++_calls; }
+    void OnWorldUpdate(uint32 diff) override { _calls += diff; }
+    void OnMapUpdate(Map* map, uint32 diff) override;   // map update threads, counts in the map state
+    bool OnPacketReceive(WorldSession* /*session*/, WorldPacket& /*packet*/) override { ++_calls; return true; }
+    bool OnPacketSend(WorldSession* /*session*/, WorldPacket const& /*packet*/) override { ++_calls; return true; }
+    
+    uint64 GetCalls() const { return _calls; }
+
+private:
+    BenchmarkPlugin* _plugin;
+    uint64 _calls;      // world thread only
+};
+
+class TC_GAME_API BenchmarkPlugin : public IPlugin
+{
+public:
+    BenchmarkPlugin();
+    
+    bool Load() override;
+    bool Initialize() override;
+    void Start() override;
+    void Stop() override;
+    void Unload() override;
+    
+    PluginInfo const& GetInfo() const override { return _info; }
+    PluginState GetState() const override { return _state; }
+    
+    IEventHandler* GetEventHandler() override { return &_eventHandler; }
+    
+    std::vector<std::string> const& GetDependencies() const override { return _dependencies; }
+    bool CheckDependencies() const override { return true; }
+    
+    std::unique_ptr<PluginMapState> CreateMapState(Map* /*map*/) override { return std::make_unique<BenchmarkMapState>(); }
+
+private:
+    PluginInfo _info;
+    std::vector<std::string> _dependencies;
+    BenchmarkEventHandler _eventHandler;
+};
+
+#endif // TRINITY_BENCHMARK_PLUGIN_H
@@ -0,0 +1,494 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * plugin-benchmark, micro-benchmarks of the plugin dispatch layer.
+ *
+ * Loads N copies of the synthetic BenchmarkPlugin through the regular
+ * LoadAllPlugins path and measures startup, event dispatch for every plugin
+ * count, packet hook throughput, concurrent OnMapUpdate from several map
+ * threads and configuration lookups. Results are written as JSON so runs of
+ * different releases can be compared.
+ *
+ * Usage:
+ *     plugin-benchmark [--output <file>] [--library <path>] [--plugins 1,8,32,64]
+ *                      [--iterations <count>] [--threads 1,2,4,8] [--sequential-startup]
+ */
+
+#include "BenchmarkPlugin.h"
+#include "PluginClock.h"
+#include "PluginConfig.h"
+#include "PluginConfigHandle.h"
+#include "PluginHooks.h"
+#include "PluginManager.h"
+#include "WorldPacket.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef PLUGIN_BENCHMARK_LIBRARY
+#define PLUGIN_BENCHMARK_LIBRARY ""
+#endif
+
+namespace
+{
+    constexpr uint32 BENCHMARK_FORMAT_VERSION = 1;
+    constexpr size_t MOCK_OBJECT_COUNT = 64;
+    constexpr size_t MAPS_PER_THREAD = 4;
+    constexpr uint32 CONFIG_KEY_COUNT = 64;
+    
+    struct BenchmarkOptions
+    {
+        std::string output;
+        std::string library = PLUGIN_BENCHMARK_LIBRARY;
+        std::vector<uint32> pluginCounts = { 1, 8, 32, 64 };
+        std::vector<uint32> threadCounts = { 1, 2, 4, 8 };
+        uint64 iterations = 200000;
+        bool parallelStartup = true;
+    };
+    
+    struct BenchmarkResult
+    {
+        std::string name;
+        uint32 plugins;
+        uint32 threads;
+        uint64 operations;
+        uint64 nanoseconds;     // wall time
+    };
+    
+    /*
+     * Stand-ins for game objects. The benchmark plugin never dereferences
+     * them and nothing is batched, so the plugin manager only passes the
+     * pointers through (and uses maps as keys of their plugin state).
+     */
+    class MockWorld
+    {
+    public:
+        template<typename T>
+        T* Get(size_t index) { return reinterpret_cast<T*>(_objects[index % MOCK_OBJECT_COUNT].data); }
+        
+        Map* GetMap(size_t thread, size_t index) { return reinterpret_cast<Map*>(_maps[thread * MAPS_PER_THREAD + index % MAPS_PER_THREAD].data); }
+        
+        void SetThreadCount(size_t threads) { _maps.resize(threads * MAPS_PER_THREAD); }
+        size_t GetMapCount() const { return _maps.size(); }
+        Map* GetMap(size_t index) { return reinterpret_cast<Map*>(_maps[index].data); }
+    
+    private:
+        struct alignas(64) Storage
+        {
+            unsigned char data[64];
+        };
+        
+        Storage _objects[MOCK_OBJECT_COUNT];
+        std::vector<Storage> _maps;
+    };
+    
+    template<typename Fn>
+    uint64 Measure(uint64 iterations, Fn&& fn)
+    {
+        // Warm up caches, branch predictors and lazily created state first
+        for (uint64 i = 0; i < iterations / 10; ++i)
+            fn(i);
+        
+        uint64 start = PluginClock::Now();
+        for (uint64 i = 0; i < iterations; ++i)
+            fn(i);
+        
+        return PluginClock::ToNanoseconds(PluginClock::Now() - start);
+    }
+    
+    std::string EscapeJson(std::string const& text)
+    {
+        std::string escaped;
+        
+        for (char c : text)
+        {
+            switch (c)
+            {
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\t': escaped += "\\t"; break;
+                default: escaped += c; break;
+            }
+        }
+        
+        return escaped;
+    }
+    
+    class PluginBenchmark
+    {
+    public:
+        explicit PluginBenchmark(BenchmarkOptions const& options) : _options(options) { }
+        
+        bool Run();
+        void WriteJson(std::ostream& out) const;
+    
+    private:
+        bool PrepareDirectory(uint32 pluginCount, std::string& error);
+        bool LoadPlugins(uint32 pluginCount);
+        void UnloadPlugins();
+        
+        void RunEventBenchmarks(uint32 pluginCount);
+        void RunPacketBenchmarks(uint32 pluginCount);
+        void RunMapUpdateBenchmarks(uint32 pluginCount);
+        void RunConfigBenchmarks();
+        
+        template<typename Fn>
+        void Add(std::string const& name, uint32 plugins, uint64 iterations, Fn&& fn)
+        {
+            _results.push_back({ name, plugins, 1, iterations, Measure(iterations, fn) });
+        }
+        
+        BenchmarkOptions _options;
+        std::filesystem::path _directory;
+        MockWorld _world;
+        std::vector<BenchmarkResult> _results;
+    };
+    
+    bool PluginBenchmark::PrepareDirectory(uint32 pluginCount, std::string& error)
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(_directory, ec);
+        std::filesystem::create_directories(_directory, ec);
+        if (ec)
+        {
+            error = "Cannot create " + _directory.string() + ": " + ec.message();
+            return false;
+        }
+        
+        std::filesystem::path library(_options.library);
+        
+        for (uint32 i = 0; i < pluginCount; ++i)
+        {
+            std::ostringstream name;
+            name << "BenchmarkPlugin" << (i < 10 ? "00" : i < 100 ? "0" : "") << i << library.extension().string();
+            
+            if (!std::filesystem::copy_file(library, _directory / name.str(), ec))
+            {
+                error = "Cannot copy " + library.string() + ": " + ec.message();
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    bool PluginBenchmark::LoadPlugins(uint32 pluginCount)
+    {
+        std::string error;
+        if (!PrepareDirectory(pluginCount, error))
+        {
+            std::cerr << error << std::endl;
+            return false;
+        }
+        
+        // Startup is timed once per plugin count, the library copies are made beforehand
+        uint64 start = PluginClock::Now();
+        sPluginManager->LoadAllPlugins(_directory.string());
+        uint64 loaded = PluginClock::Now();
+        sPluginManager->InitializeAllPlugins();
+        uint64 initialized = PluginClock::Now();
+        sPluginManager->StartAllPlugins();
+        uint64 started = PluginClock::Now();
+        
+        _results.push_back({ "startup/load_all_plugins", pluginCount, 1, 1, PluginClock::ToNanoseconds(loaded - start) });
+        _results.push_back({ "startup/initialize_all_plugins", pluginCount, 1, 1, PluginClock::ToNanoseconds(initialized - loaded) });
+        _results.push_back({ "startup/start_all_plugins", pluginCount, 1, 1, PluginClock::ToNanoseconds(started - initialized) });
+        
+        uint32 running = 0;
+        for (std::string const& name : sPluginManager->GetLoadedPluginNames())
+            if (IPlugin* plugin = sPluginManager->GetPlugin(name))
+                if (plugin->GetState() == PluginState::RUNNING)
+                    ++running;
+        
+        if (running != pluginCount)
+        {
+            std::cerr << "Only " << running << " of " << pluginCount << " benchmark plugins are running: " << sPluginManager->GetLastError() << std::endl;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    void PluginBenchmark::UnloadPlugins()
+    {
+        for (size_t i = 0; i < _world.GetMapCount(); ++i)
+            PLUGIN_HOOK_MAP_DESTROY(_world.GetMap(i));
+        
+        sPluginManager->StopAllPlugins();
+        sPluginManager->UnloadAllPlugins();
+        
+        std::error_code ec;
+        std::filesystem::remove_all(_directory, ec);
+    }
+    
+    void PluginBenchmark::RunEventBenchmarks(uint32 pluginCount)
+    {
+        uint64 const iterations = _options.iterations;
+        std::string message = "benchmark chat message";
+        
+        // Through the hook macros, exactly as the core calls them
+        Add("event/player_login", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_PLAYER_LOGIN(_world.Get<Player>(i)); });
+        Add("event/player_level_changed", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_PLAYER_LEVEL_CHANGED(_world.Get<Player>(i), uint8(i)); });
+        Add("event/player_chat", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_PLAYER_CHAT(_world.Get<Player>(i), 1, 0, message); });
+        Add("event/player_kill_creature", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_PLAYER_KILL_CREATURE(_world.Get<Player>(i), _world.Get<Creature>(i + 1)); });
+        Add("event/creature_death", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_CREATURE_DEATH(_world.Get<Creature>(i), _world.Get<Unit>(i + 1)); });
+        Add("event/gameobject_use", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_GAMEOBJECT_USE(_world.Get<GameObject>(i), _world.Get<Player>(i + 1)); });
+        Add("event/unsubscribed", pluginCount, iterations, [&](uint64 i) { PLUGIN_HOOK_CREATURE_RESPAWN(_world.Get<Creature>(i)); });
+        
+        // A whole world tick: completions, timers, budgets, OnWorldUpdate handlers and batch delivery
+        Add("tick/world_update", pluginCount, iterations / 10, [&](uint64 /*i*/) { PLUGIN_HOOK_WORLD_UPDATE(50); });
+    }
+    
+    void PluginBenchmark::RunPacketBenchmarks(uint32 pluginCount)
+    {
+        uint64 const iterations = _options.iterations;
+        WorldSession* session = _world.Get<WorldSession>(0);
+        WorldPacket hooked(BENCHMARK_HOOKED_OPCODE, 0);
+        WorldPacket unhooked(BENCHMARK_UNHOOKED_OPCODE, 0);
+        volatile bool accepted = true;
+        
+        Add("packet/receive_hooked", pluginCount, iterations, [&](uint64 /*i*/) { accepted = PLUGIN_HOOK_PACKET_RECEIVE(session, hooked); });
+        Add("packet/receive_unhooked", pluginCount, iterations, [&](uint64 /*i*/) { accepted = PLUGIN_HOOK_PACKET_RECEIVE(session, unhooked); });
+        Add("packet/send_hooked", pluginCount, iterations, [&](uint64 /*i*/) { accepted = PLUGIN_HOOK_PACKET_SEND(session, hooked); });
+        Add("packet/send_unhooked", pluginCount, iterations, [&](uint64 /*i*/) { accepted = PLUGIN_HOOK_PACKET_SEND(session, unhooked); });
+        (void)accepted;
+    }
+    
+    void PluginBenchmark::RunMapUpdateBenchmarks(uint32 pluginCount)
+    {
+        uint32 const maxThreads = *std::max_element(_options.threadCounts.begin(), _options.threadCounts.end());
+        _world.SetThreadCount(maxThreads);
+        
+        // Like the map update threads every thread owns its maps, contention is on the shared dispatch state
+        for (uint32 threadCount : _options.threadCounts)
+        {
+            uint64 const iterations = _options.iterations;
+            std::atomic<uint32> ready(0);
+            std::atomic<bool> go(false);
+            std::vector<std::thread> threads;
+            
+            for (uint32 t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    // Creates the map states outside the measured loop
+                    for (size_t m = 0; m < MAPS_PER_THREAD; ++m)
+                        PLUGIN_HOOK_MAP_UPDATE(_world.GetMap(t, m), 1);
+                    
+                    ready.fetch_add(1);
+                    while (!go.load())
+                        std::this_thread::yield();
+                    
+                    for (uint64 i = 0; i < iterations; ++i)
+                        PLUGIN_HOOK_MAP_UPDATE(_world.GetMap(t, i), 1);
+                });
+            }
+            
+            while (ready.load() != threadCount)
+                std::this_thread::yield();
+            
+            uint64 start = PluginClock::Now();
+            go.store(true);
+            
+            for (std::thread& thread : threads)
+                thread.join();
+            
+            _results.push_back({ "map_update/concurrent", pluginCount, threadCount, iterations * threadCount, PluginClock::ToNanoseconds(PluginClock::Now() - start) });
+        }
+    }
+    
+    void PluginBenchmark::RunConfigBenchmarks()
+    {
+        uint64 const iterations = _options.iterations;
+        
+        PluginConfig config;
+        PluginConfigTable table;
+        std::vector<std::string> keys;
+        std::vector<PluginConfigHandle<uint32>> handles;
+        
+        for (uint32 i = 0; i < CONFIG_KEY_COUNT; ++i)
+        {
+            keys.push_back("Benchmark.Section.Key" + std::to_string(i));
+            config.SetUInt(keys.back(), i);
+            handles.push_back(table.Bind<uint32>(keys.back(), 0));
+            sPluginConfigManager->SetGlobalSetting(keys.back(), std::to_string(i));
+        }
+        
+        table.Publish(config);
+        
+        volatile uint32 sink = 0;
+        
+        Add("config/plugin_config_get", 0, iterations, [&](uint64 i) { sink = config.GetUInt(keys[i % CONFIG_KEY_COUNT]); });
+        Add("config/global_setting", 0, iterations, [&](uint64 i) { sink = uint32(sPluginConfigManager->GetGlobalSetting(keys[i % CONFIG_KEY_COUNT]).size()); });
+        Add("config/handle_get", 0, iterations, [&](uint64 i) { sink = handles[i % CONFIG_KEY_COUNT].Get(); });
+        (void)sink;
+    }
+    
+    bool PluginBenchmark::Run()
+    {
+        if (_options.library.empty() || !std::filesystem::exists(_options.library))
+        {
+            std::cerr << "Benchmark plugin library not found: '" << _options.library << "', pass --library" << std::endl;
+            return false;
+        }
+        
+        PluginClock::Calibrate();
+        
+        _directory = std::filesystem::temp_directory_path() / ("plugin-benchmark-" + std::to_string(PluginClock::Now()));
+        
+        sPluginConfigManager->SetGlobalSetting("Plugins.ParallelStartup", _options.parallelStartup ? "1" : "0");
+        sPluginManager->SetProfilingEnabled(false);
+        
+        RunConfigBenchmarks();
+        
+        for (uint32 pluginCount : _options.pluginCounts)
+        {
+            if (!pluginCount || pluginCount >= PLUGIN_MAX_IDS)
+            {
+                std::cerr << "Skipping plugin count " << pluginCount << ", must be between 1 and " << PLUGIN_MAX_IDS - 1 << std::endl;
+                continue;
+            }
+            
+            bool loaded = LoadPlugins(pluginCount);
+            
+            if (loaded)
+            {
+                RunEventBenchmarks(pluginCount);
+                RunPacketBenchmarks(pluginCount);
+                RunMapUpdateBenchmarks(pluginCount);
+            }
+            
+            UnloadPlugins();
+            
+            if (!loaded)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    void PluginBenchmark::WriteJson(std::ostream& out) const
+    {
+        out << "{\n";
+        out << "    \"format_version\": " << BENCHMARK_FORMAT_VERSION << ",\n";
+        out << "    \"timestamp\": " << uint64(std::time(nullptr)) << ",\n";
+        out << "    \"clock\": \"" << (TRINITY_PLUGIN_CLOCK_TSC ? "tsc" : "steady_clock") << "\",\n";
+        out << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        out << "    \"iterations\": " << _options.iterations << ",\n";
+        out << "    \"parallel_startup\": " << (_options.parallelStartup ? "true" : "false") << ",\n";
+        out << "    \"results\": [";
+        
+        for (size_t i = 0; i < _results.size(); ++i)
+        {
+            BenchmarkResult const& result = _results[i];
+            
+            // ns_per_op is the average cost of one call on one thread
+            double nsPerOp = result.operations ? double(result.nanoseconds) * result.threads / result.operations : 0.0;
+            double opsPerSecond = result.nanoseconds ? double(result.operations) * 1e9 / result.nanoseconds : 0.0;
+            
+            out << (i ? ",\n" : "\n");
+            out << "        { \"name\": \"" << EscapeJson(result.name) << "\""
+                << ", \"plugins\": " << result.plugins
+                << ", \"threads\": " << result.threads
+                << ", \"operations\": " << result.operations
+                << ", \"nanoseconds\": " << result.nanoseconds
+                << ", \"ns_per_op\": " << nsPerOp
+                << ", \"ops_per_second\": " << opsPerSecond << " }";
+        }
+        
+        out << "\n    ]\n}\n";
+    }
+    
+    std::vector<uint32> ParseList(char const* text)
+    {
+        std::vector<uint32> values;
+        std::istringstream stream(text);
+        std::string value;
+        
+        while (std::getline(stream, value, ','))
+            if (!value.empty())
+                values.push_back(uint32(std::strtoul(value.c_str(), nullptr, 10)));
+        
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if (arg == "--output" && hasValue)
+            options.output = argv[++i];
+        else if (arg == "--library" && hasValue)
+            options.library = argv[++i];
+        else if (arg == "--plugins" && hasValue)
+            options.pluginCounts = ParseList(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            options.threadCounts = ParseList(argv[++i]);
+        else if (arg == "--iterations" && hasValue)
+            options.iterations = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--sequential-startup")
+            options.parallelStartup = false;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--output <file>] [--library <path>] [--plugins 1,8,32,64]"
+                      << " [--iterations <count>] [--threads 1,2,4,8] [--sequential-startup]" << std::endl;
+            return 1;
+        }
+    }
+    
+    if (options.pluginCounts.empty() || options.threadCounts.empty() || !options.iterations)
+    {
+        std::cerr << "Plugin counts, thread counts and iterations must not be empty" << std::endl;
+        return 1;
+    }
+    
+    PluginBenchmark benchmark(options);
+    if (!benchmark.Run())
+        return 1;
+    
+    if (options.output.empty())
+    {
+        benchmark.WriteJson(std::cout);
+        return 0;
+    }
+    
+    std::ofstream file(options.output);
+    benchmark.WriteJson(file);
+    
+    if (!file)
+    {
+        std::cerr << "Cannot write " << options.output << std::endl;
+        return 1;
+    }
+    
+    std::cout << "Benchmark results written to " << options.output << std::endl;
+    return 0;
+}
@@ -16,14 +16,15 @@
  */
 
 #include "ExamplePlugin.h"
+#include "PluginManager.h"
 #include "Player.h"
 #include "WorldSession.h"
 #include "Chat.h"
 #include "Log.h"
 #include "Item.h"
 #include "ObjectMgr.h"
-#include "GameTime.h"
-#include <fstream>
+#include "PluginStateBlob.h"
+#include <filesystem>
 
 // ExampleEventHandler Implementation
 void ExampleEventHandler::OnPlayerLogin(Player* player)
@@ -54,22 +55,16 @@ void ExampleEventHandler::OnPlayerLevelChanged(Player* player, uint8 oldLevel)
         _plugin->ProcessLevelUpReward(player, oldLevel);
 }
 
-void ExampleEventHandler::OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg)
+void ExampleEventHandler::OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string_view msg)
 {
     // Example: Log all chat messages (could be used for moderation)
     if (player)
     {
-        TC_LOG_DEBUG("plugins.example", "Player %s (GUID: %u) said: %s", 
-                    player->GetName().c_str(), player->GetGUID().GetCounter(), msg.c_str());
+        TC_LOG_DEBUG("plugins.example", "Player %s (GUID: %u) said: %.*s", 
+                    player->GetName().c_str(), player->GetGUID().GetCounter(), int(msg.size()), msg.data());
     }
 }
 
-void ExampleEventHandler::OnWorldUpdate(uint32 diff)
-{
-    if (_plugin)
-        _plugin->UpdateStatistics(diff);
-}
-
 void ExampleEventHandler::OnServerStart()
 {
     TC_LOG_INFO("plugins.example", "Example Plugin: Server started");
@@ -102,7 +97,6 @@ ExamplePlugin::ExamplePlugin()
     , _totalLogins(0)
     , _currentOnlinePlayers(0)
     , _totalLevelUps(0)
-    , _lastUpdateTime(0)
 {
     // Initialize plugin information
     _info.name = "ExamplePlugin";
@@ -113,6 +107,15 @@ ExamplePlugin::ExamplePlugin()
     _info.priority = PluginPriority::NORMAL;
     _info.autoLoad = true;
     
+    // Only the events ExampleEventHandler overrides
+    _info.eventMask = PluginEventBit(PluginEvent::PLAYER_LOGIN)
+        | PluginEventBit(PluginEvent::PLAYER_LOGOUT)
+        | PluginEventBit(PluginEvent::PLAYER_LEVEL_CHANGED)
+        | PluginEventBit(PluginEvent::PLAYER_CHAT)
+        | PluginEventBit(PluginEvent::SERVER_START)
+        | PluginEventBit(PluginEvent::SERVER_STOP)
+        | PluginEventBit(PluginEvent::CONFIG_RELOAD);
+    
     // No dependencies for this example
     _dependencies.clear();
     
@@ -166,7 +169,7 @@ void ExamplePlugin::Start()
     TC_LOG_INFO("plugins.example", "Starting Example Plugin...");
     
     _state = PluginState::RUNNING;
-    _lastUpdateTime = GameTime::GetGameTimeMS();
+    ScheduleStatisticsUpdate();
     
     TC_LOG_INFO("plugins.example", "Example Plugin started successfully");
 }
@@ -177,6 +180,8 @@ void ExamplePlugin::Stop()
     
     _state = PluginState::STOPPING;
     
+    _statisticsTimer.Cancel();
+    
     // Save statistics before stopping
     SaveStatistics();
     
@@ -218,6 +223,9 @@ bool ExamplePlugin::LoadConfig(std::string const& configPath)
     _levelUpRewardCount = _config->GetUInt("LevelUpReward.Count", 1);
     _updateInterval = _config->GetUInt("UpdateInterval", 10000);
     
+    // Pick up edits of the file without a manual reload
+    sPluginManager->WatchPluginConfig(_info.name, configPath);
+    
     TC_LOG_INFO("plugins.example", "Configuration loaded from %s", configPath.c_str());
     return true;
 }
@@ -234,10 +242,20 @@ void ExamplePlugin::ReloadConfig()
         _levelUpRewardCount = _config->GetUInt("LevelUpReward.Count", 1);
         _updateInterval = _config->GetUInt("UpdateInterval", 10000);
         
+        if (_state == PluginState::RUNNING)
+            ScheduleStatisticsUpdate();
+        
         TC_LOG_INFO("plugins.example", "Configuration reloaded");
     }
 }
 
+void ExamplePlugin::OnConfigChanged(std::unique_ptr<PluginConfig> config)
+{
+    // Parsed off the world thread, swapping it in is all that is left to do
+    _config = std::move(config);
+    ReloadConfig();
+}
+
 bool ExamplePlugin::CheckDependencies() const
 {
     // This example plugin has no dependencies
@@ -342,58 +360,56 @@ void ExamplePlugin::UnregisterChatCommands()
     TC_LOG_DEBUG("plugins.example", "Chat commands unregistered");
 }
 
-void ExamplePlugin::UpdateStatistics(uint32 diff)
+void ExamplePlugin::ScheduleStatisticsUpdate()
 {
-    uint32 currentTime = GameTime::GetGameTimeMS();
-    
-    if (currentTime - _lastUpdateTime >= _updateInterval)
-    {
-        _lastUpdateTime = currentTime;
-        
-        // Perform periodic tasks here
-        TC_LOG_TRACE("plugins.example", "Statistics updated - Logins: %u, Online: %u, Level-ups: %u", 
-                    _totalLogins, _currentOnlinePlayers, _totalLevelUps);
-    }
+    // Replaces the timer of a previous schedule, the interval may have changed
+    _statisticsTimer.Cancel();
+    sPluginManager->GetTimers().SchedulePeriodic(_statisticsTimer, _updateInterval, [this]() { UpdateStatistics(); });
+}
+
+void ExamplePlugin::UpdateStatistics()
+{
+    // Perform periodic tasks here
+    TC_LOG_TRACE("plugins.example", "Statistics updated - Logins: %u, Online: %u, Level-ups: %u", 
+                _totalLogins, _currentOnlinePlayers, _totalLevelUps);
 }
 
 void ExamplePlugin::SaveStatistics()
 {
-    std::ofstream file("plugins/example_stats.txt");
-    if (file.is_open())
-    {
-        file << "TotalLogins=" << _totalLogins << std::endl;
-        file << "TotalLevelUps=" << _totalLevelUps << std::endl;
-        file.close();
-        
-        TC_LOG_DEBUG("plugins.example", "Statistics saved");
-    }
+    // Written and renamed into place by the worker pool
+    PluginStateBlob blob(STATISTICS_VERSION);
+    blob.Write(_totalLogins);
+    blob.Write(_totalLevelUps);
+    
+    sPluginManager->GetPersistence().SaveSnapshot(STATISTICS_FILE, std::move(blob));
 }
 
 void ExamplePlugin::LoadStatistics()
 {
-    std::ifstream file("plugins/example_stats.txt");
-    if (file.is_open())
+    if (!std::filesystem::exists(STATISTICS_FILE))
+        return;
+    
+    PluginStateBlob blob;
+    std::string error;
+    if (!PluginPersistence::ReadSnapshot(STATISTICS_FILE, blob, error))
     {
-        std::string line;
-        while (std::getline(file, line))
-        {
-            size_t pos = line.find('=');
-            if (pos != std::string::npos)
-            {
-                std::string key = line.substr(0, pos);
-                std::string value = line.substr(pos + 1);
-                
-                if (key == "TotalLogins")
-                    _totalLogins = std::stoul(value);
-                else if (key == "TotalLevelUps")
-                    _totalLevelUps = std::stoul(value);
-            }
-        }
-        file.close();
-        
-        TC_LOG_DEBUG("plugins.example", "Statistics loaded - Logins: %u, Level-ups: %u", 
-                    _totalLogins, _totalLevelUps);
+        TC_LOG_ERROR("plugins.example", "Failed to load statistics: %s", error.c_str());
+        return;
+    }
+    
+    PluginStateReader reader(blob);
+    uint32 totalLogins, totalLevelUps;
+    if (blob.GetVersion() != STATISTICS_VERSION || !reader.Read(totalLogins) || !reader.Read(totalLevelUps))
+    {
+        TC_LOG_ERROR("plugins.example", "Ignoring statistics of an unknown format (version %u)", blob.GetVersion());
+        return;
     }
+    
+    _totalLogins = totalLogins;
+    _totalLevelUps = totalLevelUps;
+    
+    TC_LOG_DEBUG("plugins.example", "Statistics loaded - Logins: %u, Level-ups: %u", 
+                _totalLogins, _totalLevelUps);
 }
 
 // Chat command handlers (simplified examples)
@@ -20,6 +20,7 @@
 
 #include "IPlugin.h"
 #include "PluginConfig.h"
+#include "PluginTimerWheel.h"
 #include "Player.h"
 #include "WorldSession.h"
 #include "Chat.h"
@@ -46,10 +47,7 @@ public:
     void OnPlayerLogin(Player* player) override;
     void OnPlayerLogout(Player* player) override;
     void OnPlayerLevelChanged(Player* player, uint8 oldLevel) override;
-    void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg) override;
-    
-    // World Events
-    void OnWorldUpdate(uint32 diff) override;
+    void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string_view msg) override;
     
     // Server Events
     void OnServerStart() override;
@@ -80,6 +78,7 @@ public:
     
     bool LoadConfig(std::string const& configPath) override;
     void ReloadConfig() override;
+    void OnConfigChanged(std::unique_ptr<PluginConfig> config) override;
     
     std::vector<std::string> const& GetDependencies() const override { return _dependencies; }
     bool CheckDependencies() const override;
@@ -128,13 +127,20 @@ private:
     uint32 _totalLogins;
     uint32 _currentOnlinePlayers;
     uint32 _totalLevelUps;
-    uint32 _lastUpdateTime;
+    
+    // Periodic statistics update, cancelled on Stop()
+    PluginTimerToken _statisticsTimer;
+    
+    // Statistics snapshot, see PluginPersistence
+    static constexpr char const* STATISTICS_FILE = "plugins/example_stats.bin";
+    static constexpr uint32 STATISTICS_VERSION = 1;
     
     // Helper methods
     void InitializeConfig();
     void RegisterChatCommands();
     void UnregisterChatCommands();
-    void UpdateStatistics(uint32 diff);
+    void ScheduleStatisticsUpdate();
+    void UpdateStatistics();
     void SaveStatistics();
     void LoadStatistics();
 };
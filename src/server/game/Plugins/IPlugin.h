@@ -20,6 +20,7 @@
 
 #include "Define.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -31,6 +32,10 @@ class Creature;
 class Unit;
 class Map;
 class WorldPacket;
+class PluginEventBatch;
+class PluginCombatLog;
+class PluginConfig;
+class PluginStateBlob;
 
 enum class PluginState : uint8
 {
@@ -54,6 +59,95 @@ enum class PluginPriority : uint8
     CRITICAL = 5
 };
 
+enum class PluginEvent : uint8
+{
+    PLAYER_LOGIN = 0,
+    PLAYER_LOGOUT = 1,
+    PLAYER_LEVEL_CHANGED = 2,
+    PLAYER_CHAT = 3,
+    PLAYER_KILL = 4,
+    PLAYER_KILL_CREATURE = 5,
+    CREATURE_KILL = 6,
+    CREATURE_DEATH = 7,
+    CREATURE_RESPAWN = 8,
+    GAMEOBJECT_USE = 9,
+    GAMEOBJECT_DESTROYED = 10,
+    WORLD_UPDATE = 11,
+    MAP_UPDATE = 12,
+    PACKET_RECEIVE = 13,
+    PACKET_SEND = 14,
+    SERVER_START = 15,
+    SERVER_STOP = 16,
+    CONFIG_RELOAD = 17,
+    PLAYER_CHAT_REWRITE = 18,
+    COMBAT_LOG = 19,
+    MAX
+};
+
+constexpr size_t PLUGIN_EVENT_COUNT = static_cast<size_t>(PluginEvent::MAX);
+
+inline char const* GetPluginEventName(PluginEvent event)
+{
+    static char const* const names[PLUGIN_EVENT_COUNT] =
+    {
+        "player_login", "player_logout", "player_level_changed", "player_chat", "player_kill",
+        "player_kill_creature", "creature_kill", "creature_death", "creature_respawn",
+        "gameobject_use", "gameobject_destroyed", "world_update", "map_update",
+        "packet_receive", "packet_send", "server_start", "server_stop", "config_reload",
+        "player_chat_rewrite", "combat_log"
+    };
+    
+    return event < PluginEvent::MAX ? names[static_cast<size_t>(event)] : "unknown";
+}
+
+// Upper bound for simultaneously loaded plugins, plugin ids are below this value
+constexpr uint32 PLUGIN_MAX_IDS = 128;
+
+typedef uint64 PluginEventMask;
+
+constexpr PluginEventMask PluginEventBit(PluginEvent event)
+{
+    return PluginEventMask(1) << static_cast<uint32>(event);
+}
+
+constexpr PluginEventMask PLUGIN_EVENT_MASK_NONE = 0;
+constexpr PluginEventMask PLUGIN_EVENT_MASK_ALL = (PluginEventMask(1) << PLUGIN_EVENT_COUNT) - 1;
+
+static_assert(PLUGIN_EVENT_COUNT < 64, "PluginEventMask cannot hold all plugin events");
+
+// Events a plugin subscribes to when it does not set PluginInfo::eventMask.
+// Packets, rewriting chat and the combat log have to be requested explicitly
+// (SubscribeOpcode adds the packet event), so packets are never filtered, chat
+// never copied and combat never recorded for plugins that do not use them.
+constexpr PluginEventMask PLUGIN_EVENT_MASK_OPT_IN =
+    PluginEventBit(PluginEvent::PACKET_RECEIVE) | PluginEventBit(PluginEvent::PACKET_SEND) |
+    PluginEventBit(PluginEvent::PLAYER_CHAT_REWRITE) | PluginEventBit(PluginEvent::COMBAT_LOG);
+constexpr PluginEventMask PLUGIN_EVENT_MASK_DEFAULT = PLUGIN_EVENT_MASK_ALL & ~PLUGIN_EVENT_MASK_OPT_IN;
+
+constexpr PluginEventMask PLUGIN_EVENT_MASK_CHAT = PluginEventBit(PluginEvent::PLAYER_CHAT) | PluginEventBit(PluginEvent::PLAYER_CHAT_REWRITE);
+
+// Events that can be delivered as batches. Packet hooks have to answer
+// synchronously and server lifecycle events must not wait for a world tick.
+constexpr PluginEventMask PLUGIN_EVENT_MASK_BATCHABLE = PLUGIN_EVENT_MASK_ALL &
+    ~(PluginEventBit(PluginEvent::PACKET_RECEIVE) | PluginEventBit(PluginEvent::PACKET_SEND) |
+      PluginEventBit(PluginEvent::SERVER_START) | PluginEventBit(PluginEvent::SERVER_STOP) |
+      PluginEventBit(PluginEvent::CONFIG_RELOAD) | PluginEventBit(PluginEvent::PLAYER_CHAT_REWRITE) |
+      PluginEventBit(PluginEvent::COMBAT_LOG));
+
+enum class PluginPacketDirection : uint8
+{
+    RECEIVE = 0,
+    SEND = 1,
+    MAX
+};
+
+constexpr size_t PLUGIN_PACKET_DIRECTION_COUNT = static_cast<size_t>(PluginPacketDirection::MAX);
+
+constexpr PluginEvent GetPacketEvent(PluginPacketDirection direction)
+{
+    return direction == PluginPacketDirection::RECEIVE ? PluginEvent::PACKET_RECEIVE : PluginEvent::PACKET_SEND;
+}
+
 struct PluginInfo
 {
     std::string name;
@@ -65,7 +159,83 @@ struct PluginInfo
     PluginPriority priority;
     bool autoLoad;
     
-    PluginInfo() : priority(PluginPriority::NORMAL), autoLoad(true) { }
+    // Events the plugin's IEventHandler overrides. Handlers are only called
+    // for events in this mask; defaults to all events except
+    // PLUGIN_EVENT_MASK_OPT_IN for older plugins, which no longer see packets
+    // unless they add PACKET_RECEIVE/PACKET_SEND or subscribe opcodes.
+    PluginEventMask eventMask;
+    
+    // Opcodes routed to OnPacketReceive/OnPacketSend. A direction that is in
+    // eventMask but has no subscribed opcode receives every packet.
+    std::vector<uint16> packetOpcodes[PLUGIN_PACKET_DIRECTION_COUNT];
+    
+    // Subscribed events delivered once per world tick through
+    // IEventHandler::OnEventBatch instead of the individual handler methods.
+    // Only events in PLUGIN_EVENT_MASK_BATCHABLE can be batched.
+    PluginEventMask batchedEventMask;
+    
+    // Must match "lazy" in module.json. Lazy modules are only opened when one of
+    // their events fires or one of their interfaces is requested, see PluginLazyStub.
+    bool lazy;
+    
+    PluginInfo() : priority(PluginPriority::NORMAL), autoLoad(true), eventMask(PLUGIN_EVENT_MASK_DEFAULT), batchedEventMask(PLUGIN_EVENT_MASK_NONE), lazy(false) { }
+    
+    bool SubscribesTo(PluginEvent event) const { return (eventMask & PluginEventBit(event)) != 0; }
+    bool IsBatched(PluginEvent event) const { return (batchedEventMask & PLUGIN_EVENT_MASK_BATCHABLE & PluginEventBit(event)) != 0; }
+    
+    void SubscribeOpcode(PluginPacketDirection direction, uint16 opcode)
+    {
+        packetOpcodes[static_cast<size_t>(direction)].push_back(opcode);
+        eventMask |= PluginEventBit(GetPacketEvent(direction));
+    }
+    
+    std::vector<uint16> const& GetOpcodes(PluginPacketDirection direction) const
+    {
+        return packetOpcodes[static_cast<size_t>(direction)];
+    }
+};
+
+/*
+ * Chat message handed to plugins. OnPlayerChat observers read it as a view of
+ * the core's buffer. OnPlayerChatRewrite handlers (PluginEvent::PLAYER_CHAT_REWRITE)
+ * call Mutable() or Set(), which copy the text the first time, so a message no
+ * plugin rewrites is never copied.
+ */
+class PluginChatMessage
+{
+public:
+    explicit PluginChatMessage(std::string_view text) : _text(text), _modified(false) { }
+    
+    PluginChatMessage(PluginChatMessage const&) = delete;
+    PluginChatMessage& operator=(PluginChatMessage const&) = delete;
+    
+    std::string_view GetText() const { return _modified ? std::string_view(_buffer) : _text; }
+    bool IsModified() const { return _modified; }
+    
+    std::string& Mutable()
+    {
+        if (!_modified)
+        {
+            _buffer.assign(_text.data(), _text.size());
+            _modified = true;
+        }
+        
+        return _buffer;
+    }
+    
+    void Set(std::string_view text)
+    {
+        _buffer.assign(text.data(), text.size());
+        _modified = true;
+    }
+    
+    // Moves the rewritten text out, GetText() is empty afterwards
+    std::string Release() { return std::move(_buffer); }
+
+private:
+    std::string_view _text;
+    std::string _buffer;
+    bool _modified;
 };
 
 class TC_GAME_API IEventHandler
@@ -77,7 +247,8 @@ public:
     virtual void OnPlayerLogin(Player* /*player*/) { }
     virtual void OnPlayerLogout(Player* /*player*/) { }
     virtual void OnPlayerLevelChanged(Player* /*player*/, uint8 /*oldLevel*/) { }
-    virtual void OnPlayerChat(Player* /*player*/, uint32 /*type*/, uint32 /*lang*/, std::string& /*msg*/) { }
+    virtual void OnPlayerChat(Player* /*player*/, uint32 /*type*/, uint32 /*lang*/, std::string_view /*msg*/) { }
+    virtual void OnPlayerChatRewrite(Player* /*player*/, uint32 /*type*/, uint32 /*lang*/, PluginChatMessage& /*msg*/) { }
     virtual void OnPlayerKill(Player* /*killer*/, Player* /*killed*/) { }
     virtual void OnPlayerKillCreature(Player* /*killer*/, Creature* /*killed*/) { }
     
@@ -94,6 +265,10 @@ public:
     virtual void OnWorldUpdate(uint32 /*diff*/) { }
     virtual void OnMapUpdate(Map* /*map*/, uint32 /*diff*/) { }
     
+    // Combat of the map since its last update, see PluginCombatLog. Called by
+    // the map update thread at the end of the map's update.
+    virtual void OnCombatLog(Map* /*map*/, PluginCombatLog const& /*log*/) { }
+    
     // Packet Events
     virtual bool OnPacketReceive(WorldSession* /*session*/, WorldPacket& /*packet*/) { return true; }
     virtual bool OnPacketSend(WorldSession* /*session*/, WorldPacket const& /*packet*/) { return true; }
@@ -102,6 +277,16 @@ public:
     virtual void OnServerStart() { }
     virtual void OnServerStop() { }
     virtual void OnConfigReload() { }
+    
+    // Batched delivery, see PluginInfo::batchedEventMask and PluginEventQueue.h
+    virtual void OnEventBatch(PluginEventBatch const& /*batch*/) { }
+};
+
+// Base for plugin data kept per map, see IPlugin::CreateMapState
+class TC_GAME_API PluginMapState
+{
+public:
+    virtual ~PluginMapState() = default;
 };
 
 class TC_GAME_API IPlugin
@@ -110,6 +295,12 @@ public:
     virtual ~IPlugin() = default;
     
     // Plugin lifecycle
+    // Load() and Initialize() may run on worker pool threads, concurrently with
+    // other plugins (global setting "Plugins.ParallelStartup"). They must only
+    // touch the plugin's own state and the thread safe registries (interfaces,
+    // metrics, symbols). Timers, the sweeper and other world thread facilities
+    // are set up in Start(), which like Stop() always runs on the world thread;
+    // the timer wheel and sweeper registration assert on any other thread.
     virtual bool Load() = 0;
     virtual bool Initialize() = 0;
     virtual void Start() = 0;
@@ -120,6 +311,10 @@ public:
     virtual PluginInfo const& GetInfo() const = 0;
     virtual PluginState GetState() const = 0;
     
+    // World thread, after the manager stopped a misbehaving plugin or a lazy stub
+    // failed to activate. Override when GetState() is not backed by _state.
+    virtual void OnError() { _state = PluginState::ERROR; }
+    
     // Event handling
     virtual IEventHandler* GetEventHandler() { return nullptr; }
     
@@ -127,21 +322,48 @@ public:
     virtual bool LoadConfig(std::string const& /*configPath*/) { return true; }
     virtual void ReloadConfig() { }
     
+    // World thread, with the freshly parsed file registered through PluginManager::WatchPluginConfig
+    virtual void OnConfigChanged(std::unique_ptr<PluginConfig> config);
+    
     // Dependencies
     virtual std::vector<std::string> const& GetDependencies() const = 0;
     virtual bool CheckDependencies() const = 0;
     
+    // Hot reload, see PluginManager::ReloadPlugin
+    // ExportState is called on the old instance after Stop(), ImportState on the
+    // new instance after Initialize() and before Start(), both on the world
+    // thread. Return false when there is nothing to hand over or the blob's
+    // version is not understood; the new instance then starts from scratch.
+    virtual bool ExportState(PluginStateBlob& /*blob*/) { return false; }
+    virtual bool ImportState(PluginStateBlob const& /*blob*/) { return false; }
+    
     // Plugin communication
-    virtual void* GetInterface(std::string const& /*interfaceName*/) { return nullptr; }
-    virtual bool HasInterface(std::string const& /*interfaceName*/) const { return false; }
+    // String keyed, prefer typed handles from sPluginInterfaces (PluginInterface.h).
+    // By default these look up the interfaces this plugin provided to the registry.
+    virtual void* GetInterface(std::string const& interfaceName);
+    virtual bool HasInterface(std::string const& interfaceName) const;
+    
+    // Per map state
+    // Created on first use from the thread updating the map and destroyed with
+    // the map or when the plugin is unloaded. Code running inside OnMapUpdate
+    // for that map can use it without any locking.
+    virtual std::unique_ptr<PluginMapState> CreateMapState(Map* /*map*/) { return nullptr; }
+    
+    PluginMapState* GetMapState(Map* map);
     
+    template<typename T>
+    T* GetMapState(Map* map) { return static_cast<T*>(GetMapState(map)); }
+
 protected:
+    friend class PluginManager;     // assigns the plugin id
+    
     PluginState _state = PluginState::UNLOADED;
+    uint16 _pluginId = 0;
 };
 
 // Plugin factory function type
-typedef std::unique_ptr<IPlugin>(*)() PluginCreateFunc;
-typedef void(*)() PluginDestroyFunc;
+typedef std::unique_ptr<IPlugin>(*PluginCreateFunc)();
+typedef void(*PluginDestroyFunc)();
 
 // Macros for plugin registration
 #define TRINITY_PLUGIN_EXPORT extern "C" TC_GAME_API
@@ -156,4 +378,13 @@ typedef void(*)() PluginDestroyFunc;
         /* Cleanup if needed */ \
     }
 
+// Registration for modules, which may also be linked into the server
+// (MODULES_STATIC). A static module exports no factory, the plugin manager
+// creates it from the generated static module list instead.
+#ifdef TRINITY_STATIC_MODULE
+#define REGISTER_PLUGIN(PluginClass)
+#else
+#define REGISTER_PLUGIN(PluginClass) DECLARE_TRINITY_PLUGIN(PluginClass)
+#endif
+
 #endif // TRINITY_IPLUGIN_H
\ No newline at end of file
@@ -0,0 +1,153 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginArena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+PluginArena& PluginArena::Thread()
+{
+    thread_local PluginArena arena;
+    return arena;
+}
+
+PluginArena::~PluginArena()
+{
+    Release();
+}
+
+std::string_view PluginArena::Copy(std::string_view text)
+{
+    if (text.empty())
+        return std::string_view();
+    
+    char* data = static_cast<char*>(Allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return std::string_view(data, text.size());
+}
+
+void PluginArena::Rewind(Marker marker)
+{
+    // Chunks taken after the marker stay linked behind it and are reused before allocating new ones
+    if (!marker.chunk)
+    {
+        _current = _first;
+        _cursor = _first ? _first->Begin() : nullptr;
+    }
+    else
+    {
+        _current = static_cast<Chunk*>(marker.chunk);
+        _cursor = marker.cursor;
+    }
+    
+    _end = _current ? _current->End() : nullptr;
+}
+
+void PluginArena::Reset()
+{
+    if (!_first)
+        return;
+    
+    _peak = std::max(_peak, GetUsed());
+    
+    if (_first->next)
+    {
+        size_t reserved = GetReserved();
+        Release();
+        _first = NewChunk(reserved);
+    }
+    
+    _current = _first;
+    _cursor = _first->Begin();
+    _end = _first->End();
+}
+
+size_t PluginArena::GetUsed() const
+{
+    size_t used = 0;
+    for (Chunk* chunk = _first; chunk && chunk != _current; chunk = chunk->next)
+        used += chunk->size;
+    
+    if (_current)
+        used += _cursor - _current->Begin();
+    
+    return used;
+}
+
+size_t PluginArena::GetReserved() const
+{
+    size_t reserved = 0;
+    for (Chunk* chunk = _first; chunk; chunk = chunk->next)
+        reserved += chunk->size;
+    
+    return reserved;
+}
+
+PluginArena::Chunk* PluginArena::NewChunk(size_t size)
+{
+    void* memory = std::malloc(sizeof(Chunk) + size);
+    if (!memory)
+        throw std::bad_alloc();
+    
+    Chunk* chunk = static_cast<Chunk*>(memory);
+    chunk->next = nullptr;
+    chunk->size = size;
+    return chunk;
+}
+
+void* PluginArena::AllocateSlow(size_t size, size_t alignment)
+{
+    size_t needed = size + alignment;
+    
+    if (_current && _current->next && _current->next->size >= needed)
+        _current = _current->next;
+    else
+    {
+        Chunk* chunk = NewChunk(std::max(CHUNK_SIZE, needed));
+        if (_current)
+        {
+            chunk->next = _current->next;
+            _current->next = chunk;
+        }
+        else
+            _first = chunk;
+        
+        _current = chunk;
+    }
+    
+    char* ptr = Align(_current->Begin(), alignment);
+    _cursor = ptr + size;
+    _end = _current->End();
+    return ptr;
+}
+
+void PluginArena::Release()
+{
+    while (_first)
+    {
+        Chunk* next = _first->next;
+        std::free(_first);
+        _first = next;
+    }
+    
+    _current = nullptr;
+    _cursor = nullptr;
+    _end = nullptr;
+}
@@ -0,0 +1,172 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_ARENA_H
+#define TRINITY_PLUGIN_ARENA_H
+
+#include "Define.h"
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Per thread bump allocator for scratch memory of plugin handlers.
+ *
+ * Every thread has its own arena, PluginArena::Thread(). Allocation moves a
+ * pointer, freeing is a no-op (except for the most recent allocation, so
+ * growing a container in place wastes nothing) and all memory is released at
+ * once by Reset():
+ *  - the world thread arena at the end of every world update,
+ *  - a map thread arena at the end of every map update.
+ * Threads without a tick (network threads) rewind with a PluginArenaScope,
+ * the manager opens one around packet handlers.
+ *
+ * Nothing allocated from an arena may outlive the reset, keep arena memory in
+ * locals only. Destructors are not run by Reset(), so keep to trivially
+ * destructible data or containers using PluginArenaAllocator.
+ */
+class TC_GAME_API PluginArena
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    
+    struct Marker
+    {
+        void* chunk;
+        char* cursor;
+    };
+    
+    // Arena of the calling thread
+    static PluginArena& Thread();
+    
+    PluginArena() : _first(nullptr), _current(nullptr), _cursor(nullptr), _end(nullptr), _peak(0) { }
+    ~PluginArena();
+    
+    PluginArena(PluginArena const&) = delete;
+    PluginArena& operator=(PluginArena const&) = delete;
+    
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        // Aligning may step past the end of a chunk whose size is not a multiple of the alignment
+        char* ptr = Align(_cursor, alignment);
+        if (!_cursor || ptr > _end || size > static_cast<size_t>(_end - ptr))
+            return AllocateSlow(size, alignment);
+        
+        _cursor = ptr + size;
+        return ptr;
+    }
+    
+    // Only the most recent allocation is given back, anything else waits for Reset()
+    void Deallocate(void* ptr, size_t size)
+    {
+        if (static_cast<char*>(ptr) + size == _cursor)
+            _cursor = static_cast<char*>(ptr);
+    }
+    
+    std::string_view Copy(std::string_view text);
+    
+    Marker GetMarker() const { return { _current, _cursor }; }
+    void Rewind(Marker marker);
+    
+    // Frees everything. If the last tick needed more than one chunk they are
+    // merged into a single one, so a steady workload stops calling malloc
+    void Reset();
+    
+    size_t GetUsed() const;
+    size_t GetReserved() const;
+    size_t GetPeak() const { return _peak; }    // largest GetUsed() seen by Reset()
+
+private:
+    // Over aligned so that Begin() of a malloc'ed chunk suits any fundamental type
+    struct alignas(std::max_align_t) Chunk
+    {
+        Chunk* next;
+        size_t size;    // usable bytes after the header
+        
+        char* Begin() { return reinterpret_cast<char*>(this + 1); }
+        char* End() { return Begin() + size; }
+    };
+    
+    static char* Align(char* ptr, size_t alignment)
+    {
+        return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(ptr) + alignment - 1) & ~(uintptr_t(alignment) - 1));
+    }
+    
+    static Chunk* NewChunk(size_t size);
+    void* AllocateSlow(size_t size, size_t alignment);
+    void Release();
+    
+    Chunk* _first;
+    Chunk* _current;
+    char* _cursor;
+    char* _end;
+    size_t _peak;
+};
+
+// Rewinds the arena to where it was on construction
+class PluginArenaScope
+{
+public:
+    explicit PluginArenaScope(PluginArena& arena = PluginArena::Thread()) : _arena(arena), _marker(arena.GetMarker()) { }
+    ~PluginArenaScope() { _arena.Rewind(_marker); }
+    
+    PluginArenaScope(PluginArenaScope const&) = delete;
+    PluginArenaScope& operator=(PluginArenaScope const&) = delete;
+
+private:
+    PluginArena& _arena;
+    PluginArena::Marker _marker;
+};
+
+// Standard allocator over an arena, the default constructed one uses the calling thread's arena
+template<typename T>
+class PluginArenaAllocator
+{
+public:
+    typedef T value_type;
+    
+    PluginArenaAllocator() : _arena(&PluginArena::Thread()) { }
+    explicit PluginArenaAllocator(PluginArena& arena) : _arena(&arena) { }
+    
+    template<typename U>
+    PluginArenaAllocator(PluginArenaAllocator<U> const& other) : _arena(other.GetArena()) { }
+    
+    T* allocate(size_t count) { return static_cast<T*>(_arena->Allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T* ptr, size_t count) { _arena->Deallocate(ptr, count * sizeof(T)); }
+    
+    PluginArena* GetArena() const { return _arena; }
+    
+    template<typename U>
+    bool operator==(PluginArenaAllocator<U> const& other) const { return _arena == other.GetArena(); }
+    template<typename U>
+    bool operator!=(PluginArenaAllocator<U> const& other) const { return _arena != other.GetArena(); }
+
+private:
+    PluginArena* _arena;
+};
+
+template<typename T>
+using PluginArenaVector = std::vector<T, PluginArenaAllocator<T>>;
+
+typedef std::basic_string<char, std::char_traits<char>, PluginArenaAllocator<char>> PluginArenaString;
+typedef std::basic_ostringstream<char, std::char_traits<char>, PluginArenaAllocator<char>> PluginArenaStringStream;
+
+#endif // TRINITY_PLUGIN_ARENA_H
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginClock.h"
+#include "Log.h"
+#include <thread>
+
+double PluginClock::_nanosecondsPerTick = 1.0;
+
+void PluginClock::Calibrate()
+{
+#if TRINITY_PLUGIN_CLOCK_TSC
+    auto wallStart = std::chrono::steady_clock::now();
+    uint64 ticksStart = Now();
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    
+    uint64 ticks = Now() - ticksStart;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wallStart).count();
+    
+    if (ticks > 0 && elapsed > 0)
+        _nanosecondsPerTick = static_cast<double>(elapsed) / static_cast<double>(ticks);
+    
+    TC_LOG_DEBUG("plugins", "Plugin clock calibrated: %.3f GHz TSC", 1.0 / _nanosecondsPerTick);
+#endif
+}
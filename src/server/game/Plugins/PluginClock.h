@@ -0,0 +1,61 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_CLOCK_H
+#define TRINITY_PLUGIN_CLOCK_H
+
+#include "Define.h"
+#include <chrono>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRINITY_PLUGIN_CLOCK_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define TRINITY_PLUGIN_CLOCK_TSC 0
+#endif
+
+/*
+ * Cheap timestamps for measuring plugin handlers.
+ * Uses the TSC where available (calibrated against steady_clock once at
+ * startup) and steady_clock nanoseconds everywhere else.
+ */
+class TC_GAME_API PluginClock
+{
+public:
+    static uint64 Now()
+    {
+#if TRINITY_PLUGIN_CLOCK_TSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    
+    static void Calibrate();
+    
+    static uint64 ToNanoseconds(uint64 ticks) { return static_cast<uint64>(static_cast<double>(ticks) * _nanosecondsPerTick); }
+    static uint64 FromNanoseconds(uint64 nanoseconds) { return static_cast<uint64>(static_cast<double>(nanoseconds) / _nanosecondsPerTick); }
+
+private:
+    static double _nanosecondsPerTick;
+};
+
+#endif // TRINITY_PLUGIN_CLOCK_H
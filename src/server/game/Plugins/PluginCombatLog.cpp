@@ -0,0 +1,147 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginCombatLog.h"
+#include "PluginHooks.h"
+#include "Spell.h"
+#include "SpellInfo.h"
+#include "Unit.h"
+#include <algorithm>
+#include <utility>
+
+void PluginCombatLog::Clear()
+{
+    for (PluginCombatStream& stream : _streams)
+        stream.Clear();
+    
+    _duration = 0;
+    _size = 0;
+}
+
+uint64 PluginCombatMath::Sum(PluginSpan<uint32> amounts)
+{
+    uint32 const* values = amounts.data();
+    size_t const count = amounts.size();
+    
+    uint64 total = 0;
+    for (size_t i = 0; i < count; ++i)
+        total += values[i];
+    
+    return total;
+}
+
+uint32 PluginCombatMath::Max(PluginSpan<uint32> amounts)
+{
+    uint32 const* values = amounts.data();
+    size_t const count = amounts.size();
+    
+    uint32 highest = 0;
+    for (size_t i = 0; i < count; ++i)
+        highest = std::max(highest, values[i]);
+    
+    return highest;
+}
+
+uint64 PluginCombatMath::SumFor(uint64 guid, PluginSpan<uint64> units, PluginSpan<uint32> amounts)
+{
+    uint64 const* keys = units.data();
+    uint32 const* values = amounts.data();
+    size_t const count = std::min(units.size(), amounts.size());
+    
+    // Select instead of branch, the loop turns into masked vector adds
+    uint64 total = 0;
+    for (size_t i = 0; i < count; ++i)
+        total += keys[i] == guid ? uint64(values[i]) : 0;
+    
+    return total;
+}
+
+void PluginCombatMath::SumByUnit(PluginSpan<uint64> units, PluginSpan<uint32> amounts, std::vector<PluginCombatTotal>& totals)
+{
+    size_t const count = std::min(units.size(), amounts.size());
+    if (!count)
+        return;
+    
+    // Scratch buffers keep their capacity between calls of the same thread
+    thread_local std::vector<std::pair<uint64, uint32>> rows;
+    thread_local std::vector<PluginCombatTotal> merged;
+    
+    rows.clear();
+    rows.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        rows.emplace_back(units[i], amounts[i]);
+    
+    std::sort(rows.begin(), rows.end(), [](auto const& left, auto const& right) { return left.first < right.first; });
+    
+    merged.clear();
+    merged.reserve(totals.size() + count);
+    
+    auto existing = totals.begin();
+    for (size_t i = 0; i < count;)
+    {
+        PluginCombatTotal total = { rows[i].first, 0, 0 };
+        for (; i < count && rows[i].first == total.guid; ++i)
+        {
+            total.amount += rows[i].second;
+            ++total.count;
+        }
+        
+        while (existing != totals.end() && existing->guid < total.guid)
+            merged.push_back(*existing++);
+        
+        if (existing != totals.end() && existing->guid == total.guid)
+        {
+            total.amount += existing->amount;
+            total.count += existing->count;
+            ++existing;
+        }
+        
+        merged.push_back(total);
+    }
+    
+    merged.insert(merged.end(), existing, totals.end());
+    totals.swap(merged);
+}
+
+// Combat hooks only record, subscribers get the whole map's combat once per map update
+void PluginHooks::OnSpellHit(Unit* caster, Unit* target, Spell* spell)
+{
+    if constexpr (IsPluginHookCompiled(PluginEvent::COMBAT_LOG))
+        if (PluginManager::HasEventSubscribers(PluginEvent::COMBAT_LOG))
+            sPluginManager->RecordCombat(PluginCombatKind::SPELL_HIT, caster, target, spell ? spell->GetSpellInfo()->Id : 0, 0);
+}
+
+void PluginHooks::OnSpellEffect(Unit* caster, Unit* target, uint32 spellId, uint32 effIndex)
+{
+    if constexpr (IsPluginHookCompiled(PluginEvent::COMBAT_LOG))
+        if (PluginManager::HasEventSubscribers(PluginEvent::COMBAT_LOG))
+            sPluginManager->RecordCombat(PluginCombatKind::SPELL_EFFECT, caster, target, spellId, effIndex);
+}
+
+void PluginHooks::OnDamageDealt(Unit* attacker, Unit* victim, uint32 damage, uint32 spellId)
+{
+    if constexpr (IsPluginHookCompiled(PluginEvent::COMBAT_LOG))
+        if (PluginManager::HasEventSubscribers(PluginEvent::COMBAT_LOG))
+            sPluginManager->RecordCombat(PluginCombatKind::DAMAGE, attacker, victim, spellId, damage);
+}
+
+void PluginHooks::OnHealingDone(Unit* healer, Unit* target, uint32 healing, uint32 spellId)
+{
+    if constexpr (IsPluginHookCompiled(PluginEvent::COMBAT_LOG))
+        if (PluginManager::HasEventSubscribers(PluginEvent::COMBAT_LOG))
+            sPluginManager->RecordCombat(PluginCombatKind::HEALING, healer, target, spellId, healing);
+}
@@ -0,0 +1,159 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_COMBAT_LOG_H
+#define TRINITY_PLUGIN_COMBAT_LOG_H
+
+#include "Define.h"
+#include <array>
+#include <vector>
+
+enum class PluginCombatKind : uint8
+{
+    DAMAGE = 0,         // amount = damage dealt
+    HEALING = 1,        // amount = healing done
+    SPELL_HIT = 2,      // amount = 0
+    SPELL_EFFECT = 3,   // amount = effect index
+    MAX
+};
+
+constexpr size_t PLUGIN_COMBAT_KIND_COUNT = static_cast<size_t>(PluginCombatKind::MAX);
+
+// Read only view of a contiguous column
+template<typename T>
+class PluginSpan
+{
+public:
+    PluginSpan() : _data(nullptr), _size(0) { }
+    PluginSpan(T const* data, size_t size) : _data(data), _size(size) { }
+    PluginSpan(std::vector<T> const& values) : _data(values.data()), _size(values.size()) { }
+    
+    T const* data() const { return _data; }
+    T const* begin() const { return _data; }
+    T const* end() const { return _data + _size; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    T const& operator[](size_t index) const { return _data[index]; }
+
+private:
+    T const* _data;
+    size_t _size;
+};
+
+/*
+ * Combat events of one kind as a structure of arrays. Row i is
+ * (GetSources()[i], GetTargets()[i], GetSpellIds()[i], GetAmounts()[i]),
+ * guids are ObjectGuid raw values and spell id 0 is a melee hit.
+ */
+class TC_GAME_API PluginCombatStream
+{
+public:
+    void Push(uint64 source, uint64 target, uint32 spellId, uint32 amount)
+    {
+        _sources.push_back(source);
+        _targets.push_back(target);
+        _spellIds.push_back(spellId);
+        _amounts.push_back(amount);
+    }
+    
+    // Keeps the capacity, a map records about as much combat every update
+    void Clear()
+    {
+        _sources.clear();
+        _targets.clear();
+        _spellIds.clear();
+        _amounts.clear();
+    }
+    
+    size_t size() const { return _sources.size(); }
+    bool empty() const { return _sources.empty(); }
+    
+    PluginSpan<uint64> GetSources() const { return _sources; }
+    PluginSpan<uint64> GetTargets() const { return _targets; }
+    PluginSpan<uint32> GetSpellIds() const { return _spellIds; }
+    PluginSpan<uint32> GetAmounts() const { return _amounts; }
+
+private:
+    std::vector<uint64> _sources;
+    std::vector<uint64> _targets;
+    std::vector<uint32> _spellIds;
+    std::vector<uint32> _amounts;
+};
+
+/*
+ * Combat recorded on one map during one map update, handed to
+ * IEventHandler::OnCombatLog at the end of the update instead of calling a
+ * handler per hit. Filled and delivered by the thread updating the map.
+ */
+class TC_GAME_API PluginCombatLog
+{
+public:
+    PluginCombatLog() : _duration(0), _size(0) { }
+    
+    PluginCombatStream const& GetStream(PluginCombatKind kind) const { return _streams[static_cast<size_t>(kind)]; }
+    PluginCombatStream const& GetDamage() const { return GetStream(PluginCombatKind::DAMAGE); }
+    PluginCombatStream const& GetHealing() const { return GetStream(PluginCombatKind::HEALING); }
+    
+    // Milliseconds of game time the log covers, the diff of the map update
+    uint32 GetDuration() const { return _duration; }
+    
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    
+    void Record(PluginCombatKind kind, uint64 source, uint64 target, uint32 spellId, uint32 amount)
+    {
+        _streams[static_cast<size_t>(kind)].Push(source, target, spellId, amount);
+        ++_size;
+    }
+    
+    void SetDuration(uint32 duration) { _duration = duration; }
+    void Clear();
+
+private:
+    std::array<PluginCombatStream, PLUGIN_COMBAT_KIND_COUNT> _streams;
+    uint32 _duration;
+    size_t _size;
+};
+
+struct PluginCombatTotal
+{
+    uint64 guid;
+    uint64 amount;
+    uint32 count;
+};
+
+/*
+ * Reductions over combat streams. The loops run over contiguous columns without
+ * branches so the compiler vectorizes them.
+ */
+class TC_GAME_API PluginCombatMath
+{
+public:
+    static uint64 Sum(PluginSpan<uint32> amounts);
+    static uint32 Max(PluginSpan<uint32> amounts);
+    
+    // Sum of the amounts of the rows whose unit column equals guid
+    static uint64 SumFor(uint64 guid, PluginSpan<uint64> units, PluginSpan<uint32> amounts);
+    
+    // Adds the amounts per unit to totals, which is kept sorted by guid so it
+    // can accumulate several logs (for example damage per attacker over a fight)
+    static void SumByUnit(PluginSpan<uint64> units, PluginSpan<uint32> amounts, std::vector<PluginCombatTotal>& totals);
+    
+    static double PerSecond(uint64 amount, uint32 milliseconds) { return milliseconds ? double(amount) * 1000.0 / double(milliseconds) : 0.0; }
+};
+
+#endif // TRINITY_PLUGIN_COMBAT_LOG_H
@@ -0,0 +1,160 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginHooks.h"
+#include "PluginManager.h"
+#include "Chat.h"
+#include "Language.h"
+#include "RBAC.h"
+#include "ScriptMgr.h"
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+
+// Chat Command Handler
+class PluginChatHandler
+{
+public:
+    // .plugin perf [on|off|reset]
+    static bool HandlePluginPerfCommand(ChatHandler* handler, char const* args)
+    {
+        std::string_view const option = TrimArgs(args);
+        if (!option.empty())
+        {
+            if (option == "on")
+            {
+                sPluginManager->SetProfilingEnabled(true);
+                handler->SendSysMessage("Plugin profiling enabled.");
+            }
+            else if (option == "off")
+            {
+                sPluginManager->SetProfilingEnabled(false);
+                handler->SendSysMessage("Plugin profiling disabled.");
+            }
+            else if (option == "reset")
+            {
+                sPluginManager->ResetPerformanceStats();
+                handler->SendSysMessage("Plugin profiling statistics reset.");
+            }
+            else
+            {
+                handler->SendSysMessage("Usage: .plugin perf [on|off|reset]");
+                handler->SetSentErrorMessage(true);
+                return false;
+            }
+            
+            return true;
+        }
+        
+        std::vector<PluginPerfStats> stats = sPluginManager->GetPerformanceStats();
+        
+        std::ostringstream ss;
+        ss << "Plugin profiling is " << (sPluginManager->IsProfilingEnabled() ? "enabled" : "disabled") << ".";
+        
+        if (stats.empty())
+        {
+            ss << " No samples recorded.";
+            handler->SendSysMessage(ss.str().c_str());
+            return true;
+        }
+        
+        handler->SendSysMessage(ss.str().c_str());
+        handler->SendSysMessage("Plugin / event: calls, total ms, avg us, p50 us, p99 us, max us");
+        
+        for (PluginPerfStats const& entry : stats)
+        {
+            PluginLatencySnapshot const& latency = entry.latency;
+            
+            ss.str("");
+            ss << std::fixed << std::setprecision(1);
+            ss << entry.pluginName << " / " << GetPluginEventName(entry.event) << ": "
+               << latency.calls << ", "
+               << latency.totalNanoseconds / 1000000.0 << ", "
+               << latency.GetAverageNanoseconds() / 1000.0 << ", "
+               << latency.p50Nanoseconds / 1000.0 << ", "
+               << latency.p99Nanoseconds / 1000.0 << ", "
+               << latency.maxNanoseconds / 1000.0;
+            
+            handler->SendSysMessage(ss.str().c_str());
+        }
+        
+        return true;
+    }
+    
+    // .plugin trace [seconds]
+    static bool HandlePluginTraceCommand(ChatHandler* handler, char const* args)
+    {
+        uint32 seconds = (args && *args) ? uint32(strtoul(args, nullptr, 10)) : 10;
+        if (!seconds)
+        {
+            handler->SendSysMessage("Usage: .plugin trace [seconds]");
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+        
+        std::string filePath = sPluginManager->DumpTrace(seconds);
+        if (filePath.empty())
+        {
+            handler->SendSysMessage("Plugin tracing is disabled (Plugins.Trace = 0).");
+            return true;
+        }
+        
+        handler->PSendSysMessage("Writing the plugin hooks of the last %u seconds to %s.", seconds, filePath.c_str());
+        return true;
+    }
+
+private:
+    // The chat parser leaves the spaces around the arguments in place
+    static std::string_view TrimArgs(char const* args)
+    {
+        std::string_view text = args ? args : "";
+        
+        size_t first = text.find_first_not_of(" \t");
+        if (first == std::string_view::npos)
+            return std::string_view();
+        
+        return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+    }
+};
+
+class plugin_commandscript : public CommandScript
+{
+public:
+    plugin_commandscript() : CommandScript("plugin_commandscript") { }
+    
+    std::vector<ChatCommand> GetCommands() const override
+    {
+        static std::vector<ChatCommand> pluginCommandTable =
+        {
+            { "perf", rbac::RBAC_PERM_COMMAND_RELOAD, true, &PluginChatHandler::HandlePluginPerfCommand, "" },
+            { "trace", rbac::RBAC_PERM_COMMAND_RELOAD, true, &PluginChatHandler::HandlePluginTraceCommand, "" },
+        };
+        
+        static std::vector<ChatCommand> commandTable =
+        {
+            { "plugin", rbac::RBAC_PERM_COMMAND_RELOAD, true, nullptr, "", pluginCommandTable },
+        };
+        
+        return commandTable;
+    }
+};
+
+void AddSC_plugin_commandscript()
+{
+    new plugin_commandscript();
+}
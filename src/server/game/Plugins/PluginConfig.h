@@ -24,6 +24,7 @@
 #include <vector>
 #include <memory>
 #include <any>
+#include <mutex>
 
 class TC_GAME_API PluginConfig
 {
@@ -156,7 +157,7 @@ public:
     bool ExportPluginConfigs(std::string const& exportFile) const;
     bool ImportPluginConfigs(std::string const& importFile);
     
-    // Configuration monitoring
+    // Configuration monitoring, change notification runs on the PluginConfigWatcher thread
     void StartConfigMonitoring();
     void StopConfigMonitoring();
     bool IsConfigMonitoringActive() const { return _monitoringActive; }
@@ -176,7 +177,6 @@ private:
     // Configuration monitoring
     bool _monitoringActive;
     std::unordered_map<std::string, std::string> _configFilePaths;
-    std::unordered_map<std::string, uint64> _configFileTimestamps;
     
     // Thread safety
     mutable std::mutex _configMutex;
@@ -186,8 +186,6 @@ private:
     static std::mutex _instanceMutex;
     
     // Helper methods
-    bool CheckConfigFileChanged(std::string const& pluginName);
-    uint64 GetFileTimestamp(std::string const& filePath) const;
     void ProcessConfigChange(std::string const& pluginName);
 };
 
@@ -0,0 +1,137 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginConfigHandle.h"
+#include "PluginConfig.h"
+#include "PluginEpoch.h"
+#include "Config.h"
+
+PluginConfigTable::PluginConfigTable() : _values(nullptr), _snapshot(nullptr)
+{
+    PublishDefaults();
+}
+
+PluginConfigTable::~PluginConfigTable()
+{
+    // Handles die with their owner, nothing reads the table anymore
+    delete _snapshot;
+}
+
+uint32 PluginConfigTable::AddEntry(std::string const& key, PluginConfigType type, PluginConfigValue const& defaultValue)
+{
+    std::lock_guard<std::mutex> lock(_publishMutex);
+    
+    Entry entry;
+    entry.key = key;
+    entry.type = type;
+    entry.defaultValue = defaultValue;
+    _entries.push_back(std::move(entry));
+    
+    // Keep the published array in step with the entries, the new slot reads its default until the next Publish()
+    std::unique_ptr<Snapshot> snapshot = std::make_unique<Snapshot>(*_snapshot);
+    snapshot->push_back(defaultValue);
+    Store(std::move(snapshot));
+    
+    return uint32(_entries.size() - 1);
+}
+
+void PluginConfigTable::Store(std::unique_ptr<Snapshot> snapshot)
+{
+    Snapshot const* previous = _snapshot;
+    _snapshot = snapshot.release();
+    _values.store(_snapshot->data(), std::memory_order_release);
+    
+    if (previous)
+        sPluginEpoch->Retire(previous);
+}
+
+void PluginConfigTable::Publish(PluginConfig const& config)
+{
+    std::lock_guard<std::mutex> lock(_publishMutex);
+    
+    std::unique_ptr<Snapshot> snapshot = std::make_unique<Snapshot>(_entries.size());
+    for (size_t i = 0; i < _entries.size(); ++i)
+    {
+        Entry const& entry = _entries[i];
+        PluginConfigValue& value = (*snapshot)[i];
+        
+        switch (entry.type)
+        {
+            case PluginConfigType::BOOL:
+                value.boolValue = config.GetBool(entry.key, entry.defaultValue.boolValue);
+                break;
+            case PluginConfigType::INT:
+                value.intValue = config.GetInt(entry.key, entry.defaultValue.intValue);
+                break;
+            case PluginConfigType::UINT:
+                value.uintValue = config.GetUInt(entry.key, entry.defaultValue.uintValue);
+                break;
+            case PluginConfigType::FLOAT:
+                value.floatValue = config.GetFloat(entry.key, entry.defaultValue.floatValue);
+                break;
+            case PluginConfigType::STRING:
+                value.stringValue = config.GetString(entry.key, entry.defaultValue.stringValue);
+                break;
+        }
+    }
+    
+    Store(std::move(snapshot));
+}
+
+void PluginConfigTable::PublishFromServerConfig()
+{
+    std::lock_guard<std::mutex> lock(_publishMutex);
+    
+    std::unique_ptr<Snapshot> snapshot = std::make_unique<Snapshot>(_entries.size());
+    for (size_t i = 0; i < _entries.size(); ++i)
+    {
+        Entry const& entry = _entries[i];
+        PluginConfigValue& value = (*snapshot)[i];
+        
+        switch (entry.type)
+        {
+            case PluginConfigType::BOOL:
+                value.boolValue = sConfigMgr->GetBoolDefault(entry.key, entry.defaultValue.boolValue);
+                break;
+            case PluginConfigType::INT:
+                value.intValue = sConfigMgr->GetIntDefault(entry.key, entry.defaultValue.intValue);
+                break;
+            case PluginConfigType::UINT:
+                value.uintValue = uint32(sConfigMgr->GetIntDefault(entry.key, int32(entry.defaultValue.uintValue)));
+                break;
+            case PluginConfigType::FLOAT:
+                value.floatValue = sConfigMgr->GetFloatDefault(entry.key, entry.defaultValue.floatValue);
+                break;
+            case PluginConfigType::STRING:
+                value.stringValue = sConfigMgr->GetStringDefault(entry.key, entry.defaultValue.stringValue);
+                break;
+        }
+    }
+    
+    Store(std::move(snapshot));
+}
+
+void PluginConfigTable::PublishDefaults()
+{
+    std::lock_guard<std::mutex> lock(_publishMutex);
+    
+    std::unique_ptr<Snapshot> snapshot = std::make_unique<Snapshot>();
+    for (Entry const& entry : _entries)
+        snapshot->push_back(entry.defaultValue);
+    
+    Store(std::move(snapshot));
+}
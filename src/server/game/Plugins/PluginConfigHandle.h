@@ -0,0 +1,173 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_CONFIG_HANDLE_H
+#define TRINITY_PLUGIN_CONFIG_HANDLE_H
+
+#include "Define.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class PluginConfig;
+
+enum class PluginConfigType : uint8
+{
+    BOOL,
+    INT,
+    UINT,
+    FLOAT,
+    STRING
+};
+
+struct PluginConfigValue
+{
+    bool boolValue = false;
+    int32 intValue = 0;
+    uint32 uintValue = 0;
+    float floatValue = 0.0f;
+    std::string stringValue;
+};
+
+template<typename T> struct PluginConfigTraits;
+
+template<> struct PluginConfigTraits<bool>
+{
+    static constexpr PluginConfigType Type = PluginConfigType::BOOL;
+    static bool const& Get(PluginConfigValue const& value) { return value.boolValue; }
+    static void Set(PluginConfigValue& value, bool v) { value.boolValue = v; }
+};
+
+template<> struct PluginConfigTraits<int32>
+{
+    static constexpr PluginConfigType Type = PluginConfigType::INT;
+    static int32 const& Get(PluginConfigValue const& value) { return value.intValue; }
+    static void Set(PluginConfigValue& value, int32 v) { value.intValue = v; }
+};
+
+template<> struct PluginConfigTraits<uint32>
+{
+    static constexpr PluginConfigType Type = PluginConfigType::UINT;
+    static uint32 const& Get(PluginConfigValue const& value) { return value.uintValue; }
+    static void Set(PluginConfigValue& value, uint32 v) { value.uintValue = v; }
+};
+
+template<> struct PluginConfigTraits<float>
+{
+    static constexpr PluginConfigType Type = PluginConfigType::FLOAT;
+    static float const& Get(PluginConfigValue const& value) { return value.floatValue; }
+    static void Set(PluginConfigValue& value, float v) { value.floatValue = v; }
+};
+
+template<> struct PluginConfigTraits<std::string>
+{
+    static constexpr PluginConfigType Type = PluginConfigType::STRING;
+    static std::string const& Get(PluginConfigValue const& value) { return value.stringValue; }
+    static void Set(PluginConfigValue& value, std::string const& v) { value.stringValue = v; }
+};
+
+template<typename T> class PluginConfigHandle;
+
+/*
+ * Compiled view of a set of configuration keys.
+ *
+ * Keys are bound once (usually in the plugin constructor) and get a fixed slot
+ * in a flat value array. Publish() resolves every key against a config source
+ * into a new array and swaps it in with a single atomic store; the previous
+ * array is retired through sPluginEpoch. Reading a handle is one acquire load
+ * plus an indexed access, no hashing, string building or any_cast.
+ *
+ * Publish from one thread at a time (it is serialized internally). Values are
+ * always safe to read during event dispatch and on the world thread; worker
+ * tasks that keep a string reference across a reload should copy it or hold a
+ * PluginEpochGuard.
+ */
+class TC_GAME_API PluginConfigTable
+{
+public:
+    PluginConfigTable();
+    ~PluginConfigTable();
+    
+    PluginConfigTable(PluginConfigTable const&) = delete;
+    PluginConfigTable& operator=(PluginConfigTable const&) = delete;
+    
+    template<typename T>
+    PluginConfigHandle<T> Bind(std::string const& key, T const& defaultValue);
+    
+    // Resolve all bound keys, missing keys get their default
+    void Publish(PluginConfig const& config);
+    void PublishFromServerConfig();                 // worldserver.conf through sConfigMgr
+    void PublishDefaults();
+    
+    size_t GetSize() const { return _entries.size(); }
+    std::string const& GetKey(uint32 slot) const { return _entries[slot].key; }
+    
+    PluginConfigValue const& GetValue(uint32 slot) const { return _values.load(std::memory_order_acquire)[slot]; }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        PluginConfigType type;
+        PluginConfigValue defaultValue;
+    };
+    
+    typedef std::vector<PluginConfigValue> Snapshot;
+    
+    uint32 AddEntry(std::string const& key, PluginConfigType type, PluginConfigValue const& defaultValue);
+    void Store(std::unique_ptr<Snapshot> snapshot);
+    
+    std::atomic<PluginConfigValue const*> _values;  // data of _snapshot, the only member readers touch
+    Snapshot const* _snapshot;
+    
+    std::mutex _publishMutex;
+    std::vector<Entry> _entries;
+};
+
+template<typename T>
+class PluginConfigHandle
+{
+public:
+    PluginConfigHandle() : _table(nullptr), _slot(0) { }
+    
+    T const& Get() const { return PluginConfigTraits<T>::Get(_table->GetValue(_slot)); }
+    T const& operator*() const { return Get(); }
+    T const* operator->() const { return &Get(); }
+    
+    bool IsBound() const { return _table != nullptr; }
+    std::string const& GetKey() const { return _table->GetKey(_slot); }
+
+private:
+    friend class PluginConfigTable;
+    
+    PluginConfigHandle(PluginConfigTable const* table, uint32 slot) : _table(table), _slot(slot) { }
+    
+    PluginConfigTable const* _table;
+    uint32 _slot;
+};
+
+template<typename T>
+PluginConfigHandle<T> PluginConfigTable::Bind(std::string const& key, T const& defaultValue)
+{
+    PluginConfigValue value;
+    PluginConfigTraits<T>::Set(value, defaultValue);
+    return PluginConfigHandle<T>(this, AddEntry(key, PluginConfigTraits<T>::Type, value));
+}
+
+#endif // TRINITY_PLUGIN_CONFIG_HANDLE_H
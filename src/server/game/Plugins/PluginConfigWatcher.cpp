@@ -0,0 +1,600 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginConfigWatcher.h"
+#include "PluginConfig.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <condition_variable>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    void SplitPath(std::string const& path, std::string& directory, std::string& fileName)
+    {
+        size_t separator = path.find_last_of("/\\");
+        if (separator == std::string::npos)
+        {
+            directory = ".";
+            fileName = path;
+            return;
+        }
+        
+        directory = separator ? path.substr(0, separator) : path.substr(0, 1);
+        fileName = path.substr(separator + 1);
+    }
+}
+
+#if defined(__linux__)
+
+class PluginConfigWatcher::Backend
+{
+public:
+    Backend() : _inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), _wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) { }
+    
+    ~Backend()
+    {
+        if (_inotify >= 0)
+            close(_inotify);
+        
+        if (_wake >= 0)
+            close(_wake);
+    }
+    
+    bool IsValid() const { return _inotify >= 0 && _wake >= 0; }
+    
+    void Sync(std::vector<WatchedFile> const& files)
+    {
+        std::set<std::string> wanted;
+        for (WatchedFile const& file : files)
+            wanted.insert(file.directory);
+        
+        for (auto itr = _watches.begin(); itr != _watches.end();)
+        {
+            if (wanted.count(itr->first))
+            {
+                ++itr;
+                continue;
+            }
+            
+            inotify_rm_watch(_inotify, itr->second);
+            _directories.erase(itr->second);
+            itr = _watches.erase(itr);
+        }
+        
+        for (std::string const& directory : wanted)
+        {
+            if (_watches.count(directory))
+                continue;
+            
+            int watch = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (watch < 0)
+            {
+                TC_LOG_ERROR("plugins", "PluginConfigWatcher: cannot watch %s: %s", directory.c_str(), std::strerror(errno));
+                continue;
+            }
+            
+            _watches[directory] = watch;
+            _directories[watch] = directory;
+        }
+    }
+    
+    void Wait(int32 timeout, std::vector<FileEvent>& events)
+    {
+        pollfd fds[2];
+        fds[0].fd = _inotify;
+        fds[0].events = POLLIN;
+        fds[1].fd = _wake;
+        fds[1].events = POLLIN;
+        
+        if (poll(fds, 2, timeout) <= 0)
+            return;
+        
+        if (fds[1].revents & POLLIN)
+        {
+            uint64 value;
+            ssize_t result = read(_wake, &value, sizeof(value));
+            (void)result;
+        }
+        
+        if (!(fds[0].revents & POLLIN))
+            return;
+        
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(_inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char const* itr = buffer; itr < buffer + length;)
+            {
+                inotify_event const* event = reinterpret_cast<inotify_event const*>(itr);
+                itr += sizeof(inotify_event) + event->len;
+                
+                // The kernel dropped events, treat every watched file as changed
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    for (auto const& directory : _directories)
+                        events.push_back({ directory.second, std::string() });
+                    continue;
+                }
+                
+                auto directory = _directories.find(event->wd);
+                if (directory != _directories.end() && event->len)
+                    events.push_back({ directory->second, event->name });
+            }
+        }
+    }
+    
+    void Wake()
+    {
+        uint64 value = 1;
+        ssize_t result = write(_wake, &value, sizeof(value));
+        (void)result;
+    }
+
+private:
+    int _inotify;
+    int _wake;
+    std::unordered_map<std::string, int> _watches;
+    std::unordered_map<int, std::string> _directories;
+};
+
+#elif defined(_WIN32)
+
+class PluginConfigWatcher::Backend
+{
+public:
+    Backend() : _wake(CreateEventA(nullptr, FALSE, FALSE, nullptr)) { }
+    
+    ~Backend()
+    {
+        for (auto& watch : _watches)
+            Close(*watch.second);
+        
+        if (_wake)
+            CloseHandle(_wake);
+    }
+    
+    bool IsValid() const { return _wake != nullptr; }
+    
+    void Sync(std::vector<WatchedFile> const& files)
+    {
+        std::set<std::string> wanted;
+        for (WatchedFile const& file : files)
+            wanted.insert(file.directory);
+        
+        for (auto itr = _watches.begin(); itr != _watches.end();)
+        {
+            if (wanted.count(itr->first))
+            {
+                ++itr;
+                continue;
+            }
+            
+            Close(*itr->second);
+            itr = _watches.erase(itr);
+        }
+        
+        for (std::string const& directory : wanted)
+        {
+            if (_watches.count(directory))
+                continue;
+            
+            // The wake event takes one of the wait slots
+            if (_watches.size() + 1 >= MAXIMUM_WAIT_OBJECTS)
+            {
+                TC_LOG_ERROR("plugins", "PluginConfigWatcher: cannot watch %s, too many config directories", directory.c_str());
+                continue;
+            }
+            
+            std::unique_ptr<DirectoryWatch> watch = std::make_unique<DirectoryWatch>();
+            watch->directory = directory;
+            watch->handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+            
+            if (watch->handle == INVALID_HANDLE_VALUE)
+            {
+                TC_LOG_ERROR("plugins", "PluginConfigWatcher: cannot watch %s: error %u", directory.c_str(), uint32(GetLastError()));
+                continue;
+            }
+            
+            std::memset(&watch->overlapped, 0, sizeof(watch->overlapped));
+            watch->overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+            
+            if (!Arm(*watch))
+            {
+                TC_LOG_ERROR("plugins", "PluginConfigWatcher: cannot watch %s: error %u", directory.c_str(), uint32(GetLastError()));
+                Close(*watch);
+                continue;
+            }
+            
+            _watches[directory] = std::move(watch);
+        }
+    }
+    
+    void Wait(int32 timeout, std::vector<FileEvent>& events)
+    {
+        std::vector<HANDLE> handles;
+        std::vector<DirectoryWatch*> watches;
+        
+        handles.push_back(_wake);
+        for (auto& watch : _watches)
+        {
+            handles.push_back(watch.second->overlapped.hEvent);
+            watches.push_back(watch.second.get());
+        }
+        
+        DWORD result = WaitForMultipleObjects(DWORD(handles.size()), handles.data(), FALSE, timeout < 0 ? INFINITE : DWORD(timeout));
+        if (result <= WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + handles.size())
+            return;
+        
+        DirectoryWatch& watch = *watches[result - WAIT_OBJECT_0 - 1];
+        
+        DWORD bytes = 0;
+        if (GetOverlappedResult(watch.handle, &watch.overlapped, &bytes, FALSE))
+        {
+            // Zero bytes means the buffer overflowed, every file in the directory may have changed
+            if (!bytes)
+                events.push_back({ watch.directory, std::string() });
+            
+            for (DWORD offset = 0; bytes;)
+            {
+                FILE_NOTIFY_INFORMATION const* info = reinterpret_cast<FILE_NOTIFY_INFORMATION const*>(watch.buffer + offset);
+                
+                if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    int wideLength = int(info->FileNameLength / sizeof(WCHAR));
+                    int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, nullptr, 0, nullptr, nullptr);
+                    
+                    std::string fileName(size_t(length), '\0');
+                    WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, &fileName[0], length, nullptr, nullptr);
+                    events.push_back({ watch.directory, fileName });
+                }
+                
+                if (!info->NextEntryOffset)
+                    break;
+                
+                offset += info->NextEntryOffset;
+            }
+        }
+        
+        ResetEvent(watch.overlapped.hEvent);
+        Arm(watch);
+    }
+    
+    void Wake() { SetEvent(_wake); }
+
+private:
+    struct DirectoryWatch
+    {
+        std::string directory;
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped;
+        alignas(DWORD) char buffer[16 * 1024];
+    };
+    
+    static bool Arm(DirectoryWatch& watch)
+    {
+        return ReadDirectoryChangesW(watch.handle, watch.buffer, sizeof(watch.buffer), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &watch.overlapped, nullptr) != FALSE;
+    }
+    
+    static void Close(DirectoryWatch& watch)
+    {
+        if (watch.handle != INVALID_HANDLE_VALUE)
+        {
+            // The pending read still owns the buffer until it is cancelled
+            CancelIo(watch.handle);
+            DWORD bytes;
+            GetOverlappedResult(watch.handle, &watch.overlapped, &bytes, TRUE);
+            CloseHandle(watch.handle);
+            watch.handle = INVALID_HANDLE_VALUE;
+        }
+        
+        if (watch.overlapped.hEvent)
+            CloseHandle(watch.overlapped.hEvent);
+    }
+    
+    HANDLE _wake;
+    std::unordered_map<std::string, std::unique_ptr<DirectoryWatch>> _watches;
+};
+
+#else
+
+class PluginConfigWatcher::Backend
+{
+public:
+    static constexpr int32 POLL_INTERVAL = 1000;
+    
+    Backend() : _woken(false) { }
+    
+    bool IsValid() const { return true; }
+    
+    void Sync(std::vector<WatchedFile> const& files)
+    {
+        std::unordered_map<std::string, int64> timestamps;
+        for (WatchedFile const& file : files)
+        {
+            auto itr = _timestamps.find(file.path);
+            timestamps[file.path] = itr != _timestamps.end() ? itr->second : GetTimestamp(file.path);
+        }
+        
+        _files = files;
+        _timestamps.swap(timestamps);
+    }
+    
+    void Wait(int32 timeout, std::vector<FileEvent>& events)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_wakeMutex);
+            int32 interval = timeout < 0 ? POLL_INTERVAL : std::min(timeout, POLL_INTERVAL);
+            _wakeCondition.wait_for(lock, std::chrono::milliseconds(interval), [this]() { return _woken; });
+            _woken = false;
+        }
+        
+        for (WatchedFile const& file : _files)
+        {
+            int64 timestamp = GetTimestamp(file.path);
+            int64& previous = _timestamps[file.path];
+            
+            if (timestamp != previous)
+            {
+                previous = timestamp;
+                events.push_back({ file.directory, file.fileName });
+            }
+        }
+    }
+    
+    void Wake()
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _woken = true;
+        _wakeCondition.notify_one();
+    }
+
+private:
+    static int64 GetTimestamp(std::string const& path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? int64(info.st_mtime) : 0;
+    }
+    
+    std::vector<WatchedFile> _files;
+    std::unordered_map<std::string, int64> _timestamps;
+    
+    std::mutex _wakeMutex;
+    std::condition_variable _wakeCondition;
+    bool _woken;
+};
+
+#endif
+
+PluginConfigWatcher::PluginConfigWatcher() : _running(false), _filesChanged(false), _hasReady(false)
+{
+}
+
+PluginConfigWatcher::~PluginConfigWatcher()
+{
+    Stop();
+}
+
+bool PluginConfigWatcher::Start()
+{
+    // Plugins initialized concurrently may start the watcher at the same time
+    std::lock_guard<std::mutex> startLock(_startMutex);
+    
+    if (_running.load(std::memory_order_relaxed))
+        return true;
+    
+    _backend = std::make_unique<Backend>();
+    if (!_backend->IsValid())
+    {
+        TC_LOG_ERROR("plugins", "PluginConfigWatcher: file change notification is not available, config files are not watched");
+        _backend.reset();
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(_filesMutex);
+        _filesChanged = true;
+    }
+    
+    _running.store(true, std::memory_order_release);
+    _thread = std::thread(&PluginConfigWatcher::Run, this);
+    return true;
+}
+
+void PluginConfigWatcher::Stop()
+{
+    std::lock_guard<std::mutex> startLock(_startMutex);
+    
+    if (!_running.exchange(false, std::memory_order_relaxed))
+        return;
+    
+    _backend->Wake();
+    _thread.join();
+    _backend.reset();
+    
+    std::lock_guard<std::mutex> lock(_filesMutex);
+    _pending.clear();
+}
+
+void PluginConfigWatcher::Watch(std::string const& pluginName, std::string const& filePath)
+{
+    WatchedFile file;
+    file.path = filePath;
+    SplitPath(filePath, file.directory, file.fileName);
+    
+    {
+        std::lock_guard<std::mutex> lock(_filesMutex);
+        _files[pluginName] = std::move(file);
+        _filesChanged = true;
+    }
+    
+    WakeIfRunning();
+}
+
+void PluginConfigWatcher::Unwatch(std::string const& pluginName)
+{
+    {
+        std::lock_guard<std::mutex> lock(_filesMutex);
+        if (!_files.erase(pluginName))
+            return;
+        
+        _pending.erase(pluginName);
+        _filesChanged = true;
+    }
+    
+    WakeIfRunning();
+    
+    // Drop a config parsed before the plugin stopped watching
+    std::lock_guard<std::mutex> lock(_readyMutex);
+    _ready.erase(std::remove_if(_ready.begin(), _ready.end(), [&](PluginConfigChange const& change) { return change.pluginName == pluginName; }), _ready.end());
+}
+
+void PluginConfigWatcher::WakeIfRunning()
+{
+    // Stop() resets the backend under the same lock
+    std::lock_guard<std::mutex> startLock(_startMutex);
+    
+    if (_running.load(std::memory_order_relaxed))
+        _backend->Wake();
+}
+
+void PluginConfigWatcher::TakeChanges(std::vector<PluginConfigChange>& changes)
+{
+    if (!_hasReady.load(std::memory_order_acquire))
+        return;
+    
+    std::lock_guard<std::mutex> lock(_readyMutex);
+    for (PluginConfigChange& change : _ready)
+        changes.push_back(std::move(change));
+    
+    _ready.clear();
+    _hasReady.store(false, std::memory_order_release);
+}
+
+void PluginConfigWatcher::Run()
+{
+    std::vector<FileEvent> events;
+    
+    while (_running.load(std::memory_order_relaxed))
+    {
+        int32 timeout = -1;
+        
+        {
+            std::lock_guard<std::mutex> lock(_filesMutex);
+            
+            if (_filesChanged)
+            {
+                std::vector<WatchedFile> files;
+                for (auto const& file : _files)
+                    files.push_back(file.second);
+                
+                _backend->Sync(files);
+                _filesChanged = false;
+            }
+            
+            // Sleep until the earliest coalesced reload is due
+            if (!_pending.empty())
+            {
+                Clock::time_point deadline = Clock::time_point::max();
+                for (auto const& pending : _pending)
+                    deadline = std::min(deadline, pending.second);
+                
+                timeout = int32(std::max<int64>(0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count() + 1));
+            }
+        }
+        
+        events.clear();
+        _backend->Wait(timeout, events);
+        
+        QueueEvents(events);
+        ParseDueFiles();
+    }
+}
+
+void PluginConfigWatcher::QueueEvents(std::vector<FileEvent> const& events)
+{
+    if (events.empty())
+        return;
+    
+    Clock::time_point deadline = Clock::now() + COALESCE_DELAY;
+    
+    std::lock_guard<std::mutex> lock(_filesMutex);
+    for (FileEvent const& event : events)
+    {
+        // Every further write pushes the reload back, a save in several steps results in one parse
+        for (auto const& file : _files)
+            if (file.second.directory == event.directory && (event.fileName.empty() || file.second.fileName == event.fileName))
+                _pending[file.first] = deadline;
+    }
+}
+
+void PluginConfigWatcher::ParseDueFiles()
+{
+    std::vector<std::pair<std::string, std::string>> due;
+    
+    {
+        std::lock_guard<std::mutex> lock(_filesMutex);
+        Clock::time_point now = Clock::now();
+        
+        for (auto itr = _pending.begin(); itr != _pending.end();)
+        {
+            if (itr->second > now)
+            {
+                ++itr;
+                continue;
+            }
+            
+            auto file = _files.find(itr->first);
+            if (file != _files.end())
+                due.emplace_back(itr->first, file->second.path);
+            
+            itr = _pending.erase(itr);
+        }
+    }
+    
+    for (auto const& file : due)
+    {
+        std::unique_ptr<PluginConfig> config = std::make_unique<PluginConfig>();
+        if (!config->LoadFromFile(file.second))
+        {
+            // Keep the running config, the next save triggers another attempt
+            TC_LOG_ERROR("plugins", "PluginConfigWatcher: failed to parse %s for plugin %s, keeping the current configuration", file.second.c_str(), file.first.c_str());
+            continue;
+        }
+        
+        TC_LOG_DEBUG("plugins", "PluginConfigWatcher: %s changed, reloading plugin %s", file.second.c_str(), file.first.c_str());
+        
+        std::lock_guard<std::mutex> lock(_readyMutex);
+        _ready.push_back({ file.first, std::move(config) });
+        _hasReady.store(true, std::memory_order_release);
+    }
+}
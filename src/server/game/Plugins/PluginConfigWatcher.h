@@ -0,0 +1,110 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_CONFIG_WATCHER_H
+#define TRINITY_PLUGIN_CONFIG_WATCHER_H
+
+#include "Define.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class PluginConfig;
+
+struct PluginConfigChange
+{
+    std::string pluginName;
+    std::unique_ptr<PluginConfig> config;
+};
+
+/*
+ * Watches plugin configuration files from a background thread.
+ *
+ * Uses inotify on Linux and ReadDirectoryChangesW on Windows; other platforms
+ * fall back to comparing modification times once a second, still off the world
+ * thread. The containing directories are watched so editors that replace the
+ * file through a rename are picked up. Bursts of writes to a file are coalesced
+ * into one reload COALESCE_DELAY after the last write, the file is parsed on the
+ * watcher thread and the finished PluginConfig is queued for TakeChanges().
+ */
+class TC_GAME_API PluginConfigWatcher
+{
+public:
+    static constexpr std::chrono::milliseconds COALESCE_DELAY{ 250 };
+    
+    PluginConfigWatcher();
+    ~PluginConfigWatcher();
+    
+    PluginConfigWatcher(PluginConfigWatcher const&) = delete;
+    PluginConfigWatcher& operator=(PluginConfigWatcher const&) = delete;
+    
+    bool Start();
+    void Stop();
+    bool IsRunning() const { return _running.load(std::memory_order_acquire); }
+    
+    // One file per plugin, watching again replaces the previous file
+    void Watch(std::string const& pluginName, std::string const& filePath);
+    void Unwatch(std::string const& pluginName);
+    
+    // World thread, moves out the configs parsed since the last call
+    void TakeChanges(std::vector<PluginConfigChange>& changes);
+    
+    struct WatchedFile
+    {
+        std::string path;
+        std::string directory;
+        std::string fileName;
+    };
+    
+    struct FileEvent
+    {
+        std::string directory;
+        std::string fileName;           // empty when the backend lost events for the whole directory
+    };
+    
+    class Backend;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    void Run();
+    void WakeIfRunning();
+    void QueueEvents(std::vector<FileEvent> const& events);
+    void ParseDueFiles();
+    
+    std::mutex _startMutex;
+    std::unique_ptr<Backend> _backend;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    
+    // Guards _files, _filesChanged and _pending
+    std::mutex _filesMutex;
+    std::unordered_map<std::string, WatchedFile> _files;
+    bool _filesChanged;
+    std::unordered_map<std::string, Clock::time_point> _pending;    // plugin name -> parse deadline
+    
+    std::mutex _readyMutex;
+    std::vector<PluginConfigChange> _ready;
+    std::atomic<bool> _hasReady;
+};
+
+#endif // TRINITY_PLUGIN_CONFIG_WATCHER_H
@@ -0,0 +1,179 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginEpoch.h"
+#include "Errors.h"
+#include "Log.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    struct ThreadEpochState
+    {
+        PluginEpochDomain::ThreadSlot* slot = nullptr;
+        uint32 depth = 0;
+        
+        ~ThreadEpochState()
+        {
+            if (slot)
+            {
+                slot->epoch.store(0, std::memory_order_release);
+                slot->inUse.store(false, std::memory_order_release);
+            }
+        }
+    };
+    
+    thread_local ThreadEpochState threadEpochState;
+}
+
+PluginEpochDomain::PluginEpochDomain() : _globalEpoch(1), _hasRetired(false)
+{
+}
+
+PluginEpochDomain::~PluginEpochDomain()
+{
+    for (RetiredObject const& retired : _retired)
+        retired.deleter(retired.object);
+}
+
+PluginEpochDomain* PluginEpochDomain::Instance()
+{
+    // Never destroyed, plugins unloaded during static destruction still synchronize through it
+    static PluginEpochDomain* const instance = new PluginEpochDomain();
+    return instance;
+}
+
+PluginEpochDomain::ThreadSlot* PluginEpochDomain::AcquireSlot()
+{
+    for (ThreadSlot& slot : _slots)
+    {
+        bool expected = false;
+        if (!slot.inUse.load(std::memory_order_relaxed) &&
+            slot.inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+            return &slot;
+    }
+    
+    TC_LOG_FATAL("plugins", "PluginEpochDomain: more than " SZFMTD " threads dispatch plugin events", MAX_THREADS);
+    ABORT();
+    return nullptr;
+}
+
+void PluginEpochDomain::Enter()
+{
+    ThreadEpochState& state = threadEpochState;
+    if (state.depth++ > 0)
+        return;
+    
+    if (!state.slot)
+        state.slot = AcquireSlot();
+    
+    // Sequentially consistent so the epoch is visible before any protected pointer is loaded
+    state.slot->epoch.store(_globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+void PluginEpochDomain::Leave()
+{
+    ThreadEpochState& state = threadEpochState;
+    ASSERT(state.depth > 0);
+    
+    if (--state.depth == 0)
+        state.slot->epoch.store(0, std::memory_order_release);
+}
+
+bool PluginEpochDomain::InCriticalSection() const
+{
+    return threadEpochState.depth > 0;
+}
+
+void PluginEpochDomain::RetireRaw(void* object, void(*deleter)(void*))
+{
+    // Readers entering from now on observe an epoch past the retire epoch and the new pointer
+    uint64 epoch = _globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    
+    std::lock_guard<std::mutex> lock(_retiredMutex);
+    _retired.push_back({ object, deleter, epoch });
+    _hasRetired.store(true, std::memory_order_release);
+}
+
+uint64 PluginEpochDomain::GetOldestActiveEpoch() const
+{
+    uint64 oldest = std::numeric_limits<uint64>::max();
+    
+    for (ThreadSlot const& slot : _slots)
+    {
+        if (!slot.inUse.load(std::memory_order_acquire))
+            continue;
+        
+        uint64 epoch = slot.epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0)
+            oldest = std::min(oldest, epoch);
+    }
+    
+    return oldest;
+}
+
+void PluginEpochDomain::Synchronize()
+{
+    // Waiting from inside a critical section would wait on ourselves
+    ASSERT(!InCriticalSection(), "PluginEpochDomain::Synchronize called from inside a plugin event dispatch");
+    
+    uint64 epoch = _globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    
+    for (ThreadSlot const& slot : _slots)
+    {
+        if (!slot.inUse.load(std::memory_order_acquire))
+            continue;
+        
+        for (;;)
+        {
+            uint64 readerEpoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (readerEpoch == 0 || readerEpoch >= epoch)
+                break;
+            
+            std::this_thread::yield();
+        }
+    }
+    
+    Reclaim();
+}
+
+void PluginEpochDomain::Reclaim()
+{
+    if (!_hasRetired.load(std::memory_order_acquire))
+        return;
+    
+    std::vector<RetiredObject> reclaimable;
+    
+    {
+        std::lock_guard<std::mutex> lock(_retiredMutex);
+        uint64 oldestActive = GetOldestActiveEpoch();
+        
+        auto itr = std::partition(_retired.begin(), _retired.end(), [oldestActive](RetiredObject const& retired)
+        {
+            return retired.epoch > oldestActive;
+        });
+        
+        reclaimable.assign(itr, _retired.end());
+        _retired.erase(itr, _retired.end());
+        _hasRetired.store(!_retired.empty(), std::memory_order_release);
+    }
+    
+    for (RetiredObject const& retired : reclaimable)
+        retired.deleter(retired.object);
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_EPOCH_H
+#define TRINITY_PLUGIN_EPOCH_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+ * Epoch based reclamation for data read on the plugin dispatch hot path.
+ *
+ * Readers (world, map update and network threads) wrap their access in a
+ * PluginEpochGuard, which never blocks. Writers publish a new version with an
+ * atomic pointer swap and then either Retire() the old version, which frees it
+ * once every reader that could still see it has left, or Synchronize(), which
+ * waits for those readers before returning (used before dlclose()).
+ */
+class TC_GAME_API PluginEpochDomain
+{
+public:
+    static constexpr size_t MAX_THREADS = 256;
+    
+    struct alignas(64) ThreadSlot
+    {
+        std::atomic<uint64> epoch{ 0 };     // 0 while the thread is outside a critical section
+        std::atomic<bool> inUse{ false };
+    };
+    
+    static PluginEpochDomain* Instance();
+    
+    // Read side, nestable
+    void Enter();
+    void Leave();
+    bool InCriticalSection() const;
+    
+    // Write side
+    template<typename T>
+    void Retire(T const* object)
+    {
+        if (object)
+            RetireRaw(const_cast<T*>(object), [](void* ptr) { delete static_cast<T*>(ptr); });
+    }
+    
+    void Synchronize();
+    void Reclaim();
+
+private:
+    PluginEpochDomain();
+    ~PluginEpochDomain();
+    
+    struct RetiredObject
+    {
+        void* object;
+        void(*deleter)(void*);
+        uint64 epoch;
+    };
+    
+    void RetireRaw(void* object, void(*deleter)(void*));
+    ThreadSlot* AcquireSlot();
+    uint64 GetOldestActiveEpoch() const;
+    
+    std::atomic<uint64> _globalEpoch;
+    std::array<ThreadSlot, MAX_THREADS> _slots;
+    
+    std::mutex _retiredMutex;
+    std::vector<RetiredObject> _retired;
+    std::atomic<bool> _hasRetired;
+};
+
+#define sPluginEpoch PluginEpochDomain::Instance()
+
+class PluginEpochGuard
+{
+public:
+    PluginEpochGuard() { sPluginEpoch->Enter(); }
+    ~PluginEpochGuard() { sPluginEpoch->Leave(); }
+    
+    PluginEpochGuard(PluginEpochGuard const&) = delete;
+    PluginEpochGuard& operator=(PluginEpochGuard const&) = delete;
+};
+
+#endif // TRINITY_PLUGIN_EPOCH_H
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginEventQueue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    thread_local PluginEventQueue const* threadRingOwner = nullptr;
+    thread_local void* threadRing = nullptr;
+}
+
+bool PluginEventQueue::Ring::TryPush(PluginEventRecord const& record, char const* text, uint32 textLength)
+{
+    uint32 head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= CAPACITY)
+        return false;
+    
+    PluginEventRecord& slot = _records[head & (CAPACITY - 1)];
+    slot = record;
+    slot.textOffset = 0;
+    slot.textLength = 0;
+    
+    if (textLength)
+    {
+        uint32 textHead = _textHead.load(std::memory_order_relaxed);
+        if (textHead + textLength - _textTail.load(std::memory_order_acquire) > TEXT_CAPACITY)
+            return false;
+        
+        uint32 position = textHead & (TEXT_CAPACITY - 1);
+        uint32 firstPart = std::min(textLength, TEXT_CAPACITY - position);
+        memcpy(&_text[position], text, firstPart);
+        memcpy(&_text[0], text + firstPart, textLength - firstPart);
+        
+        slot.textOffset = textHead;
+        slot.textLength = textLength;
+        _textHead.store(textHead + textLength, std::memory_order_relaxed);
+    }
+    
+    // Publishes the record and its text
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void PluginEventQueue::Ring::Push(PluginEventRecord const& record, char const* text, uint32 textLength)
+{
+    // Keep per thread ordering: once spilled, stay in the overflow list until it is drained
+    if (!_overflowed.load(std::memory_order_acquire) && TryPush(record, text, textLength))
+        return;
+    
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    _overflow.emplace_back(record, std::string(text ? text : "", textLength));
+    _overflowed.store(true, std::memory_order_release);
+}
+
+void PluginEventQueue::Ring::Drain(std::array<PluginEventBatch, PLUGIN_EVENT_COUNT>& batches)
+{
+    uint32 tail = _tail.load(std::memory_order_relaxed);
+    uint32 head = _head.load(std::memory_order_acquire);
+    uint32 textTail = _textTail.load(std::memory_order_relaxed);
+    
+    for (; tail != head; ++tail)
+    {
+        PluginEventRecord record = _records[tail & (CAPACITY - 1)];
+        PluginEventBatch& batch = batches[static_cast<size_t>(record.event)];
+        
+        if (record.textLength)
+        {
+            uint32 position = record.textOffset & (TEXT_CAPACITY - 1);
+            uint32 firstPart = std::min(record.textLength, TEXT_CAPACITY - position);
+            
+            record.textOffset = uint32(batch._text.size());
+            batch._text.append(&_text[position], firstPart);
+            batch._text.append(&_text[0], record.textLength - firstPart);
+            textTail += record.textLength;
+        }
+        
+        batch._records.push_back(record);
+    }
+    
+    _textTail.store(textTail, std::memory_order_release);
+    _tail.store(tail, std::memory_order_release);
+    
+    if (!_overflowed.load(std::memory_order_acquire))
+        return;
+    
+    std::vector<std::pair<PluginEventRecord, std::string>> overflow;
+    
+    {
+        std::lock_guard<std::mutex> lock(_overflowMutex);
+        overflow.swap(_overflow);
+        _overflowed.store(false, std::memory_order_release);
+    }
+    
+    for (auto& entry : overflow)
+    {
+        PluginEventRecord& record = entry.first;
+        PluginEventBatch& batch = batches[static_cast<size_t>(record.event)];
+        
+        record.textOffset = uint32(batch._text.size());
+        record.textLength = uint32(entry.second.size());
+        batch._text.append(entry.second);
+        batch._records.push_back(record);
+    }
+}
+
+PluginEventQueue::Ring* PluginEventQueue::GetThreadRing()
+{
+    if (threadRingOwner == this)
+        return static_cast<Ring*>(threadRing);
+    
+    std::lock_guard<std::mutex> lock(_ringsMutex);
+    _rings.push_back(std::make_unique<Ring>());
+    threadRingOwner = this;
+    threadRing = _rings.back().get();
+    return _rings.back().get();
+}
+
+void PluginEventQueue::Push(PluginEventRecord const& record, char const* text, uint32 textLength)
+{
+    GetThreadRing()->Push(record, text, textLength);
+}
+
+void PluginEventQueue::Drain(std::array<PluginEventBatch, PLUGIN_EVENT_COUNT>& batches)
+{
+    for (size_t i = 0; i < PLUGIN_EVENT_COUNT; ++i)
+    {
+        batches[i]._event = static_cast<PluginEvent>(i);
+        batches[i]._records.clear();
+        batches[i]._text.clear();
+    }
+    
+    std::lock_guard<std::mutex> lock(_ringsMutex);
+    for (std::unique_ptr<Ring> const& ring : _rings)
+        ring->Drain(batches);
+}
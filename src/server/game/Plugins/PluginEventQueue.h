@@ -0,0 +1,132 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_EVENT_QUEUE_H
+#define TRINITY_PLUGIN_EVENT_QUEUE_H
+
+#include "IPlugin.h"
+#include "ObjectGuid.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Compact copy of a hook invocation for batched delivery. Field use per event:
+ *
+ *   PLAYER_LOGIN, PLAYER_LOGOUT  source = player
+ *   PLAYER_LEVEL_CHANGED         source = player, value = old level
+ *   PLAYER_CHAT                  source = player, value = chat type, extra = language, text = message
+ *   PLAYER_KILL                  source = killer, target = killed player
+ *   PLAYER_KILL_CREATURE         source = killer, target = creature, entry = creature entry
+ *   CREATURE_KILL                source = creature, target = killed unit, entry = creature entry
+ *   CREATURE_DEATH               source = creature, target = killer, entry = creature entry
+ *   CREATURE_RESPAWN             source = creature, entry = creature entry
+ *   GAMEOBJECT_USE, *_DESTROYED  source = gameobject, target = player, entry = gameobject entry
+ *   WORLD_UPDATE                 value = diff
+ *   MAP_UPDATE                   entry = map id, value = diff, extra = instance id
+ *
+ * Game objects are referenced by guid only, they may be gone by the time the
+ * batch is delivered.
+ */
+struct PluginEventRecord
+{
+    PluginEvent event;
+    ObjectGuid source;
+    ObjectGuid target;
+    uint32 entry;
+    uint32 value;
+    uint32 extra;
+    uint32 textOffset;
+    uint32 textLength;
+};
+
+/*
+ * All records of one event queued since the last drain, in the order they were
+ * queued by each thread.
+ */
+class TC_GAME_API PluginEventBatch
+{
+public:
+    PluginEvent GetEvent() const { return _event; }
+    PluginEventRecord const* begin() const { return _records.data(); }
+    PluginEventRecord const* end() const { return _records.data() + _records.size(); }
+    size_t size() const { return _records.size(); }
+    bool empty() const { return _records.empty(); }
+    
+    std::string GetText(PluginEventRecord const& record) const { return _text.substr(record.textOffset, record.textLength); }
+    char const* GetTextData(PluginEventRecord const& record) const { return _text.data() + record.textOffset; }
+
+private:
+    friend class PluginEventQueue;
+    
+    PluginEvent _event = PluginEvent::MAX;
+    std::vector<PluginEventRecord> _records;
+    std::string _text;
+};
+
+/*
+ * Collects event records from any number of threads for delivery on the world
+ * thread. Every producing thread owns a single-producer ring, pushing is wait
+ * free unless the ring is full, in which case records spill into a locked
+ * overflow list so nothing is lost.
+ */
+class TC_GAME_API PluginEventQueue
+{
+public:
+    void Push(PluginEventRecord const& record, char const* text = nullptr, uint32 textLength = 0);
+    
+    // Consumer side, single thread. Moves every queued record into batches[event].
+    void Drain(std::array<PluginEventBatch, PLUGIN_EVENT_COUNT>& batches);
+
+private:
+    class Ring
+    {
+    public:
+        static constexpr uint32 CAPACITY = 2048;
+        static constexpr uint32 TEXT_CAPACITY = 16 * 1024;
+        
+        Ring() : _head(0), _tail(0), _textHead(0), _textTail(0), _overflowed(false) { }
+        
+        void Push(PluginEventRecord const& record, char const* text, uint32 textLength);
+        void Drain(std::array<PluginEventBatch, PLUGIN_EVENT_COUNT>& batches);
+    
+    private:
+        bool TryPush(PluginEventRecord const& record, char const* text, uint32 textLength);
+        
+        alignas(64) std::atomic<uint32> _head;          // written by the producer
+        alignas(64) std::atomic<uint32> _tail;          // written by the consumer
+        std::atomic<uint32> _textHead;
+        std::atomic<uint32> _textTail;
+        
+        std::array<PluginEventRecord, CAPACITY> _records;
+        std::array<char, TEXT_CAPACITY> _text;
+        
+        std::atomic<bool> _overflowed;                  // producer writes to _overflow until the next drain
+        std::mutex _overflowMutex;
+        std::vector<std::pair<PluginEventRecord, std::string>> _overflow;
+    };
+    
+    Ring* GetThreadRing();
+    
+    std::mutex _ringsMutex;
+    std::vector<std::unique_ptr<Ring>> _rings;
+};
+
+#endif // TRINITY_PLUGIN_EVENT_QUEUE_H
@@ -19,6 +19,15 @@
 #define TRINITY_PLUGIN_HOOKS_H
 
 #include "Define.h"
+#include "PluginManager.h"
+
+// Generated by modules/CMakeLists.txt when MODULES_ELIDE_HOOKS is on, defines
+// TRINITY_PLUGIN_COMPILED_EVENTS as the events declared by the enabled modules
+#ifdef TRINITY_PLUGIN_HOOK_ELISION
+#include "PluginCompiledEvents.h"
+#else
+#define TRINITY_PLUGIN_COMPILED_EVENTS PLUGIN_EVENT_MASK_ALL
+#endif
 
 class Player;
 class WorldSession;
@@ -40,116 +49,167 @@ class InstanceScript;
  * Plugin Hook Macros
  * These macros should be placed at strategic points in TrinityCore's source code
  * to allow plugins to hook into core functionality.
+ * Events without any subscribed plugin cost a single branch at the hook site.
+ * Events outside PLUGIN_EVENT_MASK_COMPILED cost nothing, their hook sites are
+ * discarded at compile time.
  */
 
+// The world tick drives the plugin manager itself and is never compiled out
+constexpr PluginEventMask PLUGIN_EVENT_MASK_COMPILED = (PluginEventMask(TRINITY_PLUGIN_COMPILED_EVENTS) & PLUGIN_EVENT_MASK_ALL) |
+    PluginEventBit(PluginEvent::WORLD_UPDATE);
+
+static constexpr bool IsPluginHookCompiled(PluginEventMask events)
+{
+    return (PLUGIN_EVENT_MASK_COMPILED & events) != 0;
+}
+
+static constexpr bool IsPluginHookCompiled(PluginEvent event)
+{
+    return IsPluginHookCompiled(PluginEventBit(event));
+}
+
 // Player Event Hooks
 #define PLUGIN_HOOK_PLAYER_LOGIN(player) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnPlayerLogin(player); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::PLAYER_LOGIN)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::PLAYER_LOGIN)) \
+                sPluginManager->OnPlayerLogin(player); \
     } while(0)
 
 #define PLUGIN_HOOK_PLAYER_LOGOUT(player) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnPlayerLogout(player); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::PLAYER_LOGOUT)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::PLAYER_LOGOUT)) \
+                sPluginManager->OnPlayerLogout(player); \
     } while(0)
 
 #define PLUGIN_HOOK_PLAYER_LEVEL_CHANGED(player, oldLevel) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnPlayerLevelChanged(player, oldLevel); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::PLAYER_LEVEL_CHANGED)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::PLAYER_LEVEL_CHANGED)) \
+                sPluginManager->OnPlayerLevelChanged(player, oldLevel); \
     } while(0)
 
+// msg is the std::string of the core, rewritten in place, or a PluginChatMessage
 #define PLUGIN_HOOK_PLAYER_CHAT(player, type, lang, msg) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnPlayerChat(player, type, lang, msg); \
+        if constexpr (IsPluginHookCompiled(PLUGIN_EVENT_MASK_CHAT)) \
+            if (PluginManager::HasEventSubscribers(PLUGIN_EVENT_MASK_CHAT)) \
+                sPluginManager->OnPlayerChat(player, type, lang, msg); \
     } while(0)
 
 #define PLUGIN_HOOK_PLAYER_KILL_PLAYER(killer, killed) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnPlayerKill(killer, killed); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::PLAYER_KILL)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::PLAYER_KILL)) \
+                sPluginManager->OnPlayerKill(killer, killed); \
     } while(0)
 
 #define PLUGIN_HOOK_PLAYER_KILL_CREATURE(killer, killed) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnPlayerKillCreature(killer, killed); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::PLAYER_KILL_CREATURE)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::PLAYER_KILL_CREATURE)) \
+                sPluginManager->OnPlayerKillCreature(killer, killed); \
     } while(0)
 
 // Creature Event Hooks
 #define PLUGIN_HOOK_CREATURE_KILL(killer, killed) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnCreatureKill(killer, killed); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::CREATURE_KILL)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::CREATURE_KILL)) \
+                sPluginManager->OnCreatureKill(killer, killed); \
     } while(0)
 
 #define PLUGIN_HOOK_CREATURE_DEATH(creature, killer) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnCreatureDeath(creature, killer); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::CREATURE_DEATH)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::CREATURE_DEATH)) \
+                sPluginManager->OnCreatureDeath(creature, killer); \
     } while(0)
 
 #define PLUGIN_HOOK_CREATURE_RESPAWN(creature) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnCreatureRespawn(creature); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::CREATURE_RESPAWN)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::CREATURE_RESPAWN)) \
+                sPluginManager->OnCreatureRespawn(creature); \
     } while(0)
 
 // GameObject Event Hooks
 #define PLUGIN_HOOK_GAMEOBJECT_USE(go, player) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnGameObjectUse(go, player); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::GAMEOBJECT_USE)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::GAMEOBJECT_USE)) \
+                sPluginManager->OnGameObjectUse(go, player); \
     } while(0)
 
 #define PLUGIN_HOOK_GAMEOBJECT_DESTROYED(go, player) \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnGameObjectDestroyed(go, player); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::GAMEOBJECT_DESTROYED)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::GAMEOBJECT_DESTROYED)) \
+                sPluginManager->OnGameObjectDestroyed(go, player); \
     } while(0)
 
 // World Event Hooks
 #define PLUGIN_HOOK_WORLD_UPDATE(diff) \
     do { \
-        if (sPluginManager) \
+        if (PluginManager::HasEventSubscribers(PluginEvent::WORLD_UPDATE)) \
             sPluginManager->OnWorldUpdate(diff); \
     } while(0)
 
+// Also delivers the map's combat log, see PluginHooks::OnDamageDealt, and
+// resets the arena of the updating thread
 #define PLUGIN_HOOK_MAP_UPDATE(map, diff) \
     do { \
-        if (sPluginManager) \
+        if (IsPluginHookCompiled(PluginEventBit(PluginEvent::MAP_UPDATE) | PluginEventBit(PluginEvent::COMBAT_LOG)) && \
+            PluginManager::HasEventSubscribers(PluginEventBit(PluginEvent::MAP_UPDATE) | PluginEventBit(PluginEvent::COMBAT_LOG))) \
             sPluginManager->OnMapUpdate(map, diff); \
+        else if (PluginManager::HasEventSubscribers(PluginEvent::WORLD_UPDATE)) \
+            PluginArena::Thread().Reset(); \
     } while(0)
 
-// Packet Event Hooks
+// Frees the map's plugin state, place before the map is deleted
+#define PLUGIN_HOOK_MAP_DESTROY(map) \
+    do { \
+        if (PluginManager::HasMapContexts()) \
+            sPluginManager->OnMapDestroy(map); \
+    } while(0)
+
+// Packet Event Hooks, only packets with an opcode some plugin subscribed to reach the plugin manager
 #define PLUGIN_HOOK_PACKET_RECEIVE(session, packet) \
-    (sPluginManager ? sPluginManager->OnPacketReceive(session, packet) : true)
+    (!IsPluginHookCompiled(PluginEvent::PACKET_RECEIVE) || \
+        !PluginManager::HasPacketSubscribers(PluginPacketDirection::RECEIVE, (packet).GetOpcode()) || \
+        sPluginManager->OnPacketReceive(session, packet))
 
 #define PLUGIN_HOOK_PACKET_SEND(session, packet) \
-    (sPluginManager ? sPluginManager->OnPacketSend(session, packet) : true)
+    (!IsPluginHookCompiled(PluginEvent::PACKET_SEND) || \
+        !PluginManager::HasPacketSubscribers(PluginPacketDirection::SEND, (packet).GetOpcode()) || \
+        sPluginManager->OnPacketSend(session, packet))
 
 // Server Event Hooks
 #define PLUGIN_HOOK_SERVER_START() \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnServerStart(); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::SERVER_START)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::SERVER_START)) \
+                sPluginManager->OnServerStart(); \
     } while(0)
 
 #define PLUGIN_HOOK_SERVER_STOP() \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnServerStop(); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::SERVER_STOP)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::SERVER_STOP)) \
+                sPluginManager->OnServerStop(); \
     } while(0)
 
 #define PLUGIN_HOOK_CONFIG_RELOAD() \
     do { \
-        if (sPluginManager) \
-            sPluginManager->OnConfigReload(); \
+        if constexpr (IsPluginHookCompiled(PluginEvent::CONFIG_RELOAD)) \
+            if (PluginManager::HasEventSubscribers(PluginEvent::CONFIG_RELOAD)) \
+                sPluginManager->OnConfigReload(); \
     } while(0)
 
+// Registers the .plugin chat commands, called once by PluginManager::LoadAllPlugins
+TC_GAME_API void AddSC_plugin_commandscript();
+
 /*
  * Extended Event Hooks for Advanced Plugin Functionality
  * These provide more granular control over game events
@@ -158,7 +218,8 @@ class InstanceScript;
 class TC_GAME_API PluginHooks
 {
 public:
-    // Spell Events
+    // Spell Events, OnSpellHit and OnSpellEffect are recorded into the map's
+    // PluginCombatLog like the combat events below
     static void OnSpellCast(Unit* caster, Spell* spell, bool skipCheck = false);
     static void OnSpellHit(Unit* caster, Unit* target, Spell* spell);
     static void OnSpellEffect(Unit* caster, Unit* target, uint32 spellId, uint32 effIndex);
@@ -199,7 +260,9 @@ public:
     static void OnInstancePlayerEnter(InstanceScript* instance, Player* player);
     static void OnInstancePlayerLeave(InstanceScript* instance, Player* player);
     
-    // Combat Events
+    // Combat Events. OnDamageDealt and OnHealingDone do not call handlers per hit,
+    // they append to the combat log of the map (PluginManager::RecordCombat),
+    // which COMBAT_LOG subscribers receive through OnCombatLog once per map update.
     static void OnCombatStart(Unit* attacker, Unit* victim);
     static void OnCombatStop(Unit* unit);
     static void OnDamageDealt(Unit* attacker, Unit* victim, uint32 damage, uint32 spellId);
@@ -0,0 +1,131 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginInterface.h"
+#include "IPlugin.h"
+#include "Log.h"
+#include "PluginManager.h"
+
+PluginInterfaceRegistry::PluginInterfaceRegistry() : _generation(1)
+{
+}
+
+PluginInterfaceRegistry::~PluginInterfaceRegistry()
+{
+}
+
+PluginInterfaceRegistry* PluginInterfaceRegistry::Instance()
+{
+    // Never destroyed, handles held by plugins outlive static destruction order
+    static PluginInterfaceRegistry* const instance = new PluginInterfaceRegistry();
+    return instance;
+}
+
+PluginInterfaceSlot* PluginInterfaceRegistry::GetSlot(PluginInterfaceId id, std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    std::unique_ptr<PluginInterfaceSlot>& slot = _slots[id];
+    if (!slot)
+        slot = std::make_unique<PluginInterfaceSlot>(id, name);
+    else if (slot->name != name)
+    {
+        TC_LOG_ERROR("plugins", "Plugin interfaces %s and %.*s hash to the same id, rename one of them", slot->name.c_str(), int(name.size()), name.data());
+        return nullptr;
+    }
+    
+    return slot.get();
+}
+
+bool PluginInterfaceRegistry::Bind(IPlugin const* provider, PluginInterfaceId id, std::string_view name, void* instance)
+{
+    PluginInterfaceSlot* slot = GetSlot(id, name);
+    if (!slot)
+        return false;
+    
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        
+        IPlugin const* current = slot->provider.load(std::memory_order_relaxed);
+        if (current && current != provider)
+        {
+            TC_LOG_ERROR("plugins", "Interface %s is already provided by %s, ignoring %s", slot->name.c_str(), current->GetInfo().name.c_str(), provider->GetInfo().name.c_str());
+            return false;
+        }
+        
+        slot->provider.store(provider, std::memory_order_relaxed);
+        slot->instance.store(instance, std::memory_order_release);
+    }
+    
+    Invalidate();
+    return true;
+}
+
+void PluginInterfaceRegistry::Revoke(IPlugin const* provider)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    for (auto const& pair : _slots)
+    {
+        PluginInterfaceSlot& slot = *pair.second;
+        if (slot.provider.load(std::memory_order_relaxed) != provider)
+            continue;
+        
+        slot.instance.store(nullptr, std::memory_order_release);
+        slot.provider.store(nullptr, std::memory_order_relaxed);
+    }
+    
+    Invalidate();
+}
+
+void* PluginInterfaceRegistry::Find(IPlugin const* provider, std::string_view name) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    auto itr = _slots.find(PluginInterfaceHash(name));
+    if (itr == _slots.end() || itr->second->name != name || itr->second->provider.load(std::memory_order_relaxed) != provider)
+        return nullptr;
+    
+    return itr->second->instance.load(std::memory_order_acquire);
+}
+
+void* PluginInterfaceSlot::Bind()
+{
+    // Nothing was provided or registered since the last miss
+    uint32 generation = sPluginInterfaces->GetGeneration();
+    if (missGeneration.load(std::memory_order_relaxed) == generation)
+        return nullptr;
+    
+    sPluginManager->ActivateInterfaceProvider(name);
+    
+    void* bound = instance.load(std::memory_order_acquire);
+    if (!bound)
+        missGeneration.store(generation, std::memory_order_relaxed);
+    
+    return bound;
+}
+
+void* IPlugin::GetInterface(std::string const& interfaceName)
+{
+    return sPluginInterfaces->Find(this, interfaceName);
+}
+
+bool IPlugin::HasInterface(std::string const& interfaceName) const
+{
+    return sPluginInterfaces->Find(this, interfaceName) != nullptr;
+}
@@ -0,0 +1,147 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_INTERFACE_H
+#define TRINITY_PLUGIN_INTERFACE_H
+
+#include "Define.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class IPlugin;
+
+typedef uint64 PluginInterfaceId;
+
+// 64 bit FNV-1a, evaluated at compile time for the ids declared by PLUGIN_INTERFACE
+constexpr PluginInterfaceId PluginInterfaceHash(std::string_view name)
+{
+    uint64 hash = UI64LIT(0xCBF29CE484222325);
+    for (char c : name)
+        hash = (hash ^ uint8(c)) * UI64LIT(0x100000001B3);
+    
+    return hash;
+}
+
+// Declares the name and id of an interface shared between plugins, inside its class:
+//   class IEconomy { public: PLUGIN_INTERFACE("Economy"); virtual uint32 GetBalance(ObjectGuid guid) = 0; };
+// The name is the one listed under "interfaces" in module.json.
+#define PLUGIN_INTERFACE(name) \
+    static constexpr char const* PluginInterfaceName = name; \
+    static constexpr PluginInterfaceId PluginInterfaceTypeId = PluginInterfaceHash(name)
+
+/*
+ * Binding of one interface id, never freed so handles stay valid for the
+ * lifetime of the process.
+ */
+struct TC_GAME_API PluginInterfaceSlot
+{
+    PluginInterfaceSlot(PluginInterfaceId id, std::string_view name) : id(id), name(name), instance(nullptr), provider(nullptr), missGeneration(0) { }
+    
+    // Slow path of an empty slot, activates a lazy plugin declaring the interface
+    void* Bind();
+    
+    PluginInterfaceId const id;
+    std::string const name;
+    std::atomic<void*> instance;
+    std::atomic<IPlugin const*> provider;
+    std::atomic<uint32> missGeneration;     // registry generation of the last failed Bind()
+};
+
+/*
+ * Cached reference to an interface provided by another plugin. Acquire it once
+ * (constructor, Load) and keep it: the registry rebinds it when the providing
+ * plugin is stopped, unloaded or reloaded, so a call through the handle is an
+ * atomic load and the virtual call itself.
+ *
+ * Get() returns nullptr while no plugin provides the interface. Off the world
+ * thread, use the returned pointer only inside plugin event dispatch or a
+ * PluginEpochGuard; the provider is not destroyed before those have finished.
+ */
+template<typename T>
+class PluginInterfaceHandle
+{
+public:
+    PluginInterfaceHandle() : _slot(nullptr) { }
+    explicit PluginInterfaceHandle(PluginInterfaceSlot* slot) : _slot(slot) { }
+    
+    T* Get() const
+    {
+        if (!_slot)
+            return nullptr;
+        
+        void* instance = _slot->instance.load(std::memory_order_acquire);
+        return static_cast<T*>(instance ? instance : _slot->Bind());
+    }
+    
+    T* operator->() const { return Get(); }
+    explicit operator bool() const { return Get() != nullptr; }
+    
+    bool IsValid() const { return _slot != nullptr; }
+
+private:
+    PluginInterfaceSlot* _slot;
+};
+
+class TC_GAME_API PluginInterfaceRegistry
+{
+public:
+    static PluginInterfaceRegistry* Instance();
+    
+    template<typename T>
+    PluginInterfaceHandle<T> Acquire()
+    {
+        return PluginInterfaceHandle<T>(GetSlot(T::PluginInterfaceTypeId, T::PluginInterfaceName));
+    }
+    
+    // Usually from IPlugin::Start(), the manager revokes every interface of a
+    // plugin when it is stopped, unloaded or reloaded
+    template<typename T>
+    bool Provide(IPlugin const* provider, T* instance)
+    {
+        return Bind(provider, T::PluginInterfaceTypeId, T::PluginInterfaceName, static_cast<void*>(instance));
+    }
+    
+    void Revoke(IPlugin const* provider);
+    
+    // String keyed lookup behind IPlugin::GetInterface
+    void* Find(IPlugin const* provider, std::string_view name) const;
+    
+    // Makes empty slots retry Bind(), called when lazy plugins are registered
+    void Invalidate() { _generation.fetch_add(1, std::memory_order_release); }
+    uint32 GetGeneration() const { return _generation.load(std::memory_order_acquire); }
+
+private:
+    PluginInterfaceRegistry();
+    ~PluginInterfaceRegistry();
+    
+    PluginInterfaceSlot* GetSlot(PluginInterfaceId id, std::string_view name);
+    bool Bind(IPlugin const* provider, PluginInterfaceId id, std::string_view name, void* instance);
+    
+    mutable std::mutex _mutex;
+    std::unordered_map<PluginInterfaceId, std::unique_ptr<PluginInterfaceSlot>> _slots;
+    std::atomic<uint32> _generation;
+};
+
+#define sPluginInterfaces PluginInterfaceRegistry::Instance()
+
+#endif // TRINITY_PLUGIN_INTERFACE_H
@@ -0,0 +1,218 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginLazyStub.h"
+#include "PluginManager.h"
+#include "PluginManifest.h"
+#include <algorithm>
+
+PluginLazyStub::PluginLazyStub(PluginManifestModule const& module)
+{
+    _info.name = std::string(module.GetName());
+    _info.version = std::string(module.GetVersion());
+    _info.description = "Lazy stub, not activated yet";
+    _info.priority = module.GetPriority();
+    _info.eventMask = module.HasEventMask() ? module.GetEventMask() : PLUGIN_EVENT_MASK_NONE;
+    _info.lazy = true;
+    
+    for (uint32 i = 0; i < module.GetDependencyCount(); ++i)
+        _info.dependencies.emplace_back(module.GetDependency(i));
+    
+    for (uint32 i = 0; i < module.GetInterfaceCount(); ++i)
+        _interfaces.emplace_back(module.GetInterface(i));
+}
+
+bool PluginLazyStub::Load()
+{
+    _state = PluginState::LOADED;
+    return true;
+}
+
+bool PluginLazyStub::Initialize()
+{
+    _state = PluginState::INITIALIZED;
+    return true;
+}
+
+void PluginLazyStub::Start()
+{
+    _state = PluginState::RUNNING;
+}
+
+void PluginLazyStub::Stop()
+{
+    _state = PluginState::INITIALIZED;
+}
+
+void PluginLazyStub::Unload()
+{
+    _state = PluginState::UNLOADED;
+}
+
+IPlugin* PluginLazyStub::Activate()
+{
+    if (!sPluginManager->ActivatePlugin(_info.name))
+        return nullptr;
+    
+    // Safe to use, the caller is inside a dispatch or PluginManager::GetPluginInterface epoch guard
+    IPlugin* plugin = sPluginManager->GetPlugin(_info.name);
+    if (!plugin || plugin == this || plugin->GetState() != PluginState::RUNNING)
+        return nullptr;
+    
+    return plugin;
+}
+
+IEventHandler* PluginLazyStub::ActivateHandler()
+{
+    IPlugin* plugin = Activate();
+    return plugin ? plugin->GetEventHandler() : nullptr;
+}
+
+void* PluginLazyStub::GetInterface(std::string const& interfaceName)
+{
+    if (!HasInterface(interfaceName))
+        return nullptr;
+    
+    IPlugin* plugin = Activate();
+    return plugin ? plugin->GetInterface(interfaceName) : nullptr;
+}
+
+bool PluginLazyStub::HasInterface(std::string const& interfaceName) const
+{
+    return std::find(_interfaces.begin(), _interfaces.end(), interfaceName) != _interfaces.end();
+}
+
+void PluginLazyStub::OnPlayerLogin(Player* player)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerLogin(player);
+}
+
+void PluginLazyStub::OnPlayerLogout(Player* player)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerLogout(player);
+}
+
+void PluginLazyStub::OnPlayerLevelChanged(Player* player, uint8 oldLevel)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerLevelChanged(player, oldLevel);
+}
+
+void PluginLazyStub::OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string_view msg)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerChat(player, type, lang, msg);
+}
+
+void PluginLazyStub::OnPlayerChatRewrite(Player* player, uint32 type, uint32 lang, PluginChatMessage& msg)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerChatRewrite(player, type, lang, msg);
+}
+
+void PluginLazyStub::OnPlayerKill(Player* killer, Player* killed)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerKill(killer, killed);
+}
+
+void PluginLazyStub::OnPlayerKillCreature(Player* killer, Creature* killed)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnPlayerKillCreature(killer, killed);
+}
+
+void PluginLazyStub::OnCreatureKill(Creature* killer, Unit* killed)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnCreatureKill(killer, killed);
+}
+
+void PluginLazyStub::OnCreatureDeath(Creature* creature, Unit* killer)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnCreatureDeath(creature, killer);
+}
+
+void PluginLazyStub::OnCreatureRespawn(Creature* creature)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnCreatureRespawn(creature);
+}
+
+void PluginLazyStub::OnGameObjectUse(GameObject* go, Player* player)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnGameObjectUse(go, player);
+}
+
+void PluginLazyStub::OnGameObjectDestroyed(GameObject* go, Player* player)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnGameObjectDestroyed(go, player);
+}
+
+void PluginLazyStub::OnWorldUpdate(uint32 diff)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnWorldUpdate(diff);
+}
+
+void PluginLazyStub::OnMapUpdate(Map* map, uint32 diff)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnMapUpdate(map, diff);
+}
+
+void PluginLazyStub::OnCombatLog(Map* map, PluginCombatLog const& log)
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnCombatLog(map, log);
+}
+
+bool PluginLazyStub::OnPacketReceive(WorldSession* session, WorldPacket& packet)
+{
+    IEventHandler* handler = ActivateHandler();
+    return handler ? handler->OnPacketReceive(session, packet) : true;
+}
+
+bool PluginLazyStub::OnPacketSend(WorldSession* session, WorldPacket const& packet)
+{
+    IEventHandler* handler = ActivateHandler();
+    return handler ? handler->OnPacketSend(session, packet) : true;
+}
+
+void PluginLazyStub::OnServerStart()
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnServerStart();
+}
+
+void PluginLazyStub::OnServerStop()
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnServerStop();
+}
+
+void PluginLazyStub::OnConfigReload()
+{
+    if (IEventHandler* handler = ActivateHandler())
+        handler->OnConfigReload();
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_LAZY_STUB_H
+#define TRINITY_PLUGIN_LAZY_STUB_H
+
+#include "IPlugin.h"
+
+class PluginManifestModule;
+
+/*
+ * Stand-in for a lazy module, built from its manifest record. It takes part
+ * in dependency resolution and dispatch like a plugin whose handler
+ * subscribes to the events listed in module.json, without the module's
+ * library being opened.
+ *
+ * The first event or GetInterface() call for a declared interface makes
+ * PluginManager::ActivatePlugin open, initialize and start the real plugin,
+ * which replaces the stub under the same plugin id. On the world thread the
+ * triggering call is forwarded to it; from any other thread the activation
+ * waits for the next world update and calls until then are dropped (packet
+ * hooks let the packet through, GetInterface() returns nullptr). A failed
+ * activation moves the stub to PluginState::ERROR.
+ */
+class TC_GAME_API PluginLazyStub : public IPlugin, public IEventHandler
+{
+public:
+    explicit PluginLazyStub(PluginManifestModule const& module);
+    
+    bool Load() override;
+    bool Initialize() override;
+    void Start() override;
+    void Stop() override;
+    void Unload() override;
+    
+    PluginInfo const& GetInfo() const override { return _info; }
+    PluginState GetState() const override { return _state; }
+    IEventHandler* GetEventHandler() override { return this; }
+    
+    std::vector<std::string> const& GetDependencies() const override { return _info.dependencies; }
+    bool CheckDependencies() const override { return true; }    // checked by the real plugin on activation
+    
+    void* GetInterface(std::string const& interfaceName) override;
+    bool HasInterface(std::string const& interfaceName) const override;
+    
+    // Forwarded to the real plugin after activation
+    void OnPlayerLogin(Player* player) override;
+    void OnPlayerLogout(Player* player) override;
+    void OnPlayerLevelChanged(Player* player, uint8 oldLevel) override;
+    void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string_view msg) override;
+    void OnPlayerChatRewrite(Player* player, uint32 type, uint32 lang, PluginChatMessage& msg) override;
+    void OnPlayerKill(Player* killer, Player* killed) override;
+    void OnPlayerKillCreature(Player* killer, Creature* killed) override;
+    void OnCreatureKill(Creature* killer, Unit* killed) override;
+    void OnCreatureDeath(Creature* creature, Unit* killer) override;
+    void OnCreatureRespawn(Creature* creature) override;
+    void OnGameObjectUse(GameObject* go, Player* player) override;
+    void OnGameObjectDestroyed(GameObject* go, Player* player) override;
+    void OnWorldUpdate(uint32 diff) override;
+    void OnMapUpdate(Map* map, uint32 diff) override;
+    void OnCombatLog(Map* map, PluginCombatLog const& log) override;
+    bool OnPacketReceive(WorldSession* session, WorldPacket& packet) override;
+    bool OnPacketSend(WorldSession* session, WorldPacket const& packet) override;
+    void OnServerStart() override;
+    void OnServerStop() override;
+    void OnConfigReload() override;
+
+private:
+    // Activates the real plugin, nullptr if that failed or it has no handler
+    IPlugin* Activate();
+    IEventHandler* ActivateHandler();
+    
+    PluginInfo _info;
+    std::vector<std::string> _interfaces;
+};
+
+#endif // TRINITY_PLUGIN_LAZY_STUB_H
@@ -16,84 +16,161 @@
  */
 
 #include "PluginManager.h"
+#include "PluginClock.h"
+#include "PluginConfig.h"
+#include "PluginEpoch.h"
+#include "PluginHooks.h"
+#include "PluginLazyStub.h"
+#include "PluginStateBlob.h"
+#include "PluginStaticModules.h"
+#include "Creature.h"
+#include "GameObject.h"
+#include "GameTime.h"
 #include "Log.h"
+#include "Map.h"
+#include "Opcodes.h"
+#include "Player.h"
 #include "Util.h"
+#include "WorldPacket.h"
 #include <filesystem>
 #include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
 
 #ifndef _WIN32
 #include <dlfcn.h>
 #endif
 
-std::unique_ptr<PluginManager> PluginManager::_instance;
+std::atomic<PluginManager*> PluginManager::_instance(nullptr);
+std::unique_ptr<PluginManager> PluginManager::_ownedInstance;
 std::mutex PluginManager::_instanceMutex;
+std::atomic<PluginEventMask> PluginManager::_activeEvents(PLUGIN_EVENT_MASK_NONE);
+std::atomic<PluginEventMask> PluginManager::_batchedEvents(PLUGIN_EVENT_MASK_NONE);
+std::array<std::atomic<uint64>, PluginManager::OPCODE_FILTER_WORDS> PluginManager::_opcodeFilter[PLUGIN_PACKET_DIRECTION_COUNT];
+std::atomic<uint32> PluginManager::_mapContextCount(0);
 
-PluginManager* PluginManager::Instance()
+PluginManager* PluginManager::CreateInstance()
 {
     std::lock_guard<std::mutex> lock(_instanceMutex);
-    if (!_instance)
-        _instance = std::unique_ptr<PluginManager>(new PluginManager());
-    return _instance.get();
+    if (!_ownedInstance)
+    {
+        _ownedInstance = std::unique_ptr<PluginManager>(new PluginManager());
+        _instance.store(_ownedInstance.get(), std::memory_order_release);
+    }
+    return _ownedInstance.get();
 }
 
 PluginManager::PluginManager()
+    : _worldThread(std::this_thread::get_id()), _eventTable(new PluginEventTable()), _mapContextTable(new PluginMapContextTable()), _messageBus(_workerPool), _persistence(_workerPool), _hasQueuedActivations(false), _tickBudgetTicks(0), _tickBudgetMaxStrikes(0), _traceDumpSeconds(10), _traceThreadNamed(false)
 {
     TC_LOG_INFO("server.loading", "Initializing Plugin Manager...");
+    PluginClock::Calibrate();
 }
 
 PluginManager::~PluginManager()
 {
     UnloadAllPlugins();
+    delete _eventTable.exchange(nullptr);
+    delete _mapContextTable.exchange(nullptr);
+    _instance.store(nullptr, std::memory_order_release);
 }
 
 bool PluginManager::LoadPlugin(std::string const& filePath)
 {
+    // Opened and loaded outside of _pluginsMutex, IPlugin::Load() may query the manager
+    std::string error;
+    std::unique_ptr<LoadedPlugin> loadedPlugin = OpenPlugin(filePath, error);
+    
     std::lock_guard<std::mutex> lock(_pluginsMutex);
     
-    if (!std::filesystem::exists(filePath))
+    if (!loadedPlugin || !RegisterPlugin(std::move(loadedPlugin), error))
     {
-        _lastError = "Plugin file does not exist: " + filePath;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        _lastError = error;
         return false;
     }
     
+    return true;
+}
+
+std::unique_ptr<LoadedPlugin> PluginManager::OpenPlugin(std::string const& filePath, std::string& error, std::string const& libraryPath)
+{
+    if (!std::filesystem::exists(filePath))
+    {
+        error = "Plugin file does not exist: " + filePath;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        return nullptr;
+    }
+    
     auto loadedPlugin = std::make_unique<LoadedPlugin>();
     
-    if (!LoadPluginLibrary(filePath, *loadedPlugin))
-        return false;
+    if (!LoadPluginLibrary(libraryPath.empty() ? filePath : libraryPath, *loadedPlugin, error))
+        return nullptr;
+    
+    loadedPlugin->filePath = filePath;
     
     if (!loadedPlugin->plugin)
     {
-        _lastError = "Failed to create plugin instance from: " + filePath;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Failed to create plugin instance from: " + filePath;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
         UnloadPluginLibrary(*loadedPlugin);
-        return false;
+        return nullptr;
     }
     
-    if (!ValidatePlugin(loadedPlugin->plugin.get()))
+    if (!ValidatePlugin(loadedPlugin->plugin.get(), error) || !CheckManifest(filePath, loadedPlugin->plugin->GetInfo(), error))
     {
         UnloadPluginLibrary(*loadedPlugin);
-        return false;
+        return nullptr;
+    }
+    
+    if (!loadedPlugin->plugin->Load())
+    {
+        error = "Plugin failed to load: " + loadedPlugin->plugin->GetInfo().name;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        UnloadPluginLibrary(*loadedPlugin);
+        return nullptr;
     }
     
+    return loadedPlugin;
+}
+
+bool PluginManager::RegisterPlugin(std::unique_ptr<LoadedPlugin> loadedPlugin, std::string& error)
+{
     std::string pluginName = loadedPlugin->plugin->GetInfo().name;
     
     if (_loadedPlugins.find(pluginName) != _loadedPlugins.end())
     {
-        _lastError = "Plugin already loaded: " + pluginName;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Plugin already loaded: " + pluginName;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        loadedPlugin->plugin->Unload();
         UnloadPluginLibrary(*loadedPlugin);
         return false;
     }
     
-    if (!loadedPlugin->plugin->Load())
+    if (_usedPluginIds.all())
     {
-        _lastError = "Plugin failed to load: " + pluginName;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Too many plugins loaded, cannot load: " + pluginName;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        loadedPlugin->plugin->Unload();
         UnloadPluginLibrary(*loadedPlugin);
         return false;
     }
     
+    uint16 pluginId = 0;
+    while (_usedPluginIds.test(pluginId))
+        ++pluginId;
+    
+    _usedPluginIds.set(pluginId);
+    loadedPlugin->id = pluginId;
+    loadedPlugin->plugin->_pluginId = pluginId;
+    
+    // Ids are reused, don't let a new plugin inherit the statistics of an old one
+    sPluginProfiler->ResetPlugin(pluginId);
+    _budgetStates[pluginId].Reset();
+    
     _loadedPlugins[pluginName] = std::move(loadedPlugin);
     
     TC_LOG_INFO("plugins", "Successfully loaded plugin: %s v%s by %s", 
@@ -101,17 +178,36 @@ bool PluginManager::LoadPlugin(std::string const& filePath)
                 _loadedPlugins[pluginName]->plugin->GetInfo().version.c_str(),
                 _loadedPlugins[pluginName]->plugin->GetInfo().author.c_str());
     
+    // Built with MODULES_ELIDE_HOOKS, the hooks of events no enabled module declared are gone
+    PluginEventMask const elided = _loadedPlugins[pluginName]->plugin->GetInfo().eventMask & ~PLUGIN_EVENT_MASK_COMPILED;
+    if (elided != PLUGIN_EVENT_MASK_NONE)
+    {
+        std::string events;
+        for (size_t i = 0; i < PLUGIN_EVENT_COUNT; ++i)
+        {
+            if (!(elided & PluginEventBit(static_cast<PluginEvent>(i))))
+                continue;
+            
+            if (!events.empty())
+                events += ", ";
+            events += GetPluginEventName(static_cast<PluginEvent>(i));
+        }
+        
+        TC_LOG_WARN("plugins", "Plugin %s subscribes to events whose hooks were compiled out, it will never receive: %s",
+                    pluginName.c_str(), events.c_str());
+    }
+    
     return true;
 }
 
-bool PluginManager::LoadPluginLibrary(std::string const& filePath, LoadedPlugin& loadedPlugin)
+bool PluginManager::LoadPluginLibrary(std::string const& filePath, LoadedPlugin& loadedPlugin, std::string& error)
 {
 #ifdef _WIN32
     loadedPlugin.handle = LoadLibraryA(filePath.c_str());
     if (!loadedPlugin.handle)
     {
-        _lastError = "Failed to load library: " + filePath + " (Error: " + std::to_string(GetLastError()) + ")";
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Failed to load library: " + filePath + " (Error: " + std::to_string(::GetLastError()) + ")";
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
         return false;
     }
     
@@ -121,19 +217,19 @@ bool PluginManager::LoadPluginLibrary(std::string const& filePath, LoadedPlugin&
     loadedPlugin.handle = dlopen(filePath.c_str(), RTLD_LAZY);
     if (!loadedPlugin.handle)
     {
-        _lastError = "Failed to load library: " + filePath + " (" + dlerror() + ")";
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Failed to load library: " + filePath + " (" + dlerror() + ")";
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
         return false;
     }
     
     loadedPlugin.createFunc = reinterpret_cast<PluginCreateFunc>(dlsym(loadedPlugin.handle, "CreatePlugin"));
     loadedPlugin.destroyFunc = reinterpret_cast<PluginDestroyFunc>(dlsym(loadedPlugin.handle, "DestroyPlugin"));
 #endif
-    
+
     if (!loadedPlugin.createFunc)
     {
-        _lastError = "Plugin does not export CreatePlugin function: " + filePath;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Plugin does not export CreatePlugin function: " + filePath;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
         UnloadPluginLibrary(loadedPlugin);
         return false;
     }
@@ -146,6 +242,9 @@ bool PluginManager::LoadPluginLibrary(std::string const& filePath, LoadedPlugin&
 
 void PluginManager::UnloadPluginLibrary(LoadedPlugin& loadedPlugin)
 {
+    // The destructor lives in the library (and cancels the plugin's timer tokens), run it before unmapping
+    loadedPlugin.plugin.reset();
+    
     if (loadedPlugin.handle)
     {
 #ifdef _WIN32
@@ -156,12 +255,18 @@ void PluginManager::UnloadPluginLibrary(LoadedPlugin& loadedPlugin)
         loadedPlugin.handle = nullptr;
     }
     
+    if (!loadedPlugin.libraryCopy.empty())
+    {
+        std::error_code error;
+        std::filesystem::remove(loadedPlugin.libraryCopy, error);
+        loadedPlugin.libraryCopy.clear();
+    }
+    
     loadedPlugin.createFunc = nullptr;
     loadedPlugin.destroyFunc = nullptr;
-    loadedPlugin.plugin.reset();
 }
 
-bool PluginManager::ValidatePlugin(IPlugin* plugin)
+bool PluginManager::ValidatePlugin(IPlugin* plugin, std::string& error)
 {
     if (!plugin)
         return false;
@@ -170,280 +275,2205 @@ bool PluginManager::ValidatePlugin(IPlugin* plugin)
     
     if (info.name.empty())
     {
-        _lastError = "Plugin name cannot be empty";
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Plugin name cannot be empty";
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
         return false;
     }
     
     if (info.version.empty())
     {
-        _lastError = "Plugin version cannot be empty for plugin: " + info.name;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        error = "Plugin version cannot be empty for plugin: " + info.name;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
         return false;
     }
     
     return true;
 }
 
-bool PluginManager::UnloadPlugin(std::string const& pluginName)
+bool PluginManager::CheckManifest(std::string const& filePath, PluginInfo const& info, std::string& error) const
 {
-    std::lock_guard<std::mutex> lock(_pluginsMutex);
-    
-    auto it = _loadedPlugins.find(pluginName);
-    if (it == _loadedPlugins.end())
-    {
-        _lastError = "Plugin not found: " + pluginName;
-        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
-        return false;
-    }
+    if (!_manifest.IsOpen())
+        return true;
     
-    LoadedPlugin* loadedPlugin = it->second.get();
+    int32 index = FindManifestModule(filePath);
+    if (index < 0)
+        return true;
     
-    if (loadedPlugin->plugin->GetState() == PluginState::RUNNING)
-        loadedPlugin->plugin->Stop();
+    std::string mismatch = _manifest.GetModule(index).Compare(info);
+    if (mismatch.empty())
+        return true;
     
-    loadedPlugin->plugin->Unload();
+    error = "Plugin " + filePath + " does not match the module manifest (" + mismatch + "), rebuild the modules";
+    TC_LOG_ERROR("plugins", "%s", error.c_str());
+    return false;
+}
+
+int32 PluginManager::FindManifestModule(std::string const& filePath) const
+{
+    if (IsStaticModulePath(filePath))
+        return _manifest.IsOpen() ? _manifest.FindModule(std::string_view(filePath).substr(sizeof(PLUGIN_STATIC_MODULE_PREFIX) - 1)) : -1;
     
-    // Remove event handler if registered
-    UnregisterEventHandler(pluginName);
+    return _manifest.IsOpen() ? _manifest.FindLibrary(std::filesystem::path(filePath).stem().string()) : -1;
+}
+
+bool PluginManager::RegisterLazyPlugin(std::string const& filePath, std::string& error)
+{
+    auto loadedPlugin = std::make_unique<LoadedPlugin>();
+    loadedPlugin->plugin = std::make_unique<PluginLazyStub>(_manifest.GetModule(FindManifestModule(filePath)));
+    loadedPlugin->filePath = filePath;
+    loadedPlugin->lazy = true;
+    loadedPlugin->plugin->Load();
     
-    UnloadPluginLibrary(*loadedPlugin);
-    _loadedPlugins.erase(it);
+    if (!RegisterPlugin(std::move(loadedPlugin), error))
+        return false;
     
-    TC_LOG_INFO("plugins", "Successfully unloaded plugin: %s", pluginName.c_str());
+    // Handles that found no provider so far may find this stub now
+    sPluginInterfaces->Invalidate();
     return true;
 }
 
-void PluginManager::LoadAllPlugins(std::string const& pluginDirectory)
+std::unique_ptr<LoadedPlugin> PluginManager::OpenStaticPlugin(std::string const& filePath, uint16 index, std::unique_ptr<IPlugin> plugin, std::string& error)
 {
-    _pluginDirectory = pluginDirectory;
-    
-    if (!std::filesystem::exists(pluginDirectory))
+    if (!plugin)
     {
-        TC_LOG_WARN("plugins", "Plugin directory does not exist: %s", pluginDirectory.c_str());
-        return;
+        error = "Static module listed twice: " + filePath;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        return nullptr;
     }
     
-    TC_LOG_INFO("plugins", "Loading plugins from directory: %s", pluginDirectory.c_str());
+    auto loadedPlugin = std::make_unique<LoadedPlugin>();
+    loadedPlugin->plugin = std::move(plugin);
+    loadedPlugin->filePath = filePath;
+    loadedPlugin->staticModule = index + 1;
+    
+    if (!ValidatePlugin(loadedPlugin->plugin.get(), error) || !CheckManifest(filePath, loadedPlugin->plugin->GetInfo(), error))
+        return nullptr;
     
-    for (auto const& entry : std::filesystem::directory_iterator(pluginDirectory))
+    if (!loadedPlugin->plugin->Load())
     {
-        if (entry.is_regular_file())
-        {
-            std::string extension = entry.path().extension().string();
-#ifdef _WIN32
-            if (extension == ".dll")
-#else
-            if (extension == ".so")
-#endif
-            {
-                LoadPlugin(entry.path().string());
-            }
-        }
+        error = "Plugin failed to load: " + loadedPlugin->plugin->GetInfo().name;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        return nullptr;
     }
+    
+    return loadedPlugin;
 }
 
-void PluginManager::InitializeAllPlugins()
+bool PluginManager::IsStaticModulePath(std::string const& filePath)
 {
-    std::vector<std::string> loadOrder = GetPluginLoadOrder();
-    
-    for (std::string const& pluginName : loadOrder)
-    {
-        InitializePlugin(pluginName);
-    }
+    return filePath.compare(0, sizeof(PLUGIN_STATIC_MODULE_PREFIX) - 1, PLUGIN_STATIC_MODULE_PREFIX) == 0;
 }
 
-bool PluginManager::InitializePlugin(std::string const& pluginName)
+bool PluginManager::ActivatePlugin(std::string const& pluginName)
 {
-    std::lock_guard<std::mutex> lock(_pluginsMutex);
-    
-    auto it = _loadedPlugins.find(pluginName);
-    if (it == _loadedPlugins.end())
+    // Reached again from the plugin being activated, e.g. an event it raises from Initialize()
+    thread_local bool activating = false;
+    if (activating)
         return false;
     
-    IPlugin* plugin = it->second->plugin.get();
+    // Opening and starting a library would stall a map or network thread, and
+    // Start() registers with the world thread only timers and sweeper
+    if (!IsWorldThread())
+        return QueueActivation(pluginName);
+    
+    std::lock_guard<std::mutex> activationLock(_activationMutex);
+    
+    std::string filePath;
     
-    if (!CheckPluginDependencies(pluginName))
     {
-        TC_LOG_ERROR("plugins", "Plugin dependencies not met: %s", pluginName.c_str());
-        return false;
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        if (it == _loadedPlugins.end())
+        {
+            _lastError = "Plugin not found: " + pluginName;
+            TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+            return false;
+        }
+        
+        if (!it->second->lazy)
+            return true;
+        
+        // Failed before, the stub stays disabled
+        if (it->second->plugin->GetState() == PluginState::ERROR)
+            return false;
+        
+        filePath = it->second->filePath;
     }
     
-    if (!plugin->Initialize())
+    activating = true;
+    
+    TC_LOG_INFO("plugins", "Activating lazy plugin: %s", pluginName.c_str());
+    
+    std::string error;
+    std::unique_ptr<LoadedPlugin> loadedPlugin = OpenPlugin(filePath, error);
+    
+    if (loadedPlugin && loadedPlugin->plugin->GetInfo().name != pluginName)
     {
-        TC_LOG_ERROR("plugins", "Failed to initialize plugin: %s", pluginName.c_str());
-        return false;
+        error = "Plugin " + filePath + " is not " + pluginName;
+        TC_LOG_ERROR("plugins", "%s", error.c_str());
+        loadedPlugin->plugin->Unload();
+        UnloadPluginLibrary(*loadedPlugin);
+        loadedPlugin.reset();
     }
     
-    // Register event handler if available
-    IEventHandler* eventHandler = plugin->GetEventHandler();
-    if (eventHandler)
-        RegisterEventHandler(pluginName, eventHandler);
+    if (loadedPlugin && !InitializePluginInstance(pluginName, loadedPlugin->plugin.get()))
+    {
+        error = "Failed to initialize plugin: " + pluginName;
+        loadedPlugin->plugin->Unload();
+        UnloadPluginLibrary(*loadedPlugin);
+        loadedPlugin.reset();
+    }
     
-    TC_LOG_INFO("plugins", "Successfully initialized plugin: %s", pluginName.c_str());
-    return true;
-}
-
-void PluginManager::StartAllPlugins()
-{
-    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    activating = false;
+    
+    std::unique_ptr<LoadedPlugin> stub;
     
-    for (auto const& pair : _loadedPlugins)
     {
-        IPlugin* plugin = pair.second->plugin.get();
-        if (plugin->GetState() == PluginState::INITIALIZED)
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        
+        if (!loadedPlugin)
         {
-            plugin->Start();
-            TC_LOG_INFO("plugins", "Started plugin: %s", pair.first.c_str());
+            _lastError = error;
+            TC_LOG_ERROR("plugins", "Lazy plugin %s could not be activated, disabling it", pluginName.c_str());
+            
+            if (it != _loadedPlugins.end() && it->second->lazy)
+                it->second->plugin->OnError();
+            
+            RebuildEventTable();
+            return false;
         }
-    }
-}
-
-void PluginManager::StopAllPlugins()
-{
-    std::lock_guard<std::mutex> lock(_pluginsMutex);
-    
-    for (auto const& pair : _loadedPlugins)
-    {
-        IPlugin* plugin = pair.second->plugin.get();
-        if (plugin->GetState() == PluginState::RUNNING)
+        
+        // Unloaded meanwhile
+        if (it == _loadedPlugins.end() || !it->second->lazy)
         {
-            plugin->Stop();
-            TC_LOG_INFO("plugins", "Stopped plugin: %s", pair.first.c_str());
+            loadedPlugin->plugin->Unload();
+            UnloadPluginLibrary(*loadedPlugin);
+            return false;
         }
+        
+        // The stub's id, profiler statistics and budget carry over to the real plugin
+        loadedPlugin->id = it->second->id;
+        loadedPlugin->plugin->_pluginId = it->second->id;
+        
+        stub = std::move(it->second);
+        it->second = std::move(loadedPlugin);
+        
+        IPlugin* plugin = it->second->plugin.get();
+        plugin->Start();
+        
+        UnregisterEventHandler(pluginName);
+        if (IEventHandler* eventHandler = plugin->GetEventHandler())
+            RegisterEventHandler(pluginName, eventHandler);
+        
+        RebuildEventTable();
     }
-}
-
-void PluginManager::UnloadAllPlugins()
-{
-    std::vector<std::string> pluginNames = GetLoadedPluginNames();
     
-    for (std::string const& pluginName : pluginNames)
-        UnloadPlugin(pluginName);
+    // Dispatches that loaded the previous table may still be running inside the stub
+    sPluginEpoch->Retire(stub->plugin.release());
+    
+    TC_LOG_INFO("plugins", "Activated lazy plugin: %s", pluginName.c_str());
+    return true;
 }
 
-IPlugin* PluginManager::GetPlugin(std::string const& pluginName)
+bool PluginManager::QueueActivation(std::string const& pluginName)
 {
-    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        if (it == _loadedPlugins.end() || it->second->plugin->GetState() == PluginState::ERROR)
+            return false;
+        
+        // Activated already, a dispatch that loaded the previous table reached the stub
+        if (!it->second->lazy)
+            return true;
+    }
     
-    auto it = _loadedPlugins.find(pluginName);
-    if (it != _loadedPlugins.end())
-        return it->second->plugin.get();
+    std::lock_guard<std::mutex> lock(_queuedActivationsMutex);
     
-    return nullptr;
+    if (std::find(_queuedActivations.begin(), _queuedActivations.end(), pluginName) == _queuedActivations.end())
+    {
+        TC_LOG_DEBUG("plugins", "Lazy plugin %s is first used off the world thread, activating it at the next world update", pluginName.c_str());
+        _queuedActivations.push_back(pluginName);
+        _hasQueuedActivations.store(true, std::memory_order_release);
+    }
+    
+    return false;
 }
 
-std::vector<std::string> PluginManager::GetLoadedPluginNames() const
+void PluginManager::ApplyActivations()
 {
-    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    if (!_hasQueuedActivations.load(std::memory_order_acquire))
+        return;
     
-    std::vector<std::string> names;
-    names.reserve(_loadedPlugins.size());
+    std::vector<std::string> pluginNames;
     
-    for (auto const& pair : _loadedPlugins)
-        names.push_back(pair.first);
+    {
+        std::lock_guard<std::mutex> lock(_queuedActivationsMutex);
+        pluginNames.swap(_queuedActivations);
+        _hasQueuedActivations.store(false, std::memory_order_relaxed);
+    }
     
-    return names;
-}
-
-void PluginManager::RegisterEventHandler(std::string const& pluginName, IEventHandler* handler)
-{
-    std::lock_guard<std::mutex> lock(_eventHandlersMutex);
-    _eventHandlers[pluginName] = handler;
-}
-
-void PluginManager::UnregisterEventHandler(std::string const& pluginName)
-{
-    std::lock_guard<std::mutex> lock(_eventHandlersMutex);
-    _eventHandlers.erase(pluginName);
-}
-
-// Event dispatching implementations
-void PluginManager::OnPlayerLogin(Player* player)
-{
-    std::vector<IEventHandler*> handlers = GetEventHandlersByPriority();
-    for (IEventHandler* handler : handlers)
-        handler->OnPlayerLogin(player);
+    for (std::string const& pluginName : pluginNames)
+        ActivatePlugin(pluginName);
 }
 
-void PluginManager::OnPlayerLogout(Player* player)
+void PluginManager::ActivateInterfaceProvider(std::string const& interfaceName)
 {
-    std::vector<IEventHandler*> handlers = GetEventHandlersByPriority();
-    for (IEventHandler* handler : handlers)
-        handler->OnPlayerLogout(player);
+    std::string pluginName;
+    
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        for (auto const& pair : _loadedPlugins)
+        {
+            LoadedPlugin const& loadedPlugin = *pair.second;
+            if (loadedPlugin.lazy && loadedPlugin.plugin->GetState() != PluginState::ERROR && loadedPlugin.plugin->HasInterface(interfaceName))
+            {
+                pluginName = pair.first;
+                break;
+            }
+        }
+    }
+    
+    if (!pluginName.empty())
+        ActivatePlugin(pluginName);
 }
 
-void PluginManager::OnWorldUpdate(uint32 diff)
+void* PluginManager::GetPluginInterface(std::string const& pluginName, std::string const& interfaceName)
 {
-    std::vector<IEventHandler*> handlers = GetEventHandlersByPriority();
-    for (IEventHandler* handler : handlers)
-        handler->OnWorldUpdate(diff);
+    // Keeps a lazy stub alive while it activates the plugin it stands in for
+    PluginEpochGuard guard;
+    
+    IPlugin* plugin = GetPlugin(pluginName);
+    return plugin ? plugin->GetInterface(interfaceName) : nullptr;
 }
 
-std::vector<IEventHandler*> PluginManager::GetEventHandlersByPriority()
+bool PluginManager::UnloadPlugin(std::string const& pluginName)
 {
-    std::lock_guard<std::mutex> lock(_eventHandlersMutex);
-    
-    std::vector<std::pair<PluginPriority, IEventHandler*>> prioritizedHandlers;
+    std::unique_ptr<LoadedPlugin> loadedPlugin;
     
-    for (auto const& pair : _eventHandlers)
     {
-        IPlugin* plugin = GetPlugin(pair.first);
-        if (plugin && plugin->GetState() == PluginState::RUNNING)
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        if (it == _loadedPlugins.end())
         {
-            PluginPriority priority = plugin->GetInfo().priority;
-            prioritizedHandlers.emplace_back(priority, pair.second);
+            _lastError = "Plugin not found: " + pluginName;
+            TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+            return false;
         }
+        
+        loadedPlugin = std::move(it->second);
+        _loadedPlugins.erase(it);
+        _usedPluginIds.reset(loadedPlugin->id);
+        
+        // Remove event handler if registered
+        UnregisterEventHandler(pluginName);
+        RebuildEventTable();
     }
     
-    // Sort by priority (highest first)
-    std::sort(prioritizedHandlers.begin(), prioritizedHandlers.end(),
-              [](auto const& a, auto const& b) { return a.first > b.first; });
+    sPluginInterfaces->Revoke(loadedPlugin->plugin.get());
+    _messageBus.Unsubscribe(loadedPlugin->plugin.get());
+    
+    _configWatcher.Unwatch(pluginName);
+    
+    // Wait for dispatches still running the plugin's handlers before tearing it down
+    sPluginEpoch->Synchronize();
     
-    std::vector<IEventHandler*> handlers;
-    handlers.reserve(prioritizedHandlers.size());
+    if (loadedPlugin->plugin->GetState() == PluginState::RUNNING)
+        loadedPlugin->plugin->Stop();
+    
+    // Tasks run code from the plugin's library, let them finish and drop its continuations
+    _workerPool.WaitIdle();
+    _workerPool.DiscardCompletions(loadedPlugin->plugin.get());
+    
+    ReleaseMapStates(loadedPlugin->id);
     
-    for (auto const& pair : prioritizedHandlers)
-        handlers.push_back(pair.second);
+    loadedPlugin->plugin->Unload();
+    
+    UnloadPluginLibrary(*loadedPlugin);
     
-    return handlers;
+    TC_LOG_INFO("plugins", "Successfully unloaded plugin: %s", pluginName.c_str());
+    return true;
 }
 
-std::vector<std::string> PluginManager::GetPluginLoadOrder()
+bool PluginManager::ReloadPlugin(std::string const& pluginName)
 {
-    std::vector<std::string> loadOrder;
-    std::vector<std::string> pluginNames = GetLoadedPluginNames();
+    auto reload = std::make_shared<PendingReload>();
+    reload->pluginName = pluginName;
+    
+    std::string filePath;
     
-    for (std::string const& pluginName : pluginNames)
     {
-        if (std::find(loadOrder.begin(), loadOrder.end(), pluginName) == loadOrder.end())
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        if (it == _loadedPlugins.end())
+        {
+            _lastError = "Plugin not found: " + pluginName;
+            TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+            return false;
+        }
+        
+        LoadedPlugin& loadedPlugin = *it->second;
+        
+        if (loadedPlugin.reloading)
         {
-            ResolveDependencies(pluginName, loadOrder);
+            _lastError = "Plugin is already being reloaded: " + pluginName;
+            TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+            return false;
         }
+        
+        if (loadedPlugin.staticModule)
+        {
+            _lastError = "Plugin is linked into the server and cannot be reloaded: " + pluginName;
+            TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+            return false;
+        }
+        
+        // The library was never opened, activation picks up the current build
+        if (loadedPlugin.lazy)
+        {
+            TC_LOG_INFO("plugins", "Lazy plugin %s is not active, nothing to reload", pluginName.c_str());
+            return true;
+        }
+        
+        loadedPlugin.reloading = true;
+        reload->oldPlugin = loadedPlugin.plugin.get();
+        filePath = loadedPlugin.filePath;
     }
     
-    return loadOrder;
+    // dlopen() and LoadLibrary() return the library already mapped for a path,
+    // the new build is opened from a private copy
+    std::filesystem::path source(filePath);
+    std::error_code error;
+    std::string copyPath = (std::filesystem::temp_directory_path(error) / (source.stem().string() + ".reload-" + std::to_string(PluginClock::Now()) + source.extension().string())).string();
+    
+    TC_LOG_INFO("plugins", "Reloading plugin: %s", pluginName.c_str());
+    
+    StartWorkerPool();
+    
+    _workerPool.Submit(nullptr, [this, reload, filePath, copyPath]()
+    {
+        try
+        {
+            std::error_code error;
+            if (!std::filesystem::copy_file(filePath, copyPath, std::filesystem::copy_options::overwrite_existing, error))
+            {
+                reload->error = "Failed to copy " + filePath + " for reloading (" + error.message() + ")";
+                TC_LOG_ERROR("plugins", "%s", reload->error.c_str());
+                return;
+            }
+            
+            reload->loadedPlugin = OpenPlugin(filePath, reload->error, copyPath);
+
+#ifdef _WIN32
+            // A mapped file cannot be deleted, UnloadPluginLibrary removes it once freed
+            if (reload->loadedPlugin)
+                reload->loadedPlugin->libraryCopy = copyPath;
+            else
+                std::filesystem::remove(copyPath, error);
+#else
+            std::filesystem::remove(copyPath, error);
+#endif
+        }
+        catch (std::exception const& e)
+        {
+            reload->error = "Failed to open " + filePath + " for reloading (" + e.what() + ")";
+            TC_LOG_ERROR("plugins", "%s", reload->error.c_str());
+        }
+    }).Then([this, reload]()
+    {
+        // Not swapped in from here, continuations running after this one may
+        // still belong to the old instance
+        _pendingReloads.push_back(reload);
+    });
+    
+    return true;
 }
 
-bool PluginManager::ResolveDependencies(std::string const& pluginName, std::vector<std::string>& loadOrder)
+void PluginManager::ApplyReloads()
 {
-    IPlugin* plugin = GetPlugin(pluginName);
-    if (!plugin)
-        return false;
+    if (_pendingReloads.empty())
+        return;
     
-    std::vector<std::string> const& dependencies = plugin->GetDependencies();
+    std::vector<std::shared_ptr<PendingReload>> reloads;
+    reloads.swap(_pendingReloads);
+    
+    for (std::shared_ptr<PendingReload> const& reload : reloads)
+        ApplyReload(*reload);
+}
+
+void PluginManager::ApplyReload(PendingReload& reload)
+{
+    std::string const& pluginName = reload.pluginName;
+    std::unique_ptr<LoadedPlugin> loadedPlugin = std::move(reload.loadedPlugin);
+    IPlugin* oldPlugin = nullptr;
+    IEventHandler* oldHandler = nullptr;
+    uint16 pluginId = 0;
     
-    for (std::string const& dependency : dependencies)
     {
-        if (std::find(loadOrder.begin(), loadOrder.end(), dependency) == loadOrder.end())
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        // Gone, or unloaded and loaded again, while the library was being opened
+        auto it = _loadedPlugins.find(pluginName);
+        if (it != _loadedPlugins.end() && it->second->reloading && it->second->plugin.get() == reload.oldPlugin)
         {
-            if (!ResolveDependencies(dependency, loadOrder))
-                return false;
+            it->second->reloading = false;
+            oldPlugin = it->second->plugin.get();
+            pluginId = it->second->id;
         }
     }
     
-    loadOrder.push_back(pluginName);
-    return true;
+    if (!loadedPlugin)
+    {
+        _lastError = reload.error;
+        TC_LOG_ERROR("plugins", "Failed to reload plugin %s, the running instance is kept", pluginName.c_str());
+        return;
+    }
+    
+    if (!oldPlugin)
+    {
+        TC_LOG_INFO("plugins", "Plugin %s was unloaded during its reload, discarding the new instance", pluginName.c_str());
+        DiscardPlugin(*loadedPlugin);
+        return;
+    }
+    
+    if (loadedPlugin->plugin->GetInfo().name != pluginName)
+    {
+        _lastError = "Plugin " + loadedPlugin->filePath + " is no longer " + pluginName;
+        TC_LOG_ERROR("plugins", "%s, the running instance is kept", _lastError.c_str());
+        DiscardPlugin(*loadedPlugin);
+        return;
+    }
+    
+    PluginState state = oldPlugin->GetState();
+    
+    // Quiesce: new dispatches no longer see the old handlers, then wait out the running ones
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        {
+            std::lock_guard<std::mutex> handlersLock(_eventHandlersMutex);
+            auto handler = _eventHandlers.find(pluginName);
+            if (handler != _eventHandlers.end())
+                oldHandler = handler->second;
+        }
+        
+        UnregisterEventHandler(pluginName);
+        RebuildEventTable();
+    }
+    
+    // Handles are rebound when the new instance provides its interfaces in Start()
+    sPluginInterfaces->Revoke(oldPlugin);
+    _messageBus.Unsubscribe(oldPlugin);
+    
+    sPluginEpoch->Synchronize();
+    
+    if (state == PluginState::RUNNING)
+        oldPlugin->Stop();
+    
+    // Tasks of the old instance run code from its library
+    _workerPool.WaitIdle();
+    _workerPool.DiscardCompletions(oldPlugin);
+    
+    PluginStateBlob blob;
+    bool exported = state != PluginState::LOADED && oldPlugin->ExportState(blob);
+    
+    // Same id, profiler statistics and budget as the instance it replaces
+    IPlugin* plugin = loadedPlugin->plugin.get();
+    loadedPlugin->id = pluginId;
+    plugin->_pluginId = pluginId;
+    
+    if (state != PluginState::LOADED && !InitializePluginInstance(pluginName, plugin))
+    {
+        _lastError = "Failed to initialize reloaded plugin: " + pluginName;
+        TC_LOG_ERROR("plugins", "%s, the previous instance is kept", _lastError.c_str());
+        DiscardPlugin(*loadedPlugin);
+        
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        if (state == PluginState::RUNNING)
+            oldPlugin->Start();
+        
+        if (oldHandler)
+            RegisterEventHandler(pluginName, oldHandler);
+        
+        RebuildEventTable();
+        return;
+    }
+    
+    if (exported && !plugin->ImportState(blob))
+        TC_LOG_WARN("plugins", "Reloaded plugin %s did not accept the state of the previous instance (version %u)", pluginName.c_str(), blob.GetVersion());
+    
+    // Created by the old library
+    ReleaseMapStates(pluginId);
+    
+    std::unique_ptr<LoadedPlugin> oldLoadedPlugin;
+    
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        oldLoadedPlugin = std::move(it->second);
+        it->second = std::move(loadedPlugin);
+        
+        if (state == PluginState::RUNNING)
+            plugin->Start();
+        
+        if (state != PluginState::LOADED)
+            if (IEventHandler* eventHandler = plugin->GetEventHandler())
+                RegisterEventHandler(pluginName, eventHandler);
+        
+        RebuildEventTable();
+    }
+    
+    // No table references the old instance since the Synchronize above
+    oldLoadedPlugin->plugin->Unload();
+    oldLoadedPlugin->plugin.reset();
+    
+    // Unmapping runs the library's static destructors, keep it off the world thread
+    std::shared_ptr<LoadedPlugin> library(std::move(oldLoadedPlugin));
+    _workerPool.Submit(nullptr, [this, library]()
+    {
+        UnloadPluginLibrary(*library);
+    });
+    
+    TC_LOG_INFO("plugins", "Successfully reloaded plugin: %s v%s", pluginName.c_str(), plugin->GetInfo().version.c_str());
+}
+
+void PluginManager::DiscardPlugin(LoadedPlugin& loadedPlugin)
+{
+    loadedPlugin.plugin->Unload();
+    UnloadPluginLibrary(loadedPlugin);
+}
+
+void PluginManager::LoadAllPlugins(std::string const& pluginDirectory)
+{
+    _pluginDirectory = pluginDirectory;
+    
+    // The .plugin commands, loaded with the plugins during world startup
+    static std::once_flag commandScriptRegistered;
+    std::call_once(commandScriptRegistered, AddSC_plugin_commandscript);
+    
+    // Before any plugin is constructed, plugins register their metrics early
+    OpenMetrics();
+    LoadTraceSettings();
+    
+    bool const directoryExists = std::filesystem::exists(pluginDirectory);
+    
+    if (!directoryExists)
+    {
+        TC_LOG_WARN("plugins", "Plugin directory does not exist: %s", pluginDirectory.c_str());
+        if (!PluginStaticModules::Count)
+            return;
+    }
+    else
+        TC_LOG_INFO("plugins", "Loading plugins from directory: %s", pluginDirectory.c_str());
+    
+    std::vector<std::string> filePaths;
+    
+    if (directoryExists)
+    {
+        for (auto const& entry : std::filesystem::directory_iterator(pluginDirectory))
+        {
+            if (entry.is_regular_file())
+            {
+                std::string extension = entry.path().extension().string();
+#ifdef _WIN32
+                if (extension == ".dll")
+#else
+                if (extension == ".so")
+#endif
+                {
+                    filePaths.push_back(entry.path().string());
+                }
+            }
+        }
+    }
+    
+    // Modules linked into the server go through the same planning under a pseudo path.
+    // Only the owning task moves an instance out, staticPaths stays read only.
+    std::vector<std::string> staticPaths;
+    std::vector<std::unique_ptr<IPlugin>> staticPlugins;
+    
+    for (size_t i = 0; i < PluginStaticModules::Count; ++i)
+    {
+        std::unique_ptr<IPlugin> plugin = PluginStaticModules::Create(i);
+        staticPaths.push_back(PLUGIN_STATIC_MODULE_PREFIX + plugin->GetInfo().name);
+        staticPlugins.push_back(std::move(plugin));
+        filePaths.push_back(staticPaths.back());
+    }
+    
+    // Registration order decides the plugin ids, keep it independent of directory order and load timing
+    std::sort(filePaths.begin(), filePaths.end());
+    
+    std::string manifestPath = sPluginConfigManager->GetGlobalSetting("Plugins.Manifest", (std::filesystem::path(pluginDirectory) / "modules.manifest").string());
+    
+    if (_manifest.Open(manifestPath))
+        PlanManifestLoad(filePaths);
+    else if (std::filesystem::exists(manifestPath))
+        TC_LOG_WARN("plugins", "%s, loading plugins without it", _manifest.GetLastError().c_str());
+    
+    // Lazy modules only get a stub, registered after the libraries opened now
+    std::vector<std::string> lazyPaths;
+    
+    // Static modules have no library to defer
+    auto lazyBegin = std::stable_partition(filePaths.begin(), filePaths.end(), [this](std::string const& filePath)
+    {
+        int32 index = FindManifestModule(filePath);
+        return index < 0 || !_manifest.GetModule(index).IsLazy() || IsStaticModulePath(filePath);
+    });
+    
+    std::move(lazyBegin, filePaths.end(), std::back_inserter(lazyPaths));
+    filePaths.erase(lazyBegin, filePaths.end());
+    
+    std::vector<std::unique_ptr<LoadedPlugin>> openedPlugins(filePaths.size());
+    std::vector<std::string> errors(filePaths.size());
+    
+    auto openPlugin = [this, &filePaths, &errors, &staticPaths, &staticPlugins](size_t i)
+    {
+        auto staticPath = std::find(staticPaths.begin(), staticPaths.end(), filePaths[i]);
+        if (staticPath == staticPaths.end())
+            return OpenPlugin(filePaths[i], errors[i]);
+        
+        size_t index = std::distance(staticPaths.begin(), staticPath);
+        return OpenStaticPlugin(filePaths[i], uint16(index), std::move(staticPlugins[index]), errors[i]);
+    };
+    
+    if (IsParallelStartupEnabled() && filePaths.size() > 1)
+    {
+        StartWorkerPool();
+        
+        std::vector<PluginTaskFuture<bool>> tasks;
+        tasks.reserve(filePaths.size());
+        
+        for (size_t i = 0; i < filePaths.size(); ++i)
+        {
+            tasks.push_back(_workerPool.Submit(nullptr, [&openPlugin, &openedPlugins, i]()
+            {
+                openedPlugins[i] = openPlugin(i);
+                return openedPlugins[i] != nullptr;
+            }));
+        }
+        
+        // The tasks reference the vectors above, let all of them finish before rethrowing anything
+        for (PluginTaskFuture<bool> const& task : tasks)
+            task.Wait();
+        
+        for (PluginTaskFuture<bool> const& task : tasks)
+            task.Get();
+    }
+    else
+    {
+        for (size_t i = 0; i < filePaths.size(); ++i)
+            openedPlugins[i] = openPlugin(i);
+    }
+    
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    for (size_t i = 0; i < filePaths.size(); ++i)
+    {
+        if (!openedPlugins[i] || !RegisterPlugin(std::move(openedPlugins[i]), errors[i]))
+            _lastError = errors[i];
+    }
+    
+    for (std::string const& filePath : lazyPaths)
+    {
+        std::string error;
+        if (!RegisterLazyPlugin(filePath, error))
+            _lastError = error;
+    }
+}
+
+void PluginManager::PlanManifestLoad(std::vector<std::string>& filePaths) const
+{
+    uint32 moduleCount = _manifest.GetModuleCount();
+    
+    std::vector<std::string> moduleFiles(moduleCount);
+    std::vector<std::string> unlistedFiles;
+    
+    for (std::string& filePath : filePaths)
+    {
+        int32 index = FindManifestModule(filePath);
+        if (index < 0)
+            unlistedFiles.push_back(std::move(filePath));
+        else
+            moduleFiles[index] = std::move(filePath);
+    }
+    
+    std::vector<bool> accepted(moduleCount, false);
+    
+    for (uint32 i = 0; i < moduleCount; ++i)
+    {
+        PluginManifestModule module = _manifest.GetModule(i);
+        
+        if (!module.IsEnabled())
+            TC_LOG_INFO("plugins", "Skipping module %.*s: disabled", int(module.GetName().size()), module.GetName().data());
+        else if (moduleFiles[i].empty())
+            TC_LOG_WARN("plugins", "Skipping module %.*s: library %.*s not found", int(module.GetName().size()), module.GetName().data(),
+                int(module.GetLibrary().size()), module.GetLibrary().data());
+        else
+            accepted[i] = true;
+    }
+    
+    // Drops modules depending on a listed module that is not accepted. Dependencies missing
+    // from the manifest may be unlisted plugins and are left to InitializeAllPlugins.
+    // Module counts are small, iterating until nothing changes is cheap.
+    auto dropUnsatisfied = [this, moduleCount, &accepted]()
+    {
+        for (bool changed = true; changed; )
+        {
+            changed = false;
+            
+            for (uint32 i = 0; i < moduleCount; ++i)
+            {
+                if (!accepted[i])
+                    continue;
+                
+                PluginManifestModule module = _manifest.GetModule(i);
+                
+                for (uint32 dependency = 0; dependency < module.GetDependencyCount(); ++dependency)
+                {
+                    int32 index = _manifest.FindModule(module.GetDependency(dependency));
+                    if (index < 0 || accepted[index])
+                        continue;
+                    
+                    TC_LOG_WARN("plugins", "Skipping module %.*s: dependency %.*s is not loaded", int(module.GetName().size()), module.GetName().data(),
+                        int(module.GetDependency(dependency).size()), module.GetDependency(dependency).data());
+                    accepted[i] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    };
+    
+    dropUnsatisfied();
+    
+    // Of two conflicting modules the one earlier in load order wins
+    for (uint32 i = 0; i < moduleCount; ++i)
+    {
+        if (!accepted[i])
+            continue;
+        
+        PluginManifestModule module = _manifest.GetModule(i);
+        
+        for (uint32 j = 0; j < i; ++j)
+        {
+            if (!accepted[j])
+                continue;
+            
+            PluginManifestModule other = _manifest.GetModule(j);
+            if (!module.ConflictsWith(other.GetName()) && !other.ConflictsWith(module.GetName()))
+                continue;
+            
+            TC_LOG_WARN("plugins", "Skipping module %.*s: conflicts with %.*s", int(module.GetName().size()), module.GetName().data(),
+                int(other.GetName().size()), other.GetName().data());
+            accepted[i] = false;
+            break;
+        }
+    }
+    
+    dropUnsatisfied();
+    
+    // Manifest modules in load order, then everything the manifest does not know
+    filePaths.clear();
+    
+    for (uint32 i = 0; i < moduleCount; ++i)
+        if (accepted[i])
+            filePaths.push_back(std::move(moduleFiles[i]));
+    
+    std::move(unlistedFiles.begin(), unlistedFiles.end(), std::back_inserter(filePaths));
+}
+
+void PluginManager::InitializeAllPlugins()
+{
+    DependencyGraph graph;
+    BuildDependencyGraph(graph);
+    
+    bool parallel = IsParallelStartupEnabled();
+    if (parallel)
+        StartWorkerPool();
+    
+    // Plugins of one wave only depend on plugins of earlier waves and are initialized concurrently
+    ForEachDependencyWave(graph, [this, &graph, parallel](std::vector<uint32> const& wave, std::vector<bool>& initialized)
+    {
+        if (parallel && wave.size() > 1)
+        {
+            std::vector<PluginTaskFuture<bool>> tasks;
+            tasks.reserve(wave.size());
+            
+            for (uint32 index : wave)
+            {
+                tasks.push_back(_workerPool.Submit(nullptr, [this, &graph, index]()
+                {
+                    return InitializePluginInstance(graph.names[index], graph.plugins[index]);
+                }));
+            }
+            
+            for (PluginTaskFuture<bool> const& task : tasks)
+                task.Wait();
+            
+            for (size_t i = 0; i < tasks.size(); ++i)
+                initialized[i] = tasks[i].Get();
+        }
+        else
+        {
+            for (size_t i = 0; i < wave.size(); ++i)
+                initialized[i] = InitializePluginInstance(graph.names[wave[i]], graph.plugins[wave[i]]);
+        }
+        
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        for (size_t i = 0; i < wave.size(); ++i)
+        {
+            if (!initialized[i])
+                continue;
+            
+            if (IEventHandler* eventHandler = graph.plugins[wave[i]]->GetEventHandler())
+                RegisterEventHandler(graph.names[wave[i]], eventHandler);
+        }
+    });
+    
+    for (size_t i = 0; i < graph.names.size(); ++i)
+    {
+        if (graph.pendingDependencies[i] > 0)
+            TC_LOG_ERROR("plugins", "Plugin %s not initialized, it is part of or depends on a dependency cycle", graph.names[i].c_str());
+        else if (!graph.missingDependencies[i].empty())
+            TC_LOG_ERROR("plugins", "Plugin %s not initialized, missing dependency: %s", graph.names[i].c_str(), graph.missingDependencies[i].c_str());
+        else if (graph.blocked[i])
+            TC_LOG_ERROR("plugins", "Plugin %s not initialized, a dependency failed to initialize", graph.names[i].c_str());
+    }
+    
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    RebuildEventTable();
+}
+
+bool PluginManager::InitializePlugin(std::string const& pluginName)
+{
+    // Not under _pluginsMutex, Initialize() may query the manager
+    IPlugin* plugin = GetPlugin(pluginName);
+    if (!plugin)
+        return false;
+    
+    if (!InitializePluginInstance(pluginName, plugin))
+        return false;
+    
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    // Register event handler if available
+    IEventHandler* eventHandler = plugin->GetEventHandler();
+    if (eventHandler)
+        RegisterEventHandler(pluginName, eventHandler);
+    
+    RebuildEventTable();
+    return true;
+}
+
+bool PluginManager::InitializePluginInstance(std::string const& pluginName, IPlugin* plugin)
+{
+    if (!plugin->CheckDependencies())
+    {
+        TC_LOG_ERROR("plugins", "Plugin dependencies not met: %s", pluginName.c_str());
+        return false;
+    }
+    
+    if (!plugin->Initialize())
+    {
+        TC_LOG_ERROR("plugins", "Failed to initialize plugin: %s", pluginName.c_str());
+        return false;
+    }
+    
+    TC_LOG_INFO("plugins", "Successfully initialized plugin: %s", pluginName.c_str());
+    return true;
+}
+
+bool PluginManager::IsParallelStartupEnabled() const
+{
+    return std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.ParallelStartup", "1").c_str(), nullptr, 10) != 0;
+}
+
+void PluginManager::StartWorkerPool()
+{
+    if (!_workerPool.IsRunning())
+        _workerPool.Start(uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.WorkerThreads", "0").c_str(), nullptr, 10)));
+}
+
+bool PluginManager::StartPlugin(std::string const& pluginName)
+{
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    auto it = _loadedPlugins.find(pluginName);
+    if (it == _loadedPlugins.end())
+    {
+        _lastError = "Plugin not found: " + pluginName;
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return false;
+    }
+    
+    IPlugin* plugin = it->second->plugin.get();
+    if (plugin->GetState() != PluginState::INITIALIZED)
+    {
+        _lastError = "Plugin is not initialized: " + pluginName;
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return false;
+    }
+    
+    plugin->Start();
+    RebuildEventTable();
+    
+    TC_LOG_INFO("plugins", "Started plugin: %s", pluginName.c_str());
+    return true;
+}
+
+bool PluginManager::StopPlugin(std::string const& pluginName)
+{
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        auto it = _loadedPlugins.find(pluginName);
+        if (it == _loadedPlugins.end())
+        {
+            _lastError = "Plugin not found: " + pluginName;
+            TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+            return false;
+        }
+    }
+    
+    return !StopPlugins({ pluginName }).empty();
+}
+
+std::vector<IPlugin*> PluginManager::StopPlugins(std::vector<std::string> const& pluginNames)
+{
+    std::vector<std::pair<std::string, IPlugin*>> stopping;
+    
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        for (std::string const& pluginName : pluginNames)
+        {
+            auto it = _loadedPlugins.find(pluginName);
+            if (it == _loadedPlugins.end() || it->second->stopping)
+                continue;
+            
+            IPlugin* plugin = it->second->plugin.get();
+            if (plugin->GetState() != PluginState::RUNNING)
+                continue;
+            
+            it->second->stopping = true;
+            sPluginInterfaces->Revoke(plugin);
+            _messageBus.Unsubscribe(plugin);
+            stopping.emplace_back(pluginName, plugin);
+        }
+        
+        if (stopping.empty())
+            return {};
+        
+        RebuildEventTable();
+    }
+    
+    // Same order as UnloadPlugin, map and network threads may still be
+    // dispatching into these plugins from the previous table
+    sPluginEpoch->Synchronize();
+    
+    std::vector<IPlugin*> stopped;
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    for (auto const& pair : stopping)
+    {
+        // Unloaded or reloaded while synchronizing, that path stopped it already
+        auto it = _loadedPlugins.find(pair.first);
+        if (it == _loadedPlugins.end() || it->second->plugin.get() != pair.second || !it->second->stopping)
+            continue;
+        
+        it->second->stopping = false;
+        if (pair.second->GetState() != PluginState::RUNNING)
+            continue;
+        
+        pair.second->Stop();
+        stopped.push_back(pair.second);
+        TC_LOG_INFO("plugins", "Stopped plugin: %s", pair.first.c_str());
+    }
+    
+    return stopped;
+}
+
+void PluginManager::StartAllPlugins()
+{
+    LoadBudgetSettings();
+    LoadPersistenceSettings();
+    LoadMessageBusSettings();
+    LoadSweeperSettings();
+    
+    // Plugins may submit work from Start()
+    StartWorkerPool();
+    
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    for (auto const& pair : _loadedPlugins)
+    {
+        IPlugin* plugin = pair.second->plugin.get();
+        if (plugin->GetState() == PluginState::INITIALIZED)
+        {
+            plugin->Start();
+            TC_LOG_INFO("plugins", "Started plugin: %s", pair.first.c_str());
+        }
+    }
+    
+    RebuildEventTable();
+}
+
+void PluginManager::StopAllPlugins()
+{
+    std::vector<std::string> pluginNames;
+    
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        pluginNames.reserve(_loadedPlugins.size());
+        for (auto const& pair : _loadedPlugins)
+            pluginNames.push_back(pair.first);
+    }
+    
+    StopPlugins(pluginNames);
+}
+
+void PluginManager::UnloadAllPlugins()
+{
+    // Opened but never swapped in
+    for (std::shared_ptr<PendingReload> const& reload : _pendingReloads)
+        if (reload->loadedPlugin)
+            DiscardPlugin(*reload->loadedPlugin);
+    
+    _pendingReloads.clear();
+    
+    std::vector<std::string> pluginNames = GetLoadedPluginNames();
+    
+    for (std::string const& pluginName : pluginNames)
+        UnloadPlugin(pluginName);
+    
+    // Statements queued while the plugins stopped, pending snapshots are written by the pool before it stops
+    _persistence.Flush();
+    
+    _configWatcher.Stop();
+    _workerPool.Stop();
+}
+
+IPlugin* PluginManager::GetPlugin(std::string const& pluginName)
+{
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    auto it = _loadedPlugins.find(pluginName);
+    if (it != _loadedPlugins.end())
+        return it->second->plugin.get();
+    
+    return nullptr;
+}
+
+std::vector<std::string> PluginManager::GetLoadedPluginNames() const
+{
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    std::vector<std::string> names;
+    names.reserve(_loadedPlugins.size());
+    
+    for (auto const& pair : _loadedPlugins)
+        names.push_back(pair.first);
+    
+    return names;
+}
+
+void PluginManager::RegisterEventHandler(std::string const& pluginName, IEventHandler* handler)
+{
+    std::lock_guard<std::mutex> lock(_eventHandlersMutex);
+    _eventHandlers[pluginName] = handler;
+}
+
+void PluginManager::UnregisterEventHandler(std::string const& pluginName)
+{
+    std::lock_guard<std::mutex> lock(_eventHandlersMutex);
+    _eventHandlers.erase(pluginName);
+}
+
+void PluginManager::RebuildEventTable()
+{
+    struct RankedSubscriber
+    {
+        PluginPriority priority;
+        std::string const* name;
+        PluginEventSubscriber subscriber;
+    };
+    
+    std::vector<RankedSubscriber> ranked;
+    
+    {
+        std::lock_guard<std::mutex> lock(_eventHandlersMutex);
+        ranked.reserve(_eventHandlers.size());
+        
+        for (auto const& pair : _eventHandlers)
+        {
+            auto it = _loadedPlugins.find(pair.first);
+            if (it == _loadedPlugins.end())
+                continue;
+            
+            IPlugin* plugin = it->second->plugin.get();
+            if (plugin->GetState() != PluginState::RUNNING || it->second->stopping)
+                continue;
+            
+            // A handler registered in place of the module's own is called through IEventHandler
+            uint16 staticModule = pair.second == plugin->GetEventHandler() ? it->second->staticModule : 0;
+            ranked.push_back({ plugin->GetInfo().priority, &it->first, { pair.second, plugin, it->second->id, staticModule } });
+        }
+    }
+    
+    // Sort by priority (highest first), by name for a stable order between rebuilds
+    std::sort(ranked.begin(), ranked.end(), [](RankedSubscriber const& a, RankedSubscriber const& b)
+    {
+        if (a.priority != b.priority)
+            return a.priority > b.priority;
+        return *a.name < *b.name;
+    });
+    
+    auto table = std::make_unique<PluginEventTable>();
+    PluginEventMask activeEvents = PLUGIN_EVENT_MASK_NONE;
+    PluginEventMask batchedEvents = PLUGIN_EVENT_MASK_NONE;
+    
+    for (size_t i = 0; i < PLUGIN_EVENT_COUNT; ++i)
+    {
+        PluginEvent event = static_cast<PluginEvent>(i);
+        std::vector<PluginEventSubscriber>& subscribers = table->subscribers[i];
+        std::vector<PluginEventSubscriber>& batchSubscribers = table->batchSubscribers[i];
+        
+        for (RankedSubscriber const& entry : ranked)
+        {
+            PluginInfo const& info = entry.subscriber.plugin->GetInfo();
+            if (!info.SubscribesTo(event))
+                continue;
+            
+            if (info.IsBatched(event))
+                batchSubscribers.push_back(entry.subscriber);
+            else
+                subscribers.push_back(entry.subscriber);
+        }
+        
+        if (!subscribers.empty() || !batchSubscribers.empty())
+            activeEvents |= PluginEventBit(event);
+        
+        if (!batchSubscribers.empty())
+            batchedEvents |= PluginEventBit(event);
+    }
+    
+    // The world tick drives table reclamation and budget accounting, keep it
+    // flowing while any plugin is loaded even if none handles it
+    if (!_loadedPlugins.empty())
+        activeEvents |= PluginEventBit(PluginEvent::WORLD_UPDATE);
+    
+    OpcodeFilter opcodeFilters[PLUGIN_PACKET_DIRECTION_COUNT];
+    for (size_t i = 0; i < PLUGIN_PACKET_DIRECTION_COUNT; ++i)
+        BuildOpcodeTable(*table, static_cast<PluginPacketDirection>(i), opcodeFilters[i]);
+    
+    PluginEventTable const* oldTable = _eventTable.exchange(table.release(), std::memory_order_seq_cst);
+    _activeEvents.store(activeEvents, std::memory_order_relaxed);
+    _batchedEvents.store(batchedEvents, std::memory_order_relaxed);
+    
+    for (size_t i = 0; i < PLUGIN_PACKET_DIRECTION_COUNT; ++i)
+        for (size_t word = 0; word < OPCODE_FILTER_WORDS; ++word)
+            _opcodeFilter[i][word].store(opcodeFilters[i][word], std::memory_order_relaxed);
+    
+    sPluginEpoch->Retire(oldTable);
+}
+
+void PluginManager::BuildOpcodeTable(PluginEventTable& table, PluginPacketDirection direction, OpcodeFilter& filter)
+{
+    size_t const index = static_cast<size_t>(direction);
+    std::vector<PluginEventSubscriber> const& subscribers = table.GetSubscribers(GetPacketEvent(direction));
+    
+    // Opcode set of every subscriber, left empty for subscribers that want all packets
+    std::vector<std::vector<bool>> subscribedOpcodes(subscribers.size());
+    for (size_t i = 0; i < subscribers.size(); ++i)
+    {
+        std::vector<uint16> const& opcodes = subscribers[i].plugin->GetInfo().GetOpcodes(direction);
+        if (opcodes.empty())
+            continue;
+        
+        subscribedOpcodes[i].resize(NUM_MSG_TYPES, false);
+        for (uint16 opcode : opcodes)
+            if (opcode < NUM_MSG_TYPES)
+                subscribedOpcodes[i][opcode] = true;
+    }
+    
+    std::vector<PluginOpcodeSpan>& spans = table.opcodeSpans[index];
+    std::vector<PluginEventSubscriber>& routed = table.opcodeSubscribers[index];
+    spans.resize(NUM_MSG_TYPES + 1);
+    filter.fill(0);
+    
+    for (size_t opcode = 0; opcode <= NUM_MSG_TYPES; ++opcode)
+    {
+        PluginOpcodeSpan& span = spans[opcode];
+        span.offset = static_cast<uint32>(routed.size());
+        
+        for (size_t i = 0; i < subscribers.size(); ++i)
+            if (subscribedOpcodes[i].empty() || (opcode < NUM_MSG_TYPES && subscribedOpcodes[i][opcode]))
+                routed.push_back(subscribers[i]);
+        
+        span.count = static_cast<uint32>(routed.size()) - span.offset;
+        
+        if (span.count && opcode < NUM_MSG_TYPES)
+            filter[opcode >> 6] |= uint64(1) << (opcode & 63);
+    }
+    
+    // Opcodes past the end of the table only reach the catch-all subscribers
+    if (spans[NUM_MSG_TYPES].count)
+        for (size_t opcode = NUM_MSG_TYPES; opcode < 0x10000; ++opcode)
+            filter[opcode >> 6] |= uint64(1) << (opcode & 63);
+}
+
+namespace
+{
+    PluginTraceRing* GetTraceRing()
+    {
+        return PluginTrace::IsEnabled() ? sPluginTrace->GetThreadRing() : nullptr;
+    }
+    
+    // Closes the measurement of one handler call started at start
+    void RecordCall(bool profile, PluginTraceRing* trace, uint16 pluginId, PluginEvent event, uint64 start, uint8 flags = 0)
+    {
+        uint64 end = PluginClock::Now();
+        
+        if (profile)
+            sPluginProfiler->Record(pluginId, event, end - start);
+        
+        if (trace)
+            trace->Push(start, end, pluginId, event, flags);
+    }
+}
+
+template<typename Fn>
+bool PluginManager::InvokeSubscribers(PluginEvent event, PluginEventSubscriber const* subscribers, size_t count, Fn& fn)
+{
+    bool const profile = PluginProfiler::IsEnabled();
+    PluginTraceRing* const trace = GetTraceRing();
+    bool const timed = profile || trace;
+    
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64 start = timed ? PluginClock::Now() : 0;
+        
+        // Filtering events (packets) stop at the first handler that rejects
+        if constexpr (std::is_same_v<std::invoke_result_t<Fn&, IEventHandler*>, bool>)
+        {
+            bool accepted = InvokeHandler(subscribers[i], fn);
+            
+            if (timed)
+                RecordCall(profile, trace, subscribers[i].pluginId, event, start, accepted ? 0 : PluginTraceSpan::FLAG_REJECTED);
+            
+            if (!accepted)
+                return false;
+        }
+        else
+        {
+            InvokeHandler(subscribers[i], fn);
+            
+            if (timed)
+                RecordCall(profile, trace, subscribers[i].pluginId, event, start);
+        }
+    }
+    
+    return true;
+}
+
+template<typename Fn>
+std::invoke_result_t<Fn&, IEventHandler*> PluginManager::InvokeHandler(PluginEventSubscriber const& subscriber, Fn& fn)
+{
+    if constexpr (PluginStaticModules::Count > 0)
+        if (subscriber.staticModule)
+            return PluginStaticModules::Invoke(subscriber.staticModule - 1, subscriber.handler, fn);
+    
+    return fn(subscriber.handler);
+}
+
+template<typename Fn>
+void PluginManager::DispatchUpdate(PluginEvent event, Map* map, uint32 diff, Fn&& fn)
+{
+    uint64 budgetTicks = _tickBudgetTicks.load(std::memory_order_relaxed);
+    if (!budgetTicks)
+    {
+        DispatchEvent(event, [&](auto* handler) { fn(handler, diff); });
+        return;
+    }
+    
+    PluginEpochGuard guard;
+    PluginEventTable const* table = _eventTable.load(std::memory_order_seq_cst);
+    PluginMapContext* context = map ? FindMapContext(map) : nullptr;
+    bool const profile = PluginProfiler::IsEnabled();
+    PluginTraceRing* const trace = GetTraceRing();
+    
+    for (PluginEventSubscriber const& subscriber : table->GetSubscribers(event))
+    {
+        PluginBudgetState& budget = _budgetStates[subscriber.pluginId];
+        bool const exempt = subscriber.plugin->GetInfo().priority == PluginPriority::CRITICAL;
+        
+        // A map without a context has nothing deferred yet
+        uint32 elapsed = diff + (!map || context ? TakeDeferredDiff(budget, subscriber.pluginId, context) : 0);
+        
+        if (!exempt && budget.overBudget.load(std::memory_order_relaxed))
+        {
+            if (map && !context)
+                context = GetMapContext(map);
+            
+            DeferDiff(budget, subscriber.pluginId, context, elapsed);
+            continue;
+        }
+        
+        auto update = [&](auto* handler) { fn(handler, elapsed); };
+        uint64 start = PluginClock::Now();
+        InvokeHandler(subscriber, update);
+        uint64 end = PluginClock::Now();
+        uint64 ticks = end - start;
+        
+        if (profile)
+            sPluginProfiler->Record(subscriber.pluginId, event, ticks);
+        
+        if (trace)
+            trace->Push(start, end, subscriber.pluginId, event);
+        
+        if (budget.usedTicks.fetch_add(ticks, std::memory_order_relaxed) + ticks > budgetTicks && !exempt)
+            budget.overBudget.store(true, std::memory_order_relaxed);
+    }
+}
+
+template<typename Fn>
+bool PluginManager::DispatchEvent(PluginEvent event, Fn&& fn)
+{
+    PluginEpochGuard guard;
+    PluginEventTable const* table = _eventTable.load(std::memory_order_seq_cst);
+    
+    std::vector<PluginEventSubscriber> const& subscribers = table->GetSubscribers(event);
+    return InvokeSubscribers(event, subscribers.data(), subscribers.size(), fn);
+}
+
+template<typename Fn>
+bool PluginManager::DispatchPacket(PluginPacketDirection direction, uint16 opcode, Fn&& fn)
+{
+    PluginEpochGuard guard;
+    PluginEventTable const* table = _eventTable.load(std::memory_order_seq_cst);
+    
+    PluginOpcodeSpan span = table->GetOpcodeSpan(direction, opcode);
+    if (!span.count)
+        return true;
+    
+    PluginEventSubscriber const* subscribers = table->opcodeSubscribers[static_cast<size_t>(direction)].data() + span.offset;
+    return InvokeSubscribers(GetPacketEvent(direction), subscribers, span.count, fn);
+}
+
+namespace
+{
+    ObjectGuid GetGuid(Object const* object)
+    {
+        return object ? object->GetGUID() : ObjectGuid::Empty;
+    }
+    
+    PluginEventRecord MakeEventRecord(PluginEvent event, ObjectGuid source = ObjectGuid::Empty, ObjectGuid target = ObjectGuid::Empty,
+        uint32 entry = 0, uint32 value = 0, uint32 extra = 0)
+    {
+        return { event, source, target, entry, value, extra, 0, 0 };
+    }
+}
+
+void PluginManager::DeliverEventBatches()
+{
+    _eventQueue.Drain(_eventBatches);
+    
+    PluginEpochGuard guard;
+    PluginEventTable const* table = _eventTable.load(std::memory_order_seq_cst);
+    
+    for (PluginEventBatch const& batch : _eventBatches)
+    {
+        if (batch.empty())
+            continue;
+        
+        // Records queued for plugins that were stopped meanwhile are dropped here
+        std::vector<PluginEventSubscriber> const& subscribers = table->batchSubscribers[static_cast<size_t>(batch.GetEvent())];
+        auto deliver = [&](auto* handler) { handler->OnEventBatch(batch); };
+        InvokeSubscribers(batch.GetEvent(), subscribers.data(), subscribers.size(), deliver);
+    }
+}
+
+// Event dispatching implementations
+void PluginManager::OnPlayerLogin(Player* player)
+{
+    DispatchEvent(PluginEvent::PLAYER_LOGIN, [&](auto* handler) { handler->OnPlayerLogin(player); });
+    
+    if (IsEventBatched(PluginEvent::PLAYER_LOGIN))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::PLAYER_LOGIN, player->GetGUID()));
+}
+
+void PluginManager::OnPlayerLogout(Player* player)
+{
+    DispatchEvent(PluginEvent::PLAYER_LOGOUT, [&](auto* handler) { handler->OnPlayerLogout(player); });
+    
+    if (IsEventBatched(PluginEvent::PLAYER_LOGOUT))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::PLAYER_LOGOUT, player->GetGUID()));
+}
+
+void PluginManager::OnPlayerLevelChanged(Player* player, uint8 oldLevel)
+{
+    DispatchEvent(PluginEvent::PLAYER_LEVEL_CHANGED, [&](auto* handler) { handler->OnPlayerLevelChanged(player, oldLevel); });
+    
+    if (IsEventBatched(PluginEvent::PLAYER_LEVEL_CHANGED))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::PLAYER_LEVEL_CHANGED, player->GetGUID(), ObjectGuid::Empty, 0, oldLevel));
+}
+
+void PluginManager::OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg)
+{
+    PluginChatMessage message(msg);
+    OnPlayerChat(player, type, lang, message);
+    
+    if (message.IsModified())
+        msg = message.Release();
+}
+
+void PluginManager::OnPlayerChat(Player* player, uint32 type, uint32 lang, PluginChatMessage& msg)
+{
+    // Rewriters run first, observers and batches see the final message
+    DispatchEvent(PluginEvent::PLAYER_CHAT_REWRITE, [&](auto* handler) { handler->OnPlayerChatRewrite(player, type, lang, msg); });
+    
+    std::string_view text = msg.GetText();
+    DispatchEvent(PluginEvent::PLAYER_CHAT, [&](auto* handler) { handler->OnPlayerChat(player, type, lang, text); });
+    
+    if (IsEventBatched(PluginEvent::PLAYER_CHAT))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::PLAYER_CHAT, player->GetGUID(), ObjectGuid::Empty, 0, type, lang), text.data(), uint32(text.size()));
+}
+
+void PluginManager::OnPlayerKill(Player* killer, Player* killed)
+{
+    DispatchEvent(PluginEvent::PLAYER_KILL, [&](auto* handler) { handler->OnPlayerKill(killer, killed); });
+    
+    if (IsEventBatched(PluginEvent::PLAYER_KILL))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::PLAYER_KILL, GetGuid(killer), GetGuid(killed)));
+}
+
+void PluginManager::OnPlayerKillCreature(Player* killer, Creature* killed)
+{
+    DispatchEvent(PluginEvent::PLAYER_KILL_CREATURE, [&](auto* handler) { handler->OnPlayerKillCreature(killer, killed); });
+    
+    if (IsEventBatched(PluginEvent::PLAYER_KILL_CREATURE))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::PLAYER_KILL_CREATURE, GetGuid(killer), GetGuid(killed), killed ? killed->GetEntry() : 0));
+}
+
+void PluginManager::OnCreatureKill(Creature* killer, Unit* killed)
+{
+    DispatchEvent(PluginEvent::CREATURE_KILL, [&](auto* handler) { handler->OnCreatureKill(killer, killed); });
+    
+    if (IsEventBatched(PluginEvent::CREATURE_KILL))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::CREATURE_KILL, GetGuid(killer), GetGuid(killed), killer ? killer->GetEntry() : 0));
+}
+
+void PluginManager::OnCreatureDeath(Creature* creature, Unit* killer)
+{
+    DispatchEvent(PluginEvent::CREATURE_DEATH, [&](auto* handler) { handler->OnCreatureDeath(creature, killer); });
+    
+    if (IsEventBatched(PluginEvent::CREATURE_DEATH))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::CREATURE_DEATH, creature->GetGUID(), GetGuid(killer), creature->GetEntry()));
+}
+
+void PluginManager::OnCreatureRespawn(Creature* creature)
+{
+    DispatchEvent(PluginEvent::CREATURE_RESPAWN, [&](auto* handler) { handler->OnCreatureRespawn(creature); });
+    
+    if (IsEventBatched(PluginEvent::CREATURE_RESPAWN))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::CREATURE_RESPAWN, creature->GetGUID(), ObjectGuid::Empty, creature->GetEntry()));
+}
+
+void PluginManager::OnGameObjectUse(GameObject* go, Player* player)
+{
+    DispatchEvent(PluginEvent::GAMEOBJECT_USE, [&](auto* handler) { handler->OnGameObjectUse(go, player); });
+    
+    if (IsEventBatched(PluginEvent::GAMEOBJECT_USE))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::GAMEOBJECT_USE, go->GetGUID(), GetGuid(player), go->GetEntry()));
+}
+
+void PluginManager::OnGameObjectDestroyed(GameObject* go, Player* player)
+{
+    DispatchEvent(PluginEvent::GAMEOBJECT_DESTROYED, [&](auto* handler) { handler->OnGameObjectDestroyed(go, player); });
+    
+    if (IsEventBatched(PluginEvent::GAMEOBJECT_DESTROYED))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::GAMEOBJECT_DESTROYED, go->GetGUID(), GetGuid(player), go->GetEntry()));
+}
+
+namespace
+{
+    // Set by SIGUSR2, polled by the world update
+    std::atomic<bool> traceDumpRequested(false);
+    
+    void OnTraceSignal(int /*signal*/)
+    {
+        traceDumpRequested.store(true, std::memory_order_relaxed);
+    }
+}
+
+void PluginManager::OnWorldUpdate(uint32 diff)
+{
+    PluginTraceRing* const trace = GetTraceRing();
+    uint64 const tickStart = trace ? PluginClock::Now() : 0;
+    
+    if (trace && !_traceThreadNamed)
+    {
+        sPluginTrace->SetThreadName("world");
+        _traceThreadNamed = true;
+    }
+    
+    // Free subscriber tables retired since the last tick
+    sPluginEpoch->Reclaim();
+    
+    // Continuations of finished worker tasks
+    _workerPool.ProcessCompletions();
+    
+    // Swap in plugins reloaded in the background
+    ApplyReloads();
+    
+    // Lazy plugins first reached from map or network threads
+    ApplyActivations();
+    
+    _messageBus.Deliver(PluginMessageDelivery::TICK_START);
+    
+    _timers.Advance(diff);
+    
+    // Bounded share of the stale entries of plugin containers
+    _sweeper.Update(uint32(GameTime::GetGameTime()));
+    
+    ApplyConfigChanges();
+    
+    // Commits the statements queued by timers and handlers of the previous tick
+    _persistence.Update(diff);
+    
+    // A new world tick starts, close the budget accounting of the previous one
+    if (_tickBudgetTicks.load(std::memory_order_relaxed))
+        UpdateTickBudgets();
+    
+    DispatchUpdate(PluginEvent::WORLD_UPDATE, nullptr, diff, [&](auto* handler, uint32 elapsed) { handler->OnWorldUpdate(elapsed); });
+    
+    if (IsEventBatched(PluginEvent::WORLD_UPDATE))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::WORLD_UPDATE, ObjectGuid::Empty, ObjectGuid::Empty, 0, diff));
+    
+    DeliverEventBatches();
+    
+    _messageBus.Deliver(PluginMessageDelivery::TICK_END);
+    _messageBus.Deliver(PluginMessageDelivery::WORKER_POOL);
+    
+    if (traceDumpRequested.exchange(false, std::memory_order_relaxed))
+        DumpTrace(_traceDumpSeconds);
+    
+    // Scratch memory of everything the world thread dispatched this tick
+    PluginArena::Thread().Reset();
+    
+    if (trace)
+        trace->Push(tickStart, PluginClock::Now(), PLUGIN_TRACE_CORE_ID, PluginEvent::WORLD_UPDATE);
+}
+
+namespace
+{
+    // Context of the map the calling thread is updating
+    thread_local PluginMapContext* currentMapContext = nullptr;
+    
+    class PluginMapContextScope
+    {
+    public:
+        explicit PluginMapContextScope(PluginMapContext* context) : _previous(currentMapContext) { currentMapContext = context; }
+        ~PluginMapContextScope() { currentMapContext = _previous; }
+    
+    private:
+        PluginMapContext* _previous;
+    };
+}
+
+void IPlugin::OnConfigChanged(std::unique_ptr<PluginConfig> /*config*/)
+{
+}
+
+void PluginManager::WatchPluginConfig(std::string const& pluginName, std::string const& configPath)
+{
+    _configWatcher.Watch(pluginName, configPath);
+    
+    if (!_configWatcher.IsRunning())
+        _configWatcher.Start();
+}
+
+void PluginManager::UnwatchPluginConfig(std::string const& pluginName)
+{
+    _configWatcher.Unwatch(pluginName);
+}
+
+void PluginManager::ApplyConfigChanges()
+{
+    _configWatcher.TakeChanges(_configChanges);
+    if (_configChanges.empty())
+        return;
+    
+    for (PluginConfigChange& change : _configChanges)
+    {
+        // Unloaded or reloaded under the same name since the file was parsed
+        IPlugin* plugin = GetPlugin(change.pluginName);
+        if (!plugin || plugin->GetState() == PluginState::ERROR)
+            continue;
+        
+        TC_LOG_INFO("plugins", "Applying changed configuration of plugin: %s", change.pluginName.c_str());
+        plugin->OnConfigChanged(std::move(change.config));
+    }
+    
+    _configChanges.clear();
+}
+
+PluginMapState* IPlugin::GetMapState(Map* map)
+{
+    return sPluginManager->GetMapState(this, map);
+}
+
+PluginMapState* PluginManager::GetMapState(IPlugin* plugin, Map* map)
+{
+    PluginMapContext* context = currentMapContext;
+    if (context && context->map == map)
+    {
+        std::unique_ptr<PluginMapState>& state = context->states[plugin->_pluginId];
+        if (!state)
+            state = plugin->CreateMapState(map);
+        
+        return state.get();
+    }
+    
+    // Not on the thread updating the map, only existing state is handed out
+    PluginEpochGuard guard;
+    PluginMapContextTable const* table = _mapContextTable.load(std::memory_order_seq_cst);
+    
+    auto itr = table->find(map);
+    return itr != table->end() ? itr->second->states[plugin->_pluginId].get() : nullptr;
+}
+
+PluginMapContext* PluginManager::FindMapContext(Map* map) const
+{
+    PluginMapContext* context = currentMapContext;
+    if (context && context->map == map)
+        return context;
+    
+    // Contexts are only freed by OnMapDestroy, which never runs while the map updates
+    PluginEpochGuard guard;
+    PluginMapContextTable const* table = _mapContextTable.load(std::memory_order_seq_cst);
+    
+    auto itr = table->find(map);
+    return itr != table->end() ? itr->second : nullptr;
+}
+
+PluginMapContext* PluginManager::GetMapContext(Map* map)
+{
+    if (PluginMapContext* context = FindMapContext(map))
+        return context;
+    
+    std::lock_guard<std::mutex> lock(_mapContextsMutex);
+    
+    std::unique_ptr<PluginMapContext>& created = _mapContexts[map];
+    if (!created)
+    {
+        created = std::make_unique<PluginMapContext>(map);
+        _mapContextCount.fetch_add(1, std::memory_order_relaxed);
+        PublishMapContexts();
+    }
+    
+    return created.get();
+}
+
+void PluginManager::PublishMapContexts()
+{
+    auto table = std::make_unique<PluginMapContextTable>();
+    table->reserve(_mapContexts.size());
+    
+    for (auto const& pair : _mapContexts)
+        table->emplace(pair.first, pair.second.get());
+    
+    sPluginEpoch->Retire(_mapContextTable.exchange(table.release(), std::memory_order_seq_cst));
+}
+
+void PluginManager::ReleaseMapStates(uint16 pluginId)
+{
+    std::lock_guard<std::mutex> lock(_mapContextsMutex);
+    
+    for (auto const& pair : _mapContexts)
+    {
+        pair.second->states[pluginId].reset();
+        pair.second->deferredDiffs[pluginId] = 0;
+    }
+    
+    // Maps being destroyed still own states of the plugin until OnMapDestroy gets to them
+    for (PluginMapContext* context : _destroyedMapContexts)
+        context->states[pluginId].reset();
+}
+
+void PluginManager::OnMapDestroy(Map* map)
+{
+    std::unique_ptr<PluginMapContext> context;
+    
+    {
+        std::lock_guard<std::mutex> lock(_mapContextsMutex);
+        
+        auto itr = _mapContexts.find(map);
+        if (itr == _mapContexts.end())
+            return;
+        
+        context = std::move(itr->second);
+        _mapContexts.erase(itr);
+        _mapContextCount.fetch_sub(1, std::memory_order_relaxed);
+        PublishMapContexts();
+        
+        // Still reachable by ReleaseMapStates, an unload in between must not leave states behind
+        _destroyedMapContexts.push_back(context.get());
+    }
+    
+    // Readers that found the context through the old table may still hold its states.
+    // Waiting outside the lock, a dispatch creating a context would block on it.
+    sPluginEpoch->Synchronize();
+    
+    // Plugin state destructors run now, while the owning plugins are guaranteed to be loaded
+    std::lock_guard<std::mutex> lock(_mapContextsMutex);
+    
+    _destroyedMapContexts.erase(std::find(_destroyedMapContexts.begin(), _destroyedMapContexts.end(), context.get()));
+    
+    for (std::unique_ptr<PluginMapState>& state : context->states)
+        state.reset();
+}
+
+void PluginManager::OnMapUpdate(Map* map, uint32 diff)
+{
+    PluginTraceRing* const trace = GetTraceRing();
+    uint64 const tickStart = trace ? PluginClock::Now() : 0;
+    
+    // Maps get a context on first use (GetMapState, a combat record, a deferred diff),
+    // updating a map no plugin keeps state for allocates and publishes nothing
+    PluginMapContext* context = FindMapContext(map);
+    PluginMapContextScope scope(context);
+    
+    if (HasEventSubscribers(PluginEvent::MAP_UPDATE))
+        DispatchUpdate(PluginEvent::MAP_UPDATE, map, diff, [&](auto* handler, uint32 elapsed) { handler->OnMapUpdate(map, elapsed); });
+    
+    if (IsEventBatched(PluginEvent::MAP_UPDATE))
+        _eventQueue.Push(MakeEventRecord(PluginEvent::MAP_UPDATE, ObjectGuid::Empty, ObjectGuid::Empty, map->GetId(), diff, map->GetInstanceId()));
+    
+    // Dispatch may have created the context, records always do
+    if (!context)
+        context = FindMapContext(map);
+    
+    if (context && !context->combatLog.empty())
+    {
+        PluginCombatLog& combatLog = context->combatLog;
+        combatLog.SetDuration(diff);
+        DispatchEvent(PluginEvent::COMBAT_LOG, [&](auto* handler) { handler->OnCombatLog(map, combatLog); });
+        combatLog.Clear();
+    }
+    
+    PluginArena::Thread().Reset();
+    
+    if (trace)
+        trace->Push(tickStart, PluginClock::Now(), PLUGIN_TRACE_CORE_ID, PluginEvent::MAP_UPDATE);
+}
+
+void PluginManager::RecordCombat(PluginCombatKind kind, Unit* source, Unit* target, uint32 spellId, uint32 amount)
+{
+    Unit* unit = target ? target : source;
+    Map* map = unit ? unit->FindMap() : nullptr;
+    if (!map)
+        return;
+    
+    GetMapContext(map)->combatLog.Record(kind, GetGuid(source).GetRawValue(), GetGuid(target).GetRawValue(), spellId, amount);
+}
+
+bool PluginManager::OnPacketReceive(WorldSession* session, WorldPacket& packet)
+{
+    // Packets are also handled on network threads, which never reset their arena
+    PluginArenaScope scratch;
+    return DispatchPacket(PluginPacketDirection::RECEIVE, packet.GetOpcode(), [&](auto* handler) { return handler->OnPacketReceive(session, packet); });
+}
+
+bool PluginManager::OnPacketSend(WorldSession* session, WorldPacket const& packet)
+{
+    PluginArenaScope scratch;
+    return DispatchPacket(PluginPacketDirection::SEND, packet.GetOpcode(), [&](auto* handler) { return handler->OnPacketSend(session, packet); });
+}
+
+void PluginManager::OnServerStart()
+{
+    DispatchEvent(PluginEvent::SERVER_START, [&](auto* handler) { handler->OnServerStart(); });
+}
+
+void PluginManager::OnServerStop()
+{
+    DispatchEvent(PluginEvent::SERVER_STOP, [&](auto* handler) { handler->OnServerStop(); });
+}
+
+void PluginManager::OnConfigReload()
+{
+    LoadBudgetSettings();
+    LoadPersistenceSettings();
+    LoadSweeperSettings();
+    
+    DispatchEvent(PluginEvent::CONFIG_RELOAD, [&](auto* handler) { handler->OnConfigReload(); });
+}
+
+void PluginManager::SetProfilingEnabled(bool enabled)
+{
+    sPluginProfiler->SetEnabled(enabled);
+}
+
+bool PluginManager::IsProfilingEnabled() const
+{
+    return PluginProfiler::IsEnabled();
+}
+
+std::vector<PluginPerfStats> PluginManager::GetPerformanceStats() const
+{
+    std::vector<PluginPerfStats> stats;
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    for (auto const& pair : _loadedPlugins)
+    {
+        for (size_t i = 0; i < PLUGIN_EVENT_COUNT; ++i)
+        {
+            PluginEvent event = static_cast<PluginEvent>(i);
+            PluginLatencySnapshot latency = sPluginProfiler->GetSnapshot(pair.second->id, event);
+            if (latency.calls)
+                stats.push_back({ pair.first, event, latency });
+        }
+    }
+    
+    // Most expensive first
+    std::sort(stats.begin(), stats.end(), [](PluginPerfStats const& a, PluginPerfStats const& b)
+    {
+        return a.latency.totalNanoseconds > b.latency.totalNanoseconds;
+    });
+    
+    return stats;
+}
+
+void PluginManager::ResetPerformanceStats()
+{
+    sPluginProfiler->Reset();
+}
+
+void PluginBudgetState::Reset()
+{
+    usedTicks.store(0, std::memory_order_relaxed);
+    overBudget.store(false, std::memory_order_relaxed);
+    strikes = 0;
+    deferredWorldDiff = 0;
+}
+
+void PluginManager::LoadBudgetSettings()
+{
+    uint32 budgetMicroseconds = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.TickBudget", "0").c_str(), nullptr, 10));
+    uint32 maxStrikes = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.TickBudget.MaxStrikes", "10").c_str(), nullptr, 10));
+    
+    _tickBudgetMaxStrikes = std::max<uint32>(maxStrikes, 1);
+    _tickBudgetTicks.store(budgetMicroseconds ? PluginClock::FromNanoseconds(uint64(budgetMicroseconds) * 1000) : 0, std::memory_order_relaxed);
+    
+    if (budgetMicroseconds)
+        TC_LOG_INFO("plugins", "Plugin tick budget: %u us per plugin, %u strikes before a plugin is disabled", budgetMicroseconds, _tickBudgetMaxStrikes);
+}
+
+void PluginManager::LoadPersistenceSettings()
+{
+    uint32 flushInterval = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Persistence.FlushInterval", "1000").c_str(), nullptr, 10));
+    uint32 batchSize = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Persistence.BatchSize", "200").c_str(), nullptr, 10));
+    
+    _persistence.Configure(flushInterval, batchSize);
+}
+
+void PluginManager::LoadMessageBusSettings()
+{
+    uint32 poolSize = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.MessageBus.PoolSize", "16384").c_str(), nullptr, 10));
+    uint32 queueSize = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.MessageBus.QueueSize", "1024").c_str(), nullptr, 10));
+    
+    // The pool is only allocated once, a changed pool size takes effect after a restart
+    _messageBus.Start(poolSize, queueSize);
+}
+
+void PluginManager::LoadSweeperSettings()
+{
+    uint32 budget = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Sweeper.Budget", std::to_string(PluginSweeper::DEFAULT_BUDGET)).c_str(), nullptr, 10));
+    
+    _sweeper.SetBudget(budget);
+}
+
+void PluginManager::LoadTraceSettings()
+{
+    bool enabled = std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Trace", "1").c_str(), nullptr, 10) != 0;
+    uint32 capacity = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Trace.BufferSize", std::to_string(PluginTrace::DEFAULT_CAPACITY)).c_str(), nullptr, 10));
+    
+    _traceDirectory = sPluginConfigManager->GetGlobalSetting("Plugins.Trace.Directory", "");
+    _traceDumpSeconds = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Trace.DumpSeconds", "10").c_str(), nullptr, 10));
+    
+    sPluginTrace->SetCapacity(capacity);
+    sPluginTrace->SetEnabled(enabled);
+
+#ifndef _WIN32
+    if (enabled)
+        std::signal(SIGUSR2, &OnTraceSignal);
+#endif
+}
+
+std::string PluginManager::DumpTrace(uint32 seconds)
+{
+    if (!PluginTrace::IsEnabled())
+        return {};
+    
+    auto snapshot = std::make_shared<PluginTrace::Snapshot>();
+    
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        for (auto const& pair : _loadedPlugins)
+            snapshot->pluginNames[pair.second->id] = pair.first;
+    }
+    
+    std::string fileName = "plugin-trace-" + std::to_string(std::time(nullptr)) + ".json";
+    std::string filePath = _traceDirectory.empty() ? fileName : (std::filesystem::path(_traceDirectory) / fileName).string();
+    uint32 milliseconds = seconds * 1000;
+    
+    // Copying the rings and formatting take a while for large buffers, keep both off the world thread
+    _workerPool.Submit(nullptr, [snapshot, filePath, milliseconds]()
+    {
+        sPluginTrace->Collect(milliseconds, *snapshot);
+        
+        std::string error;
+        if (!PluginTrace::WriteChromeTrace(filePath, *snapshot, error))
+        {
+            TC_LOG_ERROR("plugins", "%s", error.c_str());
+            return;
+        }
+        
+        TC_LOG_INFO("plugins", "Wrote plugin trace %s (%u spans)", filePath.c_str(), uint32(snapshot->spans.size()));
+    });
+    
+    return filePath;
+}
+
+void PluginManager::OpenMetrics()
+{
+    std::string filePath = sPluginConfigManager->GetGlobalSetting("Plugins.Metrics.File", "");
+    uint32 capacity = uint32(std::strtoul(sPluginConfigManager->GetGlobalSetting("Plugins.Metrics.Capacity", std::to_string(PluginMetricsRegistry::DEFAULT_CAPACITY)).c_str(), nullptr, 10));
+    
+    // The region is created once, later calls (LoadAllPlugins after a shutdown) keep it
+    sPluginMetrics->Open(filePath, capacity);
+}
+
+uint32 PluginManager::TakeDeferredDiff(PluginBudgetState& budget, uint16 pluginId, PluginMapContext* context)
+{
+    uint32& deferred = context ? context->deferredDiffs[pluginId] : budget.deferredWorldDiff;
+    uint32 diff = deferred;
+    deferred = 0;
+    return diff;
+}
+
+void PluginManager::DeferDiff(PluginBudgetState& budget, uint16 pluginId, PluginMapContext* context, uint32 diff)
+{
+    if (context)
+        context->deferredDiffs[pluginId] = diff;
+    else
+        budget.deferredWorldDiff = diff;
+}
+
+void PluginManager::UpdateTickBudgets()
+{
+    PluginArenaVector<uint16> violators;
+    
+    for (uint16 pluginId = 0; pluginId < PLUGIN_MAX_IDS; ++pluginId)
+    {
+        PluginBudgetState& budget = _budgetStates[pluginId];
+        
+        if (budget.overBudget.exchange(false, std::memory_order_relaxed))
+        {
+            if (++budget.strikes >= _tickBudgetMaxStrikes)
+                violators.push_back(pluginId);
+        }
+        else if (budget.strikes)
+            --budget.strikes;
+        
+        budget.usedTicks.store(0, std::memory_order_relaxed);
+    }
+    
+    if (violators.empty())
+        return;
+    
+    std::vector<std::string> pluginNames;
+    
+    {
+        std::lock_guard<std::mutex> lock(_pluginsMutex);
+        
+        for (auto const& pair : _loadedPlugins)
+        {
+            LoadedPlugin& loadedPlugin = *pair.second;
+            if (std::find(violators.begin(), violators.end(), loadedPlugin.id) == violators.end())
+                continue;
+            
+            if (loadedPlugin.plugin->GetState() != PluginState::RUNNING)
+                continue;
+            
+            TC_LOG_WARN("plugins", "Plugin %s exceeded its tick budget %u times, disabling it", pair.first.c_str(), _budgetStates[loadedPlugin.id].strikes);
+            pluginNames.push_back(pair.first);
+        }
+    }
+    
+    // Stopped like StopPlugin() does so its timers, interfaces and subscriptions go too,
+    // called from OnWorldUpdate outside any dispatch so the synchronize is allowed here
+    std::vector<IPlugin*> stopped = StopPlugins(pluginNames);
+    
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    for (IPlugin* plugin : stopped)
+    {
+        plugin->OnError();
+        
+        for (auto const& pair : _loadedPlugins)
+            if (pair.second->plugin.get() == plugin)
+                _budgetStates[pair.second->id].Reset();
+    }
+}
+
+void PluginManager::BuildDependencyGraph(DependencyGraph& graph) const
+{
+    std::lock_guard<std::mutex> lock(_pluginsMutex);
+    
+    graph.names.reserve(_loadedPlugins.size());
+    for (auto const& pair : _loadedPlugins)
+        graph.names.push_back(pair.first);
+    
+    // Stable wave order regardless of hash map iteration order
+    std::sort(graph.names.begin(), graph.names.end());
+    
+    size_t count = graph.names.size();
+    graph.plugins.resize(count);
+    graph.dependents.assign(count, {});
+    graph.pendingDependencies.assign(count, 0);
+    graph.blocked.assign(count, false);
+    graph.missingDependencies.assign(count, {});
+    
+    std::unordered_map<std::string_view, uint32> indices;
+    indices.reserve(count);
+    
+    for (uint32 i = 0; i < count; ++i)
+    {
+        indices.emplace(graph.names[i], i);
+        graph.plugins[i] = _loadedPlugins.find(graph.names[i])->second->plugin.get();
+    }
+    
+    for (uint32 i = 0; i < count; ++i)
+    {
+        for (std::string const& dependency : graph.plugins[i]->GetDependencies())
+        {
+            auto itr = indices.find(dependency);
+            if (itr == indices.end())
+            {
+                graph.blocked[i] = true;
+                if (graph.missingDependencies[i].empty())
+                    graph.missingDependencies[i] = dependency;
+                continue;
+            }
+            
+            graph.dependents[itr->second].push_back(i);
+            ++graph.pendingDependencies[i];
+        }
+    }
+}
+
+template<typename Fn>
+void PluginManager::ForEachDependencyWave(DependencyGraph& graph, Fn&& processWave)
+{
+    std::vector<uint32> wave;
+    std::vector<uint32> nextWave;
+    std::vector<uint32> skipped;
+    std::vector<bool> succeeded;
+    
+    // Runs once per plugin, when its last dependency has been processed
+    auto resolve = [&](uint32 index)
+    {
+        if (graph.blocked[index])
+            skipped.push_back(index);
+        else
+            nextWave.push_back(index);
+    };
+    
+    auto release = [&](uint32 index, bool success)
+    {
+        for (uint32 dependent : graph.dependents[index])
+        {
+            if (!success)
+                graph.blocked[dependent] = true;
+            
+            if (--graph.pendingDependencies[dependent] == 0)
+                resolve(dependent);
+        }
+    };
+    
+    for (uint32 i = 0; i < graph.names.size(); ++i)
+        if (graph.pendingDependencies[i] == 0)
+            resolve(i);
+    
+    for (;;)
+    {
+        // Skipped plugins block their dependents in turn
+        while (!skipped.empty())
+        {
+            uint32 index = skipped.back();
+            skipped.pop_back();
+            release(index, false);
+        }
+        
+        if (nextWave.empty())
+            break;
+        
+        wave.swap(nextWave);
+        nextWave.clear();
+        
+        succeeded.assign(wave.size(), false);
+        processWave(static_cast<std::vector<uint32> const&>(wave), succeeded);
+        
+        for (size_t i = 0; i < wave.size(); ++i)
+            release(wave[i], succeeded[i]);
+    }
+    
+    // Plugins still waiting on a dependency are part of or depend on a cycle
+}
+
+std::vector<std::vector<std::string>> PluginManager::GetInitializationWaves()
+{
+    DependencyGraph graph;
+    BuildDependencyGraph(graph);
+    
+    std::vector<std::vector<std::string>> waves;
+    
+    ForEachDependencyWave(graph, [&graph, &waves](std::vector<uint32> const& wave, std::vector<bool>& succeeded)
+    {
+        std::vector<std::string>& names = waves.emplace_back();
+        names.reserve(wave.size());
+        
+        for (size_t i = 0; i < wave.size(); ++i)
+        {
+            names.push_back(graph.names[wave[i]]);
+            succeeded[i] = true;
+        }
+    });
+    
+    return waves;
+}
+
+std::vector<std::string> PluginManager::GetPluginLoadOrder()
+{
+    std::vector<std::string> loadOrder;
+    
+    for (std::vector<std::string>& wave : GetInitializationWaves())
+        std::move(wave.begin(), wave.end(), std::back_inserter(loadOrder));
+    
+    return loadOrder;
 }
 
 bool PluginManager::CheckPluginDependencies(std::string const& pluginName)
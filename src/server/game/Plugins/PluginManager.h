@@ -19,13 +19,33 @@
 #define TRINITY_PLUGIN_MANAGER_H
 
 #include "IPlugin.h"
+#include "PluginArena.h"
+#include "PluginCombatLog.h"
+#include "PluginConfigWatcher.h"
+#include "PluginInterface.h"
+#include "PluginEventQueue.h"
+#include "PluginManifest.h"
+#include "PluginMessageBus.h"
+#include "PluginMetrics.h"
+#include "PluginPersistence.h"
+#include "PluginProfiler.h"
+#include "PluginSweeper.h"
+#include "PluginTimerWheel.h"
+#include "PluginTrace.h"
+#include "PluginWorkerPool.h"
 #include "Define.h"
+#include <algorithm>
+#include <array>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
+#include <bitset>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <functional>
+#include <type_traits>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -41,25 +61,132 @@ struct LoadedPlugin
     std::string filePath;
     PluginCreateFunc createFunc;
     PluginDestroyFunc destroyFunc;
+    uint16 id;
+    uint16 staticModule;        // 1 based index into PluginStaticModules, 0 for plugins opened from a library
+    bool lazy;                  // plugin is a PluginLazyStub, filePath is opened on activation
+    bool reloading;             // ReloadPlugin is opening a new instance in the background
+    bool stopping;              // out of the event table, Stop() runs once no dispatch can be inside it
+    std::string libraryCopy;    // Windows only, copy mapped in place of filePath, deleted once freed
     
-    LoadedPlugin() : handle(nullptr), createFunc(nullptr), destroyFunc(nullptr) { }
+    LoadedPlugin() : handle(nullptr), createFunc(nullptr), destroyFunc(nullptr), id(0), staticModule(0), lazy(false), reloading(false), stopping(false) { }
+};
+
+struct PluginEventSubscriber
+{
+    IEventHandler* handler;
+    IPlugin* plugin;
+    uint16 pluginId;
+    uint16 staticModule;        // see LoadedPlugin, handler is the module's own GetEventHandler()
+};
+
+struct PluginOpcodeSpan
+{
+    uint32 offset;
+    uint32 count;
+};
+
+/*
+ * Immutable snapshot of the running event handlers, one priority-sorted
+ * subscriber array per event. A new table is built whenever a plugin is
+ * initialized, started, stopped or unloaded and published with an atomic
+ * pointer swap; dispatch threads read it inside a PluginEpochGuard and the
+ * old table is reclaimed once no dispatch can still be using it.
+ */
+struct PluginEventTable
+{
+    std::array<std::vector<PluginEventSubscriber>, PLUGIN_EVENT_COUNT> subscribers;
+    std::array<std::vector<PluginEventSubscriber>, PLUGIN_EVENT_COUNT> batchSubscribers;
+    
+    // Packet routing: opcodeSpans[direction][opcode] selects a range of opcodeSubscribers[direction].
+    // The extra last span holds the catch-all subscribers for opcodes past the end of the table.
+    std::array<std::vector<PluginOpcodeSpan>, PLUGIN_PACKET_DIRECTION_COUNT> opcodeSpans;
+    std::array<std::vector<PluginEventSubscriber>, PLUGIN_PACKET_DIRECTION_COUNT> opcodeSubscribers;
+    
+    std::vector<PluginEventSubscriber> const& GetSubscribers(PluginEvent event) const
+    {
+        return subscribers[static_cast<size_t>(event)];
+    }
+    
+    PluginOpcodeSpan GetOpcodeSpan(PluginPacketDirection direction, uint16 opcode) const
+    {
+        std::vector<PluginOpcodeSpan> const& spans = opcodeSpans[static_cast<size_t>(direction)];
+        return spans[std::min<size_t>(opcode, spans.size() - 1)];
+    }
+};
+
+/*
+ * Time spent by one plugin in world and map update handlers during the
+ * current world tick. Once usedTicks passes the configured budget the
+ * plugin's remaining update calls for this tick are skipped and their diff is
+ * handed to the next call, so no elapsed time is lost. Ticks that end over
+ * budget add a strike, clean ticks remove one; too many strikes put the
+ * plugin into PluginState::ERROR.
+ */
+struct alignas(64) PluginBudgetState
+{
+    std::atomic<uint64> usedTicks{ 0 };         // world and map update threads
+    std::atomic<bool> overBudget{ false };
+    uint32 strikes = 0;                         // world thread only
+    uint32 deferredWorldDiff = 0;               // world thread only, map diffs live in PluginMapContext
+    
+    void Reset();
+};
+
+/*
+ * Plugin data owned by one map. A map is updated by a single map update
+ * thread at a time, so the thread running OnMapUpdate for the map has
+ * exclusive access and needs no locking.
+ */
+struct PluginMapContext
+{
+    explicit PluginMapContext(Map* m) : map(m) { deferredDiffs.fill(0); }
+    
+    Map* map;
+    std::array<std::unique_ptr<PluginMapState>, PLUGIN_MAX_IDS> states;
+    std::array<uint32, PLUGIN_MAX_IDS> deferredDiffs;  // tick budget, see PluginBudgetState
+    PluginCombatLog combatLog;                          // delivered and cleared by OnMapUpdate
+};
+
+typedef std::unordered_map<Map const*, PluginMapContext*> PluginMapContextTable;
+
+struct PluginPerfStats
+{
+    std::string pluginName;
+    PluginEvent event;
+    PluginLatencySnapshot latency;
 };
 
 class TC_GAME_API PluginManager
 {
 public:
-    static PluginManager* Instance();
+    // No lock once the manager exists, hook sites pay a single load
+    static PluginManager* Instance()
+    {
+        PluginManager* instance = _instance.load(std::memory_order_acquire);
+        return instance ? instance : CreateInstance();
+    }
     
     ~PluginManager();
     
     // Plugin loading/unloading
     bool LoadPlugin(std::string const& filePath);
     bool UnloadPlugin(std::string const& pluginName);
+    
+    // Hot reload
+    // Opens the plugin's library again on a pool worker and swaps the new
+    // instance in during a later world update: the old handlers are withdrawn,
+    // running dispatches are waited for, state moves over through
+    // IPlugin::ExportState/ImportState and the new handlers are published with
+    // a single table rebuild. True once the reload is under way; the old
+    // instance keeps running if the new one fails to open or initialize.
+    // Like UnloadPlugin, must not race an unload of the same plugin.
     bool ReloadPlugin(std::string const& pluginName);
     
     // Plugin management
     bool InitializePlugin(std::string const& pluginName);
     bool StartPlugin(std::string const& pluginName);
+    // Like UnloadPlugin, waits for dispatches still inside the plugin before Stop(),
+    // so must not be called from a plugin event handler.
     bool StopPlugin(std::string const& pluginName);
     
     // Bulk operations
@@ -76,14 +203,46 @@ public:
     bool IsPluginLoaded(std::string const& pluginName) const;
     
     // Event system
+    // Handlers only take part in dispatch after the next table rebuild,
+    // which happens on plugin initialize, start, stop and unload.
     void RegisterEventHandler(std::string const& pluginName, IEventHandler* handler);
     void UnregisterEventHandler(std::string const& pluginName);
     
+    // Cheap check used by the PLUGIN_HOOK_* macros to skip events nobody listens to
+    static bool HasEventSubscribers(PluginEvent event)
+    {
+        return (_activeEvents.load(std::memory_order_relaxed) & PluginEventBit(event)) != 0;
+    }
+    
+    static bool HasEventSubscribers(PluginEventMask events)
+    {
+        return (_activeEvents.load(std::memory_order_relaxed) & events) != 0;
+    }
+    
+    static bool IsEventBatched(PluginEvent event)
+    {
+        return (_batchedEvents.load(std::memory_order_relaxed) & PluginEventBit(event)) != 0;
+    }
+    
+    // Same for packet hooks, filtered by opcode with a single bitmap load
+    static bool HasPacketSubscribers(PluginPacketDirection direction, uint16 opcode)
+    {
+        uint64 word = _opcodeFilter[static_cast<size_t>(direction)][opcode >> 6].load(std::memory_order_relaxed);
+        return ((word >> (opcode & 63)) & 1) != 0;
+    }
+    
+    // Lets PLUGIN_HOOK_MAP_DESTROY skip maps no plugin ever touched
+    static bool HasMapContexts()
+    {
+        return _mapContextCount.load(std::memory_order_relaxed) != 0;
+    }
+    
     // Event dispatching
     void OnPlayerLogin(Player* player);
     void OnPlayerLogout(Player* player);
     void OnPlayerLevelChanged(Player* player, uint8 oldLevel);
     void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg);
+    void OnPlayerChat(Player* player, uint32 type, uint32 lang, PluginChatMessage& msg);
     void OnPlayerKill(Player* killer, Player* killed);
     void OnPlayerKillCreature(Player* killer, Creature* killed);
     void OnCreatureKill(Creature* killer, Unit* killed);
@@ -93,55 +252,279 @@ public:
     void OnGameObjectDestroyed(GameObject* go, Player* player);
     void OnWorldUpdate(uint32 diff);
     void OnMapUpdate(Map* map, uint32 diff);
+    void OnMapDestroy(Map* map);
+    
+    // Appends to the combat log of the map the target (or source) is on, must
+    // run on the thread updating that map. Called by the PluginHooks combat hooks.
+    void RecordCombat(PluginCombatKind kind, Unit* source, Unit* target, uint32 spellId, uint32 amount);
     bool OnPacketReceive(WorldSession* session, WorldPacket& packet);
     bool OnPacketSend(WorldSession* session, WorldPacket const& packet);
     void OnServerStart();
     void OnServerStop();
     void OnConfigReload();
     
+    // Profiling
+    // Handler latencies are only recorded while profiling is enabled
+    void SetProfilingEnabled(bool enabled);
+    bool IsProfilingEnabled() const;
+    std::vector<PluginPerfStats> GetPerformanceStats() const;
+    void ResetPerformanceStats();
+    
+    // Tracing, global settings "Plugins.Trace" (on by default), "Plugins.Trace.BufferSize"
+    // (spans kept per thread), "Plugins.Trace.Directory" and "Plugins.Trace.DumpSeconds"
+    // (window of a SIGUSR2 dump). Writes the spans of the last seconds as a Chrome
+    // trace on the worker pool, returns the file name or an empty string if tracing is off.
+    std::string DumpTrace(uint32 seconds);
+    
+    // Tick budget, read from the PluginConfigManager global settings
+    // "Plugins.TickBudget" (microseconds per plugin per world tick, 0 disables)
+    // and "Plugins.TickBudget.MaxStrikes"
+    void LoadBudgetSettings();
+    void LoadPersistenceSettings();
+    void LoadMessageBusSettings();
+    void LoadSweeperSettings();
+    // "Plugins.Metrics.File" (empty keeps the metrics in process memory) and "Plugins.Metrics.Capacity"
+    void OpenMetrics();
+    void LoadTraceSettings();
+    
+    // Per map plugin state, see IPlugin::GetMapState
+    PluginMapState* GetMapState(IPlugin* plugin, Map* map);
+    
+    // Background work
+    // Sized by the global setting "Plugins.WorkerThreads" (0 = half the hardware threads)
+    PluginWorkerPool& GetWorkerPool() { return _workerPool; }
+    
+    // Periodic and one-shot callbacks on the world thread, advanced once per world update
+    PluginTimerWheel& GetTimers() { return _timers; }
+    
+    // Incremental cleanup of plugin containers, a bounded number of entries per world
+    // update. Global setting "Plugins.Sweeper.Budget" (entries per tick, all containers)
+    PluginSweeper& GetSweeper() { return _sweeper; }
+    
+    // Typed messages between plugins. Global settings "Plugins.MessageBus.PoolSize"
+    // (messages in flight) and "Plugins.MessageBus.QueueSize" (per subscription)
+    PluginMessageBus& GetMessageBus() { return _messageBus; }
+    
+    // Write-behind database batches and snapshot files, flushed during world updates.
+    // Global settings "Plugins.Persistence.FlushInterval" (milliseconds) and
+    // "Plugins.Persistence.BatchSize" (statements per transaction)
+    PluginPersistence& GetPersistence() { return _persistence; }
+    
+    // Config file hot reload
+    // The file is watched from a background thread, a changed file is parsed there
+    // and handed to IPlugin::OnConfigChanged during the next world update
+    void WatchPluginConfig(std::string const& pluginName, std::string const& configPath);
+    void UnwatchPluginConfig(std::string const& pluginName);
+    
+    // Module manifest generated at build time from the module.json files.
+    // Read from the global setting "Plugins.Manifest", defaults to
+    // modules.manifest in the plugin directory.
+    PluginManifest const& GetManifest() const { return _manifest; }
+    
     // Configuration
     void SetPluginDirectory(std::string const& directory) { _pluginDirectory = directory; }
     std::string const& GetPluginDirectory() const { return _pluginDirectory; }
     
     // Plugin communication
+    // Activates a lazy plugin that declares the interface
     void* GetPluginInterface(std::string const& pluginName, std::string const& interfaceName);
     
+    // Lazy activation
+    // Opens, initializes and starts a lazy module in place of its stub. Called
+    // by the stub on first use, true once the plugin is active. On the world
+    // thread this happens inline; any other thread only queues the activation
+    // for the next world update and gets false, the event that triggered it is
+    // dropped. Must not be reached from code holding the manager lock
+    // (IPlugin::Start/Stop). A plugin pointer obtained before activation
+    // points at the stub and is only valid inside a PluginEpochGuard.
+    bool ActivatePlugin(std::string const& pluginName);
+    
+    // The thread that created the manager, which runs the world updates
+    bool IsWorldThread() const { return std::this_thread::get_id() == _worldThread; }
+    
+    // Activates the lazy plugin declaring interfaceName in its manifest entry, if any.
+    // Called by empty PluginInterfaceHandles.
+    void ActivateInterfaceProvider(std::string const& interfaceName);
+    
     // Dependency management
     bool CheckPluginDependencies(std::string const& pluginName);
+    
+    // Loaded plugins grouped so that each wave only depends on earlier waves.
+    // Plugins with missing or circular dependencies are left out.
+    std::vector<std::vector<std::string>> GetInitializationWaves();
     std::vector<std::string> GetPluginLoadOrder();
     
     // Error handling
     std::string GetLastError() const { return _lastError; }
-    
+
 private:
     PluginManager();
     
     // Internal plugin operations
-    bool LoadPluginLibrary(std::string const& filePath, LoadedPlugin& loadedPlugin);
+    // OpenPlugin and InitializePluginInstance touch no manager state and run on
+    // pool workers during LoadAllPlugins and InitializeAllPlugins
+    // libraryPath, when set, is mapped instead of filePath (see ReloadPlugin)
+    std::unique_ptr<LoadedPlugin> OpenPlugin(std::string const& filePath, std::string& error, std::string const& libraryPath = std::string());
+    bool RegisterPlugin(std::unique_ptr<LoadedPlugin> loadedPlugin, std::string& error); // caller must hold _pluginsMutex
+    bool InitializePluginInstance(std::string const& pluginName, IPlugin* plugin);
+    bool LoadPluginLibrary(std::string const& filePath, LoadedPlugin& loadedPlugin, std::string& error);
     void UnloadPluginLibrary(LoadedPlugin& loadedPlugin);
-    bool ValidatePlugin(IPlugin* plugin);
+    bool ValidatePlugin(IPlugin* plugin, std::string& error);
+    bool CheckManifest(std::string const& filePath, PluginInfo const& info, std::string& error) const;
+    int32 FindManifestModule(std::string const& filePath) const;
+    bool RegisterLazyPlugin(std::string const& filePath, std::string& error); // caller must hold _pluginsMutex
+    
+    // Modules linked into the server, see PluginStaticModules.h. They are planned and
+    // registered under the pseudo path PLUGIN_STATIC_MODULE_PREFIX + plugin name.
+    std::unique_ptr<LoadedPlugin> OpenStaticPlugin(std::string const& filePath, uint16 index, std::unique_ptr<IPlugin> plugin, std::string& error);
+    static bool IsStaticModulePath(std::string const& filePath);
+    
+    // Orders filePaths by manifest load order and drops modules that cannot be loaded
+    void PlanManifestLoad(std::vector<std::string>& filePaths) const;
+    
+    // Hot reload, world thread
+    struct PendingReload
+    {
+        std::string pluginName;
+        IPlugin const* oldPlugin;                   // instance the reload was requested for
+        std::unique_ptr<LoadedPlugin> loadedPlugin; // null if opening failed
+        std::string error;
+    };
+    
+    void ApplyReloads();
+    bool QueueActivation(std::string const& pluginName);
+    void ApplyActivations();
+    void ApplyReload(PendingReload& reload);
+    void DiscardPlugin(LoadedPlugin& loadedPlugin);
+    
+    // Global setting "Plugins.ParallelStartup", 0 loads and initializes plugins one at a time
+    bool IsParallelStartupEnabled() const;
+    void StartWorkerPool();
     
     // Dependency resolution
-    bool ResolveDependencies(std::string const& pluginName, std::vector<std::string>& loadOrder);
-    bool HasCircularDependency(std::string const& pluginName, std::vector<std::string> const& visited);
+    // Plugins are nodes indexed by sorted name, dependents holds the reverse dependency edges
+    struct DependencyGraph
+    {
+        std::vector<std::string> names;
+        std::vector<IPlugin*> plugins;
+        std::vector<std::vector<uint32>> dependents;
+        std::vector<uint32> pendingDependencies;    // still > 0 after ForEachDependencyWave for cyclic plugins
+        std::vector<bool> blocked;                  // a dependency is missing or failed
+        std::vector<std::string> missingDependencies;
+    };
+    
+    void BuildDependencyGraph(DependencyGraph& graph) const;
+    // Kahn's algorithm, O(V + E). processWave(wave, succeeded) fills succeeded for every
+    // plugin of the wave, dependents of failed plugins are skipped.
+    template<typename Fn>
+    static void ForEachDependencyWave(DependencyGraph& graph, Fn&& processWave);
     
     // Event handler management
-    std::vector<IEventHandler*> GetEventHandlersByPriority();
+    void RebuildEventTable(); // caller must hold _pluginsMutex
+    std::vector<IPlugin*> StopPlugins(std::vector<std::string> const& pluginNames); // caller must not hold _pluginsMutex
+    template<typename Fn>
+    bool DispatchEvent(PluginEvent event, Fn&& fn);
+    template<typename Fn>
+    bool DispatchPacket(PluginPacketDirection direction, uint16 opcode, Fn&& fn);
+    // Only update events are deferred for over budget plugins, other events carry
+    // objects that may be gone by the next tick and are always delivered
+    template<typename Fn>
+    void DispatchUpdate(PluginEvent event, Map* map, uint32 diff, Fn&& fn);
+    template<typename Fn>
+    bool InvokeSubscribers(PluginEvent event, PluginEventSubscriber const* subscribers, size_t count, Fn& fn);
+    // fn is a generic lambda, static modules pass it their concrete handler type
+    template<typename Fn>
+    static std::invoke_result_t<Fn&, IEventHandler*> InvokeHandler(PluginEventSubscriber const& subscriber, Fn& fn);
+    
+    static constexpr size_t OPCODE_FILTER_WORDS = 0x10000 / 64;
+    typedef std::array<uint64, OPCODE_FILTER_WORDS> OpcodeFilter;
+    static void BuildOpcodeTable(PluginEventTable& table, PluginPacketDirection direction, OpcodeFilter& filter);
+    
+    // Batched delivery
+    void DeliverEventBatches();
+    void ApplyConfigChanges();
+    
+    // Tick budget enforcement
+    uint32 TakeDeferredDiff(PluginBudgetState& budget, uint16 pluginId, PluginMapContext* context);
+    void DeferDiff(PluginBudgetState& budget, uint16 pluginId, PluginMapContext* context, uint32 diff);
+    
+    // Map contexts, FindMapContext never creates one
+    PluginMapContext* FindMapContext(Map* map) const;
+    PluginMapContext* GetMapContext(Map* map);
+    void PublishMapContexts(); // caller must hold _mapContextsMutex
+    void ReleaseMapStates(uint16 pluginId);
+    void UpdateTickBudgets();
     
     // Thread safety
     mutable std::mutex _pluginsMutex;
+    std::mutex _activationMutex;        // serializes ActivatePlugin, taken before _pluginsMutex
+    std::thread::id const _worldThread;
     mutable std::mutex _eventHandlersMutex;
     
     // Plugin storage
     std::unordered_map<std::string, std::unique_ptr<LoadedPlugin>> _loadedPlugins;
     std::unordered_map<std::string, IEventHandler*> _eventHandlers;
+    std::bitset<PLUGIN_MAX_IDS> _usedPluginIds;
+    std::atomic<PluginEventTable const*> _eventTable;    // read under PluginEpochGuard, see PluginEpoch.h
+    static std::atomic<PluginEventMask> _activeEvents;   // events with at least one subscriber
+    static std::atomic<PluginEventMask> _batchedEvents;  // events with at least one batch subscriber
+    static std::array<std::atomic<uint64>, OPCODE_FILTER_WORDS> _opcodeFilter[PLUGIN_PACKET_DIRECTION_COUNT];
+    
+    // Per map contexts, created on the first update of a map
+    std::mutex _mapContextsMutex;
+    std::unordered_map<Map const*, std::unique_ptr<PluginMapContext>> _mapContexts;
+    std::vector<PluginMapContext*> _destroyedMapContexts;       // unpublished, states not yet released
+    static std::atomic<uint32> _mapContextCount;
+    std::atomic<PluginMapContextTable const*> _mapContextTable;  // read under PluginEpochGuard
+    
+    // Shared worker threads, their continuations run at world update
+    PluginWorkerPool _workerPool;
+    
+    PluginMessageBus _messageBus;       // after _workerPool, drains WORKER_POOL subscriptions through it
+    
+    PluginPersistence _persistence;     // after _workerPool, writes snapshots through it
+    
+    PluginTimerWheel _timers;
+    PluginSweeper _sweeper;
+    
+    PluginConfigWatcher _configWatcher;
+    std::vector<PluginConfigChange> _configChanges;
+    
+    // Reloaded instances opened by the pool, swapped in at the next world update
+    std::vector<std::shared_ptr<PendingReload>> _pendingReloads;   // world thread only
+    
+    // Lazy plugins first used off the world thread, activated at the next world update
+    std::mutex _queuedActivationsMutex;
+    std::vector<std::string> _queuedActivations;
+    std::atomic<bool> _hasQueuedActivations;
+    
+    // Opened by LoadAllPlugins, read only afterwards
+    PluginManifest _manifest;
+    
+    // Batched events, queued by any thread and delivered on the world thread
+    PluginEventQueue _eventQueue;
+    std::array<PluginEventBatch, PLUGIN_EVENT_COUNT> _eventBatches;
+    
+    // Tick budget
+    std::atomic<uint64> _tickBudgetTicks;
+    uint32 _tickBudgetMaxStrikes;
+    std::array<PluginBudgetState, PLUGIN_MAX_IDS> _budgetStates;
+    
+    // Tracing
+    std::string _traceDirectory;
+    uint32 _traceDumpSeconds;
+    bool _traceThreadNamed;             // world thread
     
     // Configuration
     std::string _pluginDirectory;
     std::string _lastError;
     
-    // Singleton instance
-    static std::unique_ptr<PluginManager> _instance;
+    // Singleton instance, _instance is constant initialized and usable during
+    // static initialization, _ownedInstance destroys the manager at exit
+    static PluginManager* CreateInstance();
+    
+    static std::atomic<PluginManager*> _instance;
+    static std::unique_ptr<PluginManager> _ownedInstance;
     static std::mutex _instanceMutex;
 };
 
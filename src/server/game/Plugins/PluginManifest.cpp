@@ -0,0 +1,333 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginManifest.h"
+#include "Log.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::string_view PluginManifestModule::GetName() const
+{
+    return _manifest->GetString(_record->name);
+}
+
+std::string_view PluginManifestModule::GetVersion() const
+{
+    return _manifest->GetString(_record->version);
+}
+
+std::string_view PluginManifestModule::GetLibrary() const
+{
+    return _manifest->GetString(_record->library);
+}
+
+std::string_view PluginManifestModule::GetDependency(uint32 index) const
+{
+    return _manifest->GetReference(_record->referenceIndex + index);
+}
+
+std::string_view PluginManifestModule::GetConflict(uint32 index) const
+{
+    return _manifest->GetReference(_record->referenceIndex + _record->dependencyCount + index);
+}
+
+std::string_view PluginManifestModule::GetInterface(uint32 index) const
+{
+    return _manifest->GetReference(_record->referenceIndex + _record->dependencyCount + _record->conflictCount + index);
+}
+
+bool PluginManifestModule::DependsOn(std::string_view name) const
+{
+    for (uint32 i = 0; i < GetDependencyCount(); ++i)
+        if (GetDependency(i) == name)
+            return true;
+    
+    return false;
+}
+
+bool PluginManifestModule::ConflictsWith(std::string_view name) const
+{
+    for (uint32 i = 0; i < GetConflictCount(); ++i)
+        if (GetConflict(i) == name)
+            return true;
+    
+    return false;
+}
+
+std::string PluginManifestModule::Compare(PluginInfo const& info) const
+{
+    if (info.name != GetName())
+        return "name " + info.name + " does not match " + std::string(GetName());
+    
+    if (info.version != GetVersion())
+        return "version " + info.version + " does not match " + std::string(GetVersion());
+    
+    if (info.dependencies.size() != GetDependencyCount())
+        return "dependencies do not match";
+    
+    for (std::string const& dependency : info.dependencies)
+        if (!DependsOn(dependency))
+            return "dependency " + dependency + " is not listed";
+    
+    if (HasEventMask() && info.eventMask != GetEventMask())
+        return "subscribed events do not match";
+    
+    if (info.lazy != IsLazy())
+        return "lazy activation does not match";
+    
+    return {};
+}
+
+PluginManifest::PluginManifest() : _data(nullptr), _size(0)
+#ifdef _WIN32
+    , _fileHandle(nullptr), _mappingHandle(nullptr)
+#endif
+{
+}
+
+PluginManifest::~PluginManifest()
+{
+    Close();
+}
+
+bool PluginManifest::Open(std::string const& filePath)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        _lastError = "Cannot open module manifest " + filePath + " (Error: " + std::to_string(::GetLastError()) + ")";
+        return false;
+    }
+    
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    void* view = nullptr;
+    
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    
+    if (mapping)
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    
+    if (!view)
+    {
+        _lastError = "Cannot map module manifest " + filePath + " (Error: " + std::to_string(::GetLastError()) + ")";
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    
+    _fileHandle = file;
+    _mappingHandle = mapping;
+    _data = static_cast<uint8 const*>(view);
+    _size = size_t(fileSize.QuadPart);
+#else
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        _lastError = "Cannot open module manifest " + filePath + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+    
+    struct stat fileStat;
+    void* view = MAP_FAILED;
+    
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+        view = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    
+    // The mapping stays valid after the descriptor is closed
+    int error = errno;
+    close(fd);
+    
+    if (view == MAP_FAILED)
+    {
+        _lastError = "Cannot map module manifest " + filePath + " (" + std::strerror(error) + ")";
+        return false;
+    }
+    
+    _data = static_cast<uint8 const*>(view);
+    _size = size_t(fileStat.st_size);
+#endif
+
+    if (!Validate())
+    {
+        _lastError = "Module manifest " + filePath + " rejected: " + _lastError;
+        Close();
+        return false;
+    }
+    
+    uint32 moduleCount = GetModuleCount();
+    _modulesByName.reserve(moduleCount);
+    _modulesByLibrary.reserve(moduleCount);
+    
+    for (uint32 i = 0; i < moduleCount; ++i)
+    {
+        PluginManifestModule module = GetModule(i);
+        _modulesByName.emplace(module.GetName(), int32(i));
+        _modulesByLibrary.emplace(module.GetLibrary(), int32(i));
+    }
+    
+    TC_LOG_INFO("plugins", "Loaded module manifest %s with %u modules", filePath.c_str(), moduleCount);
+    return true;
+}
+
+void PluginManifest::Close()
+{
+    _modulesByName.clear();
+    _modulesByLibrary.clear();
+    
+    if (!_data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(_mappingHandle);
+    CloseHandle(_fileHandle);
+    _mappingHandle = nullptr;
+    _fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8*>(_data), _size);
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
+
+int32 PluginManifest::FindModule(std::string_view name) const
+{
+    auto itr = _modulesByName.find(name);
+    return itr != _modulesByName.end() ? itr->second : -1;
+}
+
+int32 PluginManifest::FindLibrary(std::string_view library) const
+{
+    auto itr = _modulesByLibrary.find(library);
+    return itr != _modulesByLibrary.end() ? itr->second : -1;
+}
+
+uint32 PluginManifest::Checksum(uint8 const* data, size_t size)
+{
+    uint32 hash = 0x811C9DC5;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 0x01000193;
+    
+    return hash;
+}
+
+std::string_view PluginManifest::GetString(uint32 offset) const
+{
+    // Validated on open, every offset points at a NUL terminated string inside the table
+    return std::string_view(reinterpret_cast<char const*>(_data + GetHeader().stringTableOffset + offset));
+}
+
+std::string_view PluginManifest::GetReference(uint32 index) const
+{
+    uint32 offset;
+    std::memcpy(&offset, _data + GetHeader().referenceTableOffset + size_t(index) * sizeof(uint32), sizeof(offset));
+    return GetString(offset);
+}
+
+bool PluginManifest::ValidateString(uint32 offset) const
+{
+    PluginManifestHeader const& header = GetHeader();
+    if (offset >= header.stringTableSize)
+        return false;
+    
+    char const* begin = reinterpret_cast<char const*>(_data + header.stringTableOffset);
+    return std::memchr(begin + offset, '\0', header.stringTableSize - offset) != nullptr;
+}
+
+bool PluginManifest::Validate()
+{
+    if (_size < sizeof(PluginManifestHeader))
+    {
+        _lastError = "file is too small";
+        return false;
+    }
+    
+    PluginManifestHeader const& header = GetHeader();
+    
+    if (header.magic != MAGIC || header.formatVersion != FORMAT_VERSION)
+    {
+        _lastError = "unknown format, rebuild the manifest";
+        return false;
+    }
+    
+    if (header.eventCount != PLUGIN_EVENT_COUNT)
+    {
+        _lastError = "generated for a different set of plugin events, rebuild the manifest";
+        return false;
+    }
+    
+    uint64 recordsEnd = sizeof(PluginManifestHeader) + uint64(header.moduleCount) * sizeof(PluginManifestRecord);
+    uint64 referencesEnd = header.stringTableOffset;
+    uint64 stringsEnd = uint64(header.stringTableOffset) + header.stringTableSize;
+    
+    if (header.referenceTableOffset != recordsEnd || referencesEnd < recordsEnd || (referencesEnd - recordsEnd) % sizeof(uint32) != 0 || stringsEnd != _size)
+    {
+        _lastError = "inconsistent section sizes";
+        return false;
+    }
+    
+    if (Checksum(_data + sizeof(PluginManifestHeader), _size - sizeof(PluginManifestHeader)) != header.checksum)
+    {
+        _lastError = "checksum mismatch";
+        return false;
+    }
+    
+    uint64 referenceCount = (referencesEnd - recordsEnd) / sizeof(uint32);
+    
+    for (uint32 i = 0; i < referenceCount; ++i)
+    {
+        uint32 offset;
+        std::memcpy(&offset, _data + header.referenceTableOffset + size_t(i) * sizeof(uint32), sizeof(offset));
+        if (!ValidateString(offset))
+        {
+            _lastError = "reference outside of the string table";
+            return false;
+        }
+    }
+    
+    for (uint32 i = 0; i < header.moduleCount; ++i)
+    {
+        PluginManifestRecord const& record = GetRecords()[i];
+        
+        if (!ValidateString(record.name) || !ValidateString(record.version) || !ValidateString(record.library) ||
+            uint64(record.referenceIndex) + record.dependencyCount + record.conflictCount + record.interfaceCount > referenceCount ||
+            record.priority > uint8(PluginPriority::CRITICAL))
+        {
+            _lastError = "module record " + std::to_string(i) + " is invalid";
+            return false;
+        }
+    }
+    
+    return true;
+}
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_MANIFEST_H
+#define TRINITY_PLUGIN_MANIFEST_H
+
+#include "IPlugin.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+ * Read only view of the module manifest written by modules/generate_manifest.py.
+ * The file is mapped and validated once, afterwards every accessor reads the
+ * mapping directly and may be used from any thread.
+ *
+ * Layout (little endian, see generate_manifest.py):
+ *   PluginManifestHeader
+ *   PluginManifestRecord[moduleCount]      sorted by load order, priority, name
+ *   uint32 references[]                    string offsets, dependencies, conflicts, interfaces
+ *   char strings[stringTableSize]          NUL terminated
+ */
+#pragma pack(push, 1)
+struct PluginManifestHeader
+{
+    uint32 magic;
+    uint16 formatVersion;
+    uint16 eventCount;              // PLUGIN_EVENT_COUNT of the generator, event masks are meaningless otherwise
+    uint32 moduleCount;
+    uint32 stringTableOffset;
+    uint32 stringTableSize;
+    uint32 referenceTableOffset;
+    uint32 checksum;                // FNV-1a of everything after the header
+    uint32 reserved;
+};
+
+struct PluginManifestRecord
+{
+    uint32 name;
+    uint32 version;
+    uint32 library;                 // file name without extension
+    uint32 referenceIndex;
+    uint16 dependencyCount;
+    uint16 conflictCount;
+    int32 loadOrder;
+    uint64 eventMask;
+    uint8 priority;
+    uint8 flags;
+    uint16 interfaceCount;
+    uint32 reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PluginManifestHeader) == 32, "PluginManifestHeader does not match generate_manifest.py");
+static_assert(sizeof(PluginManifestRecord) == 40, "PluginManifestRecord does not match generate_manifest.py");
+
+class PluginManifest;
+
+class TC_GAME_API PluginManifestModule
+{
+public:
+    enum Flags : uint8
+    {
+        FLAG_ENABLED        = 0x01,
+        FLAG_HAS_EVENTS     = 0x02,     // module.json lists its events, eventMask is meaningful
+        FLAG_LAZY           = 0x04      // activated on first use, see PluginLazyStub
+    };
+    
+    PluginManifestModule(PluginManifest const& manifest, PluginManifestRecord const& record) : _manifest(&manifest), _record(&record) { }
+    
+    std::string_view GetName() const;
+    std::string_view GetVersion() const;
+    std::string_view GetLibrary() const;
+    
+    uint32 GetDependencyCount() const { return _record->dependencyCount; }
+    std::string_view GetDependency(uint32 index) const;
+    uint32 GetConflictCount() const { return _record->conflictCount; }
+    std::string_view GetConflict(uint32 index) const;
+    uint32 GetInterfaceCount() const { return _record->interfaceCount; }
+    std::string_view GetInterface(uint32 index) const;
+    
+    int32 GetLoadOrder() const { return _record->loadOrder; }
+    PluginPriority GetPriority() const { return static_cast<PluginPriority>(_record->priority); }
+    bool IsEnabled() const { return (_record->flags & FLAG_ENABLED) != 0; }
+    bool HasEventMask() const { return (_record->flags & FLAG_HAS_EVENTS) != 0; }
+    bool IsLazy() const { return (_record->flags & FLAG_LAZY) != 0; }
+    PluginEventMask GetEventMask() const { return _record->eventMask; }
+    
+    bool DependsOn(std::string_view name) const;
+    bool ConflictsWith(std::string_view name) const;
+    
+    // Empty if info describes the same plugin as the manifest, the first difference otherwise
+    std::string Compare(PluginInfo const& info) const;
+
+private:
+    PluginManifest const* _manifest;
+    PluginManifestRecord const* _record;
+};
+
+class TC_GAME_API PluginManifest
+{
+public:
+    static constexpr uint32 MAGIC = 0x4D504354;     // "TCPM"
+    static constexpr uint16 FORMAT_VERSION = 1;
+    
+    PluginManifest();
+    ~PluginManifest();
+    
+    PluginManifest(PluginManifest const&) = delete;
+    PluginManifest& operator=(PluginManifest const&) = delete;
+    
+    // Maps and validates the file, a rejected file leaves the manifest closed
+    bool Open(std::string const& filePath);
+    void Close();
+    bool IsOpen() const { return _data != nullptr; }
+    std::string const& GetLastError() const { return _lastError; }
+    
+    uint32 GetModuleCount() const { return _data ? GetHeader().moduleCount : 0; }
+    PluginManifestModule GetModule(uint32 index) const { return PluginManifestModule(*this, GetRecords()[index]); }
+    
+    // Lookup by module name or by library file name without extension, -1 if not listed
+    int32 FindModule(std::string_view name) const;
+    int32 FindLibrary(std::string_view library) const;
+    
+    static uint32 Checksum(uint8 const* data, size_t size);
+
+private:
+    friend class PluginManifestModule;
+    
+    PluginManifestHeader const& GetHeader() const { return *reinterpret_cast<PluginManifestHeader const*>(_data); }
+    PluginManifestRecord const* GetRecords() const { return reinterpret_cast<PluginManifestRecord const*>(_data + sizeof(PluginManifestHeader)); }
+    std::string_view GetString(uint32 offset) const;
+    std::string_view GetReference(uint32 index) const;
+    
+    bool Validate();
+    bool ValidateString(uint32 offset) const;
+    
+    uint8 const* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+
+    std::unordered_map<std::string_view, int32> _modulesByName;
+    std::unordered_map<std::string_view, int32> _modulesByLibrary;
+    
+    std::string _lastError;
+};
+
+#endif // TRINITY_PLUGIN_MANIFEST_H
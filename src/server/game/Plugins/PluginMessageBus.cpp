@@ -0,0 +1,302 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginMessageBus.h"
+#include "PluginEpoch.h"
+#include "PluginWorkerPool.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
+
+void PluginMessagePool::Start(uint32 blockCount)
+{
+    if (_blocks || !blockCount)
+        return;
+    
+    _blocks = std::make_unique<Block[]>(blockCount);
+    _blockCount = blockCount;
+    
+    for (uint32 i = 0; i < blockCount; ++i)
+    {
+        _blocks[i].next.store(i + 1 < blockCount ? i + 1 : INVALID_BLOCK, std::memory_order_relaxed);
+        _blocks[i].references.store(0, std::memory_order_relaxed);
+    }
+    
+    _freeCount.store(blockCount, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_release);
+}
+
+uint32 PluginMessagePool::Allocate()
+{
+    uint64 head = _head.load(std::memory_order_acquire);
+    
+    for (;;)
+    {
+        uint32 index = uint32(head);
+        if (index == INVALID_BLOCK)
+            return INVALID_BLOCK;
+        
+        // May read a stale link if the block was taken meanwhile, the tag makes the exchange fail then
+        uint32 next = _blocks[index].next.load(std::memory_order_relaxed);
+        uint64 replacement = ((head >> 32) + 1) << 32 | next;
+        
+        if (_head.compare_exchange_weak(head, replacement, std::memory_order_acquire, std::memory_order_acquire))
+        {
+            _freeCount.fetch_sub(1, std::memory_order_relaxed);
+            return index;
+        }
+    }
+}
+
+void PluginMessagePool::Release(uint32 index)
+{
+    uint64 head = _head.load(std::memory_order_relaxed);
+    
+    for (;;)
+    {
+        _blocks[index].next.store(uint32(head), std::memory_order_relaxed);
+        uint64 replacement = ((head >> 32) + 1) << 32 | index;
+        
+        if (_head.compare_exchange_weak(head, replacement, std::memory_order_release, std::memory_order_relaxed))
+            break;
+    }
+    
+    _freeCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+PluginMessageBus::Queue::Queue(uint32 capacity) : _enqueuePosition(0), _dequeuePosition(0)
+{
+    uint32 size = 2;
+    while (size < capacity)
+        size <<= 1;
+    
+    _cells = std::make_unique<Cell[]>(size);
+    _mask = size - 1;
+    
+    for (uint32 i = 0; i < size; ++i)
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool PluginMessageBus::Queue::Push(uint32 block)
+{
+    uint32 position = _enqueuePosition.load(std::memory_order_relaxed);
+    
+    for (;;)
+    {
+        Cell& cell = _cells[position & _mask];
+        int32 difference = int32(cell.sequence.load(std::memory_order_acquire) - position);
+        
+        if (difference == 0)
+        {
+            if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.block = block;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+            return false;       // full
+        else
+            position = _enqueuePosition.load(std::memory_order_relaxed);
+    }
+}
+
+bool PluginMessageBus::Queue::Pop(uint32& block)
+{
+    Cell& cell = _cells[_dequeuePosition & _mask];
+    if (int32(cell.sequence.load(std::memory_order_acquire) - (_dequeuePosition + 1)) < 0)
+        return false;
+    
+    block = cell.block;
+    cell.sequence.store(_dequeuePosition + _mask + 1, std::memory_order_release);
+    ++_dequeuePosition;
+    return true;
+}
+
+PluginMessageBus::Subscriber::Subscriber(PluginMessageBus* bus, PluginMessageSubscription id, IPlugin const* owner, PluginMessageId type, PluginMessageDelivery delivery, uint32 capacity, Handler handler)
+    : bus(bus), id(id), owner(owner), type(type), delivery(delivery), handler(std::move(handler)), queue(capacity), pending(0), scheduled(false)
+{
+}
+
+PluginMessageBus::Subscriber::~Subscriber()
+{
+    uint32 block;
+    while (queue.Pop(block))
+        bus->ReleaseReference(block);
+}
+
+PluginMessageBus::PluginMessageBus(PluginWorkerPool& workerPool)
+    : _workerPool(workerPool), _queueCapacity(1024), _nextId(1), _table(new Table()), _dropped(0)
+{
+}
+
+PluginMessageBus::~PluginMessageBus()
+{
+    // Subscribers release their blocks into the pool, which is destroyed after them.
+    // Tables retired by PublishTable() hold subscribers too, free them while the pool exists.
+    delete _table.exchange(nullptr);
+    sPluginEpoch->Synchronize();
+    _subscribers.clear();
+}
+
+void PluginMessageBus::Start(uint32 blockCount, uint32 queueCapacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    _queueCapacity = std::max<uint32>(queueCapacity, 2);
+    _pool.Start(blockCount);
+}
+
+bool PluginMessageBus::Publish(PluginMessageId type, void const* data, size_t size)
+{
+    PluginEpochGuard guard;
+    Table const* table = _table.load(std::memory_order_seq_cst);
+    
+    auto itr = table->byType.find(type);
+    if (itr == table->byType.end())
+        return false;
+    
+    std::vector<SubscriberPtr> const& subscribers = itr->second;
+    
+    uint32 block = _pool.Allocate();
+    if (block == PluginMessagePool::INVALID_BLOCK)
+    {
+        _dropped.fetch_add(subscribers.size(), std::memory_order_relaxed);
+        return false;
+    }
+    
+    PluginMessagePool::Block& storage = _pool.GetBlock(block);
+    std::memcpy(storage.payload, data, size);
+    storage.references.store(uint32(subscribers.size()), std::memory_order_relaxed);
+    
+    uint32 rejected = 0;
+    for (SubscriberPtr const& subscriber : subscribers)
+    {
+        // Counted before the push so the consumer never sees more messages than pending
+        subscriber->pending.fetch_add(1, std::memory_order_relaxed);
+        if (!subscriber->queue.Push(block))
+        {
+            subscriber->pending.fetch_sub(1, std::memory_order_relaxed);
+            ++rejected;
+        }
+    }
+    
+    if (rejected)
+    {
+        _dropped.fetch_add(rejected, std::memory_order_relaxed);
+        if (storage.references.fetch_sub(rejected, std::memory_order_acq_rel) == rejected)
+            _pool.Release(block);
+    }
+    
+    return rejected < subscribers.size();
+}
+
+PluginMessageSubscription PluginMessageBus::Subscribe(IPlugin const* owner, PluginMessageId type, PluginMessageDelivery delivery, uint32 capacity, Handler handler)
+{
+    if (delivery >= PluginMessageDelivery::MAX)
+        return 0;
+    
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    PluginMessageSubscription id = _nextId++;
+    _subscribers.push_back(std::make_shared<Subscriber>(this, id, owner, type, delivery, capacity ? capacity : _queueCapacity, std::move(handler)));
+    PublishTable();
+    
+    return id;
+}
+
+void PluginMessageBus::Unsubscribe(PluginMessageSubscription subscription)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    auto itr = std::find_if(_subscribers.begin(), _subscribers.end(), [subscription](SubscriberPtr const& subscriber) { return subscriber->id == subscription; });
+    if (itr == _subscribers.end())
+        return;
+    
+    _subscribers.erase(itr);
+    PublishTable();
+}
+
+void PluginMessageBus::Unsubscribe(IPlugin const* owner)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    auto end = std::remove_if(_subscribers.begin(), _subscribers.end(), [owner](SubscriberPtr const& subscriber) { return subscriber->owner == owner; });
+    if (end == _subscribers.end())
+        return;
+    
+    _subscribers.erase(end, _subscribers.end());
+    PublishTable();
+}
+
+void PluginMessageBus::PublishTable()
+{
+    auto table = std::make_unique<Table>();
+    
+    for (SubscriberPtr const& subscriber : _subscribers)
+    {
+        table->byType[subscriber->type].push_back(subscriber);
+        table->byDelivery[static_cast<size_t>(subscriber->delivery)].push_back(subscriber);
+    }
+    
+    // Removed subscribers live on in the old table until no producer can reach them
+    sPluginEpoch->Retire(_table.exchange(table.release(), std::memory_order_seq_cst));
+}
+
+void PluginMessageBus::Deliver(PluginMessageDelivery delivery)
+{
+    PluginEpochGuard guard;
+    Table const* table = _table.load(std::memory_order_seq_cst);
+    
+    for (SubscriberPtr const& subscriber : table->byDelivery[static_cast<size_t>(delivery)])
+    {
+        if (delivery != PluginMessageDelivery::WORKER_POOL)
+        {
+            Drain(*subscriber);
+            continue;
+        }
+        
+        if (!subscriber->pending.load(std::memory_order_acquire) || subscriber->scheduled.exchange(true, std::memory_order_acq_rel))
+            continue;
+        
+        // The task keeps the subscriber alive if it is removed meanwhile
+        _workerPool.Submit(subscriber->owner, [this, subscriber]()
+        {
+            Drain(*subscriber);
+            subscriber->scheduled.store(false, std::memory_order_release);
+        });
+    }
+}
+
+void PluginMessageBus::Drain(Subscriber& subscriber)
+{
+    // At most one queue's worth, producers may keep publishing while the handler runs
+    uint32 block;
+    for (uint32 handled = 0; handled <= subscriber.queue.GetMask() && subscriber.queue.Pop(block); ++handled)
+    {
+        subscriber.pending.fetch_sub(1, std::memory_order_relaxed);
+        subscriber.handler(_pool.GetBlock(block).payload);
+        ReleaseReference(block);
+    }
+}
+
+void PluginMessageBus::ReleaseReference(uint32 block)
+{
+    if (_pool.GetBlock(block).references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        _pool.Release(block);
+}
@@ -0,0 +1,226 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_MESSAGE_BUS_H
+#define TRINITY_PLUGIN_MESSAGE_BUS_H
+
+#include "Define.h"
+#include "PluginInterface.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+class IPlugin;
+class PluginWorkerPool;
+
+typedef uint64 PluginMessageId;
+typedef uint32 PluginMessageSubscription;   // 0 is never a valid subscription
+
+// Declares the name and id of a message type, inside a trivially copyable struct:
+//   struct AuctionSold { PLUGIN_MESSAGE("AuctionHouse.Sold"); uint32 itemEntry; uint32 price; };
+#define PLUGIN_MESSAGE(name) \
+    static constexpr char const* PluginMessageName = name; \
+    static constexpr PluginMessageId PluginMessageTypeId = PluginInterfaceHash(name)
+
+// Largest message, messages are copied into fixed size pool blocks
+constexpr size_t PLUGIN_MESSAGE_MAX_SIZE = 112;
+
+enum class PluginMessageDelivery : uint8
+{
+    TICK_START = 0,     // world thread, at the start of the world update
+    TICK_END = 1,       // world thread, after the world update handlers and event batches
+    WORKER_POOL = 2,    // a pool worker at the end of the world update, never two at once per subscription
+    MAX
+};
+
+constexpr size_t PLUGIN_MESSAGE_DELIVERY_COUNT = static_cast<size_t>(PluginMessageDelivery::MAX);
+
+/*
+ * Fixed size blocks for message payloads, allocated once by Start(). Allocate()
+ * and Release() are lock free (a tagged free list) and never touch the heap.
+ */
+class TC_GAME_API PluginMessagePool
+{
+public:
+    static constexpr uint32 INVALID_BLOCK = 0xFFFFFFFF;
+    
+    struct alignas(64) Block
+    {
+        std::atomic<uint32> next;
+        std::atomic<uint32> references;     // subscriptions that still have to handle the message
+        alignas(16) unsigned char payload[PLUGIN_MESSAGE_MAX_SIZE];
+    };
+    
+    PluginMessagePool() : _head(INVALID_BLOCK), _blockCount(0), _freeCount(0) { }
+    
+    PluginMessagePool(PluginMessagePool const&) = delete;
+    PluginMessagePool& operator=(PluginMessagePool const&) = delete;
+    
+    // World thread, before any message is published. Later calls are ignored.
+    void Start(uint32 blockCount);
+    
+    uint32 Allocate();
+    void Release(uint32 index);
+    
+    Block& GetBlock(uint32 index) { return _blocks[index]; }
+    uint32 GetBlockCount() const { return _blockCount; }
+    uint32 GetFreeCount() const { return _freeCount.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<Block[]> _blocks;
+    std::atomic<uint64> _head;          // tag << 32 | first free block, the tag defeats ABA
+    uint32 _blockCount;
+    std::atomic<uint32> _freeCount;
+};
+
+/*
+ * Typed publish/subscribe between plugins, hosted by the PluginManager.
+ *
+ * Every subscription owns a bounded multi producer, single consumer queue of
+ * pool blocks. Publish() may be called from any thread (network, map update,
+ * pool workers); it copies the message into one pool block shared by all
+ * subscriptions of the type and never blocks or allocates. When the pool or a
+ * queue is full the message is dropped for that subscription and counted in
+ * GetDroppedCount().
+ *
+ * Handlers run at the delivery point chosen on Subscribe(). WORKER_POOL
+ * handlers must not touch game objects. Subscriptions of a plugin are removed
+ * when it is stopped, unloaded or reloaded, so subscribe from IPlugin::Start().
+ */
+class TC_GAME_API PluginMessageBus
+{
+public:
+    explicit PluginMessageBus(PluginWorkerPool& workerPool);
+    ~PluginMessageBus();
+    
+    PluginMessageBus(PluginMessageBus const&) = delete;
+    PluginMessageBus& operator=(PluginMessageBus const&) = delete;
+    
+    // blockCount messages in flight over all subscriptions, queueCapacity is
+    // the default queue size of a subscription (rounded up to a power of two)
+    void Start(uint32 blockCount, uint32 queueCapacity);
+    
+    // Any thread. Returns false if no subscription received the message.
+    template<typename T>
+    bool Publish(T const& message)
+    {
+        CheckMessageType<T>();
+        return Publish(T::PluginMessageTypeId, &message, sizeof(T));
+    }
+    
+    // handler is called as handler(T const&). capacity 0 uses the default queue size.
+    template<typename T, typename Fn>
+    PluginMessageSubscription Subscribe(IPlugin const* owner, PluginMessageDelivery delivery, Fn&& handler, uint32 capacity = 0)
+    {
+        CheckMessageType<T>();
+        return Subscribe(owner, T::PluginMessageTypeId, delivery, capacity,
+            [fn = std::forward<Fn>(handler)](void const* payload) mutable { fn(*static_cast<T const*>(payload)); });
+    }
+    
+    void Unsubscribe(PluginMessageSubscription subscription);
+    void Unsubscribe(IPlugin const* owner);
+    
+    // World thread, called by the PluginManager at the delivery points
+    void Deliver(PluginMessageDelivery delivery);
+    
+    uint64 GetDroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+    PluginMessagePool const& GetPool() const { return _pool; }
+
+private:
+    typedef std::function<void(void const*)> Handler;
+    
+    // Bounded MPSC queue of block indices (D. Vyukov's bounded queue with a single consumer)
+    class Queue
+    {
+    public:
+        explicit Queue(uint32 capacity);
+        
+        bool Push(uint32 block);
+        bool Pop(uint32& block);
+        uint32 GetMask() const { return _mask; }
+    
+    private:
+        struct Cell
+        {
+            std::atomic<uint32> sequence;
+            uint32 block;
+        };
+        
+        std::unique_ptr<Cell[]> _cells;
+        uint32 _mask;
+        alignas(64) std::atomic<uint32> _enqueuePosition;
+        alignas(64) uint32 _dequeuePosition;
+    };
+    
+    struct Subscriber
+    {
+        Subscriber(PluginMessageBus* bus, PluginMessageSubscription id, IPlugin const* owner, PluginMessageId type, PluginMessageDelivery delivery, uint32 capacity, Handler handler);
+        ~Subscriber();      // releases the blocks still queued
+        
+        PluginMessageBus* bus;
+        PluginMessageSubscription id;
+        IPlugin const* owner;
+        PluginMessageId type;
+        PluginMessageDelivery delivery;
+        Handler handler;
+        Queue queue;
+        std::atomic<uint32> pending;        // queued messages, lets WORKER_POOL skip idle subscriptions
+        std::atomic<bool> scheduled;        // WORKER_POOL, a drain task is queued or running
+    };
+    
+    typedef std::shared_ptr<Subscriber> SubscriberPtr;
+    
+    // Published copy of the subscriptions, read by producers under PluginEpochGuard
+    struct Table
+    {
+        std::unordered_map<PluginMessageId, std::vector<SubscriberPtr>> byType;
+        std::array<std::vector<SubscriberPtr>, PLUGIN_MESSAGE_DELIVERY_COUNT> byDelivery;
+    };
+    
+    template<typename T>
+    static constexpr void CheckMessageType()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Plugin messages are copied into pool blocks and must be trivially copyable");
+        static_assert(sizeof(T) <= PLUGIN_MESSAGE_MAX_SIZE, "Plugin message is larger than PLUGIN_MESSAGE_MAX_SIZE");
+        static_assert(alignof(T) <= 16, "Plugin message needs more alignment than a pool block provides");
+    }
+    
+    bool Publish(PluginMessageId type, void const* data, size_t size);
+    PluginMessageSubscription Subscribe(IPlugin const* owner, PluginMessageId type, PluginMessageDelivery delivery, uint32 capacity, Handler handler);
+    
+    void Drain(Subscriber& subscriber);
+    void ReleaseReference(uint32 block);
+    void PublishTable();        // _mutex held
+    
+    PluginWorkerPool& _workerPool;
+    PluginMessagePool _pool;
+    uint32 _queueCapacity;
+    
+    std::mutex _mutex;
+    std::vector<SubscriberPtr> _subscribers;
+    PluginMessageSubscription _nextId;
+    
+    std::atomic<Table const*> _table;
+    std::atomic<uint64> _dropped;
+};
+
+#endif // TRINITY_PLUGIN_MESSAGE_BUS_H
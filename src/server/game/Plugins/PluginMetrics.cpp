@@ -0,0 +1,382 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginMetrics.h"
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32 CACHE_LINE_SIZE = 64;
+    constexpr uint32 MAX_SHARD_STRIDE = ((PLUGIN_METRIC_MAX_BUCKETS + 2) * sizeof(uint64) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    
+    alignas(CACHE_LINE_SIZE) uint8 metricSink[PLUGIN_METRIC_SHARDS * MAX_SHARD_STRIDE];
+    double const noBounds[1] = { 0.0 };
+    
+    bool IsValidMetricName(std::string_view name)
+    {
+        if (name.empty() || name.size() >= sizeof(PluginMetricDescriptor::name))
+            return false;
+        
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            char c = name[i];
+            bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || (i > 0 && c >= '0' && c <= '9');
+            if (!valid)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    uint32 GetProcessId()
+    {
+#ifdef _WIN32
+        return uint32(GetCurrentProcessId());
+#else
+        return uint32(getpid());
+#endif
+    }
+}
+
+PluginCounter::PluginCounter() : _values(PluginMetricsRegistry::GetSink()), _stride(CACHE_LINE_SIZE)
+{
+}
+
+uint64 PluginCounter::Get() const
+{
+    uint64 value = 0;
+    for (uint32 shard = 0; shard < PLUGIN_METRIC_SHARDS; ++shard)
+        value += Cell(shard).load(std::memory_order_relaxed);
+    
+    return value;
+}
+
+PluginGauge::PluginGauge() : _values(PluginMetricsRegistry::GetSink())
+{
+}
+
+PluginHistogram::PluginHistogram() : _values(PluginMetricsRegistry::GetSink()), _stride(MAX_SHARD_STRIDE), _bounds(noBounds), _bucketCount(0)
+{
+}
+
+void PluginHistogram::Observe(double value) const
+{
+    uint8 bucket = 0;
+    while (bucket < _bucketCount && value > _bounds[bucket])
+        ++bucket;
+    
+    std::atomic<uint64>* cells = Shard(PluginMetricShard());
+    cells[bucket].fetch_add(1, std::memory_order_relaxed);
+    
+    // Sum as double bits, a shard is shared by few threads so the loop rarely repeats
+    std::atomic<uint64>& sum = cells[_bucketCount + 1];
+    uint64 expected = sum.load(std::memory_order_relaxed);
+    uint64 desired;
+    do
+    {
+        double total;
+        std::memcpy(&total, &expected, sizeof(total));
+        total += value;
+        std::memcpy(&desired, &total, sizeof(desired));
+    } while (!sum.compare_exchange_weak(expected, desired, std::memory_order_relaxed));
+}
+
+uint64 PluginHistogram::GetCount() const
+{
+    uint64 count = 0;
+    for (uint32 shard = 0; shard < PLUGIN_METRIC_SHARDS; ++shard)
+        for (uint8 bucket = 0; bucket <= _bucketCount; ++bucket)
+            count += Shard(shard)[bucket].load(std::memory_order_relaxed);
+    
+    return count;
+}
+
+double PluginHistogram::GetSum() const
+{
+    double sum = 0.0;
+    for (uint32 shard = 0; shard < PLUGIN_METRIC_SHARDS; ++shard)
+    {
+        uint64 bits = Shard(shard)[_bucketCount + 1].load(std::memory_order_relaxed);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        sum += value;
+    }
+    
+    return sum;
+}
+
+PluginMetricsRegistry* PluginMetricsRegistry::Instance()
+{
+    static PluginMetricsRegistry* const instance = new PluginMetricsRegistry();
+    return instance;
+}
+
+PluginMetricsRegistry::PluginMetricsRegistry() : _data(nullptr), _size(0), _nextValueOffset(0)
+#ifdef _WIN32
+    , _fileHandle(nullptr), _mappingHandle(nullptr)
+#endif
+{
+}
+
+PluginMetricsRegistry::~PluginMetricsRegistry()
+{
+    if (!_data)
+        return;
+    
+    if (_filePath.empty())
+    {
+        ::operator delete(_data, std::align_val_t(CACHE_LINE_SIZE));
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(_mappingHandle);
+    CloseHandle(_fileHandle);
+#else
+    munmap(_data, _size);
+#endif
+}
+
+uint8* PluginMetricsRegistry::GetSink()
+{
+    return metricSink;
+}
+
+bool PluginMetricsRegistry::Open(std::string const& filePath, uint32 capacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return OpenRegion(filePath, capacity);
+}
+
+bool PluginMetricsRegistry::OpenRegion(std::string const& filePath, uint32 capacity)
+{
+    if (_data)
+    {
+        if (filePath != _filePath)
+        {
+            _lastError = "Plugin metrics are already registered in " + (_filePath.empty() ? std::string("process memory") : _filePath);
+            TC_LOG_WARN("plugins", "%s", _lastError.c_str());
+            return false;
+        }
+        
+        return true;
+    }
+    
+    capacity = std::max<uint32>(capacity, 1);
+    
+    uint64 descriptorOffset = sizeof(PluginMetricsHeader);
+    uint64 valueOffset = (descriptorOffset + uint64(capacity) * sizeof(PluginMetricDescriptor) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    uint64 size = valueOffset + uint64(capacity) * PLUGIN_METRIC_SHARDS * MAX_SHARD_STRIDE;
+    
+    if (!Map(filePath, size_t(size)))
+    {
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return false;
+    }
+    
+    PluginMetricsHeader& header = GetHeader();
+    header.formatVersion = FORMAT_VERSION;
+    header.shardCount = PLUGIN_METRIC_SHARDS;
+    header.capacity = capacity;
+    header.metricCount.store(0, std::memory_order_relaxed);
+    header.descriptorOffset = descriptorOffset;
+    header.valueOffset = valueOffset;
+    header.size = size;
+    header.startTime = uint64(std::time(nullptr));
+    header.processId = GetProcessId();
+    reinterpret_cast<std::atomic<uint32>&>(header.magic).store(MAGIC, std::memory_order_release);
+    
+    _nextValueOffset = valueOffset;
+    
+    if (!filePath.empty())
+        TC_LOG_INFO("plugins", "Plugin metrics exported in %s (%u metrics)", filePath.c_str(), capacity);
+    
+    return true;
+}
+
+bool PluginMetricsRegistry::Map(std::string const& filePath, size_t size)
+{
+    if (filePath.empty())
+    {
+        _data = static_cast<uint8*>(::operator new(size, std::align_val_t(CACHE_LINE_SIZE)));
+        std::memset(_data, 0, size);
+        _size = size;
+        return true;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        _lastError = "Cannot create plugin metrics file " + filePath + " (Error: " + std::to_string(::GetLastError()) + ")";
+        return false;
+    }
+    
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, DWORD(uint64(size) >> 32), DWORD(size), nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+    
+    if (!view)
+    {
+        _lastError = "Cannot map plugin metrics file " + filePath + " (Error: " + std::to_string(::GetLastError()) + ")";
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    
+    _fileHandle = file;
+    _mappingHandle = mapping;
+#else
+    int fd = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        _lastError = "Cannot create plugin metrics file " + filePath + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+    
+    // A fresh sparse file reads as zeros, pages are only backed once written
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, off_t(size)) == 0)
+        view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    
+    int error = errno;
+    close(fd);
+    
+    if (view == MAP_FAILED)
+    {
+        _lastError = "Cannot map plugin metrics file " + filePath + " (" + std::strerror(error) + ")";
+        return false;
+    }
+#endif
+
+    _data = static_cast<uint8*>(view);
+    _size = size;
+    _filePath = filePath;
+    return true;
+}
+
+PluginMetricDescriptor* PluginMetricsRegistry::Register(std::string_view name, std::string_view help, PluginMetricType type, double const* bounds, size_t bucketCount)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    auto itr = _metrics.find(std::string(name));
+    if (itr != _metrics.end())
+    {
+        PluginMetricDescriptor* descriptor = &GetDescriptors()[itr->second];
+        if (descriptor->type == uint8(type) && (type != PluginMetricType::HISTOGRAM ||
+            (descriptor->bucketCount == bucketCount && std::equal(bounds, bounds + bucketCount, descriptor->bounds))))
+            return descriptor;
+        
+        _lastError = "Plugin metric " + std::string(name) + " is already registered with another type or buckets";
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return nullptr;
+    }
+    
+    if (!IsValidMetricName(name))
+    {
+        _lastError = "Invalid plugin metric name: " + std::string(name);
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return nullptr;
+    }
+    
+    if (bucketCount > PLUGIN_METRIC_MAX_BUCKETS || !std::is_sorted(bounds, bounds + bucketCount))
+    {
+        _lastError = "Plugin histogram " + std::string(name) + " needs at most " + std::to_string(PLUGIN_METRIC_MAX_BUCKETS) + " ascending bucket bounds";
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return nullptr;
+    }
+    
+    if (!_data && !OpenRegion(std::string(), DEFAULT_CAPACITY))
+        return nullptr;
+    
+    PluginMetricsHeader& header = GetHeader();
+    uint32 index = header.metricCount.load(std::memory_order_relaxed);
+    if (index >= header.capacity)
+    {
+        _lastError = "Plugin metric capacity exhausted (Plugins.Metrics.Capacity = " + std::to_string(header.capacity) + "), cannot register " + std::string(name);
+        TC_LOG_ERROR("plugins", "%s", _lastError.c_str());
+        return nullptr;
+    }
+    
+    uint16 shardCount = type == PluginMetricType::GAUGE ? 1 : PLUGIN_METRIC_SHARDS;
+    uint32 cellCount = type == PluginMetricType::HISTOGRAM ? uint32(bucketCount) + 2 : 1;
+    uint32 stride = (cellCount * sizeof(uint64) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    
+    PluginMetricDescriptor* descriptor = &GetDescriptors()[index];
+    std::memcpy(descriptor->name, name.data(), name.size());
+    std::memcpy(descriptor->help, help.data(), std::min(help.size(), sizeof(descriptor->help) - 1));
+    descriptor->type = uint8(type);
+    descriptor->bucketCount = uint8(bucketCount);
+    descriptor->shardCount = shardCount;
+    descriptor->shardStride = stride;
+    descriptor->valueOffset = _nextValueOffset;
+    std::copy(bounds, bounds + bucketCount, descriptor->bounds);
+    
+    _nextValueOffset += uint64(shardCount) * stride;
+    _metrics.emplace(std::string(name), index);
+    
+    // Readers only look at descriptors below metricCount
+    header.metricCount.store(index + 1, std::memory_order_release);
+    return descriptor;
+}
+
+PluginCounter PluginMetricsRegistry::GetCounter(std::string_view name, std::string_view help)
+{
+    PluginMetricDescriptor* descriptor = Register(name, help, PluginMetricType::COUNTER, nullptr, 0);
+    if (!descriptor)
+        return PluginCounter();
+    
+    return PluginCounter(_data + descriptor->valueOffset, descriptor->shardStride);
+}
+
+PluginGauge PluginMetricsRegistry::GetGauge(std::string_view name, std::string_view help)
+{
+    PluginMetricDescriptor* descriptor = Register(name, help, PluginMetricType::GAUGE, nullptr, 0);
+    if (!descriptor)
+        return PluginGauge();
+    
+    return PluginGauge(_data + descriptor->valueOffset);
+}
+
+PluginHistogram PluginMetricsRegistry::GetHistogram(std::string_view name, std::string_view help, std::initializer_list<double> bounds)
+{
+    PluginMetricDescriptor* descriptor = Register(name, help, PluginMetricType::HISTOGRAM, bounds.begin(), bounds.size());
+    if (!descriptor)
+        return PluginHistogram();
+    
+    return PluginHistogram(_data + descriptor->valueOffset, descriptor->shardStride, descriptor->bounds, descriptor->bucketCount);
+}
+
+uint32 PluginMetricsRegistry::GetMetricCount() const
+{
+    return _data ? GetHeader().metricCount.load(std::memory_order_acquire) : 0;
+}
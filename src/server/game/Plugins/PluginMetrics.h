@@ -0,0 +1,225 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_METRICS_H
+#define TRINITY_PLUGIN_METRICS_H
+
+#include "Define.h"
+#include <atomic>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+ * Plugin counters, gauges and histograms kept in one memory region. With
+ * Plugins.Metrics.File set the region is a shared file mapping, so an external
+ * exporter (modules/export_metrics.py) reads the values straight from memory
+ * without asking the worldserver.
+ *
+ * Layout (native endian, see export_metrics.py):
+ *   PluginMetricsHeader
+ *   PluginMetricDescriptor[capacity]       the first metricCount are valid
+ *   values                                 per metric shardCount * shardStride bytes at valueOffset
+ *
+ * Counter and histogram values are spread over PLUGIN_METRIC_SHARDS cache line
+ * aligned shards, a thread always updates the same shard and readers add them
+ * up. A counter shard is one uint64, a gauge has a single int64 shard and a
+ * histogram shard holds bucketCount + 1 uint64 bucket counts (the last one is
+ * +Inf, counts are not cumulative) followed by the sum as a double.
+ */
+#define PLUGIN_METRIC_SHARDS 16
+#define PLUGIN_METRIC_MAX_BUCKETS 16
+
+enum class PluginMetricType : uint8
+{
+    COUNTER     = 1,
+    GAUGE       = 2,
+    HISTOGRAM   = 3
+};
+
+struct PluginMetricsHeader
+{
+    uint32 magic;                       // written last, the region is complete once it is set
+    uint16 formatVersion;
+    uint16 shardCount;
+    uint32 capacity;
+    std::atomic<uint32> metricCount;    // descriptors below are complete, release ordered
+    uint64 descriptorOffset;
+    uint64 valueOffset;
+    uint64 size;
+    uint64 startTime;                   // unix time of the worldserver start
+    uint32 processId;
+    uint8 reserved[12];
+};
+
+struct PluginMetricDescriptor
+{
+    char name[64];                      // NUL terminated, [a-zA-Z_:][a-zA-Z0-9_:]*
+    char help[48];                      // NUL terminated, truncated
+    uint8 type;                         // PluginMetricType
+    uint8 bucketCount;                  // finite histogram buckets
+    uint16 shardCount;
+    uint32 shardStride;
+    uint64 valueOffset;                 // from the start of the region
+    double bounds[PLUGIN_METRIC_MAX_BUCKETS];   // upper bounds of the finite buckets, ascending
+};
+
+static_assert(sizeof(PluginMetricsHeader) == 64, "PluginMetricsHeader does not match export_metrics.py");
+static_assert(sizeof(PluginMetricDescriptor) == 256, "PluginMetricDescriptor does not match export_metrics.py");
+static_assert(sizeof(std::atomic<uint64>) == sizeof(uint64) && std::atomic<uint64>::is_always_lock_free, "metric values are updated in place");
+
+// Shard of the calling thread, threads are spread round robin
+inline uint32 PluginMetricShard()
+{
+    static std::atomic<uint32> nextShard(0);
+    thread_local uint32 const shard = nextShard.fetch_add(1, std::memory_order_relaxed) % PLUGIN_METRIC_SHARDS;
+    return shard;
+}
+
+/*
+ * Metric handles are cheap to copy and never null: a default constructed handle
+ * or one whose registration failed updates a private sink. Updates are relaxed
+ * atomics on the calling thread's shard.
+ */
+class TC_GAME_API PluginCounter
+{
+public:
+    PluginCounter();
+    
+    void Add(uint64 value = 1) const { Cell(PluginMetricShard()).fetch_add(value, std::memory_order_relaxed); }
+    uint64 Get() const;
+
+private:
+    friend class PluginMetricsRegistry;
+    
+    PluginCounter(uint8* values, uint32 stride) : _values(values), _stride(stride) { }
+    
+    std::atomic<uint64>& Cell(uint32 shard) const { return *reinterpret_cast<std::atomic<uint64>*>(_values + shard * _stride); }
+    
+    uint8* _values;
+    uint32 _stride;
+};
+
+class TC_GAME_API PluginGauge
+{
+public:
+    PluginGauge();
+    
+    void Set(int64 value) const { Cell().store(value, std::memory_order_relaxed); }
+    void Add(int64 value) const { Cell().fetch_add(value, std::memory_order_relaxed); }
+    void Sub(int64 value) const { Cell().fetch_sub(value, std::memory_order_relaxed); }
+    int64 Get() const { return Cell().load(std::memory_order_relaxed); }
+
+private:
+    friend class PluginMetricsRegistry;
+    
+    explicit PluginGauge(uint8* values) : _values(values) { }
+    
+    std::atomic<int64>& Cell() const { return *reinterpret_cast<std::atomic<int64>*>(_values); }
+    
+    uint8* _values;
+};
+
+class TC_GAME_API PluginHistogram
+{
+public:
+    PluginHistogram();
+    
+    void Observe(double value) const;
+    
+    uint64 GetCount() const;
+    double GetSum() const;
+
+private:
+    friend class PluginMetricsRegistry;
+    
+    PluginHistogram(uint8* values, uint32 stride, double const* bounds, uint8 bucketCount)
+        : _values(values), _stride(stride), _bounds(bounds), _bucketCount(bucketCount) { }
+    
+    std::atomic<uint64>* Shard(uint32 shard) const { return reinterpret_cast<std::atomic<uint64>*>(_values + shard * _stride); }
+    
+    uint8* _values;
+    uint32 _stride;
+    double const* _bounds;
+    uint8 _bucketCount;
+};
+
+/*
+ * Registration takes a lock, keep the handles (plugin members) and register
+ * in the constructor or Load(). Registering a name again returns the existing
+ * metric if the type matches, so values survive a hot reload. Metrics are
+ * never removed.
+ */
+class TC_GAME_API PluginMetricsRegistry
+{
+public:
+    static constexpr uint32 MAGIC = 0x544D4354;     // "TCMT"
+    static constexpr uint16 FORMAT_VERSION = 1;
+    static constexpr uint32 DEFAULT_CAPACITY = 1024;
+    
+    static PluginMetricsRegistry* Instance();
+    
+    // Creates the region, in the given file or in process memory if filePath
+    // is empty. Only the first call counts; registering a metric before it
+    // opens a process memory region of DEFAULT_CAPACITY.
+    bool Open(std::string const& filePath, uint32 capacity);
+    bool IsOpen() const { return _data != nullptr; }
+    bool IsShared() const { return !_filePath.empty(); }
+    std::string const& GetLastError() const { return _lastError; }
+    
+    PluginCounter GetCounter(std::string_view name, std::string_view help);
+    PluginGauge GetGauge(std::string_view name, std::string_view help);
+    PluginHistogram GetHistogram(std::string_view name, std::string_view help, std::initializer_list<double> bounds);
+    
+    uint32 GetMetricCount() const;
+    
+    // Backing memory of default handles and rejected registrations
+    static uint8* GetSink();
+
+private:
+    PluginMetricsRegistry();
+    ~PluginMetricsRegistry();
+    
+    PluginMetricDescriptor* Register(std::string_view name, std::string_view help, PluginMetricType type, double const* bounds, size_t bucketCount);
+    
+    PluginMetricsHeader& GetHeader() const { return *reinterpret_cast<PluginMetricsHeader*>(_data); }
+    PluginMetricDescriptor* GetDescriptors() const { return reinterpret_cast<PluginMetricDescriptor*>(_data + sizeof(PluginMetricsHeader)); }
+    
+    bool OpenRegion(std::string const& filePath, uint32 capacity);     // _mutex held
+    bool Map(std::string const& filePath, size_t size);
+    
+    std::mutex _mutex;
+    uint8* _data;
+    size_t _size;
+    uint64 _nextValueOffset;
+    std::string _filePath;
+#ifdef _WIN32
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+
+    std::unordered_map<std::string, uint32> _metrics;   // descriptor index by name
+    
+    std::string _lastError;
+};
+
+#define sPluginMetrics PluginMetricsRegistry::Instance()
+
+#endif // TRINITY_PLUGIN_METRICS_H
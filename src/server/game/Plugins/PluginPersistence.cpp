@@ -0,0 +1,412 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginPersistence.h"
+#include "PluginManifest.h"
+#include "PluginWorkerPool.h"
+#include "DatabaseEnv.h"
+#include "Errors.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#pragma pack(push, 1)
+    struct PluginSnapshotHeader
+    {
+        uint32 magic;
+        uint16 formatVersion;
+        uint16 reserved;
+        uint32 blobVersion;
+        uint32 size;
+        uint32 checksum;            // FNV-1a of the blob data
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(PluginSnapshotHeader) == 20, "PluginSnapshotHeader layout changed");
+    
+    std::string LastErrorMessage()
+    {
+#ifdef _WIN32
+        return std::error_code(int(::GetLastError()), std::system_category()).message();
+#else
+        return std::error_code(errno, std::generic_category()).message();
+#endif
+    }
+    
+    // Written and flushed to the disk before anything is renamed over the old
+    // snapshot, otherwise a crash can leave the new name pointing at an empty file
+    bool WriteSynced(std::filesystem::path const& path, PluginSnapshotHeader const& header, std::vector<uint8> const& data)
+    {
+        std::pair<char const*, size_t> const parts[] =
+        {
+            { reinterpret_cast<char const*>(&header), sizeof(header) },
+            { reinterpret_cast<char const*>(data.data()), data.size() }
+        };
+
+#ifdef _WIN32
+        HANDLE file = ::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        
+        bool written = true;
+        for (auto const& part : parts)
+        {
+            DWORD size = 0;
+            if (part.second && (!::WriteFile(file, part.first, DWORD(part.second), &size, nullptr) || size != part.second))
+            {
+                written = false;
+                break;
+            }
+        }
+        
+        written = written && ::FlushFileBuffers(file);
+        return ::CloseHandle(file) && written;
+#else
+        int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file < 0)
+            return false;
+        
+        bool written = true;
+        for (auto const& part : parts)
+        {
+            for (size_t offset = 0; written && offset < part.second; )
+            {
+                ssize_t size = ::write(file, part.first + offset, part.second - offset);
+                if (size > 0)
+                    offset += size_t(size);
+                else if (size < 0 && errno != EINTR)
+                    written = false;
+            }
+        }
+        
+        written = written && ::fsync(file) == 0;
+        return ::close(file) == 0 && written;
+#endif
+    }
+    
+    // The rename itself is only durable once the directory entry reaches the disk
+    bool ReplaceSynced(std::filesystem::path const& temporary, std::filesystem::path const& target, std::string& error)
+    {
+#ifdef _WIN32
+        if (!::MoveFileExW(temporary.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            error = "cannot replace " + target.string() + " (" + LastErrorMessage() + ")";
+            return false;
+        }
+#else
+        if (::rename(temporary.c_str(), target.c_str()) != 0)
+        {
+            error = "cannot replace " + target.string() + " (" + LastErrorMessage() + ")";
+            return false;
+        }
+        
+        std::filesystem::path directory = target.parent_path();
+        if (directory.empty())
+            directory = ".";
+        
+        int handle = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        bool synced = handle >= 0 && ::fsync(handle) == 0;
+        if (!synced)
+            error = "replaced " + target.string() + " but cannot sync " + directory.string() + " (" + LastErrorMessage() + ")";
+        
+        if (handle >= 0)
+            ::close(handle);
+        
+        if (!synced)
+            return false;
+#endif
+
+        return true;
+    }
+    
+    template<typename Database, typename Statement>
+    void CommitBatches(Database& database, std::vector<PluginStatement>& statements, size_t batchSize, std::unique_ptr<Statement> PluginStatement::* prepared)
+    {
+        for (size_t first = 0; first < statements.size(); first += batchSize)
+        {
+            auto transaction = database.BeginTransaction();
+            
+            size_t last = std::min(statements.size(), first + batchSize);
+            for (size_t i = first; i < last; ++i)
+            {
+                PluginStatement& statement = statements[i];
+                
+                // The transaction owns prepared statements once appended
+                if (Statement* preparedStatement = (statement.*prepared).release())
+                    transaction->Append(preparedStatement);
+                else
+                    transaction->Append(statement.Render([&database](std::string& text) { database.EscapeString(text); }).c_str());
+            }
+            
+            // Queued to the database workers, nothing here waits for the result
+            database.CommitTransaction(transaction);
+        }
+    }
+}
+
+PluginStatement::PluginStatement(std::string sql) : _sql(std::move(sql))
+{
+}
+
+PluginStatement::PluginStatement(CharacterDatabasePreparedStatement* statement) : _characterStatement(statement)
+{
+    ASSERT(statement, "PluginStatement needs a prepared statement");
+}
+
+PluginStatement::PluginStatement(WorldDatabasePreparedStatement* statement) : _worldStatement(statement)
+{
+    ASSERT(statement, "PluginStatement needs a prepared statement");
+}
+
+PluginStatement::PluginStatement(PluginStatement&& other) noexcept = default;
+PluginStatement& PluginStatement::operator=(PluginStatement&& other) noexcept = default;
+PluginStatement::~PluginStatement() = default;
+
+PluginStatement& PluginStatement::Bind(double value)
+{
+    // max_digits10 significant digits read back as the same double
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.17g", value);
+    _values.push_back({ text, false });
+    return *this;
+}
+
+PluginPersistence::PluginPersistence(PluginWorkerPool& workerPool) : _workerPool(workerPool), _flushInterval(1000), _batchSize(200), _sinceFlush(0)
+{
+}
+
+void PluginPersistence::Configure(uint32 flushInterval, uint32 batchSize)
+{
+    _flushInterval = flushInterval;
+    _batchSize = std::max<uint32>(batchSize, 1);
+}
+
+bool PluginPersistence::CheckDatabase(PluginDatabase database, PluginStatement const& statement)
+{
+    bool const valid = database == PluginDatabase::CHARACTER ? !statement._worldStatement : !statement._characterStatement;
+    if (!valid)
+        TC_LOG_ERROR("plugins", "Plugin persistence: dropped a statement prepared for the other database");
+    
+    return valid;
+}
+
+void PluginPersistence::Queue(PluginDatabase database, PluginStatement statement)
+{
+    if (!CheckDatabase(database, statement))
+        return;
+    
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    _queues[static_cast<size_t>(database)].push_back(std::move(statement));
+}
+
+void PluginPersistence::Queue(PluginDatabase database, std::vector<PluginStatement> statements)
+{
+    statements.erase(std::remove_if(statements.begin(), statements.end(), [database](PluginStatement const& statement)
+    {
+        return !CheckDatabase(database, statement);
+    }), statements.end());
+    
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    
+    std::vector<PluginStatement>& queue = _queues[static_cast<size_t>(database)];
+    queue.insert(queue.end(), std::make_move_iterator(statements.begin()), std::make_move_iterator(statements.end()));
+}
+
+size_t PluginPersistence::GetQueuedCount() const
+{
+    std::lock_guard<std::mutex> lock(_queueMutex);
+    
+    size_t count = 0;
+    for (std::vector<PluginStatement> const& queue : _queues)
+        count += queue.size();
+    
+    return count;
+}
+
+void PluginPersistence::Update(uint32 diff)
+{
+    _sinceFlush += diff;
+    if (_sinceFlush < _flushInterval)
+        return;
+    
+    _sinceFlush = 0;
+    Flush();
+}
+
+void PluginPersistence::Flush()
+{
+    std::array<std::vector<PluginStatement>, PLUGIN_DATABASE_COUNT> queues;
+    
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        for (size_t i = 0; i < PLUGIN_DATABASE_COUNT; ++i)
+            queues[i].swap(_queues[i]);
+    }
+    
+    std::vector<PluginStatement>& characterStatements = queues[static_cast<size_t>(PluginDatabase::CHARACTER)];
+    std::vector<PluginStatement>& worldStatements = queues[static_cast<size_t>(PluginDatabase::WORLD)];
+    
+    if (characterStatements.empty() && worldStatements.empty())
+        return;
+    
+    CommitBatches(CharacterDatabase, characterStatements, _batchSize, &PluginStatement::_characterStatement);
+    CommitBatches(WorldDatabase, worldStatements, _batchSize, &PluginStatement::_worldStatement);
+    
+    TC_LOG_DEBUG("plugins", "Plugin persistence: committed " SZFMTD " character and " SZFMTD " world statements",
+                 characterStatements.size(), worldStatements.size());
+}
+
+void PluginPersistence::SaveSnapshot(std::string const& path, PluginStateBlob blob)
+{
+    {
+        std::lock_guard<std::mutex> lock(_snapshotsMutex);
+        
+        // The task writing this path picks the newest blob up when it is done
+        auto result = _snapshots.try_emplace(path);
+        if (!result.second)
+        {
+            result.first->second = std::make_unique<PluginStateBlob>(std::move(blob));
+            return;
+        }
+    }
+    
+    // No owner, the task only runs core code and must finish even if the plugin goes away
+    _workerPool.Submit(nullptr, [this, path, blob = std::move(blob)]() mutable
+    {
+        WriteSnapshots(std::move(path), std::move(blob));
+    });
+}
+
+void PluginPersistence::WriteSnapshots(std::string path, PluginStateBlob blob)
+{
+    for (;;)
+    {
+        std::string error;
+        if (!WriteSnapshot(path, blob, error))
+            TC_LOG_ERROR("plugins", "Failed to save snapshot %s: %s", path.c_str(), error.c_str());
+        
+        std::lock_guard<std::mutex> lock(_snapshotsMutex);
+        
+        auto itr = _snapshots.find(path);
+        if (!itr->second)
+        {
+            _snapshots.erase(itr);
+            return;
+        }
+        
+        blob = std::move(*itr->second);
+        itr->second.reset();
+    }
+}
+
+bool PluginPersistence::WriteSnapshot(std::string const& path, PluginStateBlob const& blob, std::string& error)
+{
+    std::vector<uint8> const& data = blob.GetData();
+    
+    PluginSnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.formatVersion = SNAPSHOT_FORMAT_VERSION;
+    header.reserved = 0;
+    header.blobVersion = blob.GetVersion();
+    header.size = uint32(data.size());
+    header.checksum = PluginManifest::Checksum(data.data(), data.size());
+    
+    std::filesystem::path target(path);
+    std::filesystem::path temporary = target;
+    temporary += ".tmp";
+    
+    if (!WriteSynced(temporary, header, data))
+    {
+        error = "cannot write " + temporary.string() + " (" + LastErrorMessage() + ")";
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        return false;
+    }
+    
+    // Replaces the previous snapshot in one step
+    if (!ReplaceSynced(temporary, target, error))
+    {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        return false;
+    }
+    
+    return true;
+}
+
+bool PluginPersistence::ReadSnapshot(std::string const& path, PluginStateBlob& blob, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    
+    PluginSnapshotHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        error = path + " is truncated";
+        return false;
+    }
+    
+    if (header.magic != SNAPSHOT_MAGIC || header.formatVersion != SNAPSHOT_FORMAT_VERSION)
+    {
+        error = path + " is not a plugin snapshot";
+        return false;
+    }
+    
+    std::error_code sizeError;
+    uintmax_t fileSize = std::filesystem::file_size(path, sizeError);
+    if (sizeError || fileSize - sizeof(header) < header.size)
+    {
+        error = path + " is truncated";
+        return false;
+    }
+    
+    std::vector<uint8> data(header.size);
+    if (!file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size())))
+    {
+        error = path + " is truncated";
+        return false;
+    }
+    
+    if (PluginManifest::Checksum(data.data(), data.size()) != header.checksum)
+    {
+        error = path + " is corrupted, checksum mismatch";
+        return false;
+    }
+    
+    blob.SetVersion(header.blobVersion);
+    blob.SetData(std::move(data));
+    return true;
+}
@@ -0,0 +1,207 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_PERSISTENCE_H
+#define TRINITY_PLUGIN_PERSISTENCE_H
+
+#include "Define.h"
+#include "DatabaseEnvFwd.h"
+#include "PluginStateBlob.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PluginWorkerPool;
+
+enum class PluginDatabase : uint8
+{
+    CHARACTER = 0,
+    WORLD = 1
+};
+
+constexpr size_t PLUGIN_DATABASE_COUNT = 2;
+
+/*
+ * Statement for PluginPersistence::Queue, either one of the core's prepared
+ * statements or, opt-in through Text(), SQL for tables the core has no
+ * prepared statement for. The core's prepared statements are indexed by per
+ * database enums plugins cannot extend, so the values of a text statement are
+ * bound here by type and strings are escaped when the statement is committed.
+ * Never build the text itself from values.
+ */
+class TC_GAME_API PluginStatement
+{
+public:
+    // Prepared and bound through the core, e.g. CharacterDatabase.GetPreparedStatement(CHAR_...),
+    // owned by the statement from here on and committed as is
+    explicit PluginStatement(CharacterDatabasePreparedStatement* statement);
+    explicit PluginStatement(WorldDatabasePreparedStatement* statement);
+    
+    // SQL text with ? placeholders for the values passed to Bind()
+    static PluginStatement Text(std::string sql) { return PluginStatement(std::move(sql)); }
+    
+    PluginStatement(PluginStatement&& other) noexcept;
+    PluginStatement& operator=(PluginStatement&& other) noexcept;
+    ~PluginStatement();
+    
+    bool IsPrepared() const { return _characterStatement || _worldStatement; }
+    
+    // Text statements only, a prepared statement is bound through the core
+    PluginStatement& Bind(int64 value) { _values.push_back({ std::to_string(value), false }); return *this; }
+    PluginStatement& Bind(uint64 value) { _values.push_back({ std::to_string(value), false }); return *this; }
+    PluginStatement& Bind(int32 value) { return Bind(int64(value)); }
+    PluginStatement& Bind(uint32 value) { return Bind(uint64(value)); }
+    PluginStatement& Bind(double value);  // round trips, std::to_string keeps 6 decimals only
+    PluginStatement& Bind(std::string value) { _values.push_back({ std::move(value), true }); return *this; }
+    PluginStatement& Bind(char const* value) { return Bind(std::string(value)); }
+    
+    // Placeholders replaced by the bound values, escape(std::string&) quotes strings for the target database.
+    // A ? inside a quoted literal or identifier is left alone.
+    template<typename Escape>
+    std::string Render(Escape&& escape) const
+    {
+        std::string sql;
+        sql.reserve(_sql.size() + _values.size() * 8);
+        
+        size_t value = 0;
+        char quote = 0;
+        for (size_t i = 0; i < _sql.size(); ++i)
+        {
+            char c = _sql[i];
+            
+            if (quote)
+            {
+                // A doubled quote closes and reopens, a backslash escapes the next character
+                if (c == quote)
+                    quote = 0;
+                else if (c == '\\' && quote != '`' && i + 1 < _sql.size())
+                    sql += _sql[i++];
+                
+                sql += _sql[i];
+                continue;
+            }
+            
+            if (c == '\'' || c == '"' || c == '`')
+                quote = c;
+            
+            if (c != '?' || value >= _values.size())
+            {
+                sql += c;
+                continue;
+            }
+            
+            BoundValue const& bound = _values[value++];
+            if (!bound.quoted)
+            {
+                sql += bound.text;
+                continue;
+            }
+            
+            std::string text = bound.text;
+            escape(text);
+            sql += '\'';
+            sql += text;
+            sql += '\'';
+        }
+        
+        return sql;
+    }
+
+private:
+    friend class PluginPersistence;     // commits the prepared statements
+    
+    explicit PluginStatement(std::string sql);
+    
+    struct BoundValue
+    {
+        std::string text;
+        bool quoted;
+    };
+    
+    std::string _sql;
+    std::vector<BoundValue> _values;
+    std::unique_ptr<CharacterDatabasePreparedStatement> _characterStatement;
+    std::unique_ptr<WorldDatabasePreparedStatement> _worldStatement;
+};
+
+/*
+ * Plugin persistence without blocking the world thread.
+ *
+ * - Write-behind: statements queued from any thread are committed every flush
+ *   interval as asynchronous transactions of at most batchSize statements,
+ *   the database worker threads run them. Usually fed from the dirty records
+ *   of a PluginPlayerStore (see PluginPlayerStore::CollectDirty).
+ * - Snapshots: a PluginStateBlob written to a small checksummed binary file on
+ *   the worker pool. The file is written next to its target, flushed to the
+ *   disk and renamed over it, so readers and a restart after a crash see the
+ *   old or the new snapshot, never a torn one. Saving a path while its
+ *   previous snapshot is still being written only keeps the newest blob.
+ */
+class TC_GAME_API PluginPersistence
+{
+public:
+    static constexpr uint32 SNAPSHOT_MAGIC = 0x53504354;    // "TCPS"
+    static constexpr uint16 SNAPSHOT_FORMAT_VERSION = 1;
+    
+    explicit PluginPersistence(PluginWorkerPool& workerPool);
+    
+    PluginPersistence(PluginPersistence const&) = delete;
+    PluginPersistence& operator=(PluginPersistence const&) = delete;
+    
+    // flushInterval in milliseconds, 0 commits every world update
+    void Configure(uint32 flushInterval, uint32 batchSize);
+    
+    // Write-behind, any thread. A prepared statement queued for the other database is dropped.
+    void Queue(PluginDatabase database, PluginStatement statement);
+    void Queue(PluginDatabase database, std::vector<PluginStatement> statements);
+    size_t GetQueuedCount() const;
+    
+    // Snapshots, any thread
+    void SaveSnapshot(std::string const& path, PluginStateBlob blob);
+    
+    // Synchronous, for startup and shutdown
+    static bool WriteSnapshot(std::string const& path, PluginStateBlob const& blob, std::string& error);
+    static bool ReadSnapshot(std::string const& path, PluginStateBlob& blob, std::string& error);
+    
+    // World thread
+    void Update(uint32 diff);
+    void Flush();
+
+private:
+    static bool CheckDatabase(PluginDatabase database, PluginStatement const& statement);
+    
+    void WriteSnapshots(std::string path, PluginStateBlob blob);
+    
+    PluginWorkerPool& _workerPool;
+    
+    mutable std::mutex _queueMutex;
+    std::array<std::vector<PluginStatement>, PLUGIN_DATABASE_COUNT> _queues;
+    
+    // Paths with a snapshot being written, and the blob to write after it
+    std::mutex _snapshotsMutex;
+    std::unordered_map<std::string, std::unique_ptr<PluginStateBlob>> _snapshots;
+    
+    uint32 _flushInterval;
+    uint32 _batchSize;
+    uint32 _sinceFlush;
+};
+
+#endif // TRINITY_PLUGIN_PERSISTENCE_H
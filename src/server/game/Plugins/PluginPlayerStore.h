@@ -0,0 +1,482 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_PLAYER_STORE_H
+#define TRINITY_PLUGIN_PLAYER_STORE_H
+
+#include "Define.h"
+#include "PluginSweeper.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Per player records for plugins, keyed by the player GUID counter.
+ *
+ * Records are POD and stored by value in an open addressing table (linear
+ * probing, backward shift deletion) split into SHARD_COUNT independently
+ * locked shards, so map threads touching different players rarely meet on the
+ * same lock. Every access moves the record to the front of its shard's LRU
+ * list, which gives two bounded eviction policies:
+ * - capacity: inserting into a full shard evicts its least recently used record
+ * - ttl: records not accessed for ttl time units are dropped oldest first
+ *
+ * Registered with the PluginSweeper (sPluginManager->GetSweeper().Register()),
+ * the store is swept a bounded number of records per world tick: expired
+ * records go, as do the oldest records of shards left over capacity by a
+ * lowered limit. Expire() does the same for one batch per shard, for plugins
+ * that clean up from their own timer.
+ *
+ * Time is whatever unit the caller passes to Sweep()/Expire() (game time in
+ * seconds with the sweeper), accesses are stamped with the time of the last
+ * of those calls.
+ *
+ * With dirty tracking enabled, records written through Update()/Modify() are
+ * remembered until CollectDirty() hands them out, so a plugin persisting the
+ * store only writes the records that changed (see PluginPersistence).
+ * Records evicted or removed before that are not reported.
+ *
+ * Callbacks given to Update()/Modify() run under the shard lock and must not
+ * access the store again.
+ */
+template<typename T>
+class PluginPlayerStore : public PluginSweepable
+{
+    static_assert(std::is_trivially_copyable<T>::value, "PluginPlayerStore records must be trivially copyable");
+
+public:
+    static constexpr uint32 SHARD_BITS = 4;
+    static constexpr uint32 SHARD_COUNT = 1 << SHARD_BITS;
+    
+    // capacity 0 keeps every record, ttl 0 disables expiry
+    explicit PluginPlayerStore(uint32 capacity = 0, uint32 ttl = 0) : _now(0), _trackDirty(false), _sweepShard(0) { SetLimits(capacity, ttl); }
+    ~PluginPlayerStore() { StopSweeping(); }
+    
+    PluginPlayerStore(PluginPlayerStore const&) = delete;
+    PluginPlayerStore& operator=(PluginPlayerStore const&) = delete;
+    
+    void SetLimits(uint32 capacity, uint32 ttl)
+    {
+        // Split evenly, a shard holding more than its share evicts a bit early
+        _shardCapacity.store(capacity ? (capacity + SHARD_COUNT - 1) / SHARD_COUNT : 0, std::memory_order_relaxed);
+        _ttl.store(ttl, std::memory_order_relaxed);
+    }
+    
+    void SetDirtyTracking(bool enabled) { _trackDirty.store(enabled, std::memory_order_relaxed); }
+    
+    // Runs fn(T&) on the record, value initialized first if the player has none
+    template<typename Fn>
+    void Update(uint32 guid, Fn&& fn)
+    {
+        Shard& shard = GetShard(guid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        
+        uint32 entry = Find(shard, guid);
+        if (entry == INVALID_INDEX)
+            entry = Insert(shard, guid);
+        else
+            Touch(shard, entry);
+        
+        fn(shard.entries[entry].value);
+        MarkDirty(shard, entry);
+    }
+    
+    // Runs fn(T&) only if the player has a record
+    template<typename Fn>
+    bool Modify(uint32 guid, Fn&& fn)
+    {
+        Shard& shard = GetShard(guid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        
+        uint32 entry = Find(shard, guid);
+        if (entry == INVALID_INDEX)
+            return false;
+        
+        Touch(shard, entry);
+        fn(shard.entries[entry].value);
+        MarkDirty(shard, entry);
+        return true;
+    }
+    
+    bool Get(uint32 guid, T& value)
+    {
+        Shard& shard = GetShard(guid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        
+        uint32 entry = Find(shard, guid);
+        if (entry == INVALID_INDEX)
+            return false;
+        
+        Touch(shard, entry);
+        value = shard.entries[entry].value;
+        return true;
+    }
+    
+    bool Remove(uint32 guid)
+    {
+        Shard& shard = GetShard(guid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        
+        uint32 entry = Find(shard, guid);
+        if (entry == INVALID_INDEX)
+            return false;
+        
+        Erase(shard, entry);
+        return true;
+    }
+    
+    void Clear()
+    {
+        for (Shard& shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.slots.clear();
+            shard.entries.clear();
+            shard.dirty.clear();
+            shard.head = shard.tail = INVALID_INDEX;
+            shard.size.store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    // Calls fn(guid, value) for every record written since the last call, one shard locked at a time
+    template<typename Fn>
+    uint32 CollectDirty(Fn&& fn)
+    {
+        uint32 collected = 0;
+        for (Shard& shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            
+            for (uint32 guid : shard.dirty)
+            {
+                // Removed since, or reported already under a duplicate guid
+                uint32 entry = Find(shard, guid);
+                if (entry == INVALID_INDEX || !shard.entries[entry].dirty)
+                    continue;
+                
+                shard.entries[entry].dirty = false;
+                fn(guid, shard.entries[entry].value);
+                ++collected;
+            }
+            
+            shard.dirty.clear();
+        }
+        
+        return collected;
+    }
+    
+    // Calls fn(guid, value) for every record, locking one shard at a time
+    template<typename Fn>
+    void ForEach(Fn&& fn)
+    {
+        for (Shard& shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (Entry const& entry : shard.entries)
+                fn(entry.guid, entry.value);
+        }
+    }
+    
+    size_t GetSize() const
+    {
+        size_t size = 0;
+        for (Shard const& shard : _shards)
+            size += shard.size.load(std::memory_order_relaxed);
+        
+        return size;
+    }
+    
+    // Advances the store clock and drops up to `budget` expired records per shard
+    uint32 Expire(uint32 now, uint32 budget)
+    {
+        _now.store(now, std::memory_order_relaxed);
+        
+        uint32 ttl = _ttl.load(std::memory_order_relaxed);
+        if (!ttl)
+            return 0;
+        
+        uint32 removed = 0;
+        for (Shard& shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            
+            for (uint32 i = 0; i < budget && shard.tail != INVALID_INDEX; ++i)
+            {
+                if (now - shard.entries[shard.tail].lastAccess < ttl)
+                    break;
+                
+                Erase(shard, shard.tail);
+                ++removed;
+            }
+        }
+        
+        return removed;
+    }
+    
+    // Called by the PluginSweeper only. Resumes at the shard the previous sweep
+    // stopped in and leaves each shard once its oldest record is neither expired
+    // nor over capacity, every record looked at counts against the budget
+    uint32 Sweep(uint32 now, uint32 budget) override
+    {
+        _now.store(now, std::memory_order_relaxed);
+        
+        uint32 ttl = _ttl.load(std::memory_order_relaxed);
+        uint32 capacity = _shardCapacity.load(std::memory_order_relaxed);
+        uint32 examined = 0;
+        
+        for (uint32 visited = 0; visited < SHARD_COUNT; ++visited)
+        {
+            Shard& shard = _shards[_sweepShard];
+            
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                
+                while (shard.tail != INVALID_INDEX)
+                {
+                    // Out of budget, continue with this shard next time
+                    if (examined == budget)
+                        return examined;
+                    
+                    ++examined;
+                    
+                    bool expired = ttl && now - shard.entries[shard.tail].lastAccess >= ttl;
+                    bool overCapacity = capacity && shard.entries.size() > capacity;
+                    if (!expired && !overCapacity)
+                        break;
+                    
+                    Erase(shard, shard.tail);
+                }
+            }
+            
+            _sweepShard = (_sweepShard + 1) % SHARD_COUNT;
+        }
+        
+        return examined;
+    }
+
+private:
+    static constexpr uint32 INVALID_INDEX = 0xFFFFFFFF;
+    static constexpr uint32 MIN_SLOTS = 16;
+    
+    struct Slot
+    {
+        uint32 guid;
+        uint32 entry;                       // index into Shard::entries, INVALID_INDEX if empty
+    };
+    
+    struct Entry
+    {
+        uint32 guid;
+        uint32 lastAccess;
+        uint32 prev;                        // towards the most recently used entry
+        uint32 next;
+        bool dirty;
+        T value;
+    };
+    
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::vector<Slot> slots;            // power of two, at most 3/4 full
+        std::vector<Entry> entries;         // dense, compacted on erase
+        std::vector<uint32> dirty;          // guids of dirty records, may hold removed ones
+        uint32 head = INVALID_INDEX;        // most recently used
+        uint32 tail = INVALID_INDEX;        // least recently used
+        std::atomic<uint32> size{ 0 };
+    };
+    
+    static uint64 Hash(uint32 guid) { return uint64(guid) * UI64LIT(0x9E3779B97F4A7C15); }
+    
+    // The top bits pick the shard, bits below them the home slot
+    Shard& GetShard(uint32 guid) { return _shards[Hash(guid) >> (64 - SHARD_BITS)]; }
+    static uint32 GetHomeSlot(Shard const& shard, uint32 guid) { return uint32(Hash(guid) >> 20) & uint32(shard.slots.size() - 1); }
+    
+    uint32 FindSlot(Shard const& shard, uint32 guid) const
+    {
+        if (shard.slots.empty())
+            return INVALID_INDEX;
+        
+        uint32 mask = uint32(shard.slots.size() - 1);
+        for (uint32 slot = GetHomeSlot(shard, guid);; slot = (slot + 1) & mask)
+        {
+            Slot const& candidate = shard.slots[slot];
+            if (candidate.entry == INVALID_INDEX)
+                return INVALID_INDEX;
+            
+            if (candidate.guid == guid)
+                return slot;
+        }
+    }
+    
+    uint32 Find(Shard const& shard, uint32 guid) const
+    {
+        uint32 slot = FindSlot(shard, guid);
+        return slot != INVALID_INDEX ? shard.slots[slot].entry : INVALID_INDEX;
+    }
+    
+    void PlaceSlot(Shard& shard, uint32 guid, uint32 entry)
+    {
+        uint32 mask = uint32(shard.slots.size() - 1);
+        uint32 slot = GetHomeSlot(shard, guid);
+        while (shard.slots[slot].entry != INVALID_INDEX)
+            slot = (slot + 1) & mask;
+        
+        shard.slots[slot].guid = guid;
+        shard.slots[slot].entry = entry;
+    }
+    
+    void Grow(Shard& shard)
+    {
+        size_t slotCount = shard.slots.empty() ? MIN_SLOTS : shard.slots.size() * 2;
+        shard.slots.assign(slotCount, Slot{ 0, INVALID_INDEX });
+        
+        for (uint32 i = 0; i < shard.entries.size(); ++i)
+            PlaceSlot(shard, shard.entries[i].guid, i);
+    }
+    
+    uint32 Insert(Shard& shard, uint32 guid)
+    {
+        // One eviction at most, a shard over a lowered capacity is trimmed by Sweep()
+        uint32 capacity = _shardCapacity.load(std::memory_order_relaxed);
+        if (capacity && shard.entries.size() >= capacity && shard.tail != INVALID_INDEX)
+            Erase(shard, shard.tail);
+        
+        if ((shard.entries.size() + 1) * 4 > shard.slots.size() * 3)
+            Grow(shard);
+        
+        Entry entry;
+        entry.guid = guid;
+        entry.lastAccess = _now.load(std::memory_order_relaxed);
+        entry.prev = entry.next = INVALID_INDEX;
+        entry.dirty = false;
+        entry.value = T();
+        
+        uint32 index = uint32(shard.entries.size());
+        shard.entries.push_back(entry);
+        PlaceSlot(shard, guid, index);
+        PushFront(shard, index);
+        
+        shard.size.store(uint32(shard.entries.size()), std::memory_order_relaxed);
+        return index;
+    }
+    
+    void Erase(Shard& shard, uint32 entry)
+    {
+        uint32 guid = shard.entries[entry].guid;
+        Unlink(shard, entry);
+        
+        // Backward shift deletion keeps probe sequences intact without tombstones
+        uint32 mask = uint32(shard.slots.size() - 1);
+        uint32 hole = FindSlot(shard, guid);
+        for (uint32 slot = (hole + 1) & mask; shard.slots[slot].entry != INVALID_INDEX; slot = (slot + 1) & mask)
+        {
+            uint32 home = GetHomeSlot(shard, shard.slots[slot].guid);
+            
+            // Move the entry back unless its home lies cyclically in (hole, slot]
+            if (((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                shard.slots[hole] = shard.slots[slot];
+                hole = slot;
+            }
+        }
+        
+        shard.slots[hole].entry = INVALID_INDEX;
+        
+        // Keep entries dense by moving the last one into the gap
+        uint32 last = uint32(shard.entries.size() - 1);
+        if (entry != last)
+        {
+            Entry& moved = shard.entries[entry];
+            moved = shard.entries[last];
+            shard.slots[FindSlot(shard, moved.guid)].entry = entry;
+            
+            if (moved.prev != INVALID_INDEX)
+                shard.entries[moved.prev].next = entry;
+            else
+                shard.head = entry;
+            
+            if (moved.next != INVALID_INDEX)
+                shard.entries[moved.next].prev = entry;
+            else
+                shard.tail = entry;
+        }
+        
+        shard.entries.pop_back();
+        shard.size.store(uint32(shard.entries.size()), std::memory_order_relaxed);
+    }
+    
+    void MarkDirty(Shard& shard, uint32 entry)
+    {
+        if (!_trackDirty.load(std::memory_order_relaxed) || shard.entries[entry].dirty)
+            return;
+        
+        shard.entries[entry].dirty = true;
+        shard.dirty.push_back(shard.entries[entry].guid);
+    }
+    
+    void Touch(Shard& shard, uint32 entry)
+    {
+        shard.entries[entry].lastAccess = _now.load(std::memory_order_relaxed);
+        if (shard.head == entry)
+            return;
+        
+        Unlink(shard, entry);
+        PushFront(shard, entry);
+    }
+    
+    void Unlink(Shard& shard, uint32 entry)
+    {
+        Entry& node = shard.entries[entry];
+        
+        if (node.prev != INVALID_INDEX)
+            shard.entries[node.prev].next = node.next;
+        else
+            shard.head = node.next;
+        
+        if (node.next != INVALID_INDEX)
+            shard.entries[node.next].prev = node.prev;
+        else
+            shard.tail = node.prev;
+        
+        node.prev = node.next = INVALID_INDEX;
+    }
+    
+    void PushFront(Shard& shard, uint32 entry)
+    {
+        Entry& node = shard.entries[entry];
+        node.prev = INVALID_INDEX;
+        node.next = shard.head;
+        
+        if (shard.head != INVALID_INDEX)
+            shard.entries[shard.head].prev = entry;
+        else
+            shard.tail = entry;
+        
+        shard.head = entry;
+    }
+    
+    std::array<Shard, SHARD_COUNT> _shards;
+    std::atomic<uint32> _shardCapacity;
+    std::atomic<uint32> _ttl;
+    std::atomic<uint32> _now;
+    std::atomic<bool> _trackDirty;
+    uint32 _sweepShard;                     // sweeper thread only
+};
+
+#endif // TRINITY_PLUGIN_PLAYER_STORE_H
@@ -0,0 +1,189 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginProfiler.h"
+#include "Log.h"
+
+std::atomic<bool> PluginProfiler::_enabled(false);
+
+namespace
+{
+    thread_local void* threadProfilerShard = nullptr;
+}
+
+PluginProfiler* PluginProfiler::Instance()
+{
+    // Never destroyed, like the epoch domain, threads may still record during shutdown
+    static PluginProfiler* const instance = new PluginProfiler();
+    return instance;
+}
+
+void PluginProfiler::SetEnabled(bool enabled)
+{
+    if (_enabled.exchange(enabled, std::memory_order_relaxed) != enabled)
+        TC_LOG_INFO("plugins", "Plugin profiling %s", enabled ? "enabled" : "disabled");
+}
+
+void PluginProfiler::Cell::Clear()
+{
+    calls.store(0, std::memory_order_relaxed);
+    totalTicks.store(0, std::memory_order_relaxed);
+    maxTicks.store(0, std::memory_order_relaxed);
+    for (std::atomic<uint64>& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+PluginProfiler::Shard::~Shard()
+{
+    for (std::atomic<Cell*>& cell : cells)
+        delete cell.load(std::memory_order_relaxed);
+}
+
+uint32 PluginProfiler::GetBucket(uint64 ticks)
+{
+    if (ticks < (2u << SUB_BUCKET_BITS))
+        return uint32(ticks);
+    
+    uint32 magnitude = 63;
+    while (!(ticks >> magnitude))
+        --magnitude;
+    
+    // Top SUB_BUCKET_BITS bits below the leading one select the sub-bucket
+    uint32 subBucket = uint32(ticks >> (magnitude - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+    uint32 bucket = ((magnitude - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + subBucket;
+    return std::min(bucket, BUCKET_COUNT - 1);
+}
+
+uint64 PluginProfiler::GetBucketUpperBound(uint32 bucket)
+{
+    if (bucket < (2u << SUB_BUCKET_BITS))
+        return bucket;
+    
+    uint32 magnitude = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+    uint64 subBucket = bucket & ((1u << SUB_BUCKET_BITS) - 1);
+    uint64 lower = (uint64(1) << magnitude) | (subBucket << (magnitude - SUB_BUCKET_BITS));
+    return lower + (uint64(1) << (magnitude - SUB_BUCKET_BITS)) - 1;
+}
+
+PluginProfiler::Shard* PluginProfiler::GetThreadShard()
+{
+    if (threadProfilerShard)
+        return static_cast<Shard*>(threadProfilerShard);
+    
+    std::lock_guard<std::mutex> lock(_shardsMutex);
+    _shards.push_back(std::make_unique<Shard>());
+    threadProfilerShard = _shards.back().get();
+    return _shards.back().get();
+}
+
+void PluginProfiler::Record(uint16 pluginId, PluginEvent event, uint64 ticks)
+{
+    if (pluginId >= PLUGIN_MAX_IDS || event >= PluginEvent::MAX)
+        return;
+    
+    std::atomic<Cell*>& slot = GetThreadShard()->cells[GetCellIndex(pluginId, event)];
+    Cell* cell = slot.load(std::memory_order_acquire);
+    if (!cell)
+    {
+        cell = new Cell();
+        slot.store(cell, std::memory_order_release);
+    }
+    
+    // Only this thread writes to the cell, so load + store is enough
+    cell->calls.store(cell->calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    cell->totalTicks.store(cell->totalTicks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+    if (ticks > cell->maxTicks.load(std::memory_order_relaxed))
+        cell->maxTicks.store(ticks, std::memory_order_relaxed);
+    
+    std::atomic<uint64>& bucket = cell->buckets[GetBucket(ticks)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+PluginLatencySnapshot PluginProfiler::GetSnapshot(uint16 pluginId, PluginEvent event) const
+{
+    PluginLatencySnapshot snapshot = { };
+    if (pluginId >= PLUGIN_MAX_IDS || event >= PluginEvent::MAX)
+        return snapshot;
+    
+    std::array<uint64, BUCKET_COUNT> buckets = { };
+    uint64 totalTicks = 0;
+    uint64 maxTicks = 0;
+    
+    {
+        std::lock_guard<std::mutex> lock(_shardsMutex);
+        for (std::unique_ptr<Shard> const& shard : _shards)
+        {
+            Cell const* cell = shard->cells[GetCellIndex(pluginId, event)].load(std::memory_order_acquire);
+            if (!cell)
+                continue;
+            
+            snapshot.calls += cell->calls.load(std::memory_order_relaxed);
+            totalTicks += cell->totalTicks.load(std::memory_order_relaxed);
+            maxTicks = std::max(maxTicks, cell->maxTicks.load(std::memory_order_relaxed));
+            for (uint32 i = 0; i < BUCKET_COUNT; ++i)
+                buckets[i] += cell->buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    
+    if (!snapshot.calls)
+        return snapshot;
+    
+    auto percentile = [&](uint64 rank)
+    {
+        uint64 seen = 0;
+        for (uint32 i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(GetBucketUpperBound(i), maxTicks);
+        }
+        
+        return maxTicks;
+    };
+    
+    // Counters are read without synchronization, so the bucket sum may lag calls slightly
+    uint64 sampled = 0;
+    for (uint64 count : buckets)
+        sampled += count;
+    
+    snapshot.totalNanoseconds = PluginClock::ToNanoseconds(totalTicks);
+    snapshot.maxNanoseconds = PluginClock::ToNanoseconds(maxTicks);
+    snapshot.p50Nanoseconds = PluginClock::ToNanoseconds(percentile((sampled + 1) / 2));
+    snapshot.p99Nanoseconds = PluginClock::ToNanoseconds(percentile((sampled * 99 + 99) / 100));
+    return snapshot;
+}
+
+void PluginProfiler::Reset()
+{
+    std::lock_guard<std::mutex> lock(_shardsMutex);
+    for (std::unique_ptr<Shard> const& shard : _shards)
+        for (std::atomic<Cell*>& cell : shard->cells)
+            if (Cell* existing = cell.load(std::memory_order_acquire))
+                existing->Clear();
+}
+
+void PluginProfiler::ResetPlugin(uint16 pluginId)
+{
+    if (pluginId >= PLUGIN_MAX_IDS)
+        return;
+    
+    std::lock_guard<std::mutex> lock(_shardsMutex);
+    for (std::unique_ptr<Shard> const& shard : _shards)
+        for (size_t event = 0; event < PLUGIN_EVENT_COUNT; ++event)
+            if (Cell* existing = shard->cells[GetCellIndex(pluginId, PluginEvent(event))].load(std::memory_order_acquire))
+                existing->Clear();
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_PROFILER_H
+#define TRINITY_PLUGIN_PROFILER_H
+
+#include "IPlugin.h"
+#include "PluginClock.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct PluginLatencySnapshot
+{
+    uint64 calls;
+    uint64 totalNanoseconds;
+    uint64 maxNanoseconds;
+    uint64 p50Nanoseconds;
+    uint64 p99Nanoseconds;
+    
+    uint64 GetAverageNanoseconds() const { return calls ? totalNanoseconds / calls : 0; }
+};
+
+/*
+ * Per (plugin id, event) call counters and latency histograms.
+ *
+ * Every dispatching thread records into its own shard, so the hot path is a
+ * handful of relaxed stores with no locking and no shared cache lines. Shards
+ * are merged when the statistics are read. Latencies are kept in log-linear
+ * buckets (eight sub-buckets per power of two of clock ticks), giving about 12%
+ * precision up to the longest representable duration.
+ */
+class TC_GAME_API PluginProfiler
+{
+public:
+    static constexpr uint32 SUB_BUCKET_BITS = 3;
+    static constexpr uint32 BUCKET_COUNT = 64 << SUB_BUCKET_BITS;
+    
+    static PluginProfiler* Instance();
+    
+    static bool IsEnabled() { return _enabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool enabled);
+    
+    void Record(uint16 pluginId, PluginEvent event, uint64 ticks);
+    
+    // Read side, merges all thread shards
+    PluginLatencySnapshot GetSnapshot(uint16 pluginId, PluginEvent event) const;
+    
+    void Reset();
+    void ResetPlugin(uint16 pluginId);
+
+private:
+    PluginProfiler() { }
+    
+    struct Cell
+    {
+        // Single writer (the owning thread), relaxed atomics only so readers never tear
+        std::atomic<uint64> calls{ 0 };
+        std::atomic<uint64> totalTicks{ 0 };
+        std::atomic<uint64> maxTicks{ 0 };
+        std::array<std::atomic<uint64>, BUCKET_COUNT> buckets{};
+        
+        void Clear();
+    };
+    
+    static constexpr size_t CELL_COUNT = PLUGIN_MAX_IDS * PLUGIN_EVENT_COUNT;
+    
+    struct Shard
+    {
+        // Cells are allocated the first time a thread records for a (plugin, event) pair
+        std::array<std::atomic<Cell*>, CELL_COUNT> cells{};
+        
+        ~Shard();
+    };
+    
+    static size_t GetCellIndex(uint16 pluginId, PluginEvent event) { return pluginId * PLUGIN_EVENT_COUNT + static_cast<size_t>(event); }
+    static uint32 GetBucket(uint64 ticks);
+    static uint64 GetBucketUpperBound(uint32 bucket);
+    
+    Shard* GetThreadShard();
+    
+    static std::atomic<bool> _enabled;
+    
+    // Shards are owned here and outlive their threads so their samples stay readable
+    mutable std::mutex _shardsMutex;
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+#define sPluginProfiler PluginProfiler::Instance()
+
+#endif // TRINITY_PLUGIN_PROFILER_H
@@ -0,0 +1,106 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_STATE_BLOB_H
+#define TRINITY_PLUGIN_STATE_BLOB_H
+
+#include "Define.h"
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * In-memory state handed from the old to the new instance of a plugin during
+ * PluginManager::ReloadPlugin. The writer picks a version, the reader checks
+ * it and refuses blobs it does not understand. Values are stored as raw bytes,
+ * both instances run in the same process.
+ */
+class PluginStateBlob
+{
+public:
+    explicit PluginStateBlob(uint32 version = 0) : _version(version) { }
+    
+    uint32 GetVersion() const { return _version; }
+    void SetVersion(uint32 version) { _version = version; }
+    
+    std::vector<uint8> const& GetData() const { return _data; }
+    void SetData(std::vector<uint8> data) { _data = std::move(data); }
+    bool IsEmpty() const { return _data.empty(); }
+    
+    template<typename T>
+    void Write(T const& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "PluginStateBlob only stores trivially copyable values");
+        
+        size_t offset = _data.size();
+        _data.resize(offset + sizeof(T));
+        std::memcpy(_data.data() + offset, &value, sizeof(T));
+    }
+    
+    void WriteString(std::string_view value)
+    {
+        Write<uint32>(uint32(value.size()));
+        _data.insert(_data.end(), value.begin(), value.end());
+    }
+
+private:
+    uint32 _version;
+    std::vector<uint8> _data;
+};
+
+class PluginStateReader
+{
+public:
+    explicit PluginStateReader(PluginStateBlob const& blob) : _data(blob.GetData()), _position(0) { }
+    
+    // False without touching value once the blob is exhausted
+    template<typename T>
+    bool Read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "PluginStateBlob only stores trivially copyable values");
+        
+        if (_data.size() - _position < sizeof(T))
+            return false;
+        
+        std::memcpy(&value, _data.data() + _position, sizeof(T));
+        _position += sizeof(T);
+        return true;
+    }
+    
+    bool ReadString(std::string& value)
+    {
+        uint32 size;
+        if (!Read(size) || _data.size() - _position < size)
+            return false;
+        
+        value.assign(reinterpret_cast<char const*>(_data.data() + _position), size);
+        _position += size;
+        return true;
+    }
+    
+    bool AtEnd() const { return _position == _data.size(); }
+
+private:
+    std::vector<uint8> const& _data;
+    size_t _position;
+};
+
+#endif // TRINITY_PLUGIN_STATE_BLOB_H
@@ -0,0 +1,118 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_STATIC_MODULES_H
+#define TRINITY_PLUGIN_STATIC_MODULES_H
+
+#include "IPlugin.h"
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Modules linked into the server binary instead of being opened with dlopen,
+ * selected with MODULES_STATIC in modules/CMakeLists.txt.
+ *
+ * The build generates PluginStaticModuleList.h, which includes the module
+ * headers and defines TRINITY_STATIC_MODULE_LIST as the list of their plugin
+ * classes. The plugin manager creates them by index and registers them like
+ * any other plugin, so priorities, event masks, states and budgets still
+ * apply. Only the handler call differs: a module whose GetEventHandler() is
+ * declared with a covariant return type naming a final handler class is
+ * called through that concrete type. The compiler devirtualizes those calls
+ * and, with LTO, inlines the handler into the hook.
+ */
+
+#ifdef TRINITY_STATIC_MODULES
+#include "PluginStaticModuleList.h"
+#endif
+
+#ifndef TRINITY_STATIC_MODULE_LIST
+#define TRINITY_STATIC_MODULE_LIST
+#endif
+
+// Prefix of the pseudo file paths static modules are planned and loaded under
+#define PLUGIN_STATIC_MODULE_PREFIX "static:"
+
+template<typename Module>
+using PluginStaticHandler = std::remove_pointer_t<decltype(std::declval<Module&>().GetEventHandler())>;
+
+template<typename... Modules>
+class PluginStaticModuleSet
+{
+public:
+    static constexpr size_t Count = sizeof...(Modules);
+    
+    static std::unique_ptr<IPlugin> Create(size_t index)
+    {
+        (void)index;
+        return Create(index, std::index_sequence_for<Modules...>());
+    }
+    
+    // Calls fn, a generic lambda, with handler cast to the handler type of module index
+    template<typename Fn>
+    static std::invoke_result_t<Fn&, IEventHandler*> Invoke(size_t index, IEventHandler* handler, Fn& fn)
+    {
+        return Invoke(index, handler, fn, std::index_sequence_for<Modules...>());
+    }
+    
+    // Only final handler classes can be called without a virtual dispatch
+    template<typename Module>
+    static constexpr bool IsDevirtualized()
+    {
+        return std::is_final_v<PluginStaticHandler<Module>>;
+    }
+
+private:
+    template<size_t... I>
+    static std::unique_ptr<IPlugin> Create(size_t index, std::index_sequence<I...>)
+    {
+        std::unique_ptr<IPlugin> plugin;
+        (void)((index == I && (plugin = std::make_unique<Modules>(), true)) || ...);
+        return plugin;
+    }
+    
+    template<typename Module, typename Fn>
+    static std::invoke_result_t<Fn&, IEventHandler*> Call(IEventHandler* handler, Fn& fn)
+    {
+        if constexpr (IsDevirtualized<Module>())
+            return fn(static_cast<PluginStaticHandler<Module>*>(handler));
+        else
+            return fn(handler);
+    }
+    
+    template<typename Fn, size_t... I>
+    static std::invoke_result_t<Fn&, IEventHandler*> Invoke(size_t index, IEventHandler* handler, Fn& fn, std::index_sequence<I...>)
+    {
+        typedef std::invoke_result_t<Fn&, IEventHandler*> Result;
+        
+        if constexpr (std::is_void_v<Result>)
+        {
+            (void)((index == I && (Call<Modules>(handler, fn), true)) || ...);
+        }
+        else
+        {
+            Result result{};
+            (void)((index == I && (result = Call<Modules>(handler, fn), true)) || ...);
+            return result;
+        }
+    }
+};
+
+typedef PluginStaticModuleSet<TRINITY_STATIC_MODULE_LIST> PluginStaticModules;
+
+#endif // TRINITY_PLUGIN_STATIC_MODULES_H
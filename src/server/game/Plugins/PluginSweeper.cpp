@@ -0,0 +1,120 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginSweeper.h"
+#include "Errors.h"
+#include <algorithm>
+
+PluginSweepable::~PluginSweepable()
+{
+    StopSweeping();
+}
+
+void PluginSweepable::StopSweeping()
+{
+    if (PluginSweeper* sweeper = _sweeper.load(std::memory_order_relaxed))
+        sweeper->Unregister(*this);
+}
+
+PluginSweeper::PluginSweeper() : _ownerThread(std::this_thread::get_id()), _first(0), _budget(DEFAULT_BUDGET)
+{
+}
+
+PluginSweeper::~PluginSweeper()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (PluginSweepable* sweepable : _sweepables)
+        sweepable->_sweeper.store(nullptr, std::memory_order_relaxed);
+}
+
+void PluginSweeper::Register(PluginSweepable& sweepable)
+{
+    ASSERT(std::this_thread::get_id() == _ownerThread, "PluginSweeper::Register is world thread only, register from Start()");
+    
+    PluginSweeper* current = sweepable._sweeper.load(std::memory_order_relaxed);
+    if (current && current != this)
+        sweepable.StopSweeping();
+    
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (sweepable._sweeper.load(std::memory_order_relaxed) == this)
+        return;
+    
+    sweepable._sweeper.store(this, std::memory_order_relaxed);
+    _sweepables.push_back(&sweepable);
+}
+
+void PluginSweeper::Unregister(PluginSweepable& sweepable)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (sweepable._sweeper.load(std::memory_order_relaxed) != this)
+        return;
+    
+    sweepable._sweeper.store(nullptr, std::memory_order_relaxed);
+    
+    auto itr = std::find(_sweepables.begin(), _sweepables.end(), &sweepable);
+    size_t index = size_t(itr - _sweepables.begin());
+    
+    _sweepables.erase(itr);
+    if (index < _first)
+        --_first;
+    if (_first >= _sweepables.size())
+        _first = 0;
+}
+
+void PluginSweeper::SetBudget(uint32 budget)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = std::max<uint32>(budget, 1);
+}
+
+uint32 PluginSweeper::GetBudget() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _budget;
+}
+
+uint32 PluginSweeper::Update(uint32 now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    size_t const count = _sweepables.size();
+    if (!count)
+        return 0;
+    
+    uint32 remaining = _budget;
+    uint32 examined = 0;
+    
+    for (size_t visited = 0; visited < count && remaining; ++visited)
+    {
+        // An equal share of what is left, unused shares roll over to the next container
+        uint32 share = std::max<uint32>(remaining / uint32(count - visited), 1);
+        uint32 used = std::min(_sweepables[(_first + visited) % count]->Sweep(now, share), share);
+        
+        examined += used;
+        remaining -= used;
+    }
+    
+    _first = (_first + 1) % count;
+    return examined;
+}
+
+size_t PluginSweeper::GetSweepableCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sweepables.size();
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_SWEEPER_H
+#define TRINITY_PLUGIN_SWEEPER_H
+
+#include "Define.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PluginSweeper;
+
+/*
+ * A container whose stale entries are removed a few at a time by the
+ * PluginSweeper instead of in one pass over everything.
+ *
+ * Derived classes call StopSweeping() first thing in their destructor, the
+ * base destructor only runs after their members are gone.
+ */
+class TC_GAME_API PluginSweepable
+{
+public:
+    PluginSweepable() : _sweeper(nullptr) { }
+    virtual ~PluginSweepable();
+    
+    PluginSweepable(PluginSweepable const&) = delete;
+    PluginSweepable& operator=(PluginSweepable const&) = delete;
+    
+    // Examines at most `budget` entries and removes those that are due at
+    // `now` (game time in seconds). Returns the number examined, less than
+    // `budget` when nothing more is due.
+    virtual uint32 Sweep(uint32 now, uint32 budget) = 0;
+    
+    bool IsSweeping() const { return _sweeper.load(std::memory_order_relaxed) != nullptr; }
+    
+    // Unregisters from the sweeper, waits for a sweep in progress
+    void StopSweeping();
+
+private:
+    friend class PluginSweeper;
+    
+    std::atomic<PluginSweeper*> _sweeper;   // written under the mutex of the sweeper
+};
+
+/*
+ * Spreads the cleanup of plugin containers over world ticks. Every world
+ * update examines at most GetBudget() entries in total, shared evenly between
+ * the registered containers; a container with nothing due hands the rest of
+ * its share to the following ones, and the first container changes every
+ * tick so a small budget still reaches all of them.
+ *
+ * Register() and Update() run on the world thread, the one constructing the
+ * sweeper, and Register() asserts elsewhere (a plugin's Initialize() on the
+ * worker pool). Unregister() may be called from any thread.
+ */
+class TC_GAME_API PluginSweeper
+{
+public:
+    static constexpr uint32 DEFAULT_BUDGET = 256;
+    
+    PluginSweeper();
+    ~PluginSweeper();
+    
+    PluginSweeper(PluginSweeper const&) = delete;
+    PluginSweeper& operator=(PluginSweeper const&) = delete;
+    
+    void Register(PluginSweepable& sweepable);
+    void Unregister(PluginSweepable& sweepable);
+    
+    // Entries examined per world tick, at least one per registered container
+    void SetBudget(uint32 budget);
+    uint32 GetBudget() const;
+    
+    // Returns the number of entries examined
+    uint32 Update(uint32 now);
+    
+    size_t GetSweepableCount() const;
+
+private:
+    std::thread::id const _ownerThread;
+    mutable std::mutex _mutex;          // held while sweeping, see PluginSweepable::StopSweeping
+    std::vector<PluginSweepable*> _sweepables;
+    size_t _first;                      // sweeps first on the next update
+    uint32 _budget;
+};
+
+#endif // TRINITY_PLUGIN_SWEEPER_H
@@ -0,0 +1,102 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginSymbol.h"
+#include "Errors.h"
+#include "Log.h"
+#include <mutex>
+
+PluginSymbolTable::PluginSymbolTable() : _count(1)
+{
+    for (std::atomic<Chunk*>& chunk : _chunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+    
+    _chunks[0].store(new Chunk(), std::memory_order_relaxed);
+}
+
+PluginSymbolTable::~PluginSymbolTable()
+{
+    for (std::atomic<Chunk*>& chunk : _chunks)
+        delete chunk.load(std::memory_order_relaxed);
+}
+
+PluginSymbolTable* PluginSymbolTable::Instance()
+{
+    // Never destroyed, symbols stay valid while plugins unload during static destruction
+    static PluginSymbolTable* const instance = new PluginSymbolTable();
+    return instance;
+}
+
+PluginSymbol PluginSymbolTable::Intern(std::string_view name)
+{
+    PluginSymbol symbol = Find(name);
+    if (symbol)
+        return symbol;
+    
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    
+    // Interned by another thread between the two locks
+    auto itr = _symbols.find(name);
+    if (itr != _symbols.end())
+    {
+        symbol.id = itr->second;
+        return symbol;
+    }
+    
+    uint32 id = _count.load(std::memory_order_relaxed);
+    if (id >= MAX_SYMBOLS)
+    {
+        TC_LOG_FATAL("plugins", "PluginSymbolTable: more than %u interned plugin keys", MAX_SYMBOLS);
+        ABORT();
+    }
+    
+    Chunk* chunk = _chunks[id >> CHUNK_BITS].load(std::memory_order_relaxed);
+    if (!chunk)
+    {
+        chunk = new Chunk();
+        _chunks[id >> CHUNK_BITS].store(chunk, std::memory_order_release);
+    }
+    
+    std::string& stored = chunk->names[id & (CHUNK_SIZE - 1)];
+    stored.assign(name.data(), name.size());
+    _symbols.emplace(std::string_view(stored), id);
+    
+    _count.store(id + 1, std::memory_order_release);
+    
+    symbol.id = id;
+    return symbol;
+}
+
+PluginSymbol PluginSymbolTable::Find(std::string_view name) const
+{
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    
+    PluginSymbol symbol;
+    auto itr = _symbols.find(name);
+    if (itr != _symbols.end())
+        symbol.id = itr->second;
+    
+    return symbol;
+}
+
+std::string_view PluginSymbolTable::GetName(PluginSymbol symbol) const
+{
+    if (!symbol || symbol.id >= _count.load(std::memory_order_acquire))
+        return std::string_view();
+    
+    return _chunks[symbol.id >> CHUNK_BITS].load(std::memory_order_acquire)->names[symbol.id & (CHUNK_SIZE - 1)];
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_SYMBOL_H
+#define TRINITY_PLUGIN_SYMBOL_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interned string, compares and hashes as an integer. 0 is the invalid symbol.
+struct PluginSymbol
+{
+    uint32 id = 0;
+    
+    explicit operator bool() const { return id != 0; }
+    bool operator==(PluginSymbol const& other) const { return id == other.id; }
+    bool operator!=(PluginSymbol const& other) const { return id != other.id; }
+    bool operator<(PluginSymbol const& other) const { return id < other.id; }
+};
+
+namespace std
+{
+    template<>
+    struct hash<PluginSymbol>
+    {
+        size_t operator()(PluginSymbol const& symbol) const { return hash<uint32>()(symbol.id); }
+    };
+}
+
+/*
+ * Process wide string interning for plugin keys.
+ *
+ * Intern() a key once when a plugin registers it (constructor, Load) and keep
+ * the symbol; the same string always yields the same symbol for the lifetime of
+ * the process, so symbols can be shared between plugins. Names are never freed
+ * and GetName() is lock free.
+ */
+class TC_GAME_API PluginSymbolTable
+{
+public:
+    static constexpr uint32 CHUNK_BITS = 8;
+    static constexpr uint32 CHUNK_SIZE = 1 << CHUNK_BITS;
+    static constexpr uint32 MAX_CHUNKS = 256;
+    static constexpr uint32 MAX_SYMBOLS = CHUNK_SIZE * MAX_CHUNKS;
+    
+    static PluginSymbolTable* Instance();
+    
+    PluginSymbol Intern(std::string_view name);
+    PluginSymbol Find(std::string_view name) const;    // invalid symbol if the name was never interned
+    
+    std::string_view GetName(PluginSymbol symbol) const;
+    uint32 GetSymbolCount() const { return _count.load(std::memory_order_acquire); }
+
+private:
+    PluginSymbolTable();
+    ~PluginSymbolTable();
+    
+    struct Chunk
+    {
+        std::array<std::string, CHUNK_SIZE> names;
+    };
+    
+    mutable std::shared_mutex _mutex;
+    std::unordered_map<std::string_view, uint32> _symbols;  // views into the chunks
+    
+    std::array<std::atomic<Chunk*>, MAX_CHUNKS> _chunks;
+    std::atomic<uint32> _count;                             // including the invalid symbol 0
+};
+
+#define sPluginSymbols PluginSymbolTable::Instance()
+
+#endif // TRINITY_PLUGIN_SYMBOL_H
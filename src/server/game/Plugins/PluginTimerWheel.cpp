@@ -0,0 +1,318 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginTimerWheel.h"
+#include "Errors.h"
+#include <algorithm>
+
+void PluginTimerToken::Cancel()
+{
+    if (_wheel)
+        _wheel->CancelToken(_id);
+}
+
+PluginTimerWheel::PluginTimerWheel() : _ownerThread(std::this_thread::get_id()), _now(0), _activeTimers(0), _freeTimers(INVALID_INDEX)
+{
+    _slots.fill(INVALID_INDEX);
+    _occupied.fill(0);
+}
+
+PluginTimerWheel::~PluginTimerWheel()
+{
+    for (TokenSlot& slot : _tokens)
+        if (slot.owner)
+            slot.owner->_wheel = nullptr;
+}
+
+uint32 PluginTimerWheel::AllocateTimer()
+{
+    if (_freeTimers != INVALID_INDEX)
+    {
+        uint32 index = _freeTimers;
+        _freeTimers = _timers[index].next;
+        _timers[index].next = INVALID_INDEX;
+        return index;
+    }
+    
+    _timers.emplace_back();
+    return uint32(_timers.size() - 1);
+}
+
+void PluginTimerWheel::FreeTimer(uint32 index)
+{
+    Timer& timer = _timers[index];
+    
+    // Unlink from the token list
+    if (timer.tokenPrev != INVALID_INDEX)
+        _timers[timer.tokenPrev].tokenNext = timer.tokenNext;
+    else
+        _tokens[timer.token].head = timer.tokenNext;
+    
+    if (timer.tokenNext != INVALID_INDEX)
+        _timers[timer.tokenNext].tokenPrev = timer.tokenPrev;
+    
+    // A cancelled token waits for its firing timers before its slot is reused
+    if (!_tokens[timer.token].owner && _tokens[timer.token].head == INVALID_INDEX)
+        ReleaseToken(timer.token);
+    
+    timer.callback = nullptr;
+    timer.token = 0;
+    timer.tokenPrev = timer.tokenNext = INVALID_INDEX;
+    timer.firing = timer.cancelled = false;
+    ++timer.generation;
+    
+    timer.next = _freeTimers;
+    _freeTimers = index;
+    --_activeTimers;
+}
+
+PluginTimerId PluginTimerWheel::ScheduleOnce(PluginTimerToken& token, uint32 delay, PluginTimerCallback callback)
+{
+    return Schedule(token, delay, 0, std::move(callback));
+}
+
+PluginTimerId PluginTimerWheel::SchedulePeriodic(PluginTimerToken& token, uint32 interval, PluginTimerCallback callback)
+{
+    return Schedule(token, interval, std::max<uint32>(interval, 1), std::move(callback));
+}
+
+PluginTimerId PluginTimerWheel::Schedule(PluginTimerToken& token, uint32 delay, uint32 interval, PluginTimerCallback callback)
+{
+    ASSERT(std::this_thread::get_id() == _ownerThread, "PluginTimerWheel is world thread only, schedule timers from Start()");
+    
+    if (!token._wheel)
+    {
+        if (!_freeTokens.empty())
+        {
+            token._id = _freeTokens.back();
+            _freeTokens.pop_back();
+        }
+        else
+        {
+            token._id = uint32(_tokens.size());
+            _tokens.emplace_back();
+        }
+        
+        token._wheel = this;
+        _tokens[token._id].owner = &token;
+    }
+    
+    uint32 index = AllocateTimer();
+    Timer& timer = _timers[index];
+    
+    // Due no earlier than the next advance
+    timer.expiry = _now + std::max<uint32>(delay, 1);
+    timer.interval = interval;
+    timer.callback = std::move(callback);
+    timer.token = token._id;
+    timer.tokenPrev = INVALID_INDEX;
+    timer.tokenNext = _tokens[token._id].head;
+    
+    if (timer.tokenNext != INVALID_INDEX)
+        _timers[timer.tokenNext].tokenPrev = index;
+    _tokens[token._id].head = index;
+    
+    ++_activeTimers;
+    Insert(index);
+    
+    PluginTimerId id;
+    id.index = index;
+    id.generation = timer.generation;
+    return id;
+}
+
+void PluginTimerWheel::Cancel(PluginTimerId id)
+{
+    if (id.index >= _timers.size() || _timers[id.index].generation != id.generation)
+        return;
+    
+    Timer& timer = _timers[id.index];
+    
+    // A firing timer is released by Fire() once its callback returns
+    if (timer.firing)
+    {
+        timer.cancelled = true;
+        return;
+    }
+    
+    Unlink(id.index);
+    FreeTimer(id.index);
+}
+
+void PluginTimerWheel::CancelToken(uint32 tokenId)
+{
+    TokenSlot& slot = _tokens[tokenId];
+    slot.owner->_wheel = nullptr;
+    slot.owner = nullptr;
+    
+    uint32 index = slot.head;
+    if (index == INVALID_INDEX)
+        ReleaseToken(tokenId);
+    
+    // FreeTimer() releases the slot with the last timer, either here or once a firing timer returns
+    while (index != INVALID_INDEX)
+    {
+        uint32 next = _timers[index].tokenNext;
+        
+        PluginTimerId id;
+        id.index = index;
+        id.generation = _timers[index].generation;
+        Cancel(id);
+        
+        index = next;
+    }
+}
+
+void PluginTimerWheel::ReleaseToken(uint32 tokenId)
+{
+    _freeTokens.push_back(tokenId);
+}
+
+void PluginTimerWheel::Insert(uint32 index)
+{
+    Timer& timer = _timers[index];
+    uint64 delta = timer.expiry > _now ? timer.expiry - _now : 0;
+    
+    // Lowest level whose range covers the remaining time, timers past the top level wait in its farthest slot
+    uint32 level = 0;
+    while (level < LEVEL_COUNT - 1 && delta >= (uint64(1) << (SLOT_BITS * (level + 1))))
+        ++level;
+    
+    uint64 placement = std::min(timer.expiry, _now + (uint64(1) << (SLOT_BITS * LEVEL_COUNT)) - 1);
+    uint32 slot = level * SLOT_COUNT + uint32((placement >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+    
+    timer.slot = slot;
+    timer.prev = INVALID_INDEX;
+    timer.next = _slots[slot];
+    
+    if (timer.next != INVALID_INDEX)
+        _timers[timer.next].prev = index;
+    
+    _slots[slot] = index;
+    _occupied[level] |= uint64(1) << (slot & (SLOT_COUNT - 1));
+}
+
+void PluginTimerWheel::Unlink(uint32 index)
+{
+    Timer& timer = _timers[index];
+    if (timer.slot == INVALID_INDEX)
+        return;
+    
+    if (timer.prev != INVALID_INDEX)
+        _timers[timer.prev].next = timer.next;
+    else
+        _slots[timer.slot] = timer.next;
+    
+    if (timer.next != INVALID_INDEX)
+        _timers[timer.next].prev = timer.prev;
+    
+    if (_slots[timer.slot] == INVALID_INDEX)
+        _occupied[timer.slot / SLOT_COUNT] &= ~(uint64(1) << (timer.slot & (SLOT_COUNT - 1)));
+    
+    timer.slot = timer.prev = timer.next = INVALID_INDEX;
+}
+
+void PluginTimerWheel::Cascade(uint32 level)
+{
+    uint32 slot = level * SLOT_COUNT + uint32((_now >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+    
+    uint32 index = _slots[slot];
+    _slots[slot] = INVALID_INDEX;
+    _occupied[level] &= ~(uint64(1) << (slot & (SLOT_COUNT - 1)));
+    
+    while (index != INVALID_INDEX)
+    {
+        uint32 next = _timers[index].next;
+        Insert(index);
+        index = next;
+    }
+}
+
+void PluginTimerWheel::Fire(uint32 index)
+{
+    Unlink(index);
+    _timers[index].firing = true;
+    
+    // The callback may schedule timers and reallocate _timers, don't hold references across it
+    PluginTimerCallback callback = std::move(_timers[index].callback);
+    callback();
+    
+    // Cancel() during the callback only flags the timer
+    Timer& timer = _timers[index];
+    timer.firing = false;
+    
+    if (timer.cancelled || !timer.interval)
+    {
+        FreeTimer(index);
+        return;
+    }
+    
+    // Keep the period stable but never schedule into the past after a long tick
+    timer.expiry = std::max(timer.expiry + timer.interval, _now + 1);
+    timer.callback = std::move(callback);
+    Insert(index);
+}
+
+void PluginTimerWheel::Advance(uint32 diff)
+{
+    uint64 target = _now + diff;
+    
+    while (_now < target)
+    {
+        ++_now;
+        
+        // Entering a new block of a level moves its timers down, highest level first
+        for (uint32 level = LEVEL_COUNT - 1; level > 0; --level)
+            if (!(_now & ((uint64(1) << (SLOT_BITS * level)) - 1)) && _occupied[level])
+                Cascade(level);
+        
+        uint32 slot = uint32(_now & (SLOT_COUNT - 1));
+        if (!(_occupied[0] & (uint64(1) << slot)))
+            continue;
+        
+        // Detach the slot first, callbacks may schedule into it again
+        uint32 index = _slots[slot];
+        _slots[slot] = INVALID_INDEX;
+        _occupied[0] &= ~(uint64(1) << slot);
+        
+        _due.clear();
+        for (; index != INVALID_INDEX; index = _timers[index].next)
+        {
+            PluginTimerId id;
+            id.index = index;
+            id.generation = _timers[index].generation;
+            _due.push_back(id);
+        }
+        
+        for (PluginTimerId const& id : _due)
+            _timers[id.index].slot = INVALID_INDEX;
+        
+        for (PluginTimerId const& id : _due)
+        {
+            // An earlier callback of this batch cancelled the timer (its index
+            // may already belong to a new timer) or queued it again
+            Timer const& timer = _timers[id.index];
+            if (timer.generation != id.generation || timer.cancelled || timer.slot != INVALID_INDEX)
+                continue;
+            
+            if (timer.expiry <= _now)
+                Fire(id.index);
+            else
+                Insert(id.index);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_TIMER_WHEEL_H
+#define TRINITY_PLUGIN_TIMER_WHEEL_H
+
+#include "Define.h"
+#include <array>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class PluginTimerWheel;
+
+typedef std::function<void()> PluginTimerCallback;
+
+// Identifies a single scheduled timer, stays safe to cancel after the timer is gone
+struct PluginTimerId
+{
+    uint32 index = 0;
+    uint32 generation = 0;
+};
+
+/*
+ * Groups the timers of one owner, usually a plugin member. Cancel() and the
+ * destructor cancel every timer scheduled with the token, so a plugin cannot
+ * leave callbacks into its unloaded library behind.
+ */
+class TC_GAME_API PluginTimerToken
+{
+public:
+    PluginTimerToken() : _wheel(nullptr), _id(0) { }
+    ~PluginTimerToken() { Cancel(); }
+    
+    PluginTimerToken(PluginTimerToken const&) = delete;
+    PluginTimerToken& operator=(PluginTimerToken const&) = delete;
+    
+    // Cancels every timer of the token, it can be used for new timers afterwards
+    void Cancel();
+    bool IsActive() const { return _wheel != nullptr; }
+
+private:
+    friend class PluginTimerWheel;
+    
+    PluginTimerWheel* _wheel;
+    uint32 _id;
+};
+
+/*
+ * Hierarchical timer wheel with millisecond resolution, advanced once per
+ * world tick. Scheduling and cancelling are O(1); advancing visits one slot
+ * per elapsed millisecond plus the timers that come due, independent of the
+ * number of pending timers. Far timers sit in coarser levels and cascade
+ * down as their expiry gets closer.
+ *
+ * World thread only, callbacks run inside Advance(). The thread constructing
+ * the wheel owns it, scheduling from any other thread (a plugin's Initialize()
+ * on the worker pool, a map update) asserts. Tokens still attached when the
+ * wheel is destroyed are detached and their timers dropped.
+ */
+class TC_GAME_API PluginTimerWheel
+{
+public:
+    PluginTimerWheel();
+    ~PluginTimerWheel();
+    
+    PluginTimerWheel(PluginTimerWheel const&) = delete;
+    PluginTimerWheel& operator=(PluginTimerWheel const&) = delete;
+    
+    PluginTimerId ScheduleOnce(PluginTimerToken& token, uint32 delay, PluginTimerCallback callback);
+    PluginTimerId SchedulePeriodic(PluginTimerToken& token, uint32 interval, PluginTimerCallback callback);
+    void Cancel(PluginTimerId id);
+    
+    void Advance(uint32 diff);
+    
+    uint64 GetTime() const { return _now; }
+    size_t GetTimerCount() const { return _activeTimers; }
+
+private:
+    friend class PluginTimerToken;
+    
+    static constexpr uint32 SLOT_BITS = 6;
+    static constexpr uint32 SLOT_COUNT = 1 << SLOT_BITS;
+    static constexpr uint32 LEVEL_COUNT = 5;                // 2^30 ms, about 12 days
+    static constexpr uint32 INVALID_INDEX = 0xFFFFFFFF;
+    
+    struct Timer
+    {
+        uint64 expiry = 0;
+        uint32 interval = 0;                    // 0 for one-shot timers
+        uint32 generation = 1;
+        uint32 token = 0;                       // index into _tokens
+        
+        // Slot list, slot is INVALID_INDEX while the timer is not queued
+        uint32 slot = INVALID_INDEX;
+        uint32 prev = INVALID_INDEX;
+        uint32 next = INVALID_INDEX;
+        
+        // Token list
+        uint32 tokenPrev = INVALID_INDEX;
+        uint32 tokenNext = INVALID_INDEX;
+        
+        bool firing = false;
+        bool cancelled = false;
+        PluginTimerCallback callback;
+    };
+    
+    PluginTimerId Schedule(PluginTimerToken& token, uint32 delay, uint32 interval, PluginTimerCallback callback);
+    uint32 AllocateTimer();
+    void FreeTimer(uint32 index);
+    void CancelToken(uint32 tokenId);
+    void ReleaseToken(uint32 tokenId);
+    
+    void Insert(uint32 index);
+    void Unlink(uint32 index);
+    void Cascade(uint32 level);
+    void Fire(uint32 index);
+    
+    std::thread::id const _ownerThread;
+    uint64 _now;
+    size_t _activeTimers;
+    
+    std::vector<Timer> _timers;
+    uint32 _freeTimers;                         // free list through Timer::next
+    
+    // Heads of the slot lists, level * SLOT_COUNT + slot
+    std::array<uint32, LEVEL_COUNT * SLOT_COUNT> _slots;
+    std::array<uint64, LEVEL_COUNT> _occupied;  // bit per non empty slot
+    
+    struct TokenSlot
+    {
+        uint32 head = INVALID_INDEX;
+        PluginTimerToken* owner = nullptr;      // nullptr once cancelled, the slot is reused when head empties
+    };
+    
+    std::vector<TokenSlot> _tokens;
+    std::vector<uint32> _freeTokens;
+    std::vector<PluginTimerId> _due;            // scratch list for Advance(), generations detect timers cancelled meanwhile
+};
+
+#endif // TRINITY_PLUGIN_TIMER_WHEEL_H
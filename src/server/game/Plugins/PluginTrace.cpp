@@ -0,0 +1,228 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginTrace.h"
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+std::atomic<bool> PluginTrace::_enabled(false);
+
+namespace
+{
+    thread_local PluginTraceRing* threadTraceRing = nullptr;
+    
+    uint32 RoundUpToPowerOfTwo(uint32 value)
+    {
+        uint32 result = 2;
+        while (result < value && result < (1u << 31))
+            result <<= 1;
+        
+        return result;
+    }
+    
+    void WriteJsonString(std::FILE* file, std::string const& text)
+    {
+        std::fputc('"', file);
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                std::fprintf(file, "\\%c", c);
+            else if (static_cast<unsigned char>(c) < 0x20)
+                std::fprintf(file, "\\u%04x", unsigned(static_cast<unsigned char>(c)));
+            else
+                std::fputc(c, file);
+        }
+        std::fputc('"', file);
+    }
+}
+
+PluginTraceRing::PluginTraceRing(uint32 thread, uint32 capacity)
+    : _head(0), _mask(RoundUpToPowerOfTwo(capacity) - 1), _thread(thread), _slots(new Slot[_mask + 1])
+{
+}
+
+void PluginTraceRing::Copy(uint64 since, std::vector<PluginTraceSpan>& spans) const
+{
+    uint64 const capacity = _mask + 1;
+    uint64 head = _head.load(std::memory_order_acquire);
+    uint64 first = head > capacity ? head - capacity : 0;
+    
+    size_t copied = spans.size();
+    std::vector<uint64> indices;
+    
+    for (uint64 index = first; index < head; ++index)
+    {
+        Slot const& slot = _slots[index & _mask];
+        uint64 end = slot.end.load(std::memory_order_relaxed);
+        if (end < since)
+            continue;
+        
+        uint64 meta = slot.meta.load(std::memory_order_relaxed);
+        PluginTraceSpan span;
+        span.start = slot.start.load(std::memory_order_relaxed);
+        span.end = end;
+        span.thread = _thread;
+        span.pluginId = uint16(meta);
+        span.event = static_cast<PluginEvent>(uint8(meta >> 16));
+        span.flags = uint8(meta >> 24);
+        spans.push_back(span);
+        indices.push_back(index);
+    }
+    
+    // Pairs with the fence in Push(): a slot the writer started reusing
+    // shows up in the head read below, drop those spans
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64 reused = _head.load(std::memory_order_relaxed);
+    uint64 firstIntact = reused + 1 > capacity ? reused + 1 - capacity : 0;
+    
+    size_t kept = copied;
+    for (size_t i = 0; i < indices.size(); ++i)
+        if (indices[i] >= firstIntact)
+            spans[kept++] = spans[copied + i];
+    
+    spans.resize(kept);
+}
+
+PluginTrace* PluginTrace::Instance()
+{
+    // Never destroyed, threads may still record during shutdown
+    static PluginTrace* const instance = new PluginTrace();
+    return instance;
+}
+
+void PluginTrace::SetCapacity(uint32 capacity)
+{
+    std::lock_guard<std::mutex> lock(_ringsMutex);
+    _capacity = std::max<uint32>(capacity, 2);
+}
+
+PluginTraceRing* PluginTrace::GetThreadRing()
+{
+    if (!IsEnabled())
+        return nullptr;
+    
+    if (threadTraceRing)
+        return threadTraceRing;
+    
+    std::lock_guard<std::mutex> lock(_ringsMutex);
+    
+    uint32 thread = uint32(_rings.size());
+    _rings.push_back(std::make_unique<PluginTraceRing>(thread, _capacity));
+    _threadNames.push_back("thread " + std::to_string(thread));
+    
+    threadTraceRing = _rings.back().get();
+    return threadTraceRing;
+}
+
+void PluginTrace::SetThreadName(std::string name)
+{
+    PluginTraceRing* ring = GetThreadRing();
+    if (!ring)
+        return;
+    
+    std::lock_guard<std::mutex> lock(_ringsMutex);
+    _threadNames[ring->GetThread()] = std::move(name);
+}
+
+void PluginTrace::Collect(uint32 milliseconds, Snapshot& snapshot) const
+{
+    uint64 now = PluginClock::Now();
+    uint64 window = PluginClock::FromNanoseconds(uint64(milliseconds) * 1000000);
+    uint64 since = now > window ? now - window : 0;
+    
+    {
+        std::lock_guard<std::mutex> lock(_ringsMutex);
+        
+        for (std::unique_ptr<PluginTraceRing> const& ring : _rings)
+            ring->Copy(since, snapshot.spans);
+        
+        snapshot.threadNames = _threadNames;
+    }
+    
+    std::sort(snapshot.spans.begin(), snapshot.spans.end(), [](PluginTraceSpan const& a, PluginTraceSpan const& b)
+    {
+        return a.start < b.start;
+    });
+}
+
+bool PluginTrace::WriteChromeTrace(std::string const& filePath, Snapshot const& snapshot, std::string& error)
+{
+    std::FILE* file = std::fopen(filePath.c_str(), "w");
+    if (!file)
+    {
+        error = "Cannot create trace file " + filePath + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+    
+    uint64 base = snapshot.spans.empty() ? 0 : snapshot.spans.front().start;
+    
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+    std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"worldserver plugins\"}}", file);
+    
+    for (size_t thread = 0; thread < snapshot.threadNames.size(); ++thread)
+    {
+        std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", uint32(thread));
+        WriteJsonString(file, snapshot.threadNames[thread]);
+        std::fputs("}}", file);
+    }
+    
+    for (PluginTraceSpan const& span : snapshot.spans)
+    {
+        std::string name;
+        if (span.pluginId == PLUGIN_TRACE_CORE_ID)
+            name = "tick";
+        else if (span.pluginId < PLUGIN_MAX_IDS && !snapshot.pluginNames[span.pluginId].empty())
+            name = snapshot.pluginNames[span.pluginId];
+        else
+            name = "plugin " + std::to_string(span.pluginId);
+        
+        name += ' ';
+        name += GetPluginEventName(span.event);
+        
+        // Chrome trace timestamps are microseconds
+        double start = double(PluginClock::ToNanoseconds(span.start - base)) / 1000.0;
+        double duration = double(PluginClock::ToNanoseconds(span.end - span.start)) / 1000.0;
+        
+        std::fputs(",\n{\"name\":", file);
+        WriteJsonString(file, name);
+        std::fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+            span.pluginId == PLUGIN_TRACE_CORE_ID ? "core" : "plugin", span.thread, start, duration);
+        
+        if (span.flags & PluginTraceSpan::FLAG_REJECTED)
+            std::fputs(",\"args\":{\"rejected\":true}", file);
+        
+        std::fputc('}', file);
+    }
+    
+    std::fputs("\n]}\n", file);
+    
+    bool written = !std::ferror(file);
+    if (std::fclose(file) != 0)
+        written = false;
+    
+    if (!written)
+    {
+        error = "Cannot write trace file " + filePath;
+        return false;
+    }
+    
+    return true;
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRINITY_PLUGIN_TRACE_H
+#define TRINITY_PLUGIN_TRACE_H
+
+#include "IPlugin.h"
+#include "PluginClock.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Plugin id of spans that do not belong to a plugin (the world tick itself)
+constexpr uint16 PLUGIN_TRACE_CORE_ID = 0xFFFF;
+
+struct PluginTraceSpan
+{
+    uint64 start;                   // PluginClock ticks
+    uint64 end;
+    uint32 thread;                  // index of the recording thread's ring
+    uint16 pluginId;
+    PluginEvent event;
+    uint8 flags;                    // FLAG_*
+    
+    enum Flags : uint8
+    {
+        FLAG_REJECTED   = 0x01      // a filtering handler (packets) returned false
+    };
+};
+
+/*
+ * Span ring of one thread. The owning thread is the only writer and never
+ * waits, readers copy it at any time and drop the spans overwritten while
+ * they were copying. Slots are relaxed atomics, so a concurrent copy never
+ * reads a torn span.
+ */
+class TC_GAME_API PluginTraceRing
+{
+public:
+    PluginTraceRing(uint32 thread, uint32 capacity);
+    
+    void Push(uint64 start, uint64 end, uint16 pluginId, PluginEvent event, uint8 flags = 0)
+    {
+        uint64 head = _head.load(std::memory_order_relaxed);
+        Slot& slot = _slots[head & _mask];
+        
+        // Orders the publication of the previous span before the slot is reused, see Copy()
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.meta.store(uint64(pluginId) | uint64(event) << 16 | uint64(flags) << 24, std::memory_order_relaxed);
+        
+        _head.store(head + 1, std::memory_order_release);
+    }
+    
+    // Appends the spans that ended at or after since (PluginClock ticks)
+    void Copy(uint64 since, std::vector<PluginTraceSpan>& spans) const;
+    
+    uint32 GetThread() const { return _thread; }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64> start{ 0 };
+        std::atomic<uint64> end{ 0 };
+        std::atomic<uint64> meta{ 0 };
+    };
+    
+    alignas(64) std::atomic<uint64> _head;  // spans ever pushed
+    uint64 _mask;
+    uint32 _thread;
+    std::unique_ptr<Slot[]> _slots;
+};
+
+/*
+ * Always on record of the plugin handlers that ran recently.
+ *
+ * The dispatch loops push one span per handler call into the ring of the
+ * calling thread, which stores the last Plugins.Trace.BufferSize spans.
+ * Collect() copies the spans of a time window from every ring and WriteChromeTrace()
+ * turns them into a Chrome / Perfetto trace (chrome://tracing, ui.perfetto.dev).
+ */
+class TC_GAME_API PluginTrace
+{
+public:
+    static constexpr uint32 DEFAULT_CAPACITY = 65536;
+    
+    static PluginTrace* Instance();
+    
+    static bool IsEnabled() { return _enabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    
+    // Spans per thread, applies to rings created afterwards
+    void SetCapacity(uint32 capacity);
+    
+    // Ring of the calling thread, nullptr while tracing is disabled
+    PluginTraceRing* GetThreadRing();
+    
+    // Shown as the thread name in the trace, for the calling thread
+    void SetThreadName(std::string name);
+    
+    struct Snapshot
+    {
+        std::vector<PluginTraceSpan> spans;                 // sorted by start
+        std::vector<std::string> threadNames;               // by ring index
+        std::array<std::string, PLUGIN_MAX_IDS> pluginNames;
+    };
+    
+    // Spans that ended during the last milliseconds, from any thread
+    void Collect(uint32 milliseconds, Snapshot& snapshot) const;
+    
+    static bool WriteChromeTrace(std::string const& filePath, Snapshot const& snapshot, std::string& error);
+
+private:
+    PluginTrace() : _capacity(DEFAULT_CAPACITY) { }
+    
+    static std::atomic<bool> _enabled;
+    
+    mutable std::mutex _ringsMutex;
+    std::vector<std::unique_ptr<PluginTraceRing>> _rings;  // outlive their threads, like profiler shards
+    std::vector<std::string> _threadNames;
+    uint32 _capacity;
+};
+
+#define sPluginTrace PluginTrace::Instance()
+
+#endif // TRINITY_PLUGIN_TRACE_H
@@ -0,0 +1,374 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginValue.h"
+#include <algorithm>
+#include <cstring>
+
+PluginValue::PluginValue(PluginValue const& other) : _type(PluginValueType::NONE)
+{
+    CopyFrom(other);
+}
+
+PluginValue::PluginValue(PluginValue&& other) noexcept : _length(other._length), _type(other._type)
+{
+    // Bitwise move, a heap string changes owner
+    std::memcpy(_chars, other._chars, sizeof(_chars));
+    other._type = PluginValueType::NONE;
+    other._length = 0;
+}
+
+PluginValue& PluginValue::operator=(PluginValue const& other)
+{
+    if (this != &other)
+    {
+        Release();
+        CopyFrom(other);
+    }
+    
+    return *this;
+}
+
+PluginValue& PluginValue::operator=(PluginValue&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        std::memcpy(_chars, other._chars, sizeof(_chars));
+        _length = other._length;
+        _type = other._type;
+        other._type = PluginValueType::NONE;
+        other._length = 0;
+    }
+    
+    return *this;
+}
+
+void PluginValue::AssignString(std::string_view value)
+{
+    _type = PluginValueType::STRING;
+    _length = uint32(value.size());
+    
+    if (_length <= INLINE_CAPACITY)
+    {
+        if (_length)
+            std::memcpy(_chars, value.data(), _length);
+    }
+    else
+    {
+        _heap = new char[_length];
+        std::memcpy(_heap, value.data(), _length);
+    }
+}
+
+void PluginValue::CopyFrom(PluginValue const& other)
+{
+    if (other._type == PluginValueType::STRING)
+    {
+        AssignString(other.GetString());
+        return;
+    }
+    
+    std::memcpy(_chars, other._chars, sizeof(_chars));
+    _length = other._length;
+    _type = other._type;
+}
+
+void PluginValue::Release()
+{
+    if (_type == PluginValueType::STRING && _length > INLINE_CAPACITY)
+        delete[] _heap;
+    
+    _type = PluginValueType::NONE;
+    _length = 0;
+}
+
+int64 PluginValue::GetInt(int64 defaultValue) const
+{
+    switch (_type)
+    {
+        case PluginValueType::INT:
+            return _int;
+        case PluginValueType::UINT:
+            return int64(_uint);
+        default:
+            return defaultValue;
+    }
+}
+
+uint64 PluginValue::GetUInt(uint64 defaultValue) const
+{
+    switch (_type)
+    {
+        case PluginValueType::UINT:
+            return _uint;
+        case PluginValueType::INT:
+            return uint64(_int);
+        default:
+            return defaultValue;
+    }
+}
+
+double PluginValue::GetFloat(double defaultValue) const
+{
+    switch (_type)
+    {
+        case PluginValueType::FLOAT:
+            return _float;
+        case PluginValueType::INT:
+            return double(_int);
+        case PluginValueType::UINT:
+            return double(_uint);
+        default:
+            return defaultValue;
+    }
+}
+
+std::string_view PluginValue::GetString(std::string_view defaultValue) const
+{
+    if (_type != PluginValueType::STRING)
+        return defaultValue;
+    
+    return std::string_view(GetStringData(), _length);
+}
+
+bool PluginValue::operator==(PluginValue const& other) const
+{
+    if (_type != other._type)
+        return false;
+    
+    switch (_type)
+    {
+        case PluginValueType::NONE:
+            return true;
+        case PluginValueType::BOOL:
+            return _bool == other._bool;
+        case PluginValueType::INT:
+            return _int == other._int;
+        case PluginValueType::UINT:
+            return _uint == other._uint;
+        case PluginValueType::FLOAT:
+            return _float == other._float;
+        case PluginValueType::STRING:
+            return GetString() == other.GetString();
+    }
+    
+    return false;
+}
+
+PluginPlayerValues::PluginPlayerValues(uint32 capacity, uint32 ttl) : _now(0), _shardCapacity(0), _ttl(0), _sweepShard(0)
+{
+    SetLimits(capacity, ttl);
+}
+
+PluginPlayerValues::~PluginPlayerValues()
+{
+    StopSweeping();
+}
+
+void PluginPlayerValues::SetLimits(uint32 capacity, uint32 ttl)
+{
+    _shardCapacity.store(capacity ? (capacity + SHARD_COUNT - 1) / SHARD_COUNT : 0, std::memory_order_relaxed);
+    _ttl.store(ttl, std::memory_order_relaxed);
+}
+
+PluginValue const* PluginPlayerValues::FindValue(Shard const& shard, uint32 guid, PluginSymbol key) const
+{
+    auto player = shard.players.find(guid);
+    if (player == shard.players.end())
+        return nullptr;
+    
+    Touch(shard, player->second);
+    
+    Fields const& fields = player->second.fields;
+    auto field = std::lower_bound(fields.begin(), fields.end(), key, [](std::pair<PluginSymbol, PluginValue> const& entry, PluginSymbol symbol)
+    {
+        return entry.first < symbol;
+    });
+    
+    return field != fields.end() && field->first == key ? &field->second : nullptr;
+}
+
+void PluginPlayerValues::Touch(Shard const& shard, PlayerValues const& player) const
+{
+    player.lastAccess = _now.load(std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, player.lru);
+}
+
+void PluginPlayerValues::ErasePlayer(Shard& shard, std::unordered_map<uint32, PlayerValues>::iterator player)
+{
+    shard.lru.erase(player->second.lru);
+    shard.players.erase(player);
+}
+
+void PluginPlayerValues::Set(uint32 guid, PluginSymbol key, PluginValue value)
+{
+    Shard& shard = GetShard(guid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    auto player = shard.players.find(guid);
+    if (player == shard.players.end())
+    {
+        // One eviction at most, a shard over a lowered capacity is trimmed by Sweep()
+        uint32 capacity = _shardCapacity.load(std::memory_order_relaxed);
+        if (capacity && shard.players.size() >= capacity)
+            ErasePlayer(shard, shard.players.find(shard.lru.back()));
+        
+        player = shard.players.emplace(guid, PlayerValues()).first;
+        player->second.lru = shard.lru.insert(shard.lru.begin(), guid);
+        player->second.lastAccess = _now.load(std::memory_order_relaxed);
+    }
+    else
+        Touch(shard, player->second);
+    
+    Fields& fields = player->second.fields;
+    auto field = std::lower_bound(fields.begin(), fields.end(), key, [](std::pair<PluginSymbol, PluginValue> const& entry, PluginSymbol symbol)
+    {
+        return entry.first < symbol;
+    });
+    
+    if (field != fields.end() && field->first == key)
+        field->second = std::move(value);
+    else
+        fields.emplace(field, key, std::move(value));
+}
+
+bool PluginPlayerValues::Remove(uint32 guid, PluginSymbol key)
+{
+    Shard& shard = GetShard(guid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    auto player = shard.players.find(guid);
+    if (player == shard.players.end())
+        return false;
+    
+    Fields& fields = player->second.fields;
+    auto field = std::find_if(fields.begin(), fields.end(), [key](std::pair<PluginSymbol, PluginValue> const& entry) { return entry.first == key; });
+    if (field == fields.end())
+        return false;
+    
+    fields.erase(field);
+    if (fields.empty())
+        ErasePlayer(shard, player);
+    
+    return true;
+}
+
+void PluginPlayerValues::RemovePlayer(uint32 guid)
+{
+    Shard& shard = GetShard(guid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    auto player = shard.players.find(guid);
+    if (player != shard.players.end())
+        ErasePlayer(shard, player);
+}
+
+void PluginPlayerValues::Clear()
+{
+    for (Shard& shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.players.clear();
+        shard.lru.clear();
+    }
+}
+
+PluginValue PluginPlayerValues::Get(uint32 guid, PluginSymbol key) const
+{
+    PluginValue result;
+    Read(guid, key, [&result](PluginValue const& value) { result = value; });
+    return result;
+}
+
+size_t PluginPlayerValues::GetSize() const
+{
+    size_t size = 0;
+    for (Shard const& shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size += shard.players.size();
+    }
+    
+    return size;
+}
+
+uint32 PluginPlayerValues::Expire(uint32 now, uint32 budget)
+{
+    _now.store(now, std::memory_order_relaxed);
+    
+    uint32 ttl = _ttl.load(std::memory_order_relaxed);
+    if (!ttl)
+        return 0;
+    
+    uint32 removed = 0;
+    for (Shard& shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        
+        for (uint32 i = 0; i < budget && !shard.lru.empty(); ++i)
+        {
+            auto oldest = shard.players.find(shard.lru.back());
+            if (now - oldest->second.lastAccess < ttl)
+                break;
+            
+            ErasePlayer(shard, oldest);
+            ++removed;
+        }
+    }
+    
+    return removed;
+}
+
+uint32 PluginPlayerValues::Sweep(uint32 now, uint32 budget)
+{
+    _now.store(now, std::memory_order_relaxed);
+    
+    uint32 ttl = _ttl.load(std::memory_order_relaxed);
+    uint32 capacity = _shardCapacity.load(std::memory_order_relaxed);
+    uint32 examined = 0;
+    
+    for (uint32 visited = 0; visited < SHARD_COUNT; ++visited)
+    {
+        Shard& shard = _shards[_sweepShard];
+        
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            
+            while (!shard.lru.empty())
+            {
+                // Out of budget, continue with this shard next time
+                if (examined == budget)
+                    return examined;
+                
+                ++examined;
+                
+                auto oldest = shard.players.find(shard.lru.back());
+                bool expired = ttl && now - oldest->second.lastAccess >= ttl;
+                bool overCapacity = capacity && shard.players.size() > capacity;
+                if (!expired && !overCapacity)
+                    break;
+                
+                ErasePlayer(shard, oldest);
+            }
+        }
+        
+        _sweepShard = (_sweepShard + 1) % SHARD_COUNT;
+    }
+    
+    return examined;
+}
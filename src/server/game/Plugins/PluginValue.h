@@ -0,0 +1,192 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_VALUE_H
+#define TRINITY_PLUGIN_VALUE_H
+
+#include "Define.h"
+#include "PluginSweeper.h"
+#include "PluginSymbol.h"
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class PluginValueType : uint8
+{
+    NONE,
+    BOOL,
+    INT,
+    UINT,
+    FLOAT,
+    STRING
+};
+
+/*
+ * Small buffer variant for plugin key-value data. Numbers and strings up to
+ * INLINE_CAPACITY bytes are stored inline, only longer strings allocate.
+ * Getters never throw, a value of another type yields the given default.
+ */
+class TC_GAME_API PluginValue
+{
+public:
+    static constexpr uint32 INLINE_CAPACITY = 24;
+    
+    PluginValue() : _int(0), _length(0), _type(PluginValueType::NONE) { }
+    PluginValue(bool value) : _bool(value), _length(0), _type(PluginValueType::BOOL) { }
+    PluginValue(int32 value) : _int(value), _length(0), _type(PluginValueType::INT) { }
+    PluginValue(int64 value) : _int(value), _length(0), _type(PluginValueType::INT) { }
+    PluginValue(uint32 value) : _uint(value), _length(0), _type(PluginValueType::UINT) { }
+    PluginValue(uint64 value) : _uint(value), _length(0), _type(PluginValueType::UINT) { }
+    PluginValue(float value) : _float(value), _length(0), _type(PluginValueType::FLOAT) { }
+    PluginValue(double value) : _float(value), _length(0), _type(PluginValueType::FLOAT) { }
+    PluginValue(std::string_view value) : _type(PluginValueType::NONE) { AssignString(value); }
+    PluginValue(std::string const& value) : PluginValue(std::string_view(value)) { }
+    PluginValue(char const* value) : PluginValue(std::string_view(value)) { }
+    
+    PluginValue(PluginValue const& other);
+    PluginValue(PluginValue&& other) noexcept;
+    PluginValue& operator=(PluginValue const& other);
+    PluginValue& operator=(PluginValue&& other) noexcept;
+    ~PluginValue() { Release(); }
+    
+    PluginValueType GetType() const { return _type; }
+    bool IsNull() const { return _type == PluginValueType::NONE; }
+    bool IsInline() const { return _type != PluginValueType::STRING || _length <= INLINE_CAPACITY; }
+    
+    bool GetBool(bool defaultValue = false) const { return _type == PluginValueType::BOOL ? _bool : defaultValue; }
+    int64 GetInt(int64 defaultValue = 0) const;
+    uint64 GetUInt(uint64 defaultValue = 0) const;
+    double GetFloat(double defaultValue = 0.0) const;
+    
+    // View into this value, valid until it is modified or destroyed
+    std::string_view GetString(std::string_view defaultValue = std::string_view()) const;
+    
+    bool operator==(PluginValue const& other) const;
+    bool operator!=(PluginValue const& other) const { return !(*this == other); }
+
+private:
+    void AssignString(std::string_view value);
+    void CopyFrom(PluginValue const& other);
+    void Release();
+    
+    char const* GetStringData() const { return _length <= INLINE_CAPACITY ? _chars : _heap; }
+    
+    union
+    {
+        bool _bool;
+        int64 _int;
+        uint64 _uint;
+        double _float;
+        char _chars[INLINE_CAPACITY];
+        char* _heap;
+    };
+    
+    uint32 _length;             // string length
+    PluginValueType _type;
+};
+
+/*
+ * Per player key-value data keyed by interned symbols. Players are spread over
+ * SHARD_COUNT independently locked shards; the fields of one player are kept
+ * in a small vector sorted by symbol, so a lookup is an integer hash and a
+ * short scan, no string hashing or allocation.
+ *
+ * Like PluginPlayerStore, every access moves the player to the front of its
+ * shard's LRU list: a full shard evicts its least recently used player on
+ * insert, and with a ttl, players not accessed for ttl time units are dropped
+ * by Sweep() (registered with the PluginSweeper) or Expire(). Plugins that do
+ * not persist the values call RemovePlayer() on logout.
+ */
+class TC_GAME_API PluginPlayerValues : public PluginSweepable
+{
+public:
+    static constexpr uint32 SHARD_COUNT = 16;
+    
+    // capacity 0 keeps every player, ttl 0 disables expiry
+    explicit PluginPlayerValues(uint32 capacity = 0, uint32 ttl = 0);
+    ~PluginPlayerValues();
+    
+    void SetLimits(uint32 capacity, uint32 ttl);
+    
+    void Set(uint32 guid, PluginSymbol key, PluginValue value);
+    bool Remove(uint32 guid, PluginSymbol key);
+    void RemovePlayer(uint32 guid);
+    void Clear();
+    
+    // Copies the value, cheap for numbers and inline strings
+    PluginValue Get(uint32 guid, PluginSymbol key) const;
+    
+    // Runs fn(PluginValue const&) under the shard lock, string views stay valid inside fn
+    template<typename Fn>
+    bool Read(uint32 guid, PluginSymbol key, Fn&& fn) const
+    {
+        Shard const& shard = GetShard(guid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        
+        PluginValue const* value = FindValue(shard, guid, key);
+        if (!value)
+            return false;
+        
+        fn(*value);
+        return true;
+    }
+    
+    // Number of players with at least one value
+    size_t GetSize() const;
+    
+    // Advances the clock and drops up to `budget` expired players per shard
+    uint32 Expire(uint32 now, uint32 budget);
+    
+    // Called by the PluginSweeper only, see PluginPlayerStore::Sweep
+    uint32 Sweep(uint32 now, uint32 budget) override;
+
+private:
+    typedef std::vector<std::pair<PluginSymbol, PluginValue>> Fields;
+    
+    struct PlayerValues
+    {
+        Fields fields;
+        mutable uint32 lastAccess;
+        std::list<uint32>::iterator lru;
+    };
+    
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<uint32, PlayerValues> players;
+        mutable std::list<uint32> lru;      // guids, most recently used first
+    };
+    
+    Shard& GetShard(uint32 guid) { return _shards[guid % SHARD_COUNT]; }
+    Shard const& GetShard(uint32 guid) const { return _shards[guid % SHARD_COUNT]; }
+    PluginValue const* FindValue(Shard const& shard, uint32 guid, PluginSymbol key) const;
+    void Touch(Shard const& shard, PlayerValues const& player) const;
+    void ErasePlayer(Shard& shard, std::unordered_map<uint32, PlayerValues>::iterator player);
+    
+    std::array<Shard, SHARD_COUNT> _shards;
+    std::atomic<uint32> _now;
+    std::atomic<uint32> _shardCapacity;
+    std::atomic<uint32> _ttl;
+    uint32 _sweepShard;                 // world thread, see Sweep()
+};
+
+#endif // TRINITY_PLUGIN_VALUE_H
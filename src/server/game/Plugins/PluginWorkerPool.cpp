@@ -0,0 +1,254 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginWorkerPool.h"
+#include "Errors.h"
+#include "Log.h"
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    thread_local PluginWorkerPool const* threadWorkerPool = nullptr;
+    thread_local size_t threadWorkerIndex = 0;
+}
+
+PluginWorkerPool::PluginWorkerPool()
+    : _running(false), _stopping(false), _queuedTasks(0), _activeTasks(0), _nextQueue(0)
+{
+}
+
+PluginWorkerPool::~PluginWorkerPool()
+{
+    Stop();
+}
+
+void PluginWorkerPool::Start(uint32 threadCount)
+{
+    std::lock_guard<std::mutex> lock(_startMutex);
+    if (_running.load(std::memory_order_relaxed))
+        return;
+    
+    if (!threadCount)
+        threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+    
+    {
+        std::lock_guard<std::mutex> wakeLock(_wakeMutex);
+        _stopping = false;
+    }
+    
+    _queues.clear();
+    for (uint32 i = 0; i < threadCount; ++i)
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    
+    for (uint32 i = 0; i < threadCount; ++i)
+        _threads.emplace_back(&PluginWorkerPool::WorkerThread, this, size_t(i));
+    
+    _running.store(true, std::memory_order_release);
+    TC_LOG_INFO("plugins", "Plugin worker pool started with %u threads", threadCount);
+}
+
+void PluginWorkerPool::Stop()
+{
+    std::lock_guard<std::mutex> lock(_startMutex);
+    if (!_running.load(std::memory_order_relaxed))
+        return;
+    
+    {
+        std::lock_guard<std::mutex> wakeLock(_wakeMutex);
+        _stopping = true;
+    }
+    
+    _wakeCondition.notify_all();
+    
+    for (std::thread& thread : _threads)
+        thread.join();
+    
+    _threads.clear();
+    _running.store(false, std::memory_order_release);
+}
+
+void PluginWorkerPool::Enqueue(PluginTask task)
+{
+    if (!_running.load(std::memory_order_acquire))
+        Start(0);
+    
+    size_t index = threadWorkerPool == this ? threadWorkerIndex : _nextQueue.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+    
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        _queues[index]->tasks.push_back(std::move(task));
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _queuedTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    _wakeCondition.notify_one();
+}
+
+bool PluginWorkerPool::TryPop(size_t workerIndex, PluginTask& task)
+{
+    // Own deque from the back, most recently pushed work is the most likely to still be cached
+    {
+        WorkerQueue& own = *_queues[workerIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    
+    // Steal the oldest task of another worker
+    for (size_t i = 1; i < _queues.size(); ++i)
+    {
+        WorkerQueue& victim = *_queues[(workerIndex + i) % _queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (lock.owns_lock() && !victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void PluginWorkerPool::RunTask(PluginTask& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+        _activeTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    // Exceptions are captured by the task wrapper built in Submit()
+    task();
+    task = PluginTask();
+    
+    bool idle;
+    
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        idle = _activeTasks.fetch_sub(1, std::memory_order_relaxed) == 1 && !_queuedTasks.load(std::memory_order_relaxed);
+    }
+    
+    if (idle)
+        _idleCondition.notify_all();
+}
+
+void PluginWorkerPool::WorkerThread(size_t workerIndex)
+{
+    threadWorkerPool = this;
+    threadWorkerIndex = workerIndex;
+    
+    for (;;)
+    {
+        PluginTask task;
+        if (TryPop(workerIndex, task))
+        {
+            RunTask(task);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(_wakeMutex);
+        
+        // Queued tasks are only left behind on stop once every deque is empty
+        if (_stopping && !_queuedTasks.load(std::memory_order_relaxed))
+            break;
+        
+        // Tasks may be counted but not yet visible to try_lock stealing, recheck without sleeping
+        if (_queuedTasks.load(std::memory_order_relaxed))
+        {
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        
+        _wakeCondition.wait(lock, [this] { return _stopping || _queuedTasks.load(std::memory_order_relaxed) > 0; });
+    }
+    
+    threadWorkerPool = nullptr;
+}
+
+void PluginWorkerPool::WaitIdle()
+{
+    ASSERT(threadWorkerPool != this, "PluginWorkerPool::WaitIdle called from a pool worker");
+    
+    std::unique_lock<std::mutex> lock(_wakeMutex);
+    _idleCondition.wait(lock, [this]
+    {
+        return !_queuedTasks.load(std::memory_order_relaxed) && !_activeTasks.load(std::memory_order_relaxed);
+    });
+}
+
+void PluginWorkerPool::PostCompletion(IPlugin const* owner, PluginTask completion)
+{
+    std::lock_guard<std::mutex> lock(_completionsMutex);
+    _completions.emplace_back(owner, std::move(completion));
+}
+
+void PluginWorkerPool::ProcessCompletions()
+{
+    std::vector<std::pair<IPlugin const*, PluginTask>> completions;
+    
+    {
+        std::lock_guard<std::mutex> lock(_completionsMutex);
+        if (_completions.empty())
+            return;
+        
+        completions.swap(_completions);
+    }
+    
+    for (auto& completion : completions)
+    {
+        try
+        {
+            completion.second();
+        }
+        catch (std::exception const& e)
+        {
+            TC_LOG_ERROR("plugins", "Plugin task failed: %s", e.what());
+        }
+        catch (...)
+        {
+            TC_LOG_ERROR("plugins", "Plugin task failed with an unknown exception");
+        }
+    }
+}
+
+void PluginWorkerPool::DiscardCompletions(IPlugin const* owner)
+{
+    std::vector<std::pair<IPlugin const*, PluginTask>> discarded;
+    
+    {
+        std::lock_guard<std::mutex> lock(_completionsMutex);
+        auto itr = std::stable_partition(_completions.begin(), _completions.end(), [owner](std::pair<IPlugin const*, PluginTask> const& completion)
+        {
+            return completion.first != owner;
+        });
+        
+        std::move(itr, _completions.end(), std::back_inserter(discarded));
+        _completions.erase(itr, _completions.end());
+    }
+    
+    // Destroyed outside the lock, the captured state may belong to the plugin being unloaded
+}
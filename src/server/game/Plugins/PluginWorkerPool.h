@@ -0,0 +1,295 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRINITY_PLUGIN_WORKER_POOL_H
+#define TRINITY_PLUGIN_WORKER_POOL_H
+
+#include "Define.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class IPlugin;
+class PluginWorkerPool;
+
+// Move-only type erased callable
+class PluginTask
+{
+public:
+    PluginTask() = default;
+    
+    template<typename Fn, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Fn>, PluginTask>>>
+    PluginTask(Fn&& fn) : _impl(std::make_unique<Impl<std::decay_t<Fn>>>(std::forward<Fn>(fn))) { }
+    
+    PluginTask(PluginTask&&) = default;
+    PluginTask& operator=(PluginTask&&) = default;
+    
+    explicit operator bool() const { return _impl != nullptr; }
+    void operator()() { _impl->Run(); }
+
+private:
+    struct Base
+    {
+        virtual ~Base() = default;
+        virtual void Run() = 0;
+    };
+    
+    template<typename Fn>
+    struct Impl : Base
+    {
+        template<typename F>
+        explicit Impl(F&& f) : fn(std::forward<F>(f)) { }
+        void Run() override { fn(); }
+        
+        Fn fn;
+    };
+    
+    std::unique_ptr<Base> _impl;
+};
+
+namespace PluginTaskDetail
+{
+    struct Empty { };
+    
+    template<typename T>
+    using Value = std::conditional_t<std::is_void_v<T>, Empty, T>;
+    
+    template<typename T>
+    struct State
+    {
+        explicit State(PluginWorkerPool* p, IPlugin const* o) : pool(p), owner(o), done(false), hasContinuation(false) { }
+        
+        PluginWorkerPool* pool;
+        IPlugin const* owner;
+        
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> done;
+        std::optional<Value<T>> value;
+        std::exception_ptr error;
+        
+        bool hasContinuation;
+        PluginTask continuation;
+        
+        void Complete(std::shared_ptr<State> const& self);
+        void PostContinuation(std::shared_ptr<State> const& self);
+    };
+}
+
+/*
+ * Handle to the result of a task submitted to the PluginWorkerPool.
+ * Then() registers a continuation that runs on the world thread once the task
+ * has finished, so it may safely touch game objects; it is skipped with an
+ * error logged if the task threw.
+ */
+template<typename T>
+class PluginTaskFuture
+{
+public:
+    PluginTaskFuture() = default;
+    explicit PluginTaskFuture(std::shared_ptr<PluginTaskDetail::State<T>> state) : _state(std::move(state)) { }
+    
+    bool IsValid() const { return _state != nullptr; }
+    bool IsReady() const { return _state && _state->done.load(std::memory_order_acquire); }
+    
+    // Blocks until the task has finished. Never call this from a pool worker.
+    void Wait() const
+    {
+        std::unique_lock<std::mutex> lock(_state->mutex);
+        _state->condition.wait(lock, [this] { return _state->done.load(std::memory_order_relaxed); });
+    }
+    
+    // Waits if necessary, rethrows the exception thrown by the task
+    template<typename U = T>
+    std::enable_if_t<!std::is_void_v<U>, U const&> Get() const
+    {
+        Wait();
+        if (_state->error)
+            std::rethrow_exception(_state->error);
+        return *_state->value;
+    }
+    
+    template<typename Fn>
+    void Then(Fn&& fn)
+    {
+        std::shared_ptr<PluginTaskDetail::State<T>> state = _state;
+        
+        PluginTaskDetail::State<T>* completed = state.get();    // no ownership, the posted completion keeps the state alive
+        
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->continuation = [completed, fn = std::forward<Fn>(fn)]() mutable
+        {
+            if constexpr (std::is_void_v<T>)
+                fn();
+            else
+                fn(*completed->value);
+        };
+        state->hasContinuation = true;
+        
+        bool done = state->done.load(std::memory_order_relaxed);
+        lock.unlock();
+        
+        if (done)
+            state->PostContinuation(state);
+    }
+
+private:
+    std::shared_ptr<PluginTaskDetail::State<T>> _state;
+};
+
+/*
+ * Shared worker threads for plugin background work (file I/O, container
+ * sweeps, ...). Each worker owns a task deque: it pops its newest task first
+ * and steals the oldest task of another worker when its own deque is empty.
+ * Tasks submitted from a worker go to that worker's deque, others are spread
+ * round robin.
+ *
+ * Tasks must not touch game objects, use PluginTaskFuture::Then() to get back
+ * to the world thread.
+ */
+class TC_GAME_API PluginWorkerPool
+{
+public:
+    PluginWorkerPool();
+    ~PluginWorkerPool();
+    
+    PluginWorkerPool(PluginWorkerPool const&) = delete;
+    PluginWorkerPool& operator=(PluginWorkerPool const&) = delete;
+    
+    // 0 picks half of the hardware threads. Started on first use if not started explicitly.
+    void Start(uint32 threadCount);
+    void Stop();        // runs all queued tasks, then joins the workers
+    bool IsRunning() const { return _running.load(std::memory_order_acquire); }
+    uint32 GetThreadCount() const { return uint32(_threads.size()); }
+    
+    // owner identifies the submitting plugin so its pending continuations can be dropped on unload
+    template<typename Fn>
+    auto Submit(IPlugin const* owner, Fn&& fn) -> PluginTaskFuture<std::invoke_result_t<std::decay_t<Fn>&>>
+    {
+        typedef std::invoke_result_t<std::decay_t<Fn>&> Result;
+        auto state = std::make_shared<PluginTaskDetail::State<Result>>(this, owner);
+        
+        Enqueue([state, fn = std::forward<Fn>(fn)]() mutable
+        {
+            try
+            {
+                if constexpr (std::is_void_v<Result>)
+                {
+                    fn();
+                    state->value.emplace();
+                }
+                else
+                    state->value.emplace(fn());
+            }
+            catch (...)
+            {
+                state->error = std::current_exception();
+            }
+            
+            state->Complete(state);
+        });
+        
+        return PluginTaskFuture<Result>(std::move(state));
+    }
+    
+    // Blocks until no task is queued or running
+    void WaitIdle();
+    
+    // World thread side
+    void ProcessCompletions();
+    void DiscardCompletions(IPlugin const* owner);
+    
+    void PostCompletion(IPlugin const* owner, PluginTask completion);
+
+private:
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<PluginTask> tasks;
+    };
+    
+    void Enqueue(PluginTask task);
+    bool TryPop(size_t workerIndex, PluginTask& task);
+    void WorkerThread(size_t workerIndex);
+    void RunTask(PluginTask& task);
+    
+    std::mutex _startMutex;
+    std::atomic<bool> _running;
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::vector<std::thread> _threads;
+    
+    std::mutex _wakeMutex;
+    std::condition_variable _wakeCondition;
+    std::condition_variable _idleCondition;
+    bool _stopping;
+    std::atomic<uint32> _queuedTasks;
+    std::atomic<uint32> _activeTasks;
+    std::atomic<uint32> _nextQueue;
+    
+    std::mutex _completionsMutex;
+    std::vector<std::pair<IPlugin const*, PluginTask>> _completions;
+};
+
+template<typename T>
+void PluginTaskDetail::State<T>::Complete(std::shared_ptr<State> const& self)
+{
+    bool post;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.store(true, std::memory_order_release);
+        post = hasContinuation;
+    }
+    
+    condition.notify_all();
+    
+    if (post)
+        PostContinuation(self);
+}
+
+template<typename T>
+void PluginTaskDetail::State<T>::PostContinuation(std::shared_ptr<State> const& self)
+{
+    pool->PostCompletion(owner, [self]()
+    {
+        PluginTask fn;
+        
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            fn = std::move(self->continuation);
+            self->hasContinuation = false;
+        }
+        
+        if (!fn)
+            return;
+        
+        if (self->error)
+            std::rethrow_exception(self->error);
+        
+        fn();
+    });
+}
+
+#endif // TRINITY_PLUGIN_WORKER_POOL_H
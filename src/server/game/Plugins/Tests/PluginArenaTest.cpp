@@ -0,0 +1,138 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginArena.h"
+#include <gtest/gtest.h>
+#include <cstring>
+
+namespace
+{
+    bool IsAligned(void* ptr, size_t alignment)
+    {
+        return (reinterpret_cast<uintptr_t>(ptr) & (alignment - 1)) == 0;
+    }
+}
+
+TEST(PluginArena, AllocationsAreAlignedAndDisjoint)
+{
+    PluginArena arena;
+    
+    char* previous = nullptr;
+    for (size_t alignment : { 1, 2, 4, 8, 16 })
+    {
+        char* ptr = static_cast<char*>(arena.Allocate(3, alignment));
+        EXPECT_TRUE(IsAligned(ptr, alignment));
+        
+        if (previous)
+            EXPECT_GE(ptr, previous + 3);
+        
+        std::memset(ptr, 0xAB, 3);
+        previous = ptr;
+    }
+}
+
+// A chunk whose end is not aligned must not hand out memory past that end
+TEST(PluginArena, AlignmentPastUnalignedChunkEnd)
+{
+    PluginArena arena;
+    
+    // Oversized, gets a chunk of exactly size + alignment bytes
+    char* large = static_cast<char*>(arena.Allocate(70001, 1));
+    std::memset(large, 0, 70001);
+    
+    char* ptr = static_cast<char*>(arena.Allocate(8, 8));
+    EXPECT_TRUE(IsAligned(ptr, 8));
+    EXPECT_TRUE(ptr + 8 <= large || ptr >= large + 70002);
+    std::memset(ptr, 0, 8);
+}
+
+// Reset merges the chunks of a tick into one of their summed size, which need not be aligned either
+TEST(PluginArena, AlignmentPastMergedChunkEnd)
+{
+    PluginArena arena;
+    
+    arena.Allocate(PluginArena::CHUNK_SIZE - 16, 1);
+    arena.Allocate(70001, 1);
+    arena.Reset();
+    
+    size_t const reserved = arena.GetReserved();
+    ASSERT_NE(reserved % 8, 0u);
+    
+    char* fill = static_cast<char*>(arena.Allocate(reserved - 1, 1));
+    std::memset(fill, 0, reserved - 1);
+    
+    char* ptr = static_cast<char*>(arena.Allocate(8, 8));
+    EXPECT_TRUE(IsAligned(ptr, 8));
+    std::memset(ptr, 0, 8);
+    EXPECT_GT(arena.GetReserved(), reserved);
+}
+
+TEST(PluginArena, ResetMergesChunks)
+{
+    PluginArena arena;
+    
+    for (int i = 0; i < 4; ++i)
+        arena.Allocate(PluginArena::CHUNK_SIZE / 2);
+    
+    size_t const used = arena.GetUsed();
+    EXPECT_GE(arena.GetReserved(), used);
+    
+    arena.Reset();
+    EXPECT_EQ(arena.GetUsed(), 0u);
+    EXPECT_GE(arena.GetPeak(), used);
+    
+    // The merged chunk holds the whole tick without growing
+    size_t const reserved = arena.GetReserved();
+    for (int i = 0; i < 4; ++i)
+        arena.Allocate(PluginArena::CHUNK_SIZE / 2);
+    
+    EXPECT_EQ(arena.GetReserved(), reserved);
+}
+
+TEST(PluginArena, ScopeRewindsAndLastAllocationIsReturned)
+{
+    PluginArena arena;
+    arena.Allocate(64);
+    size_t const used = arena.GetUsed();
+    
+    {
+        PluginArenaScope scope(arena);
+        arena.Allocate(PluginArena::CHUNK_SIZE);
+        EXPECT_GT(arena.GetUsed(), used);
+    }
+    
+    EXPECT_EQ(arena.GetUsed(), used);
+    
+    void* last = arena.Allocate(32, 1);
+    arena.Deallocate(last, 32);
+    EXPECT_EQ(arena.GetUsed(), used);
+}
+
+TEST(PluginArena, ArenaContainers)
+{
+    PluginArena arena;
+    
+    PluginArenaVector<uint32> values{ PluginArenaAllocator<uint32>(arena) };
+    for (uint32 i = 0; i < 10000; ++i)
+        values.push_back(i);
+    
+    EXPECT_EQ(values.size(), 10000u);
+    EXPECT_EQ(values[9999], 9999u);
+    
+    std::string_view copy = arena.Copy("scratch text");
+    EXPECT_EQ(copy, "scratch text");
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginPlayerStore.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+    struct Record
+    {
+        uint32 lastSeen;
+    };
+}
+
+// Expired records leave a registered store a budget at a time, over several world ticks
+TEST(PluginPlayerStore, SweeperEvictsExpiredRecordsAcrossTicks)
+{
+    uint32 const ttl = 3600;
+    uint32 const budget = 64;
+    
+    PluginSweeper sweeper;
+    sweeper.SetBudget(budget);
+    
+    PluginPlayerStore<Record> store(10000, ttl);
+    sweeper.Register(store);
+    
+    uint32 now = 1000;
+    sweeper.Update(now);
+    
+    for (uint32 guid = 1; guid <= 1000; ++guid)
+        store.Update(guid, [now](Record& record) { record.lastSeen = now; });
+    
+    // Kept alive by an access before the others expire
+    sweeper.Update(now + ttl / 2);
+    store.Update(42, [](Record&) { });
+    
+    now += ttl;
+    
+    uint32 ticks = 0;
+    size_t previous = store.GetSize();
+    while (store.GetSize() > 1)
+    {
+        sweeper.Update(now + ticks++);
+        
+        size_t size = store.GetSize();
+        EXPECT_LT(size, previous);
+        EXPECT_GE(size + budget, previous);
+        previous = size;
+        
+        ASSERT_LE(ticks, 1000u / (budget - PluginPlayerStore<Record>::SHARD_COUNT) + 2);
+    }
+    
+    EXPECT_GT(ticks, 1u);
+    
+    Record record;
+    EXPECT_TRUE(store.Get(42, record));
+    
+    // Nothing left to evict, the sweep stops at the oldest record of each shard
+    EXPECT_LE(sweeper.Update(now + ticks), PluginPlayerStore<Record>::SHARD_COUNT);
+    EXPECT_EQ(store.GetSize(), 1u);
+}
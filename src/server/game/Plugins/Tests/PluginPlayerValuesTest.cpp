@@ -0,0 +1,115 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PluginValue.h"
+#include <gtest/gtest.h>
+
+// Fields of one player are independent of each other and of other players
+TEST(PluginPlayerValues, StoresValuesPerPlayerAndKey)
+{
+    PluginPlayerValues values;
+    PluginSymbol const rank = sPluginSymbols->Intern("Rank");
+    PluginSymbol const title = sPluginSymbols->Intern("Title");
+    
+    values.Set(1, rank, PluginValue(uint32(3)));
+    values.Set(1, title, PluginValue("Champion"));
+    values.Set(2, rank, PluginValue(uint32(5)));
+    values.Set(1, rank, PluginValue(uint32(4)));
+    
+    EXPECT_EQ(values.GetSize(), 2u);
+    EXPECT_EQ(values.Get(1, rank).GetUInt(), 4u);
+    EXPECT_EQ(values.Get(1, title).GetString(), "Champion");
+    EXPECT_EQ(values.Get(2, rank).GetUInt(), 5u);
+    EXPECT_TRUE(values.Get(2, title).IsNull());
+    
+    // Wrong type reads fall back to the default instead of throwing
+    EXPECT_EQ(values.Get(1, title).GetUInt(7), 7u);
+    
+    EXPECT_TRUE(values.Remove(1, rank));
+    EXPECT_FALSE(values.Remove(1, rank));
+    EXPECT_TRUE(values.Get(1, rank).IsNull());
+    
+    // Removing the last field drops the player
+    EXPECT_TRUE(values.Remove(2, rank));
+    EXPECT_EQ(values.GetSize(), 1u);
+}
+
+// Strings above INLINE_CAPACITY live on the heap and survive copies of the value
+TEST(PluginPlayerValues, KeepsLongStringsAcrossCopies)
+{
+    PluginPlayerValues values;
+    PluginSymbol const key = sPluginSymbols->Intern("Note");
+    std::string const text(PluginValue::INLINE_CAPACITY * 3, 'x');
+    
+    PluginValue value(text);
+    EXPECT_FALSE(value.IsInline());
+    EXPECT_TRUE(PluginValue("short").IsInline());
+    
+    values.Set(1, key, value);
+    PluginValue copy = values.Get(1, key);
+    values.Clear();
+    
+    EXPECT_EQ(copy.GetString(), text);
+    EXPECT_EQ(copy, value);
+    EXPECT_FALSE(values.Read(1, key, [](PluginValue const&) { }));
+}
+
+// A full shard makes room for a new player by evicting its least recently used one
+TEST(PluginPlayerValues, EvictsLeastRecentlyUsedPlayer)
+{
+    PluginPlayerValues values(2 * PluginPlayerValues::SHARD_COUNT, 0);
+    PluginSymbol const key = sPluginSymbols->Intern("Rank");
+    
+    // Same shard, guid % SHARD_COUNT
+    uint32 const first = 1;
+    uint32 const second = first + PluginPlayerValues::SHARD_COUNT;
+    uint32 const third = second + PluginPlayerValues::SHARD_COUNT;
+    
+    values.Set(first, key, PluginValue(uint32(1)));
+    values.Set(second, key, PluginValue(uint32(2)));
+    values.Get(first, key);
+    values.Set(third, key, PluginValue(uint32(3)));
+    
+    EXPECT_EQ(values.GetSize(), 2u);
+    EXPECT_EQ(values.Get(first, key).GetUInt(), 1u);
+    EXPECT_TRUE(values.Get(second, key).IsNull());
+    EXPECT_EQ(values.Get(third, key).GetUInt(), 3u);
+}
+
+// Players not accessed for ttl are dropped by the sweep, accessed ones stay
+TEST(PluginPlayerValues, SweepDropsExpiredPlayers)
+{
+    PluginPlayerValues values(0, 60);
+    PluginSymbol const key = sPluginSymbols->Intern("Rank");
+    
+    values.Sweep(100, 256);
+    for (uint32 guid = 1; guid <= 40; ++guid)
+        values.Set(guid, key, PluginValue(guid));
+    
+    values.Sweep(130, 256);
+    values.Get(7, key);
+    
+    EXPECT_EQ(values.Sweep(159, 256), PluginPlayerValues::SHARD_COUNT);
+    EXPECT_EQ(values.GetSize(), 40u);
+    
+    values.Sweep(160, 256);
+    EXPECT_EQ(values.GetSize(), 1u);
+    EXPECT_EQ(values.Get(7, key).GetUInt(), 7u);
+    
+    values.RemovePlayer(7);
+    EXPECT_EQ(values.GetSize(), 0u);
+}
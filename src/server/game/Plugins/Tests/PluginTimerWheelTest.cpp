@@ -0,0 +1,115 @@
+/*
+ * This file is part of the TrinityCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PluginTimerWheel.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+// A callback cancelling a timer due in the same millisecond must keep it from firing
+TEST(PluginTimerWheel, CancelTimerDueInSameTick)
+{
+    PluginTimerWheel wheel;
+    PluginTimerToken token;
+    std::vector<char> fired;
+    
+    PluginTimerId second;
+    PluginTimerId first = wheel.ScheduleOnce(token, 10, [&]() { fired.push_back('A'); wheel.Cancel(second); });
+    second = wheel.ScheduleOnce(token, 10, [&]() { fired.push_back('B'); wheel.Cancel(first); });
+    
+    wheel.Advance(10);
+    
+    ASSERT_EQ(fired.size(), 1u);
+    EXPECT_EQ(wheel.GetTimerCount(), 0u);
+    
+    // Both indices were freed once, they are reused by exactly two new timers
+    PluginTimerId a = wheel.ScheduleOnce(token, 1, []() { });
+    PluginTimerId b = wheel.ScheduleOnce(token, 1, []() { });
+    PluginTimerId c = wheel.ScheduleOnce(token, 1, []() { });
+    EXPECT_NE(a.index, b.index);
+    EXPECT_NE(b.index, c.index);
+    EXPECT_NE(a.index, c.index);
+    
+    wheel.Advance(1);
+    EXPECT_EQ(wheel.GetTimerCount(), 0u);
+}
+
+// A timer rescheduled into the index of a cancelled due timer fires on its own schedule only
+TEST(PluginTimerWheel, CancelAndRescheduleInSameTick)
+{
+    PluginTimerWheel wheel;
+    PluginTimerToken token;
+    uint32 fired = 0;
+    uint32 replacementFired = 0;
+    
+    // Timers of one slot fire in no particular order, whichever runs first replaces the other
+    PluginTimerId timers[2];
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        timers[i] = wheel.ScheduleOnce(token, 5, [&, i]()
+        {
+            ++fired;
+            wheel.Cancel(timers[1 - i]);
+            wheel.ScheduleOnce(token, 5, [&]() { ++replacementFired; });
+        });
+    }
+    
+    wheel.Advance(5);
+    EXPECT_EQ(fired, 1u);
+    EXPECT_EQ(replacementFired, 0u);
+    
+    wheel.Advance(5);
+    EXPECT_EQ(fired, 1u);
+    EXPECT_EQ(replacementFired, 1u);
+    EXPECT_EQ(wheel.GetTimerCount(), 0u);
+}
+
+// Cancelling a periodic timer due in the same tick stops it for good
+TEST(PluginTimerWheel, CancelPeriodicTimerDueInSameTick)
+{
+    PluginTimerWheel wheel;
+    PluginTimerToken token;
+    uint32 fired[2] = { 0, 0 };
+    
+    PluginTimerId timers[2];
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        timers[i] = wheel.SchedulePeriodic(token, 4, [&, i]()
+        {
+            ++fired[i];
+            wheel.Cancel(timers[1 - i]);
+        });
+    }
+    
+    wheel.Advance(20);
+    EXPECT_EQ(fired[0] + fired[1], 5u);
+    EXPECT_TRUE(fired[0] == 0 || fired[1] == 0);
+    EXPECT_EQ(wheel.GetTimerCount(), 1u);
+    
+    token.Cancel();
+    EXPECT_EQ(wheel.GetTimerCount(), 0u);
+}
+
+// Scheduling from a thread other than the owner, e.g. Initialize() on the worker pool, fails loudly
+TEST(PluginTimerWheelDeathTest, ScheduleFromAnotherThreadAsserts)
+{
+    PluginTimerWheel wheel;
+    PluginTimerToken token;
+    
+    EXPECT_DEATH(std::thread([&]() { wheel.ScheduleOnce(token, 10, []() { }); }).join(), "");
+}